@@ -0,0 +1,449 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ComputePrimitives.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+
+#include "Profiling/GpuTimer.hpp"
+#include "Utils.hpp"
+
+ComputePrimitives::ComputePrimitives(const DeviceContext &context, uint32_t maxElementCount, uint32_t maxBindings) {
+    this->m_context = context;
+    this->m_maxElementCount = maxElementCount;
+    this->m_maxBlockCount = std::max(1u, (maxElementCount + 255) / 256);
+
+    if (!SupportsComputeSubgroupArithmetic(m_context.physicalDevice)) {
+        throw std::runtime_error("Compute primitives need subgroup arithmetic in the compute shaders");
+    }
+
+    CreateBuffers();
+    CreateDescriptors(maxBindings);
+    CreatePipelines();
+}
+
+void ComputePrimitives::CreateBuffers() {
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    bufferCreateInfo.size = sizeof(uint32_t) * m_maxBlockCount;
+    CreateBuffer(bufferCreateInfo, m_blockSumBuffer, m_blockSumBufferMemory);
+
+    bufferCreateInfo.size = sizeof(uint32_t) * std::max(1u, m_maxElementCount);
+    CreateBuffer(bufferCreateInfo, m_offsetBuffer, m_offsetBufferMemory);
+}
+
+void ComputePrimitives::CreateDescriptors(uint32_t maxBindings) {
+    //------------------------
+    // DESCRIPTOR SET LAYOUT
+    //------------------------
+    // input, flags, output, block sums, offsets and the result
+    std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute primitives descriptor set layout");
+    }
+
+    //-----------------
+    // DESCRIPTOR POOL
+    //-----------------
+    // one more set for the validation
+    const uint32_t setCount = maxBindings + 1;
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = static_cast<uint32_t>(bindings.size()) * setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = setCount;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute primitives descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, &m_validationDescriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate compute primitives descriptor set");
+    }
+}
+
+void ComputePrimitives::CreatePipelines() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute primitives pipeline layout");
+    }
+
+    // every pass is the same shader specialized with different PASS constant
+    VkSpecializationMapEntry passEntry{};
+    passEntry.constantID = 0;
+    passEntry.offset = 0;
+    passEntry.size = sizeof(uint32_t);
+
+    for (uint32_t pass = 0; pass < PASS_COUNT; pass++) {
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &passEntry;
+        specializationInfo.dataSize = sizeof(uint32_t);
+        specializationInfo.pData = &pass;
+
+        m_pipelines[pass] = CreateComputePipelineFromFile(m_context.logicalDevice, "Shaders/Compiled/Primitives.spv",
+                                                          m_pipelineLayout, &specializationInfo);
+    }
+}
+
+VkDescriptorSet ComputePrimitives::CreateBindings(const Buffers &buffers) {
+    VkDescriptorSet descriptorSet;
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Ran out of compute primitives descriptor sets, maxBindings has to be raised");
+    }
+
+    WriteBindings(descriptorSet, buffers);
+    return descriptorSet;
+}
+
+void ComputePrimitives::WriteBindings(VkDescriptorSet descriptorSet, const Buffers &buffers) {
+    // bindings the primitive does not use are never accessed, but they still need a valid buffer
+    auto orScratch = [this](VkBuffer buffer) {return buffer != VK_NULL_HANDLE ? buffer : m_blockSumBuffer;};
+
+    std::array<VkDescriptorBufferInfo, 6> bufferInfos = {{
+        {orScratch(buffers.input), 0, VK_WHOLE_SIZE},
+        {orScratch(buffers.flags), 0, VK_WHOLE_SIZE},
+        {orScratch(buffers.output), 0, VK_WHOLE_SIZE},
+        {m_blockSumBuffer, 0, VK_WHOLE_SIZE},
+        {m_offsetBuffer, 0, VK_WHOLE_SIZE},
+        {orScratch(buffers.result), 0, VK_WHOLE_SIZE},
+    }};
+    std::array<VkWriteDescriptorSet, 6> writes{};
+    for (uint32_t b = 0; b < writes.size(); b++) {
+        writes[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[b].dstSet = descriptorSet;
+        writes[b].dstBinding = b;
+        writes[b].descriptorCount = 1;
+        writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[b].pBufferInfo = &bufferInfos[b];
+    }
+    vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+//------------------
+// PRIMITIVES
+//------------------
+void ComputePrimitives::RecordScan(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count,
+                                   bool isInclusive) {
+    PushConstants pushConstants = BeginPrimitive(commandBuffer, bindings, count);
+    pushConstants.isInclusive = isInclusive ? 1 : 0;
+    RecordScanPasses(commandBuffer, pushConstants);
+}
+
+void ComputePrimitives::RecordCompact(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count) {
+    PushConstants pushConstants = BeginPrimitive(commandBuffer, bindings, count);
+    // exclusive scan of the flags is the position of every kept value, its total is the amount of them
+    pushConstants.useFlags = 1;
+    RecordScanPasses(commandBuffer, pushConstants);
+    Dispatch(commandBuffer, PASS_SCATTER, pushConstants.blockCount, pushConstants);
+}
+
+void ComputePrimitives::RecordHistogram(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count,
+                                        uint32_t binCount, uint32_t binShift) {
+    if (binCount == 0 || binCount > PRIMITIVES_MAX_BINS || (binCount & (binCount - 1)) != 0) {
+        throw std::runtime_error("Histogram bin count has to be power of two up to 256");
+    }
+
+    PushConstants pushConstants = BeginPrimitive(commandBuffer, bindings, count);
+    pushConstants.binCount = binCount;
+    pushConstants.binShift = binShift;
+    Dispatch(commandBuffer, PASS_CLEAR_BINS, 1, pushConstants);
+    Dispatch(commandBuffer, PASS_HISTOGRAM, pushConstants.blockCount, pushConstants);
+}
+
+void ComputePrimitives::RecordReduce(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count,
+                                     OPERATION operation) {
+    PushConstants pushConstants = BeginPrimitive(commandBuffer, bindings, count);
+    pushConstants.operation = operation;
+    Dispatch(commandBuffer, PASS_REDUCE_BLOCKS, pushConstants.blockCount, pushConstants);
+    Dispatch(commandBuffer, PASS_REDUCE_RESULT, 1, pushConstants);
+}
+
+ComputePrimitives::PushConstants ComputePrimitives::BeginPrimitive(VkCommandBuffer commandBuffer,
+                                                                   VkDescriptorSet bindings, uint32_t count) {
+    if (count > m_maxElementCount) {
+        throw std::runtime_error("Compute primitive got more values than its scratch buffers were created for");
+    }
+
+    // input might come from a compute shader or from a transfer, scratch buffers are shared with the previous primitive
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &bindings, 0,
+                            nullptr);
+
+    PushConstants pushConstants{};
+    pushConstants.count = count;
+    pushConstants.blockCount = (count + 255) / 256;
+    pushConstants.operation = OPERATION_ADD;
+    return pushConstants;
+}
+
+void ComputePrimitives::RecordScanPasses(VkCommandBuffer commandBuffer, PushConstants &pushConstants) {
+    pushConstants.operation = OPERATION_ADD;
+    Dispatch(commandBuffer, PASS_REDUCE_BLOCKS, pushConstants.blockCount, pushConstants);
+    Dispatch(commandBuffer, PASS_SCAN_BLOCK_SUMS, 1, pushConstants);
+    Dispatch(commandBuffer, PASS_SCAN, pushConstants.blockCount, pushConstants);
+}
+
+void ComputePrimitives::Dispatch(VkCommandBuffer commandBuffer, PASS pass, uint32_t groupCount,
+                                 const PushConstants &pushConstants) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[pass]);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+    // every pass consumes results of the previous one
+    InsertComputeBarrier(commandBuffer);
+}
+
+//------------------
+// VALIDATION
+//------------------
+void ComputePrimitives::Validate(VkQueue queue, VkCommandPool commandPool, uint32_t queueFamilyIndex) {
+    const uint32_t count = m_maxElementCount;
+    const VkDeviceSize size = sizeof(uint32_t) * std::max(count, PRIMITIVES_MAX_BINS);
+
+    // values have 16 bits so the histogram uses all of its bins, half of the flags is set
+    std::mt19937 generator(1234);
+    std::uniform_int_distribution<uint32_t> valueDistribution(0, 0xFFFF);
+    std::vector<uint32_t> values(count);
+    std::vector<uint32_t> flags(count);
+    for (uint32_t i = 0; i < count; i++) {
+        values[i] = valueDistribution(generator);
+        flags[i] = generator() & 1;
+    }
+
+    //----------
+    // BUFFERS
+    //----------
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    // input, flags, output and the result
+    const std::array<VkDeviceSize, 4> sizes = {size, size, size, sizeof(uint32_t)};
+    std::array<VkBuffer, 4> buffers{};
+    std::array<VkDeviceMemory, 4> buffersMemory{};
+    for (size_t i = 0; i < buffers.size(); i++) {
+        bufferCreateInfo.size = sizes[i];
+        CreateBuffer(bufferCreateInfo, buffers[i], buffersMemory[i]);
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    void *stagingMapped;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    CreateBuffer(bufferCreateInfo, stagingBuffer, stagingBufferMemory);
+    vkMapMemory(m_context.logicalDevice, stagingBufferMemory, 0, size, 0, &stagingMapped);
+
+    auto upload = [&](VkBuffer buffer, const std::vector<uint32_t> &data) {
+        memcpy(stagingMapped, data.data(), sizeof(uint32_t) * data.size());
+        CopyBuffer(m_context.logicalDevice, queue, commandPool, stagingBuffer, buffer, sizeof(uint32_t) * data.size());
+    };
+    auto download = [&](VkBuffer buffer, uint32_t valueCount) {
+        std::vector<uint32_t> data(valueCount);
+        if (valueCount == 0) return data;
+        CopyBuffer(m_context.logicalDevice, queue, commandPool, buffer, stagingBuffer, sizeof(uint32_t) * valueCount);
+        memcpy(data.data(), stagingMapped, sizeof(uint32_t) * valueCount);
+        return data;
+    };
+
+    upload(buffers[0], values);
+    upload(buffers[1], flags);
+    WriteBindings(m_validationDescriptorSet, {buffers[0], buffers[1], buffers[2], buffers[3]});
+
+    //----------
+    // RUNS
+    //----------
+    GpuTimer timer(m_context.physicalDevice, m_context.logicalDevice, queueFamilyIndex, 1,
+                   PRIMITIVES_VALIDATION_ITERATIONS);
+
+    // every run overwrites the output of the previous one, so the last one is read back
+    auto run = [&](const std::string &scope, const std::function<void(VkCommandBuffer)> &recordPrimitive) {
+        VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_context.logicalDevice, commandPool);
+        timer.Reset(commandBuffer, 0);
+        for (uint32_t i = 0; i < PRIMITIVES_VALIDATION_ITERATIONS; i++) {
+            timer.Begin(commandBuffer, 0, scope, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            recordPrimitive(commandBuffer);
+            timer.End(commandBuffer, 0, scope, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+
+        VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+        EndSingleTimeCommand(m_context.logicalDevice, commandPool, commandBuffer, queue);
+
+        timer.CollectResults(0);
+        double milliseconds = timer.HasResults(scope) ? timer.GetAverageMs(scope) : 0.0;
+        timer.ResetStatistics();
+        return milliseconds;
+    };
+
+    // bandwidth counts every value read and written once, passes over the scratch buffers are not counted
+    auto report = [&](const std::string &name, bool matches, double milliseconds, double bytes) {
+        std::cout << "[Primitives] " << name << " (" << count << " values): "
+            << (matches ? "matches the CPU" : "DOES NOT match the CPU");
+        if (milliseconds > 0.0) {
+            std::cout << ", " << milliseconds << " ms, " << bytes / (milliseconds * 1e-3) * 1e-9 << " GB/s";
+        }
+        std::cout << "\n";
+    };
+
+    const VkDescriptorSet bindings = m_validationDescriptorSet;
+    const double valueBytes = sizeof(uint32_t) * static_cast<double>(count);
+
+    //----------
+    // SCAN
+    //----------
+    for (bool isInclusive: {false, true}) {
+        double milliseconds = run("Scan", [&](VkCommandBuffer commandBuffer) {
+            RecordScan(commandBuffer, bindings, count, isInclusive);
+        });
+
+        // large counts wrap the sums around, uint32_t wraps the same way as the shader so they are compared
+        // modulo 2^32
+        std::vector<uint32_t> expected(count);
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            expected[i] = isInclusive ? sum + values[i] : sum;
+            sum += values[i];
+        }
+
+        bool matches = download(buffers[2], count) == expected && download(buffers[3], 1)[0] == sum;
+        report(isInclusive ? "inclusive scan" : "exclusive scan", matches, milliseconds, 2.0 * valueBytes);
+    }
+
+    //------------
+    // COMPACTION
+    //------------
+    {
+        double milliseconds = run("Compact", [&](VkCommandBuffer commandBuffer) {
+            RecordCompact(commandBuffer, bindings, count);
+        });
+
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < count; i++) {
+            if (flags[i] != 0) expected.push_back(values[i]);
+        }
+
+        uint32_t keptCount = download(buffers[3], 1)[0];
+        bool matches = keptCount == expected.size() && download(buffers[2], keptCount) == expected;
+        report("compaction", matches, milliseconds, 2.0 * valueBytes + sizeof(uint32_t) * expected.size());
+    }
+
+    //------------
+    // HISTOGRAM
+    //------------
+    {
+        // values have 16 bits, so the upper 8 of them pick the bin
+        double milliseconds = run("Histogram", [&](VkCommandBuffer commandBuffer) {
+            RecordHistogram(commandBuffer, bindings, count, PRIMITIVES_MAX_BINS, 8);
+        });
+
+        std::vector<uint32_t> expected(PRIMITIVES_MAX_BINS, 0);
+        for (uint32_t value: values) {
+            expected[(value >> 8) & (PRIMITIVES_MAX_BINS - 1)]++;
+        }
+
+        report("histogram", download(buffers[2], PRIMITIVES_MAX_BINS) == expected, milliseconds, valueBytes);
+    }
+
+    //------------
+    // REDUCTION
+    //------------
+    const std::array<std::pair<OPERATION, const char *>, 3> operations = {{
+        {OPERATION_ADD, "reduce add"},
+        {OPERATION_MIN, "reduce min"},
+        {OPERATION_MAX, "reduce max"},
+    }};
+    for (const auto &[operation, name]: operations) {
+        double milliseconds = run("Reduce", [&](VkCommandBuffer commandBuffer) {
+            RecordReduce(commandBuffer, bindings, count, operation);
+        });
+
+        uint32_t expected = operation == OPERATION_MIN ? 0xFFFFFFFFu : 0u;
+        for (uint32_t value: values) {
+            if (operation == OPERATION_ADD) expected += value;
+            if (operation == OPERATION_MIN) expected = std::min(expected, value);
+            if (operation == OPERATION_MAX) expected = std::max(expected, value);
+        }
+
+        report(name, download(buffers[3], 1)[0] == expected, milliseconds, valueBytes);
+    }
+
+    std::cout << std::flush;
+
+    vkUnmapMemory(m_context.logicalDevice, stagingBufferMemory);
+    vkDestroyBuffer(m_context.logicalDevice, stagingBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, stagingBufferMemory, nullptr);
+    for (size_t i = 0; i < buffers.size(); i++) {
+        vkDestroyBuffer(m_context.logicalDevice, buffers[i], nullptr);
+        vkFreeMemory(m_context.logicalDevice, buffersMemory[i], nullptr);
+    }
+}
+
+ComputePrimitives::~ComputePrimitives() {
+    for (auto pipeline: m_pipelines) {
+        vkDestroyPipeline(m_context.logicalDevice, pipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_descriptorSetLayout, nullptr);
+
+    vkDestroyBuffer(m_context.logicalDevice, m_blockSumBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_blockSumBufferMemory, nullptr);
+    vkDestroyBuffer(m_context.logicalDevice, m_offsetBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_offsetBufferMemory, nullptr);
+}
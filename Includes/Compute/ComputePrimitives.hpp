@@ -0,0 +1,117 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef COMPUTEPRIMITIVES_HPP
+#define COMPUTEPRIMITIVES_HPP
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+// largest histogram, one bin per invocation of the work group
+constexpr uint32_t PRIMITIVES_MAX_BINS = 256;
+// how many times every primitive runs when it is validated, the throughput is averaged over them
+constexpr uint32_t PRIMITIVES_VALIDATION_ITERATIONS = 10;
+
+// Prefix sum, stream compaction, histogram and reduction of uint arrays with Primitives.comp.
+// Scan is reduce-then-scan (block sums -> scan of the block sums -> scan of the blocks), compaction scans the flags
+// and scatters the values, histogram counts in the shared memory first. Scratch buffers are sized for
+// maxElementCount once, so any primitive can be recorded in to any command buffer without allocating
+class ComputePrimitives {
+public:
+    enum OPERATION {
+        OPERATION_ADD = 0,
+        OPERATION_MIN = 1,
+        OPERATION_MAX = 2,
+    };
+
+    // buffers of uint the primitive reads and writes, the ones it does not use can be left as VK_NULL_HANDLE
+    struct Buffers {
+        VkBuffer input = VK_NULL_HANDLE;
+        // compaction keeps the input values whose flag is not 0
+        VkBuffer flags = VK_NULL_HANDLE;
+        // scan result, compacted values or histogram bins
+        VkBuffer output = VK_NULL_HANDLE;
+        // single value, reduction, total of the scan or amount of the compacted values
+        VkBuffer result = VK_NULL_HANDLE;
+    };
+
+    // throws if the device can not do subgroup arithmetic in the compute shaders
+    ComputePrimitives(const DeviceContext &context, uint32_t maxElementCount, uint32_t maxBindings = 16);
+
+    // descriptor set with the given buffers, it lives as long as the primitives do and can be used every frame
+    VkDescriptorSet CreateBindings(const Buffers &buffers);
+
+    //--------------
+    // PRIMITIVES
+    //--------------
+    // every primitive waits for the compute and transfer writes recorded before it, and its results can be read by
+    // the compute shaders recorded after it
+    void RecordScan(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count, bool isInclusive);
+    void RecordCompact(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count);
+    // bin of the value is (value >> binShift) & (binCount - 1), binCount has to be power of two up to PRIMITIVES_MAX_BINS
+    void RecordHistogram(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count, uint32_t binCount,
+                         uint32_t binShift);
+    void RecordReduce(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count, OPERATION operation);
+
+    // runs every primitive on random values, compares the results with the CPU and prints their throughput.
+    // Waits for the queue, nothing else can be in flight
+    void Validate(VkQueue queue, VkCommandPool commandPool, uint32_t queueFamilyIndex);
+
+    ~ComputePrimitives();
+
+private:
+    // has to match PrimitiveParameters in Primitives.comp
+    struct PushConstants {
+        uint32_t count;
+        uint32_t blockCount;
+        uint32_t operation;
+        uint32_t isInclusive;
+        uint32_t useFlags;
+        uint32_t binShift;
+        uint32_t binCount;
+    };
+
+    enum PASS {
+        PASS_REDUCE_BLOCKS = 0,
+        PASS_SCAN_BLOCK_SUMS = 1,
+        PASS_SCAN = 2,
+        PASS_SCATTER = 3,
+        PASS_CLEAR_BINS = 4,
+        PASS_HISTOGRAM = 5,
+        PASS_REDUCE_RESULT = 6,
+        PASS_COUNT = 7,
+    };
+
+    void CreateBuffers();
+    void CreateDescriptors(uint32_t maxBindings);
+    void CreatePipelines();
+    void WriteBindings(VkDescriptorSet descriptorSet, const Buffers &buffers);
+    PushConstants BeginPrimitive(VkCommandBuffer commandBuffer, VkDescriptorSet bindings, uint32_t count);
+    void RecordScanPasses(VkCommandBuffer commandBuffer, PushConstants &pushConstants);
+    void Dispatch(VkCommandBuffer commandBuffer, PASS pass, uint32_t groupCount, const PushConstants &pushConstants);
+
+    DeviceContext m_context;
+    uint32_t m_maxElementCount;
+    uint32_t m_maxBlockCount;
+
+    // one value per work group, block sums of the scan or partial results of the reduction
+    VkBuffer m_blockSumBuffer;
+    VkDeviceMemory m_blockSumBufferMemory;
+    // scanned flags of the compaction
+    VkBuffer m_offsetBuffer;
+    VkDeviceMemory m_offsetBufferMemory;
+
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    // reserved for the validation, so it can run any amount of times without exhausting the pool
+    VkDescriptorSet m_validationDescriptorSet;
+    VkPipelineLayout m_pipelineLayout;
+    std::array<VkPipeline, PASS_COUNT> m_pipelines{};
+};
+
+
+#endif //COMPUTEPRIMITIVES_HPP
@@ -0,0 +1,194 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "FrustumCuller.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+// kernels below use __attribute__ and __builtin_* of GCC and Clang, MSVC culls with the scalar kernel
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_X86
+#endif
+
+//---------------------
+// CULLING KERNELS
+//---------------------
+// sphere is visible if its centre is not further than its radius behind any of the planes
+// every kernel does the same multiplies and adds in the same order, so all of them agree on every object
+
+struct SphereArrays {
+    const float *centreX;
+    const float *centreY;
+    const float *centreZ;
+    const float *radius;
+};
+
+static uint32_t CullScalar(const std::array<glm::vec4, 6> &planes, const SphereArrays &spheres, uint8_t *visibility,
+                           uint32_t begin, uint32_t end) {
+    uint32_t visible = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        bool isInside = true;
+        for (const glm::vec4 &plane: planes) {
+            float distance = plane.x * spheres.centreX[i] + plane.y * spheres.centreY[i];
+            distance = distance + plane.z * spheres.centreZ[i];
+            distance = distance + plane.w;
+            isInside = isInside && distance > -spheres.radius[i];
+        }
+        visibility[i] = isInside ? 1 : 0;
+        visible += isInside ? 1 : 0;
+    }
+    return visible;
+}
+
+#ifdef FRUSTUM_CULLER_X86
+// bit i of a movemask becomes byte i, so the visibility of 8 objects is written with one store
+static const std::array<uint64_t, 256> MASK_TO_BYTES = [] {
+    std::array<uint64_t, 256> table{};
+    for (uint32_t mask = 0; mask < 256; mask++) {
+        for (uint32_t bit = 0; bit < 8; bit++) {
+            table[mask] |= static_cast<uint64_t>((mask >> bit) & 1) << (bit * 8);
+        }
+    }
+    return table;
+}();
+
+// SSE is always there on x86-64
+static uint32_t CullSse(const std::array<glm::vec4, 6> &planes, const SphereArrays &spheres, uint8_t *visibility,
+                        uint32_t begin, uint32_t end) {
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(planes[p].x);
+        planeY[p] = _mm_set1_ps(planes[p].y);
+        planeZ[p] = _mm_set1_ps(planes[p].z);
+        planeW[p] = _mm_set1_ps(planes[p].w);
+    }
+
+    uint32_t visible = 0;
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        const __m128 x = _mm_loadu_ps(spheres.centreX + i);
+        const __m128 y = _mm_loadu_ps(spheres.centreY + i);
+        const __m128 z = _mm_loadu_ps(spheres.centreZ + i);
+        const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius + i));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y));
+            distance = _mm_add_ps(distance, _mm_mul_ps(planeZ[p], z));
+            distance = _mm_add_ps(distance, planeW[p]);
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        memcpy(visibility + i, &MASK_TO_BYTES[mask], 4);
+        visible += __builtin_popcount(mask);
+    }
+    return visible + CullScalar(planes, spheres, visibility, i, end);
+}
+
+// compiled for AVX2 only, called only when the CPU reports the support
+__attribute__((target("avx2")))
+static uint32_t CullAvx2(const std::array<glm::vec4, 6> &planes, const SphereArrays &spheres, uint8_t *visibility,
+                         uint32_t begin, uint32_t end) {
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm256_set1_ps(planes[p].x);
+        planeY[p] = _mm256_set1_ps(planes[p].y);
+        planeZ[p] = _mm256_set1_ps(planes[p].z);
+        planeW[p] = _mm256_set1_ps(planes[p].w);
+    }
+
+    uint32_t visible = 0;
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        const __m256 x = _mm256_loadu_ps(spheres.centreX + i);
+        const __m256 y = _mm256_loadu_ps(spheres.centreY + i);
+        const __m256 z = _mm256_loadu_ps(spheres.centreZ + i);
+        const __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius + i));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(planeZ[p], z));
+            distance = _mm256_add_ps(distance, planeW[p]);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GT_OQ));
+        }
+
+        const int mask = _mm256_movemask_ps(inside);
+        memcpy(visibility + i, &MASK_TO_BYTES[mask], 8);
+        visible += __builtin_popcount(mask);
+    }
+    return visible + CullScalar(planes, spheres, visibility, i, end);
+}
+#endif
+
+FrustumCuller::FrustumCuller(ThreadPool &threadPool) : m_threadPool(threadPool) {
+#ifdef FRUSTUM_CULLER_X86
+    m_hasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+void FrustumCuller::SetBounds(const std::vector<glm::vec4> &spheres) {
+    const size_t count = spheres.size();
+    m_centreX.resize(count);
+    m_centreY.resize(count);
+    m_centreZ.resize(count);
+    m_radius.resize(count);
+    m_visibility.assign(count, 0);
+
+    for (size_t i = 0; i < count; i++) {
+        m_centreX[i] = spheres[i].x;
+        m_centreY[i] = spheres[i].y;
+        m_centreZ[i] = spheres[i].z;
+        m_radius[i] = spheres[i].w;
+    }
+}
+
+std::array<glm::vec4, 6> FrustumCuller::ExtractPlanes(const glm::mat4 &projection, const glm::mat4 &view) {
+    // rows of the view projection, the clip space is -w <= x, y <= w and 0 <= z <= w
+    const glm::mat4 m = glm::transpose(projection * view);
+    std::array<glm::vec4, 6> planes = {m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]};
+    for (auto &plane: planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
+}
+
+uint32_t FrustumCuller::Cull(const glm::mat4 &projection, const glm::mat4 &view) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const std::array<glm::vec4, 6> planes = ExtractPlanes(projection, view);
+    const SphereArrays spheres{m_centreX.data(), m_centreY.data(), m_centreZ.data(), m_radius.data()};
+    uint8_t *visibility = m_visibility.data();
+    const bool hasAvx2 = m_hasAvx2;
+
+    std::atomic<uint32_t> visible{0};
+    m_threadPool.ParallelFor(GetObjectCount(), FRUSTUM_CULLER_MIN_CHUNK, [&](uint32_t begin, uint32_t end) {
+#ifdef FRUSTUM_CULLER_X86
+        const uint32_t chunkVisible = hasAvx2
+                                          ? CullAvx2(planes, spheres, visibility, begin, end)
+                                          : CullSse(planes, spheres, visibility, begin, end);
+#else
+        const uint32_t chunkVisible = CullScalar(planes, spheres, visibility, begin, end);
+#endif
+        visible.fetch_add(chunkVisible, std::memory_order_relaxed);
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    m_totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+    m_visibleSum += visible.load();
+    m_samples++;
+    return visible.load();
+}
+
+const char *FrustumCuller::GetInstructionSet() const {
+#ifdef FRUSTUM_CULLER_X86
+    return m_hasAvx2 ? "AVX2" : "SSE";
+#else
+    return "scalar";
+#endif
+}
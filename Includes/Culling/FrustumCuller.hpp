@@ -0,0 +1,66 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef FRUSTUMCULLER_HPP
+#define FRUSTUMCULLER_HPP
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Threading/ThreadPool.hpp"
+
+// smallest amount of objects a single thread gets, testing them is cheaper than waking up another thread
+constexpr uint32_t FRUSTUM_CULLER_MIN_CHUNK = 16384;
+
+// Frustum culling of bounding spheres on the CPU. Spheres are kept as structure of arrays so that 8 (AVX2) or 4 (SSE)
+// of them are tested against a plane with one instruction, the array is split between the threads of the pool.
+// Result is one byte per object, every thread writes only the bytes of its own range
+class FrustumCuller {
+public:
+    explicit FrustumCuller(ThreadPool &threadPool);
+
+    // world space spheres, xyz - centre, w - radius
+    void SetBounds(const std::vector<glm::vec4> &spheres);
+
+    // planes of the clip space (Gribb & Hartmann) in the world space, normalized and pointing inside of the frustum,
+    // projection is the one that is not flipped with the depth from 0 to 1
+    static std::array<glm::vec4, 6> ExtractPlanes(const glm::mat4 &projection, const glm::mat4 &view);
+
+    // returns the amount of the visible objects, which of them are visible is in GetVisibility
+    uint32_t Cull(const glm::mat4 &projection, const glm::mat4 &view);
+
+    // 1 for every visible object, valid after Cull
+    const std::vector<uint8_t> &GetVisibility() const {return m_visibility;}
+
+    const char *GetInstructionSet() const;
+
+    uint32_t GetObjectCount() const {return static_cast<uint32_t>(m_centreX.size());}
+
+    uint32_t GetThreadCount() const {return m_threadPool.GetThreadCount();}
+
+    bool HasResults() const {return m_samples > 0;}
+
+    double GetAverageMs() const {return m_samples == 0 ? 0.0 : m_totalMs / static_cast<double>(m_samples);}
+
+    double GetAverageVisibleCount() const {
+        return m_samples == 0 ? 0.0 : static_cast<double>(m_visibleSum) / static_cast<double>(m_samples);
+    }
+
+    void ResetStatistics() {m_totalMs = 0.0; m_visibleSum = 0; m_samples = 0;}
+
+private:
+    ThreadPool &m_threadPool;
+    bool m_hasAvx2 = false;
+
+    std::vector<float> m_centreX, m_centreY, m_centreZ, m_radius;
+    std::vector<uint8_t> m_visibility;
+
+    double m_totalMs = 0.0;
+    uint64_t m_visibleSum = 0;
+    uint64_t m_samples = 0;
+};
+
+
+#endif //FRUSTUMCULLER_HPP
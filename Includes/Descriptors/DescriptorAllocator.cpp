@@ -0,0 +1,91 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "DescriptorAllocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+DescriptorAllocator::DescriptorAllocator(VkDevice logicalDevice, uint32_t initialSetsPerPool,
+                                         const std::vector<PoolSizeRatio> &ratios) {
+    this->m_logicalDevice = logicalDevice;
+    this->m_setsPerPool = std::max(initialSetsPerPool, 1u);
+    this->m_ratios = ratios;
+
+    m_freePools.push_back(CreatePool(m_setsPerPool));
+}
+
+VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout) {
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_freePools.empty() ? TakePool() : m_freePools.back();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet descriptorSet;
+    VkResult result = vkAllocateDescriptorSets(m_logicalDevice, &allocInfo, &descriptorSet);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        // pool is exhausted, the set goes to the next one
+        m_fullPools.push_back(allocInfo.descriptorPool);
+        m_freePools.pop_back();
+
+        allocInfo.descriptorPool = TakePool();
+        result = vkAllocateDescriptorSets(m_logicalDevice, &allocInfo, &descriptorSet);
+    }
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate descriptor set");
+    }
+
+    m_allocationCount++;
+    return descriptorSet;
+}
+
+void DescriptorAllocator::Reset() {
+    for (VkDescriptorPool pool: m_freePools) {
+        vkResetDescriptorPool(m_logicalDevice, pool, 0);
+    }
+    for (VkDescriptorPool pool: m_fullPools) {
+        vkResetDescriptorPool(m_logicalDevice, pool, 0);
+        m_freePools.push_back(pool);
+    }
+    m_fullPools.clear();
+}
+
+VkDescriptorPool DescriptorAllocator::TakePool() {
+    if (m_freePools.empty()) {
+        const uint32_t grown = std::max(static_cast<uint32_t>(m_setsPerPool * DESCRIPTOR_POOL_GROWTH), m_setsPerPool + 1);
+        m_setsPerPool = std::min(grown, DESCRIPTOR_POOL_MAX_SETS);
+        m_freePools.push_back(CreatePool(m_setsPerPool));
+    }
+    return m_freePools.back();
+}
+
+VkDescriptorPool DescriptorAllocator::CreatePool(uint32_t setCount) {
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    poolSizes.reserve(m_ratios.size());
+    for (const auto &ratio: m_ratios) {
+        // at least one descriptor of every type, so a pool for a single set is still usable
+        poolSizes.push_back({ratio.type, std::max(static_cast<uint32_t>(ratio.ratio * setCount), 1u)});
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(m_logicalDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor pool");
+    }
+    m_createdPoolCount++;
+    return pool;
+}
+
+DescriptorAllocator::~DescriptorAllocator() {
+    for (VkDescriptorPool pool: m_freePools) {
+        vkDestroyDescriptorPool(m_logicalDevice, pool, nullptr);
+    }
+    for (VkDescriptorPool pool: m_fullPools) {
+        vkDestroyDescriptorPool(m_logicalDevice, pool, nullptr);
+    }
+}
@@ -0,0 +1,58 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef DESCRIPTORALLOCATOR_HPP
+#define DESCRIPTORALLOCATOR_HPP
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// every new pool holds this many times more sets than the previous one, up to DESCRIPTOR_POOL_MAX_SETS
+constexpr float DESCRIPTOR_POOL_GROWTH = 1.5f;
+constexpr uint32_t DESCRIPTOR_POOL_MAX_SETS = 4096;
+
+// Allocates descriptor sets from pools it creates as they run out, so nobody has to count the descriptors up front.
+// Pools are sized by the expected amount of descriptors of every type per set. When a pool is exhausted it is put
+// aside and the next one is taken from the free pools or created, every created pool is larger than the last.
+// Reset returns every pool at once, an allocator per frame in flight can hold the transient sets of that frame
+class DescriptorAllocator {
+public:
+    // descriptors of the type per set, a pool for n sets holds ratio * n of them
+    struct PoolSizeRatio {
+        VkDescriptorType type;
+        float ratio;
+    };
+
+    DescriptorAllocator(VkDevice logicalDevice, uint32_t initialSetsPerPool, const std::vector<PoolSizeRatio> &ratios);
+
+    VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+    // frees every set allocated from the allocator, none of them can be in use by the GPU anymore.
+    // Pools are kept for the next allocations
+    void Reset();
+
+    uint64_t GetAllocationCount() const {return m_allocationCount;}
+    uint32_t GetPoolCount() const {return static_cast<uint32_t>(m_freePools.size() + m_fullPools.size());}
+    uint32_t GetCreatedPoolCount() const {return m_createdPoolCount;}
+    void ResetStatistics() {m_allocationCount = 0; m_createdPoolCount = 0;}
+
+    ~DescriptorAllocator();
+
+private:
+    // free pool, or a new one when there is none left
+    VkDescriptorPool TakePool();
+    VkDescriptorPool CreatePool(uint32_t setCount);
+
+    VkDevice m_logicalDevice;
+    std::vector<PoolSizeRatio> m_ratios;
+    uint32_t m_setsPerPool;
+
+    // pool the sets are allocated from is the last of the free pools
+    std::vector<VkDescriptorPool> m_freePools;
+    std::vector<VkDescriptorPool> m_fullPools;
+
+    uint64_t m_allocationCount = 0;
+    uint32_t m_createdPoolCount = 0;
+};
+
+
+#endif //DESCRIPTORALLOCATOR_HPP
@@ -0,0 +1,78 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "DescriptorLayoutCache.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+DescriptorLayoutCache::DescriptorLayoutCache(VkDevice logicalDevice) {
+    this->m_logicalDevice = logicalDevice;
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::GetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings) {
+    std::sort(bindings.begin(), bindings.end(),
+              [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) {
+                  return a.binding < b.binding;
+              });
+
+    LayoutKey key{bindings, {}};
+    for (const auto &binding: bindings) {
+        if (binding.pImmutableSamplers != nullptr) {
+            key.immutableSamplers.insert(key.immutableSamplers.end(), binding.pImmutableSamplers,
+                                         binding.pImmutableSamplers + binding.descriptorCount);
+        }
+    }
+
+    auto cached = m_layouts.find(key);
+    if (cached != m_layouts.end()) {
+        m_hitCount++;
+        return cached->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(m_logicalDevice, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor set layout");
+    }
+    m_layouts.emplace(std::move(key), layout);
+    return layout;
+}
+
+bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey &other) const {
+    if (bindings.size() != other.bindings.size() || immutableSamplers != other.immutableSamplers) return false;
+
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const VkDescriptorSetLayoutBinding &a = bindings[i];
+        const VkDescriptorSetLayoutBinding &b = other.bindings[i];
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount ||
+            a.stageFlags != b.stageFlags) {
+            return false;
+        }
+        // immutable samplers are part of the layout, their handles are compared above
+        if ((a.pImmutableSamplers == nullptr) != (b.pImmutableSamplers == nullptr)) return false;
+    }
+    return true;
+}
+
+size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey &key) const {
+    // every binding is packed in to one word, combined like boost::hash_combine
+    size_t hash = key.bindings.size();
+    for (const auto &binding: key.bindings) {
+        size_t packed = binding.binding | binding.descriptorType << 8 | binding.descriptorCount << 16 |
+            static_cast<size_t>(binding.stageFlags) << 32;
+        hash ^= std::hash<size_t>()(packed) + 0x9E3779B9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+DescriptorLayoutCache::~DescriptorLayoutCache() {
+    for (const auto &[key, layout]: m_layouts) {
+        vkDestroyDescriptorSetLayout(m_logicalDevice, layout, nullptr);
+    }
+}
@@ -0,0 +1,45 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef DESCRIPTORLAYOUTCACHE_HPP
+#define DESCRIPTORLAYOUTCACHE_HPP
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Hands out one VkDescriptorSetLayout per distinct set of bindings.
+// Bindings are sorted by their binding number and hashed, so the same bindings listed in a different order give the
+// same layout, and pipelines that describe the same set share the layout (and stay compatible) without
+// passing it around. The cache owns every layout it created and destroys them with itself
+class DescriptorLayoutCache {
+public:
+    explicit DescriptorLayoutCache(VkDevice logicalDevice);
+
+    VkDescriptorSetLayout GetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+
+    uint32_t GetLayoutCount() const {return static_cast<uint32_t>(m_layouts.size());}
+    // requests that were answered with an existing layout
+    uint32_t GetHitCount() const {return m_hitCount;}
+
+    ~DescriptorLayoutCache();
+
+private:
+    struct LayoutKey {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        // immutable samplers of all bindings one after the other, the pointers in the bindings do not outlive the call
+        std::vector<VkSampler> immutableSamplers;
+        bool operator==(const LayoutKey &other) const;
+    };
+
+    struct LayoutKeyHash {
+        size_t operator()(const LayoutKey &key) const;
+    };
+
+    VkDevice m_logicalDevice;
+    std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> m_layouts;
+    uint32_t m_hitCount = 0;
+};
+
+
+#endif //DESCRIPTORLAYOUTCACHE_HPP
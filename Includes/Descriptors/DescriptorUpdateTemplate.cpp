@@ -0,0 +1,48 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "DescriptorUpdateTemplate.hpp"
+
+#include <stdexcept>
+
+DescriptorUpdateTemplate::DescriptorUpdateTemplate(VkDevice logicalDevice, VkDescriptorSetLayout layout,
+                                                   const std::vector<Entry> &entries) {
+    this->m_logicalDevice = logicalDevice;
+
+    std::vector<VkDescriptorUpdateTemplateEntry> templateEntries(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        const bool isImage = entries[i].type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+            entries[i].type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+            entries[i].type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+            entries[i].type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+            entries[i].type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+
+        templateEntries[i].dstBinding = entries[i].binding;
+        templateEntries[i].dstArrayElement = 0;
+        templateEntries[i].descriptorCount = entries[i].count;
+        templateEntries[i].descriptorType = entries[i].type;
+        templateEntries[i].offset = entries[i].offset;
+        templateEntries[i].stride = isImage ? sizeof(VkDescriptorImageInfo) : sizeof(VkDescriptorBufferInfo);
+    }
+
+    // set layout is all the template needs, the pipeline layout is only for the push descriptors
+    VkDescriptorUpdateTemplateCreateInfo templateInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO};
+    templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+    templateInfo.pDescriptorUpdateEntries = templateEntries.data();
+    templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    templateInfo.descriptorSetLayout = layout;
+
+    if (vkCreateDescriptorUpdateTemplate(m_logicalDevice, &templateInfo, nullptr, &m_template) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor update template");
+    }
+}
+
+void DescriptorUpdateTemplate::Update(VkDescriptorSet descriptorSet, const void *data) {
+    vkUpdateDescriptorSetWithTemplate(m_logicalDevice, descriptorSet, m_template, data);
+    m_updateCount++;
+}
+
+DescriptorUpdateTemplate::~DescriptorUpdateTemplate() {
+    vkDestroyDescriptorUpdateTemplate(m_logicalDevice, m_template, nullptr);
+}
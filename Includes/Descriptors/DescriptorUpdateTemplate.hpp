@@ -0,0 +1,40 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef DESCRIPTORUPDATETEMPLATE_HPP
+#define DESCRIPTORUPDATETEMPLATE_HPP
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Writes all descriptors of a set with one vkUpdateDescriptorSetWithTemplate call.
+// The template describes where the VkDescriptorBufferInfo / VkDescriptorImageInfo of every binding lies in a plain
+// struct, so the set is updated from that struct instead of building a VkWriteDescriptorSet for every binding
+class DescriptorUpdateTemplate {
+public:
+    struct Entry {
+        uint32_t binding;
+        VkDescriptorType type;
+        // offset of the first info of the binding in the struct passed to Update, use offsetof
+        size_t offset;
+        // infos of an array binding follow each other
+        uint32_t count = 1;
+    };
+
+    DescriptorUpdateTemplate(VkDevice logicalDevice, VkDescriptorSetLayout layout, const std::vector<Entry> &entries);
+
+    void Update(VkDescriptorSet descriptorSet, const void *data);
+
+    uint64_t GetUpdateCount() const {return m_updateCount;}
+    void ResetStatistics() {m_updateCount = 0;}
+
+    ~DescriptorUpdateTemplate();
+
+private:
+    VkDevice m_logicalDevice;
+    VkDescriptorUpdateTemplate m_template;
+    uint64_t m_updateCount = 0;
+};
+
+
+#endif //DESCRIPTORUPDATETEMPLATE_HPP
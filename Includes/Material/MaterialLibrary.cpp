@@ -0,0 +1,296 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "MaterialLibrary.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "Utils.hpp"
+#include <stb/stb_image.h>
+
+MaterialLibrary::MaterialLibrary(const DeviceContext &context, uint32_t maxTextures, uint32_t maxMaterials) {
+    this->m_context = context;
+    this->m_maxTextures = maxTextures;
+    this->m_maxMaterials = maxMaterials;
+
+    CreateSampler();
+    CreateMaterialBuffer();
+    CreateDescriptors();
+}
+
+VkPhysicalDeviceVulkan12Features MaterialLibrary::GetRequiredFeatures(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceVulkan12Features supported{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 features{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features.pNext = &supported;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    if (!supported.runtimeDescriptorArray || !supported.descriptorBindingPartiallyBound ||
+        !supported.descriptorBindingSampledImageUpdateAfterBind ||
+        !supported.shaderSampledImageArrayNonUniformIndexing) {
+        throw std::runtime_error("Device does not support the descriptor indexing the materials need");
+    }
+
+    // only what the library uses is enabled
+    VkPhysicalDeviceVulkan12Features required{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    required.runtimeDescriptorArray = VK_TRUE;
+    required.descriptorBindingPartiallyBound = VK_TRUE;
+    required.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    required.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    return required;
+}
+
+uint32_t MaterialLibrary::AddTexture(const std::string &path, VkQueue queue, VkCommandPool commandPool,
+                                     VkFormat format) {
+    if (m_textures.size() >= m_maxTextures) {
+        throw std::runtime_error("Material library is out of texture slots");
+    }
+
+    int texWidth, texHeight, texChannels;
+    stbi_uc *pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (!pixels) {
+        throw std::runtime_error("Failed to load texture " + path);
+    }
+
+    Texture texture{};
+    texture.maxMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+
+    //----------------
+    // STAGING BUFFER
+    //----------------
+    // times 4 because the pixels are loaded as RGBA
+    const VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth) * texHeight * 4;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = imageSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    CreateBuffer(bufferCreateInfo, stagingBuffer, stagingBufferMemory);
+
+    void *data;
+    vkMapMemory(m_context.logicalDevice, stagingBufferMemory, 0, imageSize, 0, &data);
+    memcpy(data, pixels, static_cast<size_t>(imageSize));
+    vkUnmapMemory(m_context.logicalDevice, stagingBufferMemory);
+    stbi_image_free(pixels);
+
+    //---------
+    // IMAGE
+    //---------
+    ImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.physicalDevice = m_context.physicalDevice;
+    imageCreateInfo.logicalDevice = m_context.logicalDevice;
+    imageCreateInfo.surface = m_context.surface;
+    imageCreateInfo.format = format;
+    imageCreateInfo.width = static_cast<uint32_t>(texWidth);
+    imageCreateInfo.height = static_cast<uint32_t>(texHeight);
+    imageCreateInfo.size = imageSize;
+    imageCreateInfo.mipLevels = texture.maxMipLevels;
+    // mips are blitted from the previous level, so the image is the source of the copies as well
+    imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+        VK_IMAGE_USAGE_SAMPLED_BIT;
+    CreateImage(imageCreateInfo, texture.image, texture.memory);
+
+    //------------------
+    // UPLOAD AND MIPS
+    //------------------
+    // blits need the graphics queue
+    ImageLayoutDependencyInfo dependencyInfo{};
+    dependencyInfo.logicalDevice = m_context.logicalDevice;
+    dependencyInfo.commandBuffer = BeginSingleTimeCommand(m_context.logicalDevice, commandPool);
+    dependencyInfo.transformQueue = queue;
+
+    TransferImageLayout(dependencyInfo, texture.image, format, VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.maxMipLevels);
+    CopyBufferToImage(dependencyInfo, stagingBuffer, texture.image, imageCreateInfo.width, imageCreateInfo.height);
+    // leaves every level in the shader read only layout
+    GenerateMipMaps(m_context.physicalDevice, dependencyInfo, texture.image, imageCreateInfo.width,
+                    imageCreateInfo.height, texture.maxMipLevels, format);
+
+    EndSingleTimeCommand(m_context.logicalDevice, commandPool, dependencyInfo.commandBuffer, queue);
+
+    vkDestroyBuffer(m_context.logicalDevice, stagingBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, stagingBufferMemory, nullptr);
+
+    texture.imageView = GenerateImageView(m_context.logicalDevice, texture.image, texture.maxMipLevels, format);
+
+    //---------------------
+    // SLOT OF THE ARRAY
+    //---------------------
+    const uint32_t slot = static_cast<uint32_t>(m_textures.size());
+    m_textures.push_back(texture);
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = VK_NULL_HANDLE;
+    imageInfo.imageView = texture.imageView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet descriptorWrite{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    descriptorWrite.dstSet = m_descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_context.logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+    std::cout << "[Materials] texture " << slot << ": " << path << " (" << texWidth << "x" << texHeight << ", "
+        << texture.maxMipLevels << " mips)\n";
+    return slot;
+}
+
+uint32_t MaterialLibrary::AddMaterial(const MaterialParameters &material) {
+    if (m_materials.size() >= m_maxMaterials) {
+        throw std::runtime_error("Material library is out of material slots");
+    }
+
+    const uint32_t index = static_cast<uint32_t>(m_materials.size());
+    m_materials.push_back(material);
+    memcpy(static_cast<MaterialParameters *>(m_materialBufferMapped) + index, &material, sizeof(MaterialParameters));
+    return index;
+}
+
+//------------------
+// CREATION
+//------------------
+void MaterialLibrary::CreateSampler() {
+    VkPhysicalDeviceProperties physicalDeviceProperties;
+    vkGetPhysicalDeviceProperties(m_context.physicalDevice, &physicalDeviceProperties);
+
+    VkSamplerCreateInfo samplerInfo{.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = VK_TRUE;
+    samplerInfo.maxAnisotropy = physicalDeviceProperties.limits.maxSamplerAnisotropy;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.minLod = 0.0f;
+    // textures have different amount of mips, every one of them is clamped by its own view
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(m_context.logicalDevice, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create material sampler");
+    }
+}
+
+void MaterialLibrary::CreateMaterialBuffer() {
+    // read only by the fragment shaders and small, so it stays mapped in the host visible memory
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = sizeof(MaterialParameters) * m_maxMaterials;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    CreateBuffer(bufferCreateInfo, m_materialBuffer, m_materialBufferMemory);
+
+    vkMapMemory(m_context.logicalDevice, m_materialBufferMemory, 0, bufferCreateInfo.size, 0, &m_materialBufferMapped);
+}
+
+void MaterialLibrary::CreateDescriptors() {
+    //------------------
+    // LAYOUT
+    //------------------
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    // every texture of the scene, slots that were not added yet are never read
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[0].descriptorCount = m_maxTextures;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].pImmutableSamplers = &m_sampler;
+
+    // material table
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].descriptorCount = 1;
+    bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::array<VkDescriptorBindingFlags, 3> bindingFlags = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT, 0, 0
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO
+    };
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create material descriptor set layout");
+    }
+
+    //------------------
+    // POOL AND SET
+    //------------------
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0] = {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, m_maxTextures};
+    poolSizes[1] = {VK_DESCRIPTOR_TYPE_SAMPLER, 1};
+    poolSizes[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create material descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate material descriptor set");
+    }
+
+    // the table is written once, the textures are written as they are added
+    VkDescriptorBufferInfo bufferInfo{m_materialBuffer, 0, sizeof(MaterialParameters) * m_maxMaterials};
+    VkWriteDescriptorSet descriptorWrite{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    descriptorWrite.dstSet = m_descriptorSet;
+    descriptorWrite.dstBinding = 2;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(m_context.logicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+MaterialLibrary::~MaterialLibrary() {
+    for (const auto &texture: m_textures) {
+        vkDestroyImageView(m_context.logicalDevice, texture.imageView, nullptr);
+        vkDestroyImage(m_context.logicalDevice, texture.image, nullptr);
+        vkFreeMemory(m_context.logicalDevice, texture.memory, nullptr);
+    }
+
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_descriptorSetLayout, nullptr);
+
+    vkUnmapMemory(m_context.logicalDevice, m_materialBufferMemory);
+    vkDestroyBuffer(m_context.logicalDevice, m_materialBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_materialBufferMemory, nullptr);
+
+    vkDestroySampler(m_context.logicalDevice, m_sampler, nullptr);
+}
@@ -0,0 +1,90 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef MATERIALLIBRARY_HPP
+#define MATERIALLIBRARY_HPP
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+// texture index of a material that has no texture of that kind, the scalar parameters are used instead
+constexpr uint32_t MATERIAL_NO_TEXTURE = 0xFFFFFFFF;
+
+struct Texture {
+    VkImage image;
+    VkImageView imageView;
+    VkDeviceMemory memory;
+    uint32_t maxMipLevels;
+};
+
+// one entry of the material table, has to match Material in ParticleMeshFragment.frag (std430)
+struct MaterialParameters {
+    // multiplies the albedo texture, or is the albedo when there is none
+    glm::vec4 baseColor = glm::vec4(1.0f);
+    uint32_t albedoTexture = MATERIAL_NO_TEXTURE;
+    // ambient occlusion, roughness and metalness in r, g and b
+    uint32_t armTexture = MATERIAL_NO_TEXTURE;
+    uint32_t normalTexture = MATERIAL_NO_TEXTURE;
+    // used when there is no ARM texture
+    float roughness = 0.5f;
+    float metalness = 0.0f;
+    float padding[3] = {};
+};
+
+// Every texture and material of the scene behind one descriptor set.
+// Textures live in one large array of sampled images indexed with descriptor indexing, materials live in a table
+// (SSBO) that stores the indices of their textures and their scalar parameters. Shaders pick the material by its index,
+// so any amount of materials is drawn without switching the descriptor sets and draws can be batched across them.
+// Texture slots are written after bind, so textures can be added while the set is in use
+class MaterialLibrary {
+public:
+    MaterialLibrary(const DeviceContext &context, uint32_t maxTextures, uint32_t maxMaterials);
+
+    // loads the image with its mip chain in to the next free slot of the array and returns the slot.
+    // Colour textures are sRGB, data (ARM, normals) should use VK_FORMAT_R8G8B8A8_UNORM
+    uint32_t AddTexture(const std::string &path, VkQueue queue, VkCommandPool commandPool,
+                        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+    // writes the material in to the table and returns its index, the table is host coherent,
+    // so the material can be used by the next recorded frame
+    uint32_t AddMaterial(const MaterialParameters &material);
+
+    // set = 1 of the pipelines that read the materials
+    VkDescriptorSetLayout GetDescriptorSetLayout() const {return m_descriptorSetLayout;}
+    VkDescriptorSet GetDescriptorSet() const {return m_descriptorSet;}
+    uint32_t GetMaterialCount() const {return static_cast<uint32_t>(m_materials.size());}
+    uint32_t GetTextureCount() const {return static_cast<uint32_t>(m_textures.size());}
+
+    // throws if the device can not index the sampled image arrays the way the library needs
+    static VkPhysicalDeviceVulkan12Features GetRequiredFeatures(VkPhysicalDevice physicalDevice);
+
+    ~MaterialLibrary();
+
+private:
+    void CreateDescriptors();
+    void CreateMaterialBuffer();
+    void CreateSampler();
+
+    DeviceContext m_context;
+    uint32_t m_maxTextures;
+    uint32_t m_maxMaterials;
+
+    std::vector<Texture> m_textures;
+    std::vector<MaterialParameters> m_materials;
+
+    // every texture is sampled with the same sampler, so the array holds only the images
+    VkSampler m_sampler;
+    VkBuffer m_materialBuffer;
+    VkDeviceMemory m_materialBufferMemory;
+    void *m_materialBufferMapped;
+
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    VkDescriptorSet m_descriptorSet;
+};
+
+
+#endif //MATERIALLIBRARY_HPP
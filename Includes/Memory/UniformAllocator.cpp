@@ -0,0 +1,57 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "UniformAllocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Utils.hpp"
+
+UniformAllocator::UniformAllocator(const DeviceContext &context, VkDeviceSize regionSize, uint32_t regionCount) {
+    this->m_context = context;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_context.physicalDevice, &properties);
+    this->m_alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+
+    // every region starts at an offset the descriptors can be bound with
+    this->m_regionSize = (regionSize + m_alignment - 1) / m_alignment * m_alignment;
+    this->m_heads.assign(regionCount, 0);
+
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = m_regionSize * regionCount;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    CreateBuffer(bufferCreateInfo, m_buffer, m_memory);
+
+    // mapped for the whole lifetime, host coherent memory needs no flushes
+    vkMapMemory(m_context.logicalDevice, m_memory, 0, bufferCreateInfo.size, 0, &m_mapped);
+}
+
+void UniformAllocator::Reset(uint32_t region) {
+    m_heads[region] = 0;
+}
+
+uint32_t UniformAllocator::Allocate(uint32_t region, VkDeviceSize size) {
+    VkDeviceSize offset = m_heads[region];
+    if (offset + size > m_regionSize) {
+        throw std::runtime_error("Uniform allocator region is out of memory");
+    }
+
+    m_heads[region] = std::min(m_regionSize, (offset + size + m_alignment - 1) / m_alignment * m_alignment);
+    m_peakUsage = std::max(m_peakUsage, m_heads[region]);
+    m_allocationCount++;
+
+    return static_cast<uint32_t>(m_regionSize * region + offset);
+}
+
+UniformAllocator::~UniformAllocator() {
+    vkUnmapMemory(m_context.logicalDevice, m_memory);
+    vkDestroyBuffer(m_context.logicalDevice, m_buffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_memory, nullptr);
+}
@@ -0,0 +1,62 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef UNIFORMALLOCATOR_HPP
+#define UNIFORMALLOCATOR_HPP
+#include <cstring>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "Structs.hpp"
+
+// Linear allocator of the uniform data over one persistently mapped, host coherent buffer.
+// The buffer is split in to regions, one for every frame in flight (and queue) that writes constants. Push copies the
+// data to the head of the region, moves the head past it aligned to minUniformBufferOffsetAlignment and returns
+// the dynamic offset it has to be bound with. Reset rewinds the region once the GPU is done with it, so any amount
+// of per pass constants is written without allocating or rewriting the descriptor sets
+class UniformAllocator {
+public:
+    UniformAllocator(const DeviceContext &context, VkDeviceSize regionSize, uint32_t regionCount);
+
+    // data of the region can not be in use by the GPU anymore
+    void Reset(uint32_t region);
+
+    // offset for vkCmdBindDescriptorSets, the descriptor points at the start of the buffer with the range of T
+    template<typename T>
+    uint32_t Push(uint32_t region, const T &data) {
+        uint32_t offset = Allocate(region, sizeof(T));
+        memcpy(static_cast<char *>(m_mapped) + offset, &data, sizeof(T));
+        return offset;
+    }
+
+    VkBuffer GetBuffer() const {return m_buffer;}
+
+    uint64_t GetAllocationCount() const {return m_allocationCount;}
+    // most bytes any region had in use since the statistics were reset
+    VkDeviceSize GetPeakUsage() const {return m_peakUsage;}
+    VkDeviceSize GetRegionSize() const {return m_regionSize;}
+    void ResetStatistics() {m_allocationCount = 0; m_peakUsage = 0;}
+
+    ~UniformAllocator();
+
+private:
+    uint32_t Allocate(uint32_t region, VkDeviceSize size);
+
+    DeviceContext m_context;
+    VkDeviceSize m_alignment;
+    VkDeviceSize m_regionSize;
+
+    // next free byte of every region, relative to the start of the region
+    std::vector<VkDeviceSize> m_heads;
+
+    VkBuffer m_buffer;
+    VkDeviceMemory m_memory;
+    void *m_mapped;
+
+    uint64_t m_allocationCount = 0;
+    VkDeviceSize m_peakUsage = 0;
+};
+
+
+#endif //UNIFORMALLOCATOR_HPP
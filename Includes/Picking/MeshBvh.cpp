@@ -0,0 +1,611 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "MeshBvh.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#include "Simulation/MeshCollider.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define MESH_BVH_X86
+#endif
+
+//---------------------
+// BUILD
+//---------------------
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    void Grow(const glm::vec3 &point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Grow(const Bounds &bounds) {
+        min = glm::min(min, bounds.min);
+        max = glm::max(max, bounds.max);
+    }
+
+    float Area() const {
+        if (min.x > max.x) return 0.0f;
+        const glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+struct MeshBvhBuildInput {
+    std::vector<Bounds> triangleBounds;
+    std::vector<glm::vec3> centroids;
+};
+
+// bounds of the triangles of a node and of their centroids, the split planes are placed in the latter
+struct NodeBounds {
+    Bounds triangles;
+    Bounds centroids;
+};
+
+struct Bins {
+    Bounds bounds[3][MESH_BVH_BIN_COUNT];
+    uint32_t counts[3][MESH_BVH_BIN_COUNT] = {};
+};
+
+static void Merge(NodeBounds &target, const NodeBounds &source) {
+    target.triangles.Grow(source.triangles);
+    target.centroids.Grow(source.centroids);
+}
+
+static void Merge(Bins &target, const Bins &source) {
+    for (int axis = 0; axis < 3; axis++) {
+        for (uint32_t bin = 0; bin < MESH_BVH_BIN_COUNT; bin++) {
+            target.bounds[axis][bin].Grow(source.bounds[axis][bin]);
+            target.counts[axis][bin] += source.counts[axis][bin];
+        }
+    }
+}
+
+// with the thread pool the range is split between its threads, every chunk merges its result under the mutex
+template<typename Result, typename Task>
+static Result ReduceRange(ThreadPool *threadPool, uint32_t first, uint32_t count, const Task &task) {
+    Result result{};
+    if (threadPool == nullptr) {
+        task(first, first + count, result);
+        return result;
+    }
+
+    std::mutex mutex;
+    threadPool->ParallelFor(count, MESH_BVH_SUBTREE_SIZE, [&](uint32_t begin, uint32_t end) {
+        Result chunk{};
+        task(first + begin, first + end, chunk);
+        std::lock_guard<std::mutex> lock(mutex);
+        Merge(result, chunk);
+    });
+    return result;
+}
+
+static uint32_t BinOf(float centroid, float min, float scale) {
+    return std::min(static_cast<uint32_t>((centroid - min) * scale), MESH_BVH_BIN_COUNT - 1);
+}
+
+static NodeBounds ComputeBounds(const MeshBvhBuildInput &input, const uint32_t *order, uint32_t first, uint32_t count,
+                                ThreadPool *threadPool) {
+    return ReduceRange<NodeBounds>(threadPool, first, count, [&](uint32_t begin, uint32_t end, NodeBounds &result) {
+        for (uint32_t i = begin; i < end; i++) {
+            result.triangles.Grow(input.triangleBounds[order[i]]);
+            result.centroids.Grow(input.centroids[order[i]]);
+        }
+    });
+}
+
+// returns the amount of the triangles that went to the left child, 0 if the node should be a leaf
+static uint32_t SplitNode(const MeshBvhBuildInput &input, uint32_t *order, uint32_t first, uint32_t count,
+                          uint32_t depth, const NodeBounds &node, ThreadPool *threadPool) {
+    if (count <= 2 || depth >= MESH_BVH_MAX_DEPTH) return 0;
+
+    const glm::vec3 extent = node.centroids.max - node.centroids.min;
+    glm::vec3 scale;
+    for (int axis = 0; axis < 3; axis++) {
+        scale[axis] = extent[axis] > 0.0f ? static_cast<float>(MESH_BVH_BIN_COUNT) / extent[axis] : 0.0f;
+    }
+
+    const Bins bins = ReduceRange<Bins>(threadPool, first, count, [&](uint32_t begin, uint32_t end, Bins &result) {
+        for (uint32_t i = begin; i < end; i++) {
+            const glm::vec3 &centroid = input.centroids[order[i]];
+            for (int axis = 0; axis < 3; axis++) {
+                const uint32_t bin = BinOf(centroid[axis], node.centroids.min[axis], scale[axis]);
+                result.bounds[axis][bin].Grow(input.triangleBounds[order[i]]);
+                result.counts[axis][bin]++;
+            }
+        }
+    });
+
+    // cost of a plane is the area of each side times its triangles, sides are swept from both ends
+    int bestAxis = -1;
+    uint32_t bestBin = 0;
+    float bestCost = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        if (extent[axis] <= 0.0f) continue;
+
+        float rightCosts[MESH_BVH_BIN_COUNT] = {};
+        Bounds right;
+        uint32_t rightCount = 0;
+        for (uint32_t bin = MESH_BVH_BIN_COUNT - 1; bin > 0; bin--) {
+            right.Grow(bins.bounds[axis][bin]);
+            rightCount += bins.counts[axis][bin];
+            rightCosts[bin] = right.Area() * static_cast<float>(rightCount);
+        }
+
+        Bounds left;
+        uint32_t leftCount = 0;
+        for (uint32_t bin = 1; bin < MESH_BVH_BIN_COUNT; bin++) {
+            left.Grow(bins.bounds[axis][bin - 1]);
+            leftCount += bins.counts[axis][bin - 1];
+            if (leftCount == 0 || leftCount == count) continue;
+            const float cost = left.Area() * static_cast<float>(leftCount) + rightCosts[bin];
+            if (cost < bestCost) {
+                bestAxis = axis;
+                bestBin = bin;
+                bestCost = cost;
+            }
+        }
+    }
+
+    uint32_t leftCount = count / 2;
+    if (bestAxis >= 0) {
+        // traversing the node costs about as much as testing one triangle
+        const float area = node.triangles.Area();
+        if (area + bestCost >= area * static_cast<float>(count) && count <= MESH_BVH_MAX_LEAF_SIZE) return 0;
+
+        uint32_t *middle = std::partition(order + first, order + first + count, [&](uint32_t triangle) {
+            return BinOf(input.centroids[triangle][bestAxis], node.centroids.min[bestAxis], scale[bestAxis]) < bestBin;
+        });
+        leftCount = static_cast<uint32_t>(middle - (order + first));
+    }
+    else if (count <= MESH_BVH_MAX_LEAF_SIZE) {
+        return 0;
+    }
+
+    // every centroid is the same or the plane did not separate anything, halves are as good as anything else
+    if (leftCount == 0 || leftCount == count) leftCount = count / 2;
+    return leftCount;
+}
+
+MeshBvh::MeshBvh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, ThreadPool &threadPool,
+                 const std::string &cachePath) {
+    if (indices.size() < 3) {
+        throw std::runtime_error("Mesh BVH needs at least one triangle");
+    }
+
+    const uint64_t meshHash = MeshCollider::HashMesh(vertices, indices);
+    if (LoadCache(cachePath, meshHash)) {
+        std::cout << "[BVH] " << GetTriangleCount() << " triangles loaded from " << cachePath << "\n";
+    }
+    else {
+        auto start = std::chrono::high_resolution_clock::now();
+        Build(vertices, indices, threadPool);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "[BVH] " << GetTriangleCount() << " triangles in " << GetNodeCount() << " nodes built in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms on "
+            << threadPool.GetThreadCount() << " threads\n";
+        SaveCache(cachePath, meshHash);
+    }
+
+    // bounds of the root are the bounds of its children
+    m_boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    m_boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+    const MeshBvhNode &root = m_nodes[0];
+    for (int i = 0; i < 4; i++) {
+        if (root.child[i] == MESH_BVH_EMPTY_CHILD) continue;
+        m_boundsMin = glm::min(m_boundsMin, glm::vec3(root.minX[i], root.minY[i], root.minZ[i]));
+        m_boundsMax = glm::max(m_boundsMax, glm::vec3(root.maxX[i], root.maxY[i], root.maxZ[i]));
+    }
+}
+
+void MeshBvh::Build(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, ThreadPool &threadPool) {
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    MeshBvhBuildInput input;
+    input.triangleBounds.resize(triangleCount);
+    input.centroids.resize(triangleCount);
+    threadPool.ParallelFor(triangleCount, MESH_BVH_SUBTREE_SIZE, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t triangle = begin; triangle < end; triangle++) {
+            Bounds bounds;
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                bounds.Grow(vertices[indices[triangle * 3 + corner]].pos);
+            }
+            input.triangleBounds[triangle] = bounds;
+            input.centroids[triangle] = (bounds.min + bounds.max) * 0.5f;
+        }
+    });
+    m_order.resize(triangleCount);
+    std::iota(m_order.begin(), m_order.end(), 0);
+
+    //---------------------
+    // TOP OF THE TREE
+    //---------------------
+    // every large node is binned by all of the threads, nodes small enough are left for the subtrees
+    struct Task {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+        uint32_t depth;
+    };
+    std::vector<BuildNode> nodes(1);
+    std::vector<Task> pending = {{0, 0, triangleCount, 0}};
+    std::vector<Task> subtrees;
+    while (!pending.empty()) {
+        const Task task = pending.back();
+        pending.pop_back();
+        if (task.count <= MESH_BVH_SUBTREE_SIZE) {
+            subtrees.push_back(task);
+            continue;
+        }
+
+        const NodeBounds bounds = ComputeBounds(input, m_order.data(), task.first, task.count, &threadPool);
+        const uint32_t leftCount = SplitNode(input, m_order.data(), task.first, task.count, task.depth, bounds,
+                                             &threadPool);
+        if (leftCount == 0) {
+            nodes[task.node] = {bounds.triangles.min, bounds.triangles.max, 0, 0, task.first, task.count};
+            continue;
+        }
+
+        const uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + 2);
+        nodes[task.node] = {bounds.triangles.min, bounds.triangles.max, left, left + 1, 0, 0};
+        pending.push_back({left, task.first, leftCount, task.depth + 1});
+        pending.push_back({left + 1, task.first + leftCount, task.count - leftCount, task.depth + 1});
+    }
+
+    //---------------------
+    // SUBTREES
+    //---------------------
+    // every subtree owns its range of the order, so the threads never touch the same triangles
+    std::vector<std::vector<BuildNode>> subtreeNodes(subtrees.size());
+    threadPool.ParallelFor(static_cast<uint32_t>(subtrees.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            BuildSubtree(input, subtrees[i].first, subtrees[i].count, subtrees[i].depth, subtreeNodes[i]);
+        }
+    });
+
+    // root of a subtree replaces the node of its task, the rest is appended
+    for (size_t i = 0; i < subtrees.size(); i++) {
+        const uint32_t base = static_cast<uint32_t>(nodes.size());
+        auto remap = [&](uint32_t node) {return node == 0 ? subtrees[i].node : base + node - 1;};
+        for (size_t j = 0; j < subtreeNodes[i].size(); j++) {
+            BuildNode node = subtreeNodes[i][j];
+            if (node.count == 0) {
+                node.left = remap(node.left);
+                node.right = remap(node.right);
+            }
+            if (j == 0) nodes[subtrees[i].node] = node;
+            else nodes.push_back(node);
+        }
+    }
+
+    //---------------------
+    // FLATTEN
+    //---------------------
+    m_nodes.clear();
+    Collapse(nodes, 0);
+
+    m_triangles.resize(triangleCount);
+    threadPool.ParallelFor(triangleCount, MESH_BVH_SUBTREE_SIZE, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const uint32_t triangle = m_order[i];
+            const glm::vec3 &vertex0 = vertices[indices[triangle * 3]].pos;
+            m_triangles[i] = {
+                vertex0, vertices[indices[triangle * 3 + 1]].pos - vertex0,
+                vertices[indices[triangle * 3 + 2]].pos - vertex0, triangle
+            };
+        }
+    });
+    m_order.clear();
+    m_order.shrink_to_fit();
+}
+
+uint32_t MeshBvh::BuildSubtree(const MeshBvhBuildInput &input, uint32_t first, uint32_t count, uint32_t depth,
+                               std::vector<BuildNode> &nodes) {
+    const uint32_t node = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    const NodeBounds bounds = ComputeBounds(input, m_order.data(), first, count, nullptr);
+    const uint32_t leftCount = SplitNode(input, m_order.data(), first, count, depth, bounds, nullptr);
+    if (leftCount == 0) {
+        nodes[node] = {bounds.triangles.min, bounds.triangles.max, 0, 0, first, count};
+        return node;
+    }
+
+    const uint32_t left = BuildSubtree(input, first, leftCount, depth + 1, nodes);
+    const uint32_t right = BuildSubtree(input, first + leftCount, count - leftCount, depth + 1, nodes);
+    nodes[node] = {bounds.triangles.min, bounds.triangles.max, left, right, 0, 0};
+    return node;
+}
+
+uint32_t MeshBvh::Collapse(const std::vector<BuildNode> &binaryNodes, uint32_t binaryNode) {
+    // children with the largest area are opened until there are 4 of them, they are the most likely to be hit
+    std::vector<uint32_t> children;
+    const BuildNode &root = binaryNodes[binaryNode];
+    if (root.count > 0) children = {binaryNode};
+    else children = {root.left, root.right};
+
+    while (children.size() < 4) {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (size_t i = 0; i < children.size(); i++) {
+            const BuildNode &child = binaryNodes[children[i]];
+            if (child.count > 0) continue;
+            Bounds bounds{child.boundsMin, child.boundsMax};
+            if (bounds.Area() > largestArea) {
+                largest = static_cast<int>(i);
+                largestArea = bounds.Area();
+            }
+        }
+        if (largest < 0) break;
+
+        const BuildNode &opened = binaryNodes[children[largest]];
+        children[largest] = opened.left;
+        children.push_back(opened.right);
+    }
+
+    const uint32_t node = static_cast<uint32_t>(m_nodes.size());
+    MeshBvhNode empty{};
+    for (int i = 0; i < 4; i++) {
+        empty.minX[i] = empty.minY[i] = empty.minZ[i] = std::numeric_limits<float>::max();
+        empty.maxX[i] = empty.maxY[i] = empty.maxZ[i] = std::numeric_limits<float>::lowest();
+        empty.child[i] = MESH_BVH_EMPTY_CHILD;
+    }
+    m_nodes.push_back(empty);
+
+    for (size_t i = 0; i < children.size(); i++) {
+        const BuildNode &child = binaryNodes[children[i]];
+        // children are collapsed before the node is written, m_nodes can grow meanwhile
+        const uint32_t index = child.count > 0 ? child.first : Collapse(binaryNodes, children[i]);
+        MeshBvhNode &target = m_nodes[node];
+        target.minX[i] = child.boundsMin.x;
+        target.minY[i] = child.boundsMin.y;
+        target.minZ[i] = child.boundsMin.z;
+        target.maxX[i] = child.boundsMax.x;
+        target.maxY[i] = child.boundsMax.y;
+        target.maxZ[i] = child.boundsMax.z;
+        target.child[i] = index;
+        target.triangleCount[i] = child.count;
+    }
+    return node;
+}
+
+//---------------------
+// QUERIES
+//---------------------
+struct BvhRay {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+    // the near plane of a box on an axis is its max when the ray goes in the negative direction
+    bool isNegative[3];
+};
+
+// writes the distance to every child the ray enters and returns them as the bits of a mask
+static int IntersectChildren(const MeshBvhNode &node, const BvhRay &ray, float closest, float *distances) {
+    const float *nearX = ray.isNegative[0] ? node.maxX : node.minX;
+    const float *nearY = ray.isNegative[1] ? node.maxY : node.minY;
+    const float *nearZ = ray.isNegative[2] ? node.maxZ : node.minZ;
+    const float *farX = ray.isNegative[0] ? node.minX : node.maxX;
+    const float *farY = ray.isNegative[1] ? node.minY : node.maxY;
+    const float *farZ = ray.isNegative[2] ? node.minZ : node.maxZ;
+
+#ifdef MESH_BVH_X86
+    const __m128 originX = _mm_set1_ps(ray.origin.x);
+    const __m128 originY = _mm_set1_ps(ray.origin.y);
+    const __m128 originZ = _mm_set1_ps(ray.origin.z);
+    const __m128 inverseX = _mm_set1_ps(ray.inverseDirection.x);
+    const __m128 inverseY = _mm_set1_ps(ray.inverseDirection.y);
+    const __m128 inverseZ = _mm_set1_ps(ray.inverseDirection.z);
+
+    const __m128 nearDistance = _mm_max_ps(
+        _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearX), originX), inverseX),
+                   _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearY), originY), inverseY)),
+        _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearZ), originZ), inverseZ), _mm_setzero_ps()));
+    const __m128 farDistance = _mm_min_ps(
+        _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farX), originX), inverseX),
+                   _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farY), originY), inverseY)),
+        _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farZ), originZ), inverseZ), _mm_set1_ps(closest)));
+    _mm_storeu_ps(distances, nearDistance);
+    return _mm_movemask_ps(_mm_cmple_ps(nearDistance, farDistance));
+#else
+    int mask = 0;
+    for (int i = 0; i < 4; i++) {
+        const float nearDistance = std::max(std::max((nearX[i] - ray.origin.x) * ray.inverseDirection.x,
+                                                     (nearY[i] - ray.origin.y) * ray.inverseDirection.y),
+                                            std::max((nearZ[i] - ray.origin.z) * ray.inverseDirection.z, 0.0f));
+        const float farDistance = std::min(std::min((farX[i] - ray.origin.x) * ray.inverseDirection.x,
+                                                    (farY[i] - ray.origin.y) * ray.inverseDirection.y),
+                                           std::min((farZ[i] - ray.origin.z) * ray.inverseDirection.z, closest));
+        distances[i] = nearDistance;
+        mask |= nearDistance <= farDistance ? 1 << i : 0;
+    }
+    return mask;
+#endif
+}
+
+// Moller-Trumbore, closest and the barycentrics change only when the triangle is closer
+static bool IntersectTriangle(const MeshBvhTriangle &triangle, const BvhRay &ray, float &closest,
+                              glm::vec2 &barycentrics) {
+    const glm::vec3 p = glm::cross(ray.direction, triangle.edge2);
+    const float determinant = glm::dot(triangle.edge1, p);
+    if (determinant == 0.0f) return false;
+
+    const float inverseDeterminant = 1.0f / determinant;
+    const glm::vec3 t = ray.origin - triangle.vertex0;
+    const float u = glm::dot(t, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f) return false;
+
+    const glm::vec3 q = glm::cross(t, triangle.edge1);
+    const float v = glm::dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    const float distance = glm::dot(triangle.edge2, q) * inverseDeterminant;
+    if (distance <= 0.0f || distance >= closest) return false;
+
+    closest = distance;
+    barycentrics = glm::vec2(u, v);
+    return true;
+}
+
+bool MeshBvh::Intersect(const glm::vec3 &origin, const glm::vec3 &direction, MeshBvhHit &hit, float maxDistance) const {
+    // division by 0 gives infinity, which the slab test handles
+    const BvhRay ray{
+        origin, direction, 1.0f / direction, {direction.x < 0.0f, direction.y < 0.0f, direction.z < 0.0f}
+    };
+
+    struct Entry {
+        uint32_t node;
+        float distance;
+    };
+    // every visit takes one entry and adds at most 4, so the depth limit keeps it below 3 * MESH_BVH_MAX_DEPTH + 1
+    Entry stack[MESH_BVH_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = {0, 0.0f};
+
+    float closest = maxDistance;
+    uint32_t hitTriangle = MESH_BVH_EMPTY_CHILD;
+    glm::vec2 barycentrics(0.0f);
+    while (stackSize > 0) {
+        const Entry entry = stack[--stackSize];
+        // something closer was hit since it was pushed
+        if (entry.distance >= closest) continue;
+
+        const MeshBvhNode &node = m_nodes[entry.node];
+        float distances[4];
+        const int mask = IntersectChildren(node, ray, closest, distances);
+
+        Entry nodes[4];
+        uint32_t nodeCount = 0;
+        for (int i = 0; i < 4; i++) {
+            if ((mask & (1 << i)) == 0) continue;
+
+            if (node.triangleCount[i] == 0) {
+                // closest child ends on the top of the stack
+                uint32_t slot = nodeCount++;
+                for (; slot > 0 && nodes[slot - 1].distance < distances[i]; slot--) {
+                    nodes[slot] = nodes[slot - 1];
+                }
+                nodes[slot] = {node.child[i], distances[i]};
+                continue;
+            }
+            for (uint32_t triangle = node.child[i]; triangle < node.child[i] + node.triangleCount[i]; triangle++) {
+                if (IntersectTriangle(m_triangles[triangle], ray, closest, barycentrics)) hitTriangle = triangle;
+            }
+        }
+        for (uint32_t i = 0; i < nodeCount; i++) {
+            stack[stackSize++] = nodes[i];
+        }
+    }
+
+    if (hitTriangle == MESH_BVH_EMPTY_CHILD) return false;
+
+    const MeshBvhTriangle &triangle = m_triangles[hitTriangle];
+    hit.triangle = triangle.index;
+    hit.distance = closest;
+    hit.position = origin + direction * closest;
+    hit.normal = glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+    if (glm::dot(hit.normal, direction) > 0.0f) hit.normal = -hit.normal;
+    hit.barycentrics = barycentrics;
+    return true;
+}
+
+double MeshBvh::BenchmarkQueries(uint32_t rayCount, uint32_t &hitCount) const {
+    hitCount = 0;
+    if (rayCount == 0) return 0.0;
+
+    // same seed every time, so the runs shoot the same rays
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    const glm::vec3 centre = (m_boundsMin + m_boundsMax) * 0.5f;
+    const glm::vec3 halfSize = (m_boundsMax - m_boundsMin) * 0.5f;
+    const float radius = glm::length(halfSize) * 2.0f;
+
+    std::vector<glm::vec3> origins(rayCount);
+    std::vector<glm::vec3> directions(rayCount);
+    for (uint32_t i = 0; i < rayCount; i++) {
+        glm::vec3 onSphere(distribution(random), distribution(random), distribution(random));
+        if (glm::dot(onSphere, onSphere) < 1e-6f) onSphere = glm::vec3(0.0f, 0.0f, 1.0f);
+        origins[i] = centre + glm::normalize(onSphere) * radius;
+        const glm::vec3 target = centre + halfSize * glm::vec3(distribution(random), distribution(random),
+                                                               distribution(random));
+        directions[i] = target - origins[i];
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < rayCount; i++) {
+        MeshBvhHit hit;
+        hitCount += Intersect(origins[i], directions[i], hit) ? 1 : 0;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / static_cast<double>(rayCount);
+}
+
+const char *MeshBvh::GetInstructionSet() const {
+#ifdef MESH_BVH_X86
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
+
+//------------------
+// CACHE
+//------------------
+bool MeshBvh::LoadCache(const std::string &cachePath, uint64_t meshHash) {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    MeshBvhHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || header.magic != MESH_BVH_MAGIC || header.version != MESH_BVH_VERSION || header.meshHash != meshHash ||
+        header.nodeCount == 0) {
+        return false;
+    }
+
+    m_nodes.resize(header.nodeCount);
+    m_triangles.resize(header.triangleCount);
+    file.read(reinterpret_cast<char *>(m_nodes.data()),
+              static_cast<std::streamsize>(m_nodes.size() * sizeof(MeshBvhNode)));
+    file.read(reinterpret_cast<char *>(m_triangles.data()),
+              static_cast<std::streamsize>(m_triangles.size() * sizeof(MeshBvhTriangle)));
+    if (!file) {
+        m_nodes.clear();
+        m_triangles.clear();
+        return false;
+    }
+    return true;
+}
+
+void MeshBvh::SaveCache(const std::string &cachePath, uint64_t meshHash) const {
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write the BVH cache " << cachePath << " \n";
+        return;
+    }
+
+    MeshBvhHeader header{};
+    header.magic = MESH_BVH_MAGIC;
+    header.version = MESH_BVH_VERSION;
+    header.meshHash = meshHash;
+    header.nodeCount = GetNodeCount();
+    header.triangleCount = GetTriangleCount();
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(m_nodes.data()),
+               static_cast<std::streamsize>(m_nodes.size() * sizeof(MeshBvhNode)));
+    file.write(reinterpret_cast<const char *>(m_triangles.data()),
+               static_cast<std::streamsize>(m_triangles.size() * sizeof(MeshBvhTriangle)));
+}
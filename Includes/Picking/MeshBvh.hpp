@@ -0,0 +1,132 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef MESHBVH_HPP
+#define MESHBVH_HPP
+#include <limits>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Threading/ThreadPool.hpp"
+
+constexpr uint32_t MESH_BVH_MAGIC = 0x34485642; // "BVH4"
+constexpr uint32_t MESH_BVH_VERSION = 1;
+// planes the surface area heuristic tries on every axis
+constexpr uint32_t MESH_BVH_BIN_COUNT = 16;
+// nodes with at most this many triangles become a leaf once splitting them does not pay off
+constexpr uint32_t MESH_BVH_MAX_LEAF_SIZE = 8;
+// deeper nodes become a leaf no matter their size, which also bounds the traversal stack
+constexpr uint32_t MESH_BVH_MAX_DEPTH = 64;
+constexpr uint32_t MESH_BVH_STACK_SIZE = 256;
+// larger nodes are binned by every thread of the pool, smaller ones are built as a whole subtree by one thread
+constexpr uint32_t MESH_BVH_SUBTREE_SIZE = 8192;
+// child of a node without anything in it
+constexpr uint32_t MESH_BVH_EMPTY_CHILD = 0xFFFFFFFFu;
+
+// triangle bounds and centroids while the BVH is built, defined in MeshBvh.cpp
+struct MeshBvhBuildInput;
+
+// start of the cached BVH, followed by the nodes and the triangles
+struct MeshBvhHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t meshHash;
+    uint32_t nodeCount;
+    uint32_t triangleCount;
+};
+
+// 4 children of a node, their bounds are structure of arrays so SSE tests the ray against all of them at once.
+// Child with 0 triangles is a node, otherwise it is a leaf and the child is its first triangle.
+// Empty children have inverted bounds, which the ray never hits
+struct alignas(64) MeshBvhNode {
+    float minX[4];
+    float minY[4];
+    float minZ[4];
+    float maxX[4];
+    float maxY[4];
+    float maxZ[4];
+    uint32_t child[4];
+    uint32_t triangleCount[4];
+};
+
+// triangle in the order of the leaves, ready for the Moller-Trumbore test
+struct MeshBvhTriangle {
+    glm::vec3 vertex0;
+    glm::vec3 edge1;
+    glm::vec3 edge2;
+    // index of the triangle in the index buffer divided by 3
+    uint32_t index;
+};
+
+struct MeshBvhHit {
+    uint32_t triangle = 0;
+    // along the ray, in the units of its direction
+    float distance = std::numeric_limits<float>::max();
+    glm::vec3 position = glm::vec3(0.0f);
+    // normal of the triangle facing the ray
+    glm::vec3 normal = glm::vec3(0.0f);
+    // weights of the second and the third vertex
+    glm::vec2 barycentrics = glm::vec2(0.0f);
+};
+
+// Bounding volume hierarchy of the triangles of a mesh for the ray queries on the CPU.
+// Built top down with the binned surface area heuristic, the large nodes at the top are binned by every thread
+// of the pool and the subtrees below them are built in parallel. The binary tree is then collapsed in to nodes with
+// 4 children stored depth first, so one SSE test decides which of the 4 children the ray enters.
+// Built BVH is stored in the cache file under the hash of the mesh, so it is built only once per mesh
+class MeshBvh {
+public:
+    // the thread pool is used only while the BVH is built, before the constructor returns
+    MeshBvh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, ThreadPool &threadPool,
+            const std::string &cachePath);
+
+    // closest triangle hit by origin + t * direction with t in (0, maxDistance), direction does not have to be
+    // normalized, so the ray can be taken to the space of the mesh with a scaled transformation
+    bool Intersect(const glm::vec3 &origin, const glm::vec3 &direction, MeshBvhHit &hit,
+                   float maxDistance = std::numeric_limits<float>::max()) const;
+
+    // rays from a sphere around the mesh to the random points in its bounds, returns the average microseconds
+    // of a single query on the calling thread
+    double BenchmarkQueries(uint32_t rayCount, uint32_t &hitCount) const;
+
+    glm::vec3 GetBoundsMin() const {return m_boundsMin;}
+    glm::vec3 GetBoundsMax() const {return m_boundsMax;}
+    uint32_t GetNodeCount() const {return static_cast<uint32_t>(m_nodes.size());}
+    uint32_t GetTriangleCount() const {return static_cast<uint32_t>(m_triangles.size());}
+    const char *GetInstructionSet() const;
+
+private:
+    struct BuildNode {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // interior node if the count is 0
+        uint32_t left;
+        uint32_t right;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    void Build(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, ThreadPool &threadPool);
+    // recursive build of a subtree on a single thread, returns the node
+    uint32_t BuildSubtree(const MeshBvhBuildInput &input, uint32_t first, uint32_t count, uint32_t depth,
+                          std::vector<BuildNode> &nodes);
+    // binary node becomes a node with up to 4 children, returns the node
+    uint32_t Collapse(const std::vector<BuildNode> &binaryNodes, uint32_t binaryNode);
+
+    bool LoadCache(const std::string &cachePath, uint64_t meshHash);
+    void SaveCache(const std::string &cachePath, uint64_t meshHash) const;
+
+    std::vector<MeshBvhNode> m_nodes;
+    std::vector<MeshBvhTriangle> m_triangles;
+    // order of the triangles in the leaves while it is built
+    std::vector<uint32_t> m_order;
+
+    glm::vec3 m_boundsMin = glm::vec3(0.0f);
+    glm::vec3 m_boundsMax = glm::vec3(0.0f);
+};
+
+
+#endif //MESHBVH_HPP
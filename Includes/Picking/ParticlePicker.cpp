@@ -0,0 +1,223 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ParticlePicker.hpp"
+
+#include <cstring>
+
+#include "Utils.hpp"
+
+static_assert(sizeof(ParticlePicker::PickResult) == 48, "Pick result has to match the std430 layout of the shader");
+
+ParticlePicker::ParticlePicker(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers,
+                               uint32_t particleCount, uint32_t framesInFlight) {
+    this->m_context = context;
+    this->m_particleCount = particleCount;
+    this->m_candidateCount = (particleCount + 255) / 256;
+    this->m_framesInFlight = framesInFlight;
+    this->m_stateCount = static_cast<uint32_t>(particleBuffers.size());
+
+    if (!SupportsComputeSubgroupArithmetic(m_context.physicalDevice)) {
+        throw std::runtime_error("Particle picking needs subgroup arithmetic in the compute shaders");
+    }
+
+    CreateBuffers();
+    CreateDescriptors(particleBuffers);
+    CreatePipelines();
+}
+
+void ParticlePicker::CreateBuffers() {
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    bufferCreateInfo.size = sizeof(glm::uvec2) * m_candidateCount;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    CreateBuffer(bufferCreateInfo, m_candidateBuffer, m_candidateBufferMemory);
+
+    // result is only 48 bytes, so the shader writes it straight in to the host visible memory without a copy
+    bufferCreateInfo.size = sizeof(PickResult);
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    m_resultBuffers.resize(m_framesInFlight);
+    m_resultBuffersMemory.resize(m_framesInFlight);
+    m_resultBuffersMapped.resize(m_framesInFlight);
+    m_isResultPending.assign(m_framesInFlight, false);
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        CreateBuffer(bufferCreateInfo, m_resultBuffers[i], m_resultBuffersMemory[i]);
+        vkMapMemory(m_context.logicalDevice, m_resultBuffersMemory[i], 0, sizeof(PickResult), 0,
+                    &m_resultBuffersMapped[i]);
+    }
+}
+
+void ParticlePicker::CreateDescriptors(const std::vector<VkBuffer> &particleBuffers) {
+    //------------------------
+    // DESCRIPTOR SET LAYOUT
+    //------------------------
+    // particles, candidates and the result
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle picking descriptor set layout");
+    }
+
+    //-----------------
+    // DESCRIPTOR POOL
+    //-----------------
+    const uint32_t setCount = m_framesInFlight * m_stateCount;
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = static_cast<uint32_t>(bindings.size()) * setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = setCount;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle picking descriptor pool");
+    }
+
+    //-----------------
+    // DESCRIPTOR SETS
+    //-----------------
+    std::vector<VkDescriptorSetLayout> layouts(setCount, m_descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+    m_descriptorSets.resize(setCount);
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate particle picking descriptor sets");
+    }
+
+    for (uint32_t frame = 0; frame < m_framesInFlight; frame++) {
+        for (uint32_t state = 0; state < m_stateCount; state++) {
+            std::array<VkDescriptorBufferInfo, 3> bufferInfos = {{
+                {particleBuffers[state], 0, VK_WHOLE_SIZE},
+                {m_candidateBuffer, 0, VK_WHOLE_SIZE},
+                {m_resultBuffers[frame], 0, VK_WHOLE_SIZE},
+            }};
+            std::array<VkWriteDescriptorSet, 3> writes{};
+            for (uint32_t b = 0; b < writes.size(); b++) {
+                writes[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+                writes[b].dstSet = m_descriptorSets[frame * m_stateCount + state];
+                writes[b].dstBinding = b;
+                writes[b].descriptorCount = 1;
+                writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[b].pBufferInfo = &bufferInfos[b];
+            }
+            vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0,
+                                   nullptr);
+        }
+    }
+}
+
+void ParticlePicker::CreatePipelines() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle picking pipeline layout");
+    }
+
+    // both passes are the same shader specialized with different PASS constant
+    VkSpecializationMapEntry passEntry{};
+    passEntry.constantID = 0;
+    passEntry.offset = 0;
+    passEntry.size = sizeof(uint32_t);
+
+    for (uint32_t pass = 0; pass < PASS_COUNT; pass++) {
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &passEntry;
+        specializationInfo.dataSize = sizeof(uint32_t);
+        specializationInfo.pData = &pass;
+
+        m_pipelines[pass] = CreateComputePipelineFromFile(m_context.logicalDevice, "Shaders/Compiled/ParticlePick.spv",
+                                                          m_pipelineLayout, &specializationInfo);
+    }
+}
+
+void ParticlePicker::RecordCommands(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t stateIndex,
+                                    const glm::vec3 &rayOrigin, const glm::vec3 &rayDirection, GpuTimer &timer) {
+    PushConstants pushConstants{};
+    pushConstants.rayOrigin = glm::vec4(rayOrigin, 1.0f);
+    pushConstants.rayDirection = glm::vec4(glm::normalize(rayDirection), 0.0f);
+    pushConstants.particleCount = m_particleCount;
+    pushConstants.candidateCount = m_candidateCount;
+    pushConstants.maxAngle = PICK_MAX_ANGLE;
+
+    // particles might come from a compute shader or from a transfer (CPU simulation, replay),
+    // candidates are shared with the frame before
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    timer.Begin(commandBuffer, frame, "Picking", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1,
+                            &m_descriptorSets[frame * m_stateCount + stateIndex], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[PASS_PARTICLES]);
+    vkCmdDispatch(commandBuffer, m_candidateCount, 1, 1);
+    InsertComputeBarrier(commandBuffer);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[PASS_CANDIDATES]);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+    timer.End(commandBuffer, frame, "Picking", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_isResultPending[frame] = true;
+}
+
+void ParticlePicker::CollectResults(uint32_t frame) {
+    if (!m_isResultPending[frame]) return;
+
+    memcpy(&m_result, m_resultBuffersMapped[frame], sizeof(PickResult));
+    m_isResultPending[frame] = false;
+}
+
+ParticlePicker::~ParticlePicker() {
+    for (auto pipeline: m_pipelines) {
+        vkDestroyPipeline(m_context.logicalDevice, pipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_descriptorSetLayout, nullptr);
+
+    vkDestroyBuffer(m_context.logicalDevice, m_candidateBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_candidateBufferMemory, nullptr);
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        vkUnmapMemory(m_context.logicalDevice, m_resultBuffersMemory[i]);
+        vkDestroyBuffer(m_context.logicalDevice, m_resultBuffers[i], nullptr);
+        vkFreeMemory(m_context.logicalDevice, m_resultBuffersMemory[i], nullptr);
+    }
+}
@@ -0,0 +1,99 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef PARTICLEPICKER_HPP
+#define PARTICLEPICKER_HPP
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Profiling/GpuTimer.hpp"
+
+// index of the picked particle when nothing is under the mouse
+constexpr uint32_t PICK_NO_PARTICLE = 0xFFFFFFFFu;
+// largest angle (radians) between the mouse ray and the direction to the particle that still counts as a hit
+constexpr float PICK_MAX_ANGLE = 0.015f;
+
+// Finds the particle closest to the mouse ray on the GPU with ParticlePick.comp.
+// Every work group reduces its particles with subgroup min to one candidate, second single work group pass
+// reduces the candidates and writes the result in to the host visible buffer of the frame.
+// The result is read once the fence of that frame was waited on, so it is 1 - 2 frames old and nothing waits on it.
+// CPU cost does not depend on the amount of particles
+class ParticlePicker {
+public:
+    // has to match PickResult in ParticlePick.comp (std430)
+    struct PickResult {
+        uint32_t index = PICK_NO_PARTICLE;
+        float angle = 0.0f;
+        uint32_t padding[2];
+        glm::vec4 position = glm::vec4(0.0f);
+        glm::vec4 velocity = glm::vec4(0.0f);
+    };
+
+    // throws if the device can not do subgroup arithmetic in the compute shaders
+    ParticlePicker(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers, uint32_t particleCount,
+                   uint32_t framesInFlight);
+
+    // ray has to be in the space of the particles, has to be recorded after the commands that wrote particleBuffers[stateIndex]
+    void RecordCommands(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t stateIndex, const glm::vec3 &rayOrigin,
+                        const glm::vec3 &rayDirection, GpuTimer &timer);
+
+    // call after the fence of the frame is signaled
+    void CollectResults(uint32_t frame);
+
+    bool HasPickedParticle() const {return m_result.index != PICK_NO_PARTICLE;}
+    // latest result that came back from the GPU
+    const PickResult &GetResult() const {return m_result;}
+
+    ~ParticlePicker();
+
+private:
+    // has to match PickParameters in ParticlePick.comp
+    struct PushConstants {
+        glm::vec4 rayOrigin;
+        glm::vec4 rayDirection;
+        uint32_t particleCount;
+        uint32_t candidateCount;
+        float maxAngle;
+    };
+
+    enum PASS {
+        PASS_PARTICLES = 0,
+        PASS_CANDIDATES = 1,
+        PASS_COUNT = 2,
+    };
+
+    void CreateBuffers();
+    void CreateDescriptors(const std::vector<VkBuffer> &particleBuffers);
+    void CreatePipelines();
+
+    DeviceContext m_context;
+    uint32_t m_particleCount;
+    uint32_t m_candidateCount;
+    uint32_t m_framesInFlight;
+    uint32_t m_stateCount;
+
+    // one candidate (angle, index) per work group of the first pass
+    VkBuffer m_candidateBuffer;
+    VkDeviceMemory m_candidateBufferMemory;
+
+    // per frame in flight, persistently mapped
+    std::vector<VkBuffer> m_resultBuffers;
+    std::vector<VkDeviceMemory> m_resultBuffersMemory;
+    std::vector<void *> m_resultBuffersMapped;
+    std::vector<bool> m_isResultPending;
+    PickResult m_result{};
+
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    // indexed [frame * stateCount + stateIndex]
+    std::vector<VkDescriptorSet> m_descriptorSets;
+    VkPipelineLayout m_pipelineLayout;
+    std::array<VkPipeline, PASS_COUNT> m_pipelines{};
+};
+
+
+#endif //PARTICLEPICKER_HPP
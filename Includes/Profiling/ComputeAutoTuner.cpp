@@ -0,0 +1,165 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ComputeAutoTuner.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "Profiling/GpuTimer.hpp"
+#include "Utils.hpp"
+
+ComputeAutoTuner::ComputeAutoTuner(const DeviceContext &context, uint32_t queueFamilyIndex, VkQueue queue,
+                                   VkCommandPool commandPool, const std::string &cachePath) {
+    this->m_context = context;
+    this->m_queueFamilyIndex = queueFamilyIndex;
+    this->m_queue = queue;
+    this->m_commandPool = commandPool;
+    this->m_cachePath = cachePath;
+
+    VkPhysicalDeviceIDProperties idProperties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    properties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(m_context.physicalDevice, &properties);
+    m_limits = properties.properties.limits;
+
+    std::ostringstream deviceKey;
+    deviceKey << std::hex << std::setfill('0');
+    for (uint8_t byte: idProperties.deviceUUID) {
+        deviceKey << std::setw(2) << static_cast<uint32_t>(byte);
+    }
+    deviceKey << "-" << properties.properties.driverVersion;
+    m_deviceKey = deviceKey.str();
+
+    LoadCache();
+}
+
+KernelVariant ComputeAutoTuner::Tune(const std::string &kernelName, const std::string &shaderPath,
+                                     VkPipelineLayout layout, const std::vector<KernelVariant> &variants,
+                                     const KernelVariant &defaultVariant,
+                                     const std::function<void(VkCommandBuffer, const KernelVariant &)> &recordDispatch) {
+    // cached variant is used only when it is still one of the candidates, otherwise the kernel changed
+    auto cached = m_cache.find(m_deviceKey + " " + kernelName);
+    if (cached != m_cache.end() &&
+        std::find(variants.begin(), variants.end(), cached->second) != variants.end() && CanRun(cached->second)) {
+        return cached->second;
+    }
+
+    GpuTimer timer(m_context.physicalDevice, m_context.logicalDevice, m_queueFamilyIndex, 1, TUNING_MEASURE_ITERATIONS);
+    if (!timer.IsSupported()) {
+        return defaultVariant;
+    }
+
+    KernelVariant bestVariant = defaultVariant;
+    double bestMs = std::numeric_limits<double>::max();
+
+    for (const auto &variant: variants) {
+        if (!CanRun(variant)) continue;
+
+        VkPipeline pipeline = CreatePipeline(m_context.logicalDevice, shaderPath, layout, variant);
+
+        VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_context.logicalDevice, m_commandPool);
+        timer.Reset(commandBuffer, 0);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+        for (uint32_t i = 0; i < TUNING_WARMUP_ITERATIONS; i++) {
+            recordDispatch(commandBuffer, variant);
+            InsertComputeBarrier(commandBuffer);
+        }
+        for (uint32_t i = 0; i < TUNING_MEASURE_ITERATIONS; i++) {
+            timer.Begin(commandBuffer, 0, kernelName, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            recordDispatch(commandBuffer, variant);
+            timer.End(commandBuffer, 0, kernelName, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            InsertComputeBarrier(commandBuffer);
+        }
+        EndSingleTimeCommand(m_context.logicalDevice, m_commandPool, commandBuffer, m_queue);
+
+        timer.CollectResults(0);
+        double milliseconds = timer.GetAverageMs(kernelName);
+        timer.ResetStatistics();
+        vkDestroyPipeline(m_context.logicalDevice, pipeline, nullptr);
+
+        std::cout << "[Tuning] " << kernelName << " (";
+        for (size_t c = 0; c < variant.size(); c++) {
+            std::cout << (c == 0 ? "" : ", ") << variant[c];
+        }
+        std::cout << "): " << milliseconds << " ms \n";
+
+        if (milliseconds < bestMs) {
+            bestMs = milliseconds;
+            bestVariant = variant;
+        }
+    }
+
+    m_hasMeasured = true;
+    m_cache[m_deviceKey + " " + kernelName] = bestVariant;
+    SaveCache();
+    return bestVariant;
+}
+
+VkPipeline ComputeAutoTuner::CreatePipeline(VkDevice logicalDevice, const std::string &shaderPath,
+                                            VkPipelineLayout layout, const KernelVariant &variant) {
+    std::vector<VkSpecializationMapEntry> entries(variant.size());
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        entries[i].constantID = i;
+        entries[i].offset = i * sizeof(uint32_t);
+        entries[i].size = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+    specializationInfo.pMapEntries = entries.data();
+    specializationInfo.dataSize = sizeof(uint32_t) * variant.size();
+    specializationInfo.pData = variant.data();
+
+    return CreateComputePipelineFromFile(logicalDevice, shaderPath, layout, &specializationInfo);
+}
+
+bool ComputeAutoTuner::CanRun(const KernelVariant &variant) const {
+    return !variant.empty() && variant[0] > 0 && variant[0] <= m_limits.maxComputeWorkGroupSize[0] &&
+        variant[0] <= m_limits.maxComputeWorkGroupInvocations;
+}
+
+void ComputeAutoTuner::LoadCache() {
+    std::ifstream file(m_cachePath);
+    if (!file.is_open()) return;
+
+    // every line is: device key, kernel name, amount of constants and the constants
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string deviceKey, kernelName;
+        size_t count = 0;
+        if (!(stream >> deviceKey >> kernelName >> count)) continue;
+
+        KernelVariant variant(count);
+        for (auto &value: variant) {
+            stream >> value;
+        }
+        if (stream) {
+            m_cache[deviceKey + " " + kernelName] = variant;
+        }
+    }
+}
+
+void ComputeAutoTuner::SaveCache() const {
+    std::ofstream file(m_cachePath, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write the tuning cache " << m_cachePath << " \n";
+        return;
+    }
+
+    // entries of other devices are kept, the same file can be shared between machines
+    for (const auto &[key, variant]: m_cache) {
+        file << key << " " << variant.size();
+        for (uint32_t value: variant) {
+            file << " " << value;
+        }
+        file << "\n";
+    }
+}
@@ -0,0 +1,66 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef COMPUTEAUTOTUNER_HPP
+#define COMPUTEAUTOTUNER_HPP
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+// dispatches that are not timed before every variant is measured, so clocks and caches settle
+constexpr uint32_t TUNING_WARMUP_ITERATIONS = 3;
+constexpr uint32_t TUNING_MEASURE_ITERATIONS = 8;
+
+// one variant of the kernel, value i goes to the specialization constant with id i.
+// Constant 0 is always the work group size in x (local_size_x_id = 0)
+using KernelVariant = std::vector<uint32_t>;
+
+// Picks the fastest specialization of a compute kernel for the device it runs on.
+// Every variant is built as its own pipeline and timed with timestamp queries after a few warm up dispatches,
+// the winner is stored in the cache file under the UUID and driver version of the device,
+// so the measurement runs only once per device (delete the file to tune again)
+class ComputeAutoTuner {
+public:
+    ComputeAutoTuner(const DeviceContext &context, uint32_t queueFamilyIndex, VkQueue queue, VkCommandPool commandPool,
+                     const std::string &cachePath);
+
+    // cached variant of the kernel or the fastest of the variants the device can run. recordDispatch records one
+    // run of the kernel with its pipeline already bound, it has to bind the descriptors it needs.
+    // defaultVariant is returned when the device can not write timestamps
+    KernelVariant Tune(const std::string &kernelName, const std::string &shaderPath, VkPipelineLayout layout,
+                       const std::vector<KernelVariant> &variants, const KernelVariant &defaultVariant,
+                       const std::function<void(VkCommandBuffer commandBuffer, const KernelVariant &variant)> &recordDispatch);
+
+    // true once any kernel was measured, the measured dispatches have overwritten the buffers they write
+    bool HasMeasured() const {return m_hasMeasured;}
+
+    static VkPipeline CreatePipeline(VkDevice logicalDevice, const std::string &shaderPath, VkPipelineLayout layout,
+                                     const KernelVariant &variant);
+
+private:
+    bool CanRun(const KernelVariant &variant) const;
+    void LoadCache();
+    void SaveCache() const;
+
+    DeviceContext m_context;
+    uint32_t m_queueFamilyIndex;
+    VkQueue m_queue;
+    VkCommandPool m_commandPool;
+    std::string m_cachePath;
+    VkPhysicalDeviceLimits m_limits;
+    // UUID of the device and the driver version, tuned variants are valid only for this combination
+    std::string m_deviceKey;
+    bool m_hasMeasured = false;
+
+    // "deviceKey kernelName" -> variant
+    std::unordered_map<std::string, KernelVariant> m_cache;
+};
+
+
+#endif //COMPUTEAUTOTUNER_HPP
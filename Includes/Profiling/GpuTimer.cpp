@@ -0,0 +1,144 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "GpuTimer.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+GpuTimer::GpuTimer(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamilyIndex,
+                   uint32_t framesInFlight, uint32_t maxScopesPerFrame) {
+    this->m_logicalDevice = logicalDevice;
+    this->m_framesInFlight = framesInFlight;
+    this->m_maxScopesPerFrame = maxScopesPerFrame;
+    this->m_recordedScopes.resize(framesInFlight);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    // 0 valid bits means the queue can not write timestamps at all
+    uint32_t validBits = queueFamilyIndex < queueFamilyCount ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+    if (validBits == 0 || properties.limits.timestampPeriod == 0.0f) {
+        std::cout << "Timestamp queries are not supported, GPU timings will not be available \n";
+        return;
+    }
+
+    m_timestampPeriod = properties.limits.timestampPeriod;
+    m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    // every scope needs 2 queries, begin and end
+    VkQueryPoolCreateInfo queryPoolInfo{.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = framesInFlight * maxScopesPerFrame * 2;
+
+    if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timestamp query pool");
+    }
+
+    m_isSupported = true;
+}
+
+void GpuTimer::Reset(VkCommandBuffer commandBuffer, uint32_t frame) {
+    m_recordedScopes[frame].clear();
+    if (!m_isSupported) return;
+
+    vkCmdResetQueryPool(commandBuffer, m_queryPool, frame * m_maxScopesPerFrame * 2, m_maxScopesPerFrame * 2);
+}
+
+void GpuTimer::Begin(VkCommandBuffer commandBuffer, uint32_t frame, const std::string &scope,
+                     VkPipelineStageFlagBits stage) {
+    auto &recorded = m_recordedScopes[frame];
+    if (!m_isSupported || recorded.size() >= m_maxScopesPerFrame) return;
+
+    RecordedScope recordedScope{};
+    recordedScope.scopeId = GetScopeId(scope);
+    recordedScope.firstQuery = (frame * m_maxScopesPerFrame + static_cast<uint32_t>(recorded.size())) * 2;
+    recordedScope.isClosed = false;
+
+    vkCmdWriteTimestamp(commandBuffer, stage, m_queryPool, recordedScope.firstQuery);
+    recorded.push_back(recordedScope);
+}
+
+void GpuTimer::End(VkCommandBuffer commandBuffer, uint32_t frame, const std::string &scope,
+                   VkPipelineStageFlagBits stage) {
+    if (!m_isSupported) return;
+
+    auto id = m_scopeIds.find(scope);
+    if (id == m_scopeIds.end()) return;
+
+    // close the most recently opened scope with the same name, this allows nesting
+    auto &recorded = m_recordedScopes[frame];
+    for (auto it = recorded.rbegin(); it != recorded.rend(); ++it) {
+        if (it->scopeId == id->second && !it->isClosed) {
+            vkCmdWriteTimestamp(commandBuffer, stage, m_queryPool, it->firstQuery + 1);
+            it->isClosed = true;
+            return;
+        }
+    }
+}
+
+void GpuTimer::CollectResults(uint32_t frame) {
+    if (!m_isSupported) return;
+
+    for (const auto &recordedScope: m_recordedScopes[frame]) {
+        if (!recordedScope.isClosed) continue;
+
+        // timestamp and availability for begin and end query
+        uint64_t results[4] = {};
+        VkResult result = vkGetQueryPoolResults(m_logicalDevice, m_queryPool, recordedScope.firstQuery, 2,
+                                                sizeof(results), results, sizeof(uint64_t) * 2,
+                                                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+        // not ready yet, we never wait for the results
+        if (result != VK_SUCCESS || results[1] == 0 || results[3] == 0) continue;
+
+        uint64_t ticks = ((results[2] & m_timestampMask) - (results[0] & m_timestampMask)) & m_timestampMask;
+        auto &statistics = m_statistics[recordedScope.scopeId];
+        statistics.totalMs += static_cast<double>(ticks) * m_timestampPeriod / 1e6;
+        statistics.samples++;
+    }
+
+    m_recordedScopes[frame].clear();
+}
+
+bool GpuTimer::HasResults(const std::string &scope) const {
+    auto id = m_scopeIds.find(scope);
+    return id != m_scopeIds.end() && m_statistics[id->second].samples > 0;
+}
+
+double GpuTimer::GetAverageMs(const std::string &scope) const {
+    auto id = m_scopeIds.find(scope);
+    if (id == m_scopeIds.end() || m_statistics[id->second].samples == 0) return 0.0;
+
+    const auto &statistics = m_statistics[id->second];
+    return statistics.totalMs / static_cast<double>(statistics.samples);
+}
+
+void GpuTimer::ResetStatistics() {
+    for (auto &statistics: m_statistics) {
+        statistics = ScopeStatistics{};
+    }
+}
+
+uint32_t GpuTimer::GetScopeId(const std::string &scope) {
+    auto id = m_scopeIds.find(scope);
+    if (id != m_scopeIds.end()) return id->second;
+
+    uint32_t newId = static_cast<uint32_t>(m_scopeNames.size());
+    m_scopeIds[scope] = newId;
+    m_scopeNames.push_back(scope);
+    m_statistics.emplace_back();
+    return newId;
+}
+
+GpuTimer::~GpuTimer() {
+    if (m_queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(m_logicalDevice, m_queryPool, nullptr);
+    }
+}
@@ -0,0 +1,76 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef GPUTIMER_HPP
+#define GPUTIMER_HPP
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Measures GPU time of named scopes with timestamp queries.
+// Every frame in flight owns its own block of queries, results are read only after the frame's fence
+// was waited on, so collecting them never stalls the CPU
+class GpuTimer {
+public:
+    GpuTimer(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamilyIndex,
+             uint32_t framesInFlight, uint32_t maxScopesPerFrame = 16);
+
+    // has to be recorded outside of the render pass before any Begin/End of the given frame
+    void Reset(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    void Begin(VkCommandBuffer commandBuffer, uint32_t frame, const std::string &scope,
+               VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+    void End(VkCommandBuffer commandBuffer, uint32_t frame, const std::string &scope,
+             VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+    // call after the fence of the frame is signaled and before the frame is recorded again
+    void CollectResults(uint32_t frame);
+
+    bool HasResults(const std::string &scope) const;
+
+    double GetAverageMs(const std::string &scope) const;
+
+    const std::vector<std::string> &GetScopes() const {return m_scopeNames;}
+
+    void ResetStatistics();
+
+    bool IsSupported() const {return m_isSupported;}
+
+    ~GpuTimer();
+
+private:
+    struct ScopeStatistics {
+        double totalMs = 0.0;
+        uint64_t samples = 0;
+    };
+
+    struct RecordedScope {
+        uint32_t scopeId;
+        uint32_t firstQuery;
+        bool isClosed;
+    };
+
+    uint32_t GetScopeId(const std::string &scope);
+
+    VkDevice m_logicalDevice;
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    bool m_isSupported = false;
+
+    // nanoseconds per timestamp tick
+    double m_timestampPeriod = 1.0;
+    uint64_t m_timestampMask = ~0ull;
+
+    uint32_t m_framesInFlight;
+    uint32_t m_maxScopesPerFrame;
+
+    std::vector<std::vector<RecordedScope>> m_recordedScopes;
+    std::vector<std::string> m_scopeNames;
+    std::unordered_map<std::string, uint32_t> m_scopeIds;
+    std::vector<ScopeStatistics> m_statistics;
+};
+
+
+#endif //GPUTIMER_HPP
@@ -0,0 +1,96 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef PARTICLETELEMETRY_HPP
+#define PARTICLETELEMETRY_HPP
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Profiling/GpuTimer.hpp"
+
+// Statistics of the whole particle system (bounds, speed, kinetic energy, alive count) reduced on the GPU
+// with ParticleTelemetry.comp, so the particle buffer is never read back. Only the 48 byte result is written
+// in to the host visible buffer of the frame and read once the fence of that frame was waited on, nothing waits for it
+class ParticleTelemetry {
+public:
+    // has to match Statistics in ParticleTelemetry.comp (std430)
+    struct Statistics {
+        glm::vec4 boundsMin = glm::vec4(0.0f);
+        glm::vec4 boundsMax = glm::vec4(0.0f);
+        float speedSum = 0.0f;
+        float maxSpeed = 0.0f;
+        // particles have unit mass
+        float kineticEnergy = 0.0f;
+        // particles with finite position and velocity, the rest is left out of every other value
+        uint32_t aliveCount = 0;
+    };
+
+    // throws if the device can not do subgroup arithmetic in the compute shaders
+    ParticleTelemetry(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers, uint32_t particleCount,
+                      uint32_t framesInFlight);
+
+    // has to be recorded after the commands that wrote particleBuffers[stateIndex]
+    void RecordCommands(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t stateIndex, GpuTimer &timer);
+
+    // call after the fence of the frame is signaled
+    void CollectResults(uint32_t frame);
+
+    //----------------
+    // POLLING
+    //----------------
+    bool HasStatistics() const {return m_hasStatistics;}
+    // latest statistics that came back from the GPU, 1 - 2 frames old
+    const Statistics &GetStatistics() const {return m_statistics;}
+    float GetMeanSpeed() const {return m_statistics.aliveCount == 0 ? 0.0f : m_statistics.speedSum / m_statistics.aliveCount;}
+
+    ~ParticleTelemetry();
+
+private:
+    // has to match TelemetryParameters in ParticleTelemetry.comp
+    struct PushConstants {
+        uint32_t particleCount;
+        uint32_t partialCount;
+    };
+
+    enum PASS {
+        PASS_PARTICLES = 0,
+        PASS_PARTIALS = 1,
+        PASS_COUNT = 2,
+    };
+
+    void CreateBuffers();
+    void CreateDescriptors(const std::vector<VkBuffer> &particleBuffers);
+    void CreatePipelines();
+
+    DeviceContext m_context;
+    uint32_t m_particleCount;
+    uint32_t m_partialCount;
+    uint32_t m_framesInFlight;
+    uint32_t m_stateCount;
+
+    // one partial result per work group of the first pass
+    VkBuffer m_partialBuffer;
+    VkDeviceMemory m_partialBufferMemory;
+
+    // per frame in flight, persistently mapped
+    std::vector<VkBuffer> m_resultBuffers;
+    std::vector<VkDeviceMemory> m_resultBuffersMemory;
+    std::vector<void *> m_resultBuffersMapped;
+    std::vector<bool> m_isResultPending;
+    Statistics m_statistics{};
+    bool m_hasStatistics = false;
+
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    // indexed [frame * stateCount + stateIndex]
+    std::vector<VkDescriptorSet> m_descriptorSets;
+    VkPipelineLayout m_pipelineLayout;
+    std::array<VkPipeline, PASS_COUNT> m_pipelines{};
+};
+
+
+#endif //PARTICLETELEMETRY_HPP
@@ -0,0 +1,102 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "PipelineStatistics.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+PipelineStatistics::PipelineStatistics(VkDevice logicalDevice, uint32_t framesInFlight, bool isEnabled) {
+    this->m_logicalDevice = logicalDevice;
+    this->m_recordedScopes.resize(framesInFlight);
+
+    if (!isEnabled) {
+        std::cout << "Pipeline statistics queries are not supported, fragment counts will not be available \n";
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo{.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount = framesInFlight;
+    // results are written in the order of the bits, vertex invocations come before fragment invocations
+    queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                       VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline statistics query pool");
+    }
+
+    m_isSupported = true;
+}
+
+void PipelineStatistics::Reset(VkCommandBuffer commandBuffer, uint32_t frame) {
+    m_recordedScopes[frame] = RecordedScope{};
+    if (!m_isSupported) return;
+
+    vkCmdResetQueryPool(commandBuffer, m_queryPool, frame, 1);
+}
+
+void PipelineStatistics::Begin(VkCommandBuffer commandBuffer, uint32_t frame, const std::string &scope) {
+    auto &recorded = m_recordedScopes[frame];
+    // only one scope fits in to the query of the frame
+    if (!m_isSupported || recorded.isActive || recorded.isClosed) return;
+
+    recorded.scope = scope;
+    recorded.isActive = true;
+    vkCmdBeginQuery(commandBuffer, m_queryPool, frame, 0);
+}
+
+void PipelineStatistics::End(VkCommandBuffer commandBuffer, uint32_t frame) {
+    auto &recorded = m_recordedScopes[frame];
+    if (!m_isSupported || !recorded.isActive) return;
+
+    vkCmdEndQuery(commandBuffer, m_queryPool, frame);
+    recorded.isActive = false;
+    recorded.isClosed = true;
+}
+
+void PipelineStatistics::CollectResults(uint32_t frame) {
+    auto &recorded = m_recordedScopes[frame];
+    if (!m_isSupported || !recorded.isClosed) return;
+
+    // vertex invocations, fragment invocations and availability
+    uint64_t results[3] = {};
+    VkResult result = vkGetQueryPoolResults(m_logicalDevice, m_queryPool, frame, 1, sizeof(results), results,
+                                            sizeof(results), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if (result == VK_SUCCESS && results[2] != 0) {
+        auto &statistics = m_statistics[recorded.scope];
+        statistics.total.vertexInvocations += static_cast<double>(results[0]);
+        statistics.total.fragmentInvocations += static_cast<double>(results[1]);
+        statistics.samples++;
+    }
+
+    recorded = RecordedScope{};
+}
+
+bool PipelineStatistics::HasResults(const std::string &scope) const {
+    auto statistics = m_statistics.find(scope);
+    return statistics != m_statistics.end() && statistics->second.samples > 0;
+}
+
+PipelineStatistics::Counters PipelineStatistics::GetAverage(const std::string &scope) const {
+    auto statistics = m_statistics.find(scope);
+    if (statistics == m_statistics.end() || statistics->second.samples == 0) return Counters{};
+
+    double samples = static_cast<double>(statistics->second.samples);
+    Counters average{};
+    average.vertexInvocations = statistics->second.total.vertexInvocations / samples;
+    average.fragmentInvocations = statistics->second.total.fragmentInvocations / samples;
+    return average;
+}
+
+void PipelineStatistics::ResetStatistics() {
+    m_statistics.clear();
+}
+
+PipelineStatistics::~PipelineStatistics() {
+    if (m_queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(m_logicalDevice, m_queryPool, nullptr);
+    }
+}
@@ -0,0 +1,66 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef PIPELINESTATISTICS_HPP
+#define PIPELINESTATISTICS_HPP
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Counts vertex and fragment shader invocations of one named scope per frame with pipeline statistics queries.
+// Works the same way as GpuTimer, every frame in flight has its own query and results are never waited on
+class PipelineStatistics {
+public:
+    struct Counters {
+        double vertexInvocations = 0.0;
+        double fragmentInvocations = 0.0;
+    };
+
+    // isEnabled should be the pipelineStatisticsQuery feature that was enabled on the logical device
+    PipelineStatistics(VkDevice logicalDevice, uint32_t framesInFlight, bool isEnabled);
+
+    // has to be recorded outside of the render pass
+    void Reset(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    // Begin and End has to be in the same sub pass
+    void Begin(VkCommandBuffer commandBuffer, uint32_t frame, const std::string &scope);
+
+    void End(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    void CollectResults(uint32_t frame);
+
+    bool HasResults(const std::string &scope) const;
+
+    // average counts per frame
+    Counters GetAverage(const std::string &scope) const;
+
+    void ResetStatistics();
+
+    bool IsSupported() const {return m_isSupported;}
+
+    ~PipelineStatistics();
+
+private:
+    struct ScopeStatistics {
+        Counters total;
+        uint64_t samples = 0;
+    };
+
+    struct RecordedScope {
+        std::string scope;
+        bool isActive = false;
+        bool isClosed = false;
+    };
+
+    VkDevice m_logicalDevice;
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    bool m_isSupported = false;
+
+    std::vector<RecordedScope> m_recordedScopes;
+    std::unordered_map<std::string, ScopeStatistics> m_statistics;
+};
+
+
+#endif //PIPELINESTATISTICS_HPP
@@ -0,0 +1,215 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ParticleRecorder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "Recording/StateCodec.hpp"
+#include "Utils.hpp"
+
+ParticleRecorder::ParticleRecorder(const DeviceContext &context, uint32_t particleCount) {
+    this->m_context = context;
+    this->m_particleCount = particleCount;
+    this->m_stateSize = sizeof(Particle) * particleCount;
+
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = m_stateSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    m_slots.resize(RECORDER_RING_SIZE);
+    for (auto &slot: m_slots) {
+        CreateBuffer(bufferCreateInfo, slot.buffer, slot.memory);
+        // persistent mapping, the writer thread reads straight from it
+        vkMapMemory(m_context.logicalDevice, slot.memory, 0, m_stateSize, 0, &slot.mapped);
+    }
+}
+
+bool ParticleRecorder::Start(const std::string &path, uint32_t frameInterval) {
+    if (m_isRecording) return true;
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open()) {
+        std::cout << "Failed to open " << path << " for recording \n";
+        return false;
+    }
+
+    m_frameInterval = std::max(1u, frameInterval);
+    RecordingHeader header{};
+    header.magic = RECORDING_MAGIC;
+    header.version = RECORDING_VERSION;
+    header.particleCount = m_particleCount;
+    header.particleStride = sizeof(Particle);
+    header.frameInterval = m_frameInterval;
+    m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    m_previousState.assign(m_stateSize, 0);
+    m_chunksWritten = 0;
+    m_capturedCount = 0;
+    m_droppedCount = 0;
+    m_rawBytes = 0;
+    m_writtenBytes = sizeof(header);
+    m_startTime = std::chrono::steady_clock::now();
+
+    m_isStopping = false;
+    m_writer = std::thread(&ParticleRecorder::WriterLoop, this);
+    m_isRecording = true;
+    return true;
+}
+
+void ParticleRecorder::Stop() {
+    if (!m_isRecording) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+    m_writer.join();
+    m_file.close();
+
+    // the GPU might still copy in to them, caller waits for the device before the recording starts again
+    for (auto &slot: m_slots) {
+        slot.state = SLOT_FREE;
+    }
+    m_isRecording = false;
+}
+
+void ParticleRecorder::RecordCapture(VkCommandBuffer commandBuffer, uint32_t frame, uint64_t frameNumber,
+                                     VkBuffer particleBuffer, GpuTimer &timer) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Slot *freeSlot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto &slot: m_slots) {
+            if (slot.state == SLOT_FREE) {
+                freeSlot = &slot;
+                break;
+            }
+        }
+        if (freeSlot != nullptr) {
+            freeSlot->state = SLOT_ON_GPU;
+        }
+    }
+
+    // the writer can not keep up, skipping the capture is better than waiting for it
+    if (freeSlot == nullptr) {
+        m_droppedCount++;
+        return;
+    }
+    freeSlot->frame = frame;
+    freeSlot->frameNumber = frameNumber;
+
+    // particles might come from a compute shader or from a transfer (CPU simulation, replay)
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    timer.Begin(commandBuffer, frame, "Recording::Copy", VK_PIPELINE_STAGE_TRANSFER_BIT);
+    CopyBuffer(m_context.logicalDevice, commandBuffer, particleBuffer, freeSlot->buffer, m_stateSize);
+    timer.End(commandBuffer, frame, "Recording::Copy", VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_capturedCount++;
+    auto end = std::chrono::high_resolution_clock::now();
+    m_overheadMs += std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void ParticleRecorder::CollectCompleted(uint32_t frame) {
+    if (!m_isRecording) return;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // captures are handed over in the order they were taken, so the deltas are written in the right order
+        std::vector<Slot *> completed;
+        for (auto &slot: m_slots) {
+            if (slot.state == SLOT_ON_GPU && slot.frame == frame) {
+                completed.push_back(&slot);
+            }
+        }
+        std::sort(completed.begin(), completed.end(), [](const Slot *a, const Slot *b) {
+            return a->frameNumber < b->frameNumber;
+        });
+        for (Slot *slot: completed) {
+            slot->state = SLOT_WRITING;
+            m_pendingSlots.push(static_cast<uint32_t>(slot - m_slots.data()));
+        }
+    }
+    m_condition.notify_one();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    m_overheadMs += std::chrono::duration<double, std::milli>(end - start).count();
+    m_overheadSamples++;
+}
+
+void ParticleRecorder::WriterLoop() {
+    std::vector<uint8_t> scratch;
+    std::vector<uint8_t> encoded;
+
+    while (true) {
+        uint32_t slotIndex;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_isStopping || !m_pendingSlots.empty(); });
+            if (m_pendingSlots.empty()) return;
+
+            slotIndex = m_pendingSlots.front();
+            m_pendingSlots.pop();
+        }
+        Slot &slot = m_slots[slotIndex];
+        const auto *state = static_cast<const uint8_t *>(slot.mapped);
+        const uint64_t frameNumber = slot.frameNumber;
+
+        bool isKeyFrame = m_chunksWritten % RECORDER_KEY_FRAME_INTERVAL == 0;
+        EncodeState(state, isKeyFrame ? nullptr : m_previousState.data(), m_stateSize, scratch, encoded);
+        memcpy(m_previousState.data(), state, m_stateSize);
+
+        // the ring buffer is not needed any more, the GPU can copy the next capture in to it
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            slot.state = SLOT_FREE;
+        }
+
+        RecordingChunkHeader chunkHeader{};
+        chunkHeader.frame = static_cast<uint32_t>(frameNumber);
+        chunkHeader.isKeyFrame = isKeyFrame ? 1 : 0;
+        chunkHeader.encodedSize = static_cast<uint32_t>(encoded.size());
+        chunkHeader.decodedSize = static_cast<uint32_t>(m_stateSize);
+        m_file.write(reinterpret_cast<const char *>(&chunkHeader), sizeof(chunkHeader));
+        m_file.write(reinterpret_cast<const char *>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+
+        m_chunksWritten++;
+        m_rawBytes += m_stateSize;
+        m_writtenBytes += sizeof(chunkHeader) + encoded.size();
+    }
+}
+
+double ParticleRecorder::GetSustainedMBps() const {
+    if (!m_isRecording) return 0.0;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+    return seconds <= 0.0 ? 0.0 : static_cast<double>(m_writtenBytes) / seconds * 1e-6;
+}
+
+ParticleRecorder::~ParticleRecorder() {
+    Stop();
+    for (auto &slot: m_slots) {
+        vkUnmapMemory(m_context.logicalDevice, slot.memory);
+        vkDestroyBuffer(m_context.logicalDevice, slot.buffer, nullptr);
+        vkFreeMemory(m_context.logicalDevice, slot.memory, nullptr);
+    }
+}
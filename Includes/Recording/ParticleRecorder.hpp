@@ -0,0 +1,115 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef PARTICLERECORDER_HPP
+#define PARTICLERECORDER_HPP
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Profiling/GpuTimer.hpp"
+
+// how many captures can wait for the GPU or the writer thread at once, captures are dropped when all are taken
+constexpr uint32_t RECORDER_RING_SIZE = 4;
+// every how many chunks the state is stored without the delta, so a damaged chunk does not break the rest
+constexpr uint32_t RECORDER_KEY_FRAME_INTERVAL = 64;
+
+// Streams the particle state to a chunked file (see StateCodec.hpp) without ever waiting on the GPU.
+// The SSBO is copied in to one of the host visible buffers of the ring as part of the compute command buffer,
+// once the fence of that frame was waited on the buffer is handed to the writer thread, which encodes it
+// and writes it to the file. The buffer is free for the next capture after that
+class ParticleRecorder {
+public:
+    ParticleRecorder(const DeviceContext &context, uint32_t particleCount);
+
+    // opens the file and starts the writer thread, captures are taken every frameInterval frames
+    bool Start(const std::string &path, uint32_t frameInterval);
+
+    // waits for the writer thread to write the captures it already has, the ones still on the GPU are dropped
+    void Stop();
+
+    bool IsRecording() const {return m_isRecording;}
+
+    bool ShouldCapture(uint64_t frameNumber) const {return m_isRecording && frameNumber % m_frameInterval == 0;}
+
+    // copies the particle buffer in to a free ring buffer, has to be recorded after the commands that wrote it
+    void RecordCapture(VkCommandBuffer commandBuffer, uint32_t frame, uint64_t frameNumber, VkBuffer particleBuffer,
+                       GpuTimer &timer);
+
+    // call after the fence of the frame is signaled, captures of the frame go to the writer thread
+    void CollectCompleted(uint32_t frame);
+
+    //----------------
+    // STATISTICS
+    //----------------
+    uint64_t GetCapturedCount() const {return m_capturedCount;}
+    uint64_t GetDroppedCount() const {return m_droppedCount;}
+    uint64_t GetRawBytes() const {return m_rawBytes;}
+    uint64_t GetWrittenBytes() const {return m_writtenBytes;}
+    // bytes written to the file divided by the time the recording runs
+    double GetSustainedMBps() const;
+    // time the render thread spent in RecordCapture and CollectCompleted per frame
+    double GetAverageOverheadMs() const {return m_overheadSamples == 0 ? 0.0 : m_overheadMs / m_overheadSamples;}
+    void ResetOverhead() {m_overheadMs = 0.0; m_overheadSamples = 0;}
+
+    ~ParticleRecorder();
+
+private:
+    enum SLOT_STATE {
+        SLOT_FREE = 0,
+        SLOT_ON_GPU = 1,
+        SLOT_WRITING = 2,
+    };
+
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+        SLOT_STATE state = SLOT_FREE;
+        uint32_t frame = 0;
+        uint64_t frameNumber = 0;
+    };
+
+    void WriterLoop();
+
+    DeviceContext m_context;
+    uint32_t m_particleCount;
+    VkDeviceSize m_stateSize;
+    uint32_t m_frameInterval = 1;
+    bool m_isRecording = false;
+
+    std::vector<Slot> m_slots;
+
+    //----------------
+    // WRITER THREAD
+    //----------------
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::queue<uint32_t> m_pendingSlots;
+    bool m_isStopping = false;
+    std::ofstream m_file;
+    std::vector<uint8_t> m_previousState;
+    uint32_t m_chunksWritten = 0;
+
+    std::atomic<uint64_t> m_capturedCount = 0;
+    std::atomic<uint64_t> m_droppedCount = 0;
+    std::atomic<uint64_t> m_rawBytes = 0;
+    std::atomic<uint64_t> m_writtenBytes = 0;
+    std::chrono::steady_clock::time_point m_startTime;
+    double m_overheadMs = 0.0;
+    uint64_t m_overheadSamples = 0;
+};
+
+
+#endif //PARTICLERECORDER_HPP
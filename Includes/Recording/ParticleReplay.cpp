@@ -0,0 +1,67 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ParticleReplay.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+ParticleReplay::ParticleReplay(const std::string &path, uint32_t particleCount) {
+    m_file.open(path, std::ios::binary);
+    if (!m_file.is_open()) {
+        throw std::runtime_error("Failed to open recording " + path);
+    }
+
+    m_file.read(reinterpret_cast<char *>(&m_header), sizeof(m_header));
+    if (!m_file || m_header.magic != RECORDING_MAGIC || m_header.version != RECORDING_VERSION) {
+        throw std::runtime_error(path + " is not a particle recording");
+    }
+    if (m_header.particleCount != particleCount || m_header.particleStride != sizeof(Particle)) {
+        throw std::runtime_error(path + " was recorded with different amount or layout of particles");
+    }
+
+    m_firstChunk = m_file.tellg();
+    m_file.seekg(0, std::ios::end);
+    m_fileEnd = m_file.tellg();
+    m_file.seekg(m_firstChunk);
+    m_state.assign(static_cast<size_t>(particleCount) * sizeof(Particle), 0);
+}
+
+bool ParticleReplay::ReadNext(Particle *destination) {
+    uint32_t frame = 0;
+    if (!ReadChunk(frame)) {
+        // end of the recording, the first chunk is always a key frame so the loop does not need the last state
+        Rewind();
+        if (!ReadChunk(frame)) return false;
+    }
+
+    m_lastFrame = frame;
+    memcpy(destination, m_state.data(), m_state.size());
+    return true;
+}
+
+bool ParticleReplay::ReadChunk(uint32_t &frame) {
+    RecordingChunkHeader chunkHeader{};
+    m_file.read(reinterpret_cast<char *>(&chunkHeader), sizeof(chunkHeader));
+    if (!m_file || chunkHeader.decodedSize != m_state.size()) return false;
+    // size of a damaged header can be anything, it is not allocated unless the file has that many bytes left
+    if (chunkHeader.encodedSize > static_cast<uint64_t>(m_fileEnd - m_file.tellg())) return false;
+
+    m_encoded.resize(chunkHeader.encodedSize);
+    m_file.read(reinterpret_cast<char *>(m_encoded.data()), chunkHeader.encodedSize);
+    // state is decoded in place, every byte depends only on the same byte of the previous state.
+    // Damaged delta leaves the state half decoded, which the key frame after the rewind overwrites whole
+    if (!m_file || !DecodeState(m_encoded.data(), m_encoded.size(), chunkHeader.isKeyFrame ? nullptr : m_state.data(),
+                                m_state.size(), m_scratch, m_state.data())) {
+        return false;
+    }
+
+    frame = chunkHeader.frame;
+    return true;
+}
+
+void ParticleReplay::Rewind() {
+    m_file.clear();
+    m_file.seekg(m_firstChunk);
+}
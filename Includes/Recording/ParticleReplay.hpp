@@ -0,0 +1,47 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef PARTICLEREPLAY_HPP
+#define PARTICLEREPLAY_HPP
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Recording/StateCodec.hpp"
+
+// Reads the file written by ParticleRecorder chunk by chunk, once the last chunk is read it starts over
+class ParticleReplay {
+public:
+    // throws if the file does not exist or was recorded with different particles
+    ParticleReplay(const std::string &path, uint32_t particleCount);
+
+    // decodes the next recorded state, destination has to have room for all particles.
+    // Chunk cut off or damaged while it was written counts as the end of the recording and the replay starts over,
+    // false if not even the first chunk can be read
+    bool ReadNext(Particle *destination);
+
+    uint32_t GetFrameInterval() const {return m_header.frameInterval;}
+
+    uint32_t GetLastFrame() const {return m_lastFrame;}
+
+private:
+    // reads and decodes the chunk at the current position in to m_state, false if it is missing, short or damaged
+    bool ReadChunk(uint32_t &frame);
+    void Rewind();
+
+    std::ifstream m_file;
+    RecordingHeader m_header{};
+    std::streampos m_firstChunk;
+    std::streampos m_fileEnd;
+    uint32_t m_lastFrame = 0;
+
+    std::vector<uint8_t> m_state;
+    std::vector<uint8_t> m_encoded;
+    std::vector<uint8_t> m_scratch;
+};
+
+
+#endif //PARTICLEREPLAY_HPP
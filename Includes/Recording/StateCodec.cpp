@@ -0,0 +1,98 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "StateCodec.hpp"
+
+#include <algorithm>
+
+// token byte below 128 is followed by token + 1 literal bytes, token from 128 up stands for token - 127 zero bytes
+constexpr uint8_t LITERAL_RUN_LIMIT = 128;
+constexpr uint8_t ZERO_RUN_LIMIT = 128;
+
+void EncodeState(const uint8_t *state, const uint8_t *previous, size_t size, std::vector<uint8_t> &scratch,
+                 std::vector<uint8_t> &encoded) {
+    //-------------------------
+    // DELTA AND BYTE PLANES
+    //-------------------------
+    const size_t wordCount = size / 4;
+    scratch.resize(size);
+    for (size_t word = 0; word < wordCount; word++) {
+        for (size_t byte = 0; byte < 4; byte++) {
+            uint8_t value = state[4 * word + byte];
+            if (previous != nullptr) {
+                value ^= previous[4 * word + byte];
+            }
+            scratch[byte * wordCount + word] = value;
+        }
+    }
+
+    //-------------------
+    // ZERO RUN LENGTH
+    //-------------------
+    encoded.clear();
+    size_t i = 0;
+    while (i < size) {
+        if (scratch[i] == 0) {
+            size_t run = 1;
+            while (i + run < size && scratch[i + run] == 0 && run < ZERO_RUN_LIMIT) {
+                run++;
+            }
+            encoded.push_back(static_cast<uint8_t>(127 + run));
+            i += run;
+        }
+        else {
+            // single zeros stay in the literal, only a pair of them is worth a new token
+            size_t start = i;
+            size_t run = 0;
+            while (i < size && run < LITERAL_RUN_LIMIT && !(scratch[i] == 0 && i + 1 < size && scratch[i + 1] == 0)) {
+                i++;
+                run++;
+            }
+            encoded.push_back(static_cast<uint8_t>(run - 1));
+            encoded.insert(encoded.end(), scratch.begin() + start, scratch.begin() + start + run);
+        }
+    }
+}
+
+bool DecodeState(const uint8_t *encoded, size_t encodedSize, const uint8_t *previous, size_t size,
+                 std::vector<uint8_t> &scratch, uint8_t *state) {
+    //-------------------
+    // ZERO RUN LENGTH
+    //-------------------
+    scratch.resize(size);
+    size_t written = 0;
+    size_t i = 0;
+    while (i < encodedSize) {
+        uint8_t token = encoded[i++];
+        if (token >= 128) {
+            size_t run = token - 127;
+            if (written + run > size) return false;
+            std::fill(scratch.begin() + written, scratch.begin() + written + run, 0);
+            written += run;
+        }
+        else {
+            size_t run = token + 1;
+            if (written + run > size || i + run > encodedSize) return false;
+            std::copy(encoded + i, encoded + i + run, scratch.begin() + written);
+            written += run;
+            i += run;
+        }
+    }
+    if (written != size) return false;
+
+    //-------------------------
+    // DELTA AND BYTE PLANES
+    //-------------------------
+    const size_t wordCount = size / 4;
+    for (size_t word = 0; word < wordCount; word++) {
+        for (size_t byte = 0; byte < 4; byte++) {
+            uint8_t value = scratch[byte * wordCount + word];
+            if (previous != nullptr) {
+                value ^= previous[4 * word + byte];
+            }
+            state[4 * word + byte] = value;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef STATECODEC_HPP
+#define STATECODEC_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Recording file layout: RecordingHeader followed by chunks, every chunk is RecordingChunkHeader
+// and the encoded particle state right after it
+constexpr uint32_t RECORDING_MAGIC = 0x43455250; // "PREC"
+constexpr uint32_t RECORDING_VERSION = 1;
+
+struct RecordingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t particleCount;
+    // sizeof(Particle) of the application that recorded the file
+    uint32_t particleStride;
+    // every how many frames was the state captured
+    uint32_t frameInterval;
+};
+
+struct RecordingChunkHeader {
+    uint32_t frame;
+    // key frames are encoded on their own, the rest is relative to the previous chunk
+    uint32_t isKeyFrame;
+    uint32_t encodedSize;
+    uint32_t decodedSize;
+};
+
+// The state is XORed with the previous one (unless previous is nullptr), the result is split in to 4 byte planes
+// (first bytes of every 32 bit word, then the second bytes...) and runs of zero bytes are collapsed.
+// Slowly moving particles change only the low bytes of the floats, so most of the planes become zeros.
+// size has to be multiple of 4, scratch is only reused to avoid allocations
+void EncodeState(const uint8_t *state, const uint8_t *previous, size_t size, std::vector<uint8_t> &scratch,
+                 std::vector<uint8_t> &encoded);
+
+// inverse of EncodeState, previous has to be the state the chunk was encoded against.
+// Returns false if the data does not decode in to exactly size bytes
+bool DecodeState(const uint8_t *encoded, size_t encodedSize, const uint8_t *previous, size_t size,
+                 std::vector<uint8_t> &scratch, uint8_t *state);
+
+
+#endif //STATECODEC_HPP
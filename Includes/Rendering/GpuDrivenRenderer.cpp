@@ -0,0 +1,562 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "GpuDrivenRenderer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Utils.hpp"
+
+static_assert(sizeof(GpuObject) == 112, "Object has to match the std430 layout of the shaders");
+
+GpuDrivenRenderer::GpuDrivenRenderer(const DeviceContext &context, const MeshPool &meshes, VkRenderPass renderPass,
+                                     uint32_t subpass, VkSampleCountFlagBits samples,
+                                     VkDescriptorSetLayout cameraLayout, VkDescriptorSetLayout materialLayout,
+                                     uint32_t maxObjects, uint32_t framesInFlight) {
+    this->m_context = context;
+    this->m_meshes = &meshes;
+    this->m_maxObjects = maxObjects;
+
+    if (meshes.GetMeshCount() > GPU_DRIVEN_MAX_MESHES) {
+        throw std::runtime_error("GPU driven renderer counts the LODs of at most GPU_DRIVEN_MAX_MESHES meshes");
+    }
+    // occluded and in frustum objects are counted per subgroup
+    if (!SupportsComputeSubgroupArithmetic(m_context.physicalDevice)) {
+        throw std::runtime_error("Object culling needs subgroup arithmetic in the compute shaders");
+    }
+
+    CreateBuffers(framesInFlight);
+    CreateDescriptors();
+    CreatePipelines(renderPass, subpass, samples, cameraLayout, materialLayout);
+}
+
+void GpuDrivenRenderer::EnableRequiredFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures &features,
+                                               VkPhysicalDeviceVulkan12Features &vulkan12Features) {
+    VkPhysicalDeviceVulkan12Features supported12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 supported{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    supported.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+
+    if (!supported12.drawIndirectCount || !supported.features.multiDrawIndirect ||
+        !supported.features.drawIndirectFirstInstance) {
+        throw std::runtime_error("Device does not support the indirect draws the GPU driven rendering needs");
+    }
+
+    // firstInstance of the commands is the index of the object
+    features.multiDrawIndirect = VK_TRUE;
+    features.drawIndirectFirstInstance = VK_TRUE;
+    vulkan12Features.drawIndirectCount = VK_TRUE;
+}
+
+GpuObject GpuDrivenRenderer::CreateObject(uint32_t mesh, const glm::mat4 &transform, const glm::vec4 &color,
+                                          uint32_t material) const {
+    const MeshRange &range = m_meshes->GetMesh(mesh);
+    const float scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                                  glm::length(glm::vec3(transform[2]))});
+
+    GpuObject object{};
+    object.transform = transform;
+    object.color = color;
+    object.bounds = glm::vec4(glm::vec3(transform * glm::vec4(range.boundsCenter, 1.0f)), range.boundsRadius * scale);
+    object.mesh = mesh;
+    object.material = material;
+    return object;
+}
+
+void GpuDrivenRenderer::SetObjects(const std::vector<GpuObject> &objects, VkQueue queue,
+                                   VkCommandPool commandPool) {
+    if (objects.size() > m_maxObjects) {
+        throw std::runtime_error("GPU driven renderer is out of objects");
+    }
+
+    m_objectCount = static_cast<uint32_t>(objects.size());
+    if (objects.empty()) return;
+
+    // nothing was visible before, the first late pass draws everything that is
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_context.logicalDevice, commandPool);
+    vkCmdFillBuffer(commandBuffer, m_visibilityBuffer, 0, sizeof(uint32_t) * m_objectCount, 0);
+    EndSingleTimeCommand(m_context.logicalDevice, commandPool, commandBuffer, queue);
+
+    const VkDeviceSize size = sizeof(GpuObject) * objects.size();
+
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    CreateBuffer(bufferCreateInfo, stagingBuffer, stagingBufferMemory);
+
+    void *data;
+    vkMapMemory(m_context.logicalDevice, stagingBufferMemory, 0, size, 0, &data);
+    memcpy(data, objects.data(), size);
+    vkUnmapMemory(m_context.logicalDevice, stagingBufferMemory);
+
+    CopyBuffer(m_context.logicalDevice, queue, commandPool, stagingBuffer, m_objectBuffer, size);
+
+    vkDestroyBuffer(m_context.logicalDevice, stagingBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, stagingBufferMemory, nullptr);
+}
+
+void GpuDrivenRenderer::CreateBuffers(uint32_t framesInFlight) {
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    bufferCreateInfo.size = sizeof(GpuObject) * m_maxObjects;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    CreateBuffer(bufferCreateInfo, m_objectBuffer, m_objectBufferMemory);
+
+    bufferCreateInfo.size = sizeof(uint32_t) * m_maxObjects;
+    CreateBuffer(bufferCreateInfo, m_visibilityBuffer, m_visibilityBufferMemory);
+
+    // the early pass fills the first half, the late one the second half
+    bufferCreateInfo.size = sizeof(VkDrawIndexedIndirectCommand) * m_maxObjects * 2;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    CreateBuffer(bufferCreateInfo, m_drawBuffer, m_drawBufferMemory);
+
+    // cleared with vkCmdFillBuffer before every frame and copied out for the statistics
+    bufferCreateInfo.size = sizeof(Counters);
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    CreateBuffer(bufferCreateInfo, m_counterBuffer, m_counterBufferMemory);
+
+    // only a few bytes that never change, the shader reads them straight from the host visible memory
+    std::vector<GpuMesh> meshes;
+    for (uint32_t i = 0; i < m_meshes->GetMeshCount(); i++) {
+        const MeshRange &range = m_meshes->GetMesh(i);
+        GpuMesh mesh{};
+        mesh.vertexOffset = range.vertexOffset;
+        mesh.lodCount = range.lodCount;
+        for (uint32_t lod = 0; lod < range.lodCount; lod++) {
+            mesh.lods[lod] = {range.lods[lod].firstIndex, range.lods[lod].indexCount, range.lods[lod].error, 0};
+        }
+        meshes.push_back(mesh);
+    }
+    bufferCreateInfo.size = sizeof(GpuMesh) * std::max<size_t>(meshes.size(), 1);
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    CreateBuffer(bufferCreateInfo, m_meshBuffer, m_meshBufferMemory);
+
+    void *data;
+    vkMapMemory(m_context.logicalDevice, m_meshBufferMemory, 0, bufferCreateInfo.size, 0, &data);
+    memcpy(data, meshes.data(), sizeof(GpuMesh) * meshes.size());
+    vkUnmapMemory(m_context.logicalDevice, m_meshBufferMemory);
+
+    bufferCreateInfo.size = sizeof(Counters);
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    m_readbackBuffers.resize(framesInFlight);
+    m_readbackBuffersMemory.resize(framesInFlight);
+    m_readbackBuffersMapped.resize(framesInFlight);
+    m_isReadbackPending.assign(framesInFlight, false);
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        CreateBuffer(bufferCreateInfo, m_readbackBuffers[i], m_readbackBuffersMemory[i]);
+        vkMapMemory(m_context.logicalDevice, m_readbackBuffersMemory[i], 0, sizeof(Counters), 0,
+                    &m_readbackBuffersMapped[i]);
+    }
+}
+
+void GpuDrivenRenderer::CreateDescriptors() {
+    //-------------------------
+    // DESCRIPTOR SET LAYOUTS
+    //-------------------------
+    // objects, meshes, draw commands, counters, visibility and the Hi-Z pyramid
+    std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_cullingDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create object culling descriptor set layout");
+    }
+
+    // vertex shader reads only the objects
+    VkDescriptorSetLayoutBinding objectBinding = bindings[0];
+    objectBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &objectBinding;
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_objectDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create GPU driven object descriptor set layout");
+    }
+
+    //-----------------
+    // DESCRIPTOR POOL
+    //-----------------
+    std::array<VkDescriptorPoolSize, 2> poolSizes{{
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size())},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+    }};
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 2;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create GPU driven descriptor pool");
+    }
+
+    //-----------------
+    // DESCRIPTOR SETS
+    //-----------------
+    std::array<VkDescriptorSetLayout, 2> layouts = {m_cullingDescriptorSetLayout, m_objectDescriptorSetLayout};
+    std::array<VkDescriptorSet, 2> sets{};
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+    allocInfo.pSetLayouts = layouts.data();
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate GPU driven descriptor sets");
+    }
+    m_cullingDescriptorSet = sets[0];
+    m_objectDescriptorSet = sets[1];
+
+    // pyramid is written by SetPyramid
+    std::array<VkDescriptorBufferInfo, 5> bufferInfos = {{
+        {m_objectBuffer, 0, VK_WHOLE_SIZE},
+        {m_meshBuffer, 0, VK_WHOLE_SIZE},
+        {m_drawBuffer, 0, VK_WHOLE_SIZE},
+        {m_counterBuffer, 0, VK_WHOLE_SIZE},
+        {m_visibilityBuffer, 0, VK_WHOLE_SIZE},
+    }};
+    std::array<VkWriteDescriptorSet, 6> writes{};
+    for (uint32_t b = 0; b < bufferInfos.size(); b++) {
+        writes[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[b].dstSet = m_cullingDescriptorSet;
+        writes[b].dstBinding = b;
+        writes[b].descriptorCount = 1;
+        writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[b].pBufferInfo = &bufferInfos[b];
+    }
+    writes[5] = writes[0];
+    writes[5].dstSet = m_objectDescriptorSet;
+    vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void GpuDrivenRenderer::CreatePipelines(VkRenderPass renderPass, uint32_t subpass, VkSampleCountFlagBits samples,
+                                        VkDescriptorSetLayout cameraLayout, VkDescriptorSetLayout materialLayout) {
+    //-----------------
+    // CULLING PIPELINE
+    //-----------------
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_cullingDescriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_cullingPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create object culling pipeline layout");
+    }
+
+    VkSpecializationMapEntry passEntry{};
+    passEntry.constantID = 0;
+    passEntry.offset = 0;
+    passEntry.size = sizeof(uint32_t);
+
+    for (uint32_t pass = 0; pass < CULL_PASS_COUNT; pass++) {
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &passEntry;
+        specializationInfo.dataSize = sizeof(uint32_t);
+        specializationInfo.pData = &pass;
+
+        m_cullingPipelines[pass] = CreateComputePipelineFromFile(m_context.logicalDevice,
+                                                                 "Shaders/Compiled/ObjectCulling.spv",
+                                                                 m_cullingPipelineLayout, &specializationInfo);
+    }
+
+    //-----------------
+    // DRAW PIPELINE
+    //-----------------
+    std::array<VkDescriptorSetLayout, 3> setLayouts = {cameraLayout, materialLayout, m_objectDescriptorSetLayout};
+    layoutInfo = {.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    layoutInfo.pSetLayouts = setLayouts.data();
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create GPU driven pipeline layout");
+    }
+
+    // shading is the same as the one of the mesh particles, so is the interface of the vertex shader
+    auto vertexCode = readFile("Shaders/Compiled/GpuDrivenMeshVertex.spv");
+    auto fragmentCode = readFile("Shaders/Compiled/ParticleMeshFragment.spv");
+    VkShaderModule vertexModule = createShaderModuel(m_context.logicalDevice, vertexCode);
+    VkShaderModule fragmentModule = createShaderModuel(m_context.logicalDevice, fragmentCode);
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    shaderStages[0] = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertexModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1] = shaderStages[0];
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragmentModule;
+
+    // only the vertices of the mesh, the object comes from the SSBO
+    auto binding = Vertex::getBindingDescription();
+    auto attributes = Vertex::getAttributeDescriptions();
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &binding;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState{.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample{.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisample.rasterizationSamples = samples;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    blendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlend{.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    colorBlend.attachmentCount = 1;
+    colorBlend.pAttachments = &blendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = subpass;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(m_context.logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                  &m_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create GPU driven pipeline");
+    }
+
+    vkDestroyShaderModule(m_context.logicalDevice, vertexModule, nullptr);
+    vkDestroyShaderModule(m_context.logicalDevice, fragmentModule, nullptr);
+}
+
+void GpuDrivenRenderer::SetPyramid(const VkDescriptorImageInfo &pyramidInfo, VkExtent2D pyramidExtent) {
+    m_pyramidExtent = pyramidExtent;
+
+    VkWriteDescriptorSet write{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = m_cullingDescriptorSet;
+    write.dstBinding = 5;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &pyramidInfo;
+    vkUpdateDescriptorSets(m_context.logicalDevice, 1, &write, 0, nullptr);
+}
+
+void GpuDrivenRenderer::SetLodThreshold(float pixelError, uint32_t viewportHeight) {
+    m_lodPixelError = pixelError;
+    m_viewportHeight = viewportHeight;
+}
+
+void GpuDrivenRenderer::RecordCulling(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &view,
+                                      const glm::mat4 &projection, CULL_PASS pass, GpuTimer &timer) {
+    if (m_objectCount == 0) return;
+
+    // the culling runs in the view space with z pointing forward, the planes of the sides go through the camera
+    // so only their normals are needed (Gribb & Hartmann), the depth goes from 0 to 1
+    const glm::mat4 projectionT = glm::transpose(projection);
+    const glm::vec4 frustumX = projectionT[3] + projectionT[0];
+    const glm::vec4 frustumY = projectionT[3] + projectionT[1];
+    const float lengthX = glm::length(glm::vec3(frustumX));
+    const float lengthY = glm::length(glm::vec3(frustumY));
+
+    PushConstants pushConstants{};
+    pushConstants.view = view;
+    pushConstants.frustum = glm::vec4(projection[0][0] / lengthX, 1.0f / lengthX, projection[1][1] / lengthY,
+                                      1.0f / lengthY);
+    pushConstants.projection = glm::vec4(projection[0][0], projection[1][1], projection[2][2], projection[3][2]);
+    pushConstants.nearFar = glm::vec2(projection[3][2] / projection[2][2],
+                                      projection[3][2] / (projection[2][2] + 1.0f));
+    pushConstants.pyramidSize = glm::vec2(m_pyramidExtent.width, m_pyramidExtent.height);
+    pushConstants.objectCount = m_objectCount;
+    pushConstants.lateDrawOffset = m_maxObjects;
+    // error of e world units at the distance d covers e * P11 * height / (2 * d) pixels
+    pushConstants.lodScale = m_lodPixelError > 0.0f
+                                 ? projection[1][1] * 0.5f * static_cast<float>(m_viewportHeight) / m_lodPixelError
+                                 : 0.0f;
+
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    if (pass != CULL_PASS_LATE) {
+        // draw and culling of the previous frame can still be using the commands, counters and the visibility
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(commandBuffer, m_counterBuffer, 0, sizeof(Counters), 0);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    else {
+        // counters and the visibility of the early pass, the pyramid is made visible by its build
+        InsertComputeBarrier(commandBuffer);
+    }
+
+    static constexpr std::array<const char *, CULL_PASS_COUNT> scopes = {"Cull::Objects", "Cull::Early",
+                                                                         "Cull::Late"};
+    timer.Begin(commandBuffer, frame, scopes[pass], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullingPipelines[pass]);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullingPipelineLayout, 0, 1,
+                            &m_cullingDescriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_cullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, (m_objectCount + 255) / 256, 1, 1);
+    timer.End(commandBuffer, frame, scopes[pass], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+
+    // the early pass only draws, the counters of the whole frame are known after the late one
+    if (pass == CULL_PASS_EARLY) return;
+
+    // counters are read back a frame or two later, nothing waits on them
+    VkBufferCopy copy{0, 0, sizeof(Counters)};
+    vkCmdCopyBuffer(commandBuffer, m_counterBuffer, m_readbackBuffers[frame], 1, &copy);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+    m_isReadbackPending[frame] = true;
+}
+
+void GpuDrivenRenderer::RecordDraw(VkCommandBuffer commandBuffer, VkDescriptorSet cameraSet, uint32_t cameraOffset,
+                                   VkDescriptorSet materialSet, CULL_PASS pass) {
+    if (m_objectCount == 0) return;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    std::array<VkDescriptorSet, 3> sets = {cameraSet, materialSet, m_objectDescriptorSet};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0,
+                            static_cast<uint32_t>(sets.size()), sets.data(), 1, &cameraOffset);
+    m_meshes->Bind(commandBuffer);
+
+    // the GPU decides how many of the commands are drawn
+    const uint32_t list = pass == CULL_PASS_LATE ? 1 : 0;
+    vkCmdDrawIndexedIndirectCount(commandBuffer, m_drawBuffer,
+                                  sizeof(VkDrawIndexedIndirectCommand) * m_maxObjects * list, m_counterBuffer,
+                                  sizeof(uint32_t) * list, m_objectCount, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuDrivenRenderer::CollectResults(uint32_t frame) {
+    if (!m_isReadbackPending[frame]) return;
+
+    Counters counters;
+    memcpy(&counters, m_readbackBuffersMapped[frame], sizeof(Counters));
+    m_statisticSums[0] += counters.drawCounts[0];
+    m_statisticSums[1] += counters.drawCounts[1];
+    m_statisticSums[2] += counters.inFrustumCount;
+    m_statisticSums[3] += counters.occludedCount;
+    for (uint32_t mesh = 0; mesh < m_meshes->GetMeshCount(); mesh++) {
+        const MeshRange &range = m_meshes->GetMesh(mesh);
+        for (uint32_t lod = 0; lod < range.lodCount; lod++) {
+            const uint32_t drawCount = counters.lodDrawCounts[mesh * MESH_MAX_LODS + lod];
+            m_lodDrawSums[lod] += drawCount;
+            m_triangleSum += static_cast<uint64_t>(drawCount) * (range.lods[lod].indexCount / 3);
+        }
+    }
+    m_statisticSamples++;
+    m_isReadbackPending[frame] = false;
+}
+
+double GpuDrivenRenderer::GetAverageVisibleCount() const {
+    const CullStatistics statistics = GetAverageStatistics();
+    return statistics.earlyDrawCount + statistics.lateDrawCount;
+}
+
+GpuDrivenRenderer::CullStatistics GpuDrivenRenderer::GetAverageStatistics() const {
+    CullStatistics statistics{};
+    if (m_statisticSamples == 0) return statistics;
+
+    const auto samples = static_cast<double>(m_statisticSamples);
+    statistics.earlyDrawCount = static_cast<double>(m_statisticSums[0]) / samples;
+    statistics.lateDrawCount = static_cast<double>(m_statisticSums[1]) / samples;
+    statistics.inFrustumCount = static_cast<double>(m_statisticSums[2]) / samples;
+    statistics.occludedCount = static_cast<double>(m_statisticSums[3]) / samples;
+    statistics.triangleCount = static_cast<double>(m_triangleSum) / samples;
+    for (uint32_t lod = 0; lod < MESH_MAX_LODS; lod++) {
+        statistics.lodDrawCounts[lod] = static_cast<double>(m_lodDrawSums[lod]) / samples;
+    }
+    return statistics;
+}
+
+GpuDrivenRenderer::~GpuDrivenRenderer() {
+    vkDestroyPipeline(m_context.logicalDevice, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_pipelineLayout, nullptr);
+    for (auto pipeline: m_cullingPipelines) {
+        vkDestroyPipeline(m_context.logicalDevice, pipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_cullingPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_cullingDescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_objectDescriptorSetLayout, nullptr);
+
+    vkDestroyBuffer(m_context.logicalDevice, m_objectBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_objectBufferMemory, nullptr);
+    vkDestroyBuffer(m_context.logicalDevice, m_meshBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_meshBufferMemory, nullptr);
+    vkDestroyBuffer(m_context.logicalDevice, m_drawBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_drawBufferMemory, nullptr);
+    vkDestroyBuffer(m_context.logicalDevice, m_counterBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_counterBufferMemory, nullptr);
+    vkDestroyBuffer(m_context.logicalDevice, m_visibilityBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_visibilityBufferMemory, nullptr);
+    for (size_t i = 0; i < m_readbackBuffers.size(); i++) {
+        vkUnmapMemory(m_context.logicalDevice, m_readbackBuffersMemory[i]);
+        vkDestroyBuffer(m_context.logicalDevice, m_readbackBuffers[i], nullptr);
+        vkFreeMemory(m_context.logicalDevice, m_readbackBuffersMemory[i], nullptr);
+    }
+}
@@ -0,0 +1,193 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef GPUDRIVENRENDERER_HPP
+#define GPUDRIVENRENDERER_HPP
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "MeshPool.hpp"
+#include "Structs.hpp"
+#include "Profiling/GpuTimer.hpp"
+
+// meshes the culling counts the draws of per LOD, has to match MAX_MESHES in ObjectCulling.comp
+constexpr uint32_t GPU_DRIVEN_MAX_MESHES = 8;
+
+// one object of the GPU driven scene, has to match Object in ObjectCulling.comp and GpuDrivenMeshVertex.vert (std430)
+struct GpuObject {
+    // scale has to be uniform, normals are turned by its upper 3x3
+    glm::mat4 transform = glm::mat4(1.0f);
+    glm::vec4 color = glm::vec4(1.0f);
+    // bounding sphere of the mesh in the world space, xyz - centre, w - radius
+    glm::vec4 bounds = glm::vec4(0.0f);
+    uint32_t mesh = 0;
+    // index in to the material table of the MaterialLibrary
+    uint32_t material = 0;
+    uint32_t padding[2] = {};
+};
+
+// Draws the objects of a MeshPool without the CPU knowing which of them are visible.
+// Every object lives in the object SSBO, ObjectCulling.comp tests its bounding sphere against the frustum and
+// appends a VkDrawIndexedIndirectCommand of the visible ones to a compacted buffer together with their count.
+// The draw is a single vkCmdDrawIndexedIndirectCount, firstInstance of every command is the index of its object,
+// so the vertex shader reads the object by gl_InstanceIndex. Recording costs the same at 10 or 1M objects
+// With the occlusion culling the frame is culled in two phases: the early pass draws what was visible in the
+// previous frame, a HiZPyramid is built from its depth and the late pass draws what became visible since then.
+// Every drawn object also picks the coarsest LOD of its mesh whose error projected to the screen stays under
+// the threshold, so the far away objects are drawn with a fraction of the triangles
+class GpuDrivenRenderer {
+public:
+    enum CULL_PASS {
+        // every object in the frustum is drawn, no occlusion culling
+        CULL_PASS_FRUSTUM = 0,
+        // objects in the frustum that were visible in the previous frame
+        CULL_PASS_EARLY = 1,
+        // objects in the frustum that are not hidden behind the pyramid and were not drawn by the early pass
+        CULL_PASS_LATE = 2,
+        CULL_PASS_COUNT = 3,
+    };
+
+    // averages over the frames since the statistics were reset
+    struct CullStatistics {
+        double earlyDrawCount = 0.0;
+        double lateDrawCount = 0.0;
+        double inFrustumCount = 0.0;
+        double occludedCount = 0.0;
+        // triangles of the drawn LODs
+        double triangleCount = 0.0;
+        // drawn objects of every mesh by the LOD they were drawn with
+        std::array<double, MESH_MAX_LODS> lodDrawCounts{};
+    };
+
+    // pipeline is created for the given subpass, set 0 is the camera UBO (dynamic offset) and set 1 the materials
+    GpuDrivenRenderer(const DeviceContext &context, const MeshPool &meshes, VkRenderPass renderPass, uint32_t subpass,
+                      VkSampleCountFlagBits samples, VkDescriptorSetLayout cameraLayout,
+                      VkDescriptorSetLayout materialLayout, uint32_t maxObjects, uint32_t framesInFlight);
+
+    // turns on what the culling and the indirect draw need, throws if the device does not have it
+    static void EnableRequiredFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures &features,
+                                       VkPhysicalDeviceVulkan12Features &vulkan12Features);
+
+    // world space bounds of the mesh are computed from the transform
+    GpuObject CreateObject(uint32_t mesh, const glm::mat4 &transform, const glm::vec4 &color, uint32_t material) const;
+    // replaces every object and forgets their visibility, nothing can be drawing the previous ones
+    void SetObjects(const std::vector<GpuObject> &objects, VkQueue queue, VkCommandPool commandPool);
+    uint32_t GetObjectCount() const {return m_objectCount;}
+
+    // pyramid the late pass tests against, has to be set before the first culling and again after it is resized
+    void SetPyramid(const VkDescriptorImageInfo &pyramidInfo, VkExtent2D pyramidExtent);
+    // LOD whose error projected to the viewport is at most pixelError pixels is drawn, 0 draws LOD 0 only.
+    // Has to be set again after the viewport is resized
+    void SetLodThreshold(float pixelError, uint32_t viewportHeight);
+
+    // has to be recorded outside of the render pass before the draw of the same pass, projection is the one that is
+    // not flipped, the late pass has to come after the early one and after the pyramid was built from its depth
+    void RecordCulling(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &view,
+                       const glm::mat4 &projection, CULL_PASS pass, GpuTimer &timer);
+    // viewport and scissor have to be set
+    void RecordDraw(VkCommandBuffer commandBuffer, VkDescriptorSet cameraSet, uint32_t cameraOffset,
+                    VkDescriptorSet materialSet, CULL_PASS pass);
+
+    // call after the fence of the frame is signaled
+    void CollectResults(uint32_t frame);
+
+    // objects drawn by both of the passes, averaged over the frames since the statistics were reset
+    double GetAverageVisibleCount() const;
+    CullStatistics GetAverageStatistics() const;
+    void ResetStatistics() {m_statisticSums = {}; m_lodDrawSums = {}; m_triangleSum = 0; m_statisticSamples = 0;}
+
+    ~GpuDrivenRenderer();
+
+private:
+    // has to match Lod in ObjectCulling.comp
+    struct GpuLod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;
+        uint32_t padding;
+    };
+
+    // has to match Mesh in ObjectCulling.comp
+    struct GpuMesh {
+        int32_t vertexOffset;
+        uint32_t lodCount;
+        uint32_t padding[2];
+        GpuLod lods[MESH_MAX_LODS];
+    };
+
+    // has to match CullParameters in ObjectCulling.comp
+    struct PushConstants {
+        glm::mat4 view;
+        glm::vec4 frustum;
+        glm::vec4 projection;
+        glm::vec2 nearFar;
+        glm::vec2 pyramidSize;
+        uint32_t objectCount;
+        uint32_t lateDrawOffset;
+        // LOD is fine enough when error * scale * lodScale <= distance, 0 draws LOD 0
+        float lodScale;
+    };
+
+    // has to match Counters in ObjectCulling.comp
+    struct Counters {
+        uint32_t drawCounts[2];
+        uint32_t inFrustumCount;
+        uint32_t occludedCount;
+        uint32_t lodDrawCounts[GPU_DRIVEN_MAX_MESHES * MESH_MAX_LODS];
+    };
+
+    void CreateBuffers(uint32_t framesInFlight);
+    void CreateDescriptors();
+    void CreatePipelines(VkRenderPass renderPass, uint32_t subpass, VkSampleCountFlagBits samples,
+                         VkDescriptorSetLayout cameraLayout, VkDescriptorSetLayout materialLayout);
+
+    DeviceContext m_context;
+    const MeshPool *m_meshes;
+    uint32_t m_maxObjects;
+    uint32_t m_objectCount = 0;
+
+    VkBuffer m_objectBuffer;
+    VkDeviceMemory m_objectBufferMemory;
+    // ranges of the meshes, written once when the renderer is created
+    VkBuffer m_meshBuffer;
+    VkDeviceMemory m_meshBufferMemory;
+    // two lists of m_maxObjects VkDrawIndexedIndirectCommand, the early (or frustum) one and the late one,
+    // the first drawCounts of each are valid
+    VkBuffer m_drawBuffer;
+    VkDeviceMemory m_drawBufferMemory;
+    VkBuffer m_counterBuffer;
+    VkDeviceMemory m_counterBufferMemory;
+    // one uint per object, 1 if it was visible in the previous frame
+    VkBuffer m_visibilityBuffer;
+    VkDeviceMemory m_visibilityBufferMemory;
+    VkExtent2D m_pyramidExtent = {1, 1};
+    float m_lodPixelError = 0.0f;
+    uint32_t m_viewportHeight = 1;
+
+    // per frame in flight, the counters are copied there for the statistics
+    std::vector<VkBuffer> m_readbackBuffers;
+    std::vector<VkDeviceMemory> m_readbackBuffersMemory;
+    std::vector<void *> m_readbackBuffersMapped;
+    std::vector<bool> m_isReadbackPending;
+    std::array<uint64_t, 4> m_statisticSums{};
+    std::array<uint64_t, MESH_MAX_LODS> m_lodDrawSums{};
+    uint64_t m_triangleSum = 0;
+    uint64_t m_statisticSamples = 0;
+
+    VkDescriptorPool m_descriptorPool;
+    VkDescriptorSetLayout m_cullingDescriptorSetLayout;
+    VkDescriptorSet m_cullingDescriptorSet;
+    VkDescriptorSetLayout m_objectDescriptorSetLayout;
+    VkDescriptorSet m_objectDescriptorSet;
+
+    VkPipelineLayout m_cullingPipelineLayout;
+    std::array<VkPipeline, CULL_PASS_COUNT> m_cullingPipelines{};
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+};
+
+
+#endif //GPUDRIVENRENDERER_HPP
@@ -0,0 +1,331 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "HiZPyramid.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include "Utils.hpp"
+
+HiZPyramid::HiZPyramid(const DeviceContext &context, VkImage depthImage, VkImageView depthImageView,
+                       VkFormat depthFormat, VkExtent2D depthExtent, VkSampleCountFlagBits samples, VkQueue queue,
+                       VkCommandPool commandPool) {
+    this->m_context = context;
+    this->m_depthImage = depthImage;
+    this->m_depthImageView = depthImageView;
+    this->m_depthFormat = depthFormat;
+    this->m_depthExtent = depthExtent;
+
+    // HiZBuild.comp reads the depth as sampler2DMS
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_context.physicalDevice, &properties);
+    if (samples == VK_SAMPLE_COUNT_1_BIT || !(properties.limits.sampledImageDepthSampleCounts & samples)) {
+        throw std::runtime_error("Hi-Z pyramid needs a multisampled depth that can be sampled");
+    }
+
+    CreateImages(queue, commandPool);
+    CreateDescriptors();
+    WriteDescriptors();
+    CreatePipeline();
+}
+
+void HiZPyramid::EnableRequiredFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures &features) {
+    VkPhysicalDeviceFeatures supported;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+    if (!supported.shaderStorageImageArrayDynamicIndexing) {
+        throw std::runtime_error("Device does not support the indexing of the storage images the Hi-Z build needs");
+    }
+
+    // levels are picked by a loop index
+    features.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
+}
+
+void HiZPyramid::Resize(VkImage depthImage, VkImageView depthImageView, VkExtent2D depthExtent, VkQueue queue,
+                        VkCommandPool commandPool) {
+    this->m_depthImage = depthImage;
+    this->m_depthImageView = depthImageView;
+    this->m_depthExtent = depthExtent;
+
+    DestroyImages();
+    CreateImages(queue, commandPool);
+    WriteDescriptors();
+}
+
+void HiZPyramid::CreateImages(VkQueue queue, VkCommandPool commandPool) {
+    // power of two, so every texel of a level covers exactly 2x2 texels of the one below
+    auto previousPowerOfTwo = [](uint32_t value) {
+        uint32_t result = 1;
+        while (result * 2 <= value) {
+            result <<= 1;
+        }
+        return result;
+    };
+    m_extent = {previousPowerOfTwo(m_depthExtent.width), previousPowerOfTwo(m_depthExtent.height)};
+    m_levelCount = 1;
+    while ((std::max(m_extent.width, m_extent.height) >> m_levelCount) > 0 && m_levelCount < HIZ_MAX_LEVELS) {
+        m_levelCount++;
+    }
+
+    ImageCreateInfo imageInfo{};
+    imageInfo.physicalDevice = m_context.physicalDevice;
+    imageInfo.logicalDevice = m_context.logicalDevice;
+    imageInfo.surface = m_context.surface;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.width = m_extent.width;
+    imageInfo.height = m_extent.height;
+    imageInfo.mipLevels = m_levelCount;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    CreateImage(imageInfo, m_pyramid, m_pyramidMemory);
+
+    m_pyramidView = GenerateImageView(m_context.logicalDevice, m_pyramid, m_levelCount, VK_FORMAT_R32_SFLOAT);
+
+    m_levelViews.resize(m_levelCount);
+    for (uint32_t level = 0; level < m_levelCount; level++) {
+        VkImageViewCreateInfo viewInfo{.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewInfo.image = m_pyramid;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        if (vkCreateImageView(m_context.logicalDevice, &viewInfo, nullptr, &m_levelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create Hi-Z level image view");
+        }
+    }
+
+    VkImageMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_pyramid;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, m_levelCount, 0, 1};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_context.logicalDevice, commandPool);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+    EndSingleTimeCommand(m_context.logicalDevice, commandPool, commandBuffer, queue);
+}
+
+void HiZPyramid::DestroyImages() {
+    for (auto view: m_levelViews) {
+        vkDestroyImageView(m_context.logicalDevice, view, nullptr);
+    }
+    m_levelViews.clear();
+    vkDestroyImageView(m_context.logicalDevice, m_pyramidView, nullptr);
+    vkDestroyImage(m_context.logicalDevice, m_pyramid, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_pyramidMemory, nullptr);
+}
+
+void HiZPyramid::CreateDescriptors() {
+    VkSamplerCreateInfo samplerInfo{.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(m_context.logicalDevice, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Hi-Z sampler");
+    }
+
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = sizeof(uint32_t);
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    CreateBuffer(bufferCreateInfo, m_counterBuffer, m_counterBufferMemory);
+
+    //------------------------
+    // DESCRIPTOR SET LAYOUT
+    //------------------------
+    // depth, levels of the pyramid and the counter of the finished work groups
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorCount = 1;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].binding = 1;
+    bindings[1].descriptorCount = HIZ_MAX_LEVELS;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[2].binding = 2;
+    bindings[2].descriptorCount = 1;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    for (auto &binding: bindings) {
+        binding.pImmutableSamplers = nullptr;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Hi-Z descriptor set layout");
+    }
+
+    //-----------------
+    // DESCRIPTOR POOL
+    //-----------------
+    // single set, it is rewritten only on resize when nothing is in flight
+    std::array<VkDescriptorPoolSize, 3> poolSizes{{
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, HIZ_MAX_LEVELS},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
+    }};
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Hi-Z descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate Hi-Z descriptor set");
+    }
+}
+
+void HiZPyramid::WriteDescriptors() {
+    VkDescriptorImageInfo depthInfo{m_sampler, m_depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+
+    // slots past the last level are never written by the shader, they only have to hold a valid view
+    std::array<VkDescriptorImageInfo, HIZ_MAX_LEVELS> levelInfos{};
+    for (uint32_t level = 0; level < HIZ_MAX_LEVELS; level++) {
+        levelInfos[level] = {VK_NULL_HANDLE, m_levelViews[std::min(level, m_levelCount - 1)], VK_IMAGE_LAYOUT_GENERAL};
+    }
+    VkDescriptorBufferInfo counterInfo{m_counterBuffer, 0, VK_WHOLE_SIZE};
+
+    std::array<VkWriteDescriptorSet, 3> writes{};
+    for (uint32_t i = 0; i < writes.size(); i++) {
+        writes[i] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[i].dstSet = m_descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &depthInfo;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].descriptorCount = HIZ_MAX_LEVELS;
+    writes[1].pImageInfo = levelInfos.data();
+    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[2].pBufferInfo = &counterInfo;
+    vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void HiZPyramid::CreatePipeline() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Hi-Z pipeline layout");
+    }
+
+    m_pipeline = CreateComputePipelineFromFile(m_context.logicalDevice, "Shaders/Compiled/HiZBuild.spv",
+                                               m_pipelineLayout);
+}
+
+void HiZPyramid::RecordBuild(VkCommandBuffer commandBuffer, uint32_t frame, GpuTimer &timer) {
+    const uint32_t groupsX = (m_extent.width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+    const uint32_t groupsY = (m_extent.height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+
+    PushConstants pushConstants{};
+    pushConstants.depthSize = glm::ivec2(m_depthExtent.width, m_depthExtent.height);
+    pushConstants.baseSize = glm::ivec2(m_extent.width, m_extent.height);
+    pushConstants.levelCount = m_levelCount;
+    pushConstants.groupCount = groupsX * groupsY;
+
+    //----------------------
+    // DEPTH AND PYRAMID IN
+    //----------------------
+    const VkImageAspectFlags depthAspect = HasStencilComponent(m_depthFormat)
+                                               ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
+                                               : VK_IMAGE_ASPECT_DEPTH_BIT;
+    std::array<VkImageMemoryBarrier, 2> imageBarriers{};
+    imageBarriers[0] = {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    imageBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarriers[0].image = m_depthImage;
+    imageBarriers[0].subresourceRange = {depthAspect, 0, 1, 0, 1};
+    imageBarriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    imageBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    // every level is written again, the previous content does not matter
+    imageBarriers[1] = imageBarriers[0];
+    imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarriers[1].image = m_pyramid;
+    imageBarriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, m_levelCount, 0, 1};
+    imageBarriers[1].srcAccessMask = 0;
+    imageBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    // culling of the previous frame still reads the pyramid and the previous build the counter
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+    vkCmdFillBuffer(commandBuffer, m_counterBuffer, 0, sizeof(uint32_t), 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr,
+                         static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+    //----------
+    // BUILD
+    //----------
+    timer.Begin(commandBuffer, frame, "HiZ::Build", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet,
+                            0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+    timer.End(commandBuffer, frame, "HiZ::Build", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    //------------------------
+    // DEPTH BACK TO THE DRAW
+    //------------------------
+    imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    imageBarriers[0].srcAccessMask = 0;
+    imageBarriers[0].dstAccessMask =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         0, 1, &barrier, 0, nullptr, 1, &imageBarriers[0]);
+}
+
+HiZPyramid::~HiZPyramid() {
+    vkDestroyPipeline(m_context.logicalDevice, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_descriptorSetLayout, nullptr);
+    vkDestroySampler(m_context.logicalDevice, m_sampler, nullptr);
+    vkDestroyBuffer(m_context.logicalDevice, m_counterBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_counterBufferMemory, nullptr);
+    DestroyImages();
+}
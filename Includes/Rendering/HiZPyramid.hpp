@@ -0,0 +1,90 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef HIZPYRAMID_HPP
+#define HIZPYRAMID_HPP
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Profiling/GpuTimer.hpp"
+
+// has to match the size of the pyramid array in HiZBuild.comp
+constexpr uint32_t HIZ_MAX_LEVELS = 16;
+// texels of the level 0 one work group of HiZBuild.comp reduces in to the levels 0 - 5
+constexpr uint32_t HIZ_TILE_SIZE = 32;
+
+// Hierarchical depth of the multisampled depth attachment for the occlusion culling.
+// Level 0 is the largest power of two that fits in to the depth, every texel of every level is the farthest
+// depth under it, so whatever is behind a texel is hidden by everything drawn there.
+// HiZBuild.comp builds all of the levels in one dispatch: work groups reduce their tiles to the level 5 in the
+// shared memory and the last work group to finish reduces the rest
+class HiZPyramid {
+public:
+    // throws if the depth can not be sampled with the given sample count, queue and pool are used to move the
+    // pyramid in to VK_IMAGE_LAYOUT_GENERAL, so it can be bound before it was built for the first time
+    HiZPyramid(const DeviceContext &context, VkImage depthImage, VkImageView depthImageView, VkFormat depthFormat,
+               VkExtent2D depthExtent, VkSampleCountFlagBits samples, VkQueue queue, VkCommandPool commandPool);
+
+    // turns on what the single pass build needs, throws if the device does not have it
+    static void EnableRequiredFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures &features);
+
+    // recreates the pyramid for the new depth attachment, nothing can be in flight
+    void Resize(VkImage depthImage, VkImageView depthImageView, VkExtent2D depthExtent, VkQueue queue,
+                VkCommandPool commandPool);
+
+    // has to be recorded outside of the render pass after the depth was drawn, the depth has to be (and is left) in
+    // VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, the pyramid is ready for the compute shaders afterwards
+    void RecordBuild(VkCommandBuffer commandBuffer, uint32_t frame, GpuTimer &timer);
+
+    // all of the levels in VK_IMAGE_LAYOUT_GENERAL, with a nearest sampler for texelFetch
+    VkDescriptorImageInfo GetDescriptorInfo() const {return {m_sampler, m_pyramidView, VK_IMAGE_LAYOUT_GENERAL};}
+    VkExtent2D GetExtent() const {return m_extent;}
+    uint32_t GetLevelCount() const {return m_levelCount;}
+
+    ~HiZPyramid();
+
+private:
+    // has to match HiZParameters in HiZBuild.comp
+    struct PushConstants {
+        glm::ivec2 depthSize;
+        glm::ivec2 baseSize;
+        uint32_t levelCount;
+        uint32_t groupCount;
+    };
+
+    void CreateImages(VkQueue queue, VkCommandPool commandPool);
+    void DestroyImages();
+    void CreateDescriptors();
+    void WriteDescriptors();
+    void CreatePipeline();
+
+    DeviceContext m_context;
+    VkImage m_depthImage;
+    VkImageView m_depthImageView;
+    VkFormat m_depthFormat;
+    VkExtent2D m_depthExtent;
+
+    VkExtent2D m_extent;
+    uint32_t m_levelCount;
+    VkImage m_pyramid;
+    VkDeviceMemory m_pyramidMemory;
+    VkImageView m_pyramidView;
+    // one per level for the storage image writes
+    std::vector<VkImageView> m_levelViews;
+    VkSampler m_sampler;
+    // work groups that finished their tiles, the last one builds the rest of the levels
+    VkBuffer m_counterBuffer;
+    VkDeviceMemory m_counterBufferMemory;
+
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    VkDescriptorSet m_descriptorSet;
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+};
+
+
+#endif //HIZPYRAMID_HPP
@@ -0,0 +1,307 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "InstancedMeshRenderer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+#include "MeshPool.hpp"
+#include "Utils.hpp"
+
+InstancedMeshRenderer::InstancedMeshRenderer(const DeviceContext &context, const MeshPool &meshes,
+                                             VkRenderPass renderPass, uint32_t subpass, VkSampleCountFlagBits samples,
+                                             VkDescriptorSetLayout cameraLayout, VkDescriptorSetLayout materialLayout,
+                                             uint32_t maxInstances, uint32_t framesInFlight) {
+    this->m_context = context;
+    this->m_meshes = &meshes;
+    this->m_maxInstances = maxInstances;
+    this->m_instances.resize(maxInstances);
+
+    CreateBuffers(framesInFlight);
+    CreatePipeline(renderPass, subpass, samples, cameraLayout, materialLayout);
+}
+
+uint32_t InstancedMeshRenderer::AddBatch(uint32_t mesh, uint32_t maxInstances) {
+    if (m_reservedInstances + maxInstances > m_maxInstances) {
+        throw std::runtime_error("Instanced mesh renderer is out of instances for the batch");
+    }
+
+    m_batches.push_back({mesh, m_reservedInstances, maxInstances, 0});
+    m_reservedInstances += maxInstances;
+    return static_cast<uint32_t>(m_batches.size() - 1);
+}
+
+uint32_t InstancedMeshRenderer::AddInstance(uint32_t batch, const InstanceData &instance) {
+    Batch &target = m_batches[batch];
+    if (target.count >= target.capacity) {
+        throw std::runtime_error("Instance batch is full");
+    }
+
+    SetInstance(batch, target.count, instance);
+    return target.count++;
+}
+
+void InstancedMeshRenderer::SetInstance(uint32_t batch, uint32_t index, const InstanceData &instance) {
+    const uint32_t instanceIndex = m_batches[batch].firstInstance + index;
+    m_instances[instanceIndex] = instance;
+    MarkDirty(instanceIndex, 1);
+}
+
+void InstancedMeshRenderer::SetTransform(uint32_t batch, uint32_t index, const glm::mat4 &transform) {
+    const uint32_t instanceIndex = m_batches[batch].firstInstance + index;
+    m_instances[instanceIndex].transform = transform;
+    MarkDirty(instanceIndex, 1);
+}
+
+const InstanceData &InstancedMeshRenderer::GetInstance(uint32_t batch, uint32_t index) const {
+    return m_instances[m_batches[batch].firstInstance + index];
+}
+
+void InstancedMeshRenderer::ClearInstances(uint32_t batch) {
+    // instances past the count are not drawn, there is nothing to upload
+    m_batches[batch].count = 0;
+}
+
+uint32_t InstancedMeshRenderer::GetInstanceCount() const {
+    uint32_t count = 0;
+    for (const auto &batch: m_batches) {
+        count += batch.count;
+    }
+    return count;
+}
+
+void InstancedMeshRenderer::MarkDirty(uint32_t firstInstance, uint32_t count) {
+    // instances are usually changed in order, so the range is grown instead of adding a new one
+    if (!m_dirtyRanges.empty() && m_dirtyRanges.back().first <= firstInstance &&
+        firstInstance <= m_dirtyRanges.back().second) {
+        m_dirtyRanges.back().second = std::max(m_dirtyRanges.back().second, firstInstance + count);
+        return;
+    }
+    m_dirtyRanges.emplace_back(firstInstance, firstInstance + count);
+}
+
+void InstancedMeshRenderer::CreateBuffers(uint32_t framesInFlight) {
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = GetInstanceBufferSize();
+
+    // read by the vertex input as the second vertex binding
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    CreateBuffer(bufferCreateInfo, m_instanceBuffer, m_instanceBufferMemory);
+
+    // instances keep their place in the staging buffer, so every range is copied with the same offsets
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    m_stagingBuffers.resize(framesInFlight);
+    m_stagingBuffersMemory.resize(framesInFlight);
+    m_stagingBuffersMapped.resize(framesInFlight);
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        CreateBuffer(bufferCreateInfo, m_stagingBuffers[i], m_stagingBuffersMemory[i]);
+        vkMapMemory(m_context.logicalDevice, m_stagingBuffersMemory[i], 0, bufferCreateInfo.size, 0,
+                    &m_stagingBuffersMapped[i]);
+    }
+}
+
+void InstancedMeshRenderer::CreatePipeline(VkRenderPass renderPass, uint32_t subpass, VkSampleCountFlagBits samples,
+                                           VkDescriptorSetLayout cameraLayout, VkDescriptorSetLayout materialLayout) {
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {cameraLayout, materialLayout};
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    layoutInfo.pSetLayouts = setLayouts.data();
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create instanced mesh pipeline layout");
+    }
+
+    //----------
+    // SHADERS
+    //----------
+    // shading is the same as the one of the mesh particles, so is the interface of the vertex shader
+    auto vertexCode = readFile("Shaders/Compiled/InstancedMeshVertex.spv");
+    auto fragmentCode = readFile("Shaders/Compiled/ParticleMeshFragment.spv");
+    VkShaderModule vertexModule = createShaderModuel(m_context.logicalDevice, vertexCode);
+    VkShaderModule fragmentModule = createShaderModuel(m_context.logicalDevice, fragmentCode);
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    shaderStages[0] = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertexModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1] = shaderStages[0];
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragmentModule;
+
+    //--------------
+    // VERTEX INPUT
+    //--------------
+    // vertices of the mesh advance per vertex, the instances per instance
+    std::array<VkVertexInputBindingDescription, 2> bindings{};
+    bindings[0] = Vertex::getBindingDescription();
+    bindings[1].binding = 1;
+    bindings[1].stride = sizeof(InstanceData);
+    bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    for (const auto &attribute: Vertex::getAttributeDescriptions()) {
+        attributes.push_back(attribute);
+    }
+    // mat4 takes 4 locations, one per column
+    for (uint32_t column = 0; column < 4; column++) {
+        attributes.push_back({4 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+                              static_cast<uint32_t>(offsetof(InstanceData, transform) + sizeof(glm::vec4) * column)});
+    }
+    attributes.push_back({8, 1, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, color))});
+    attributes.push_back({9, 1, VK_FORMAT_R32_UINT, static_cast<uint32_t>(offsetof(InstanceData, material))});
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindings.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+
+    //-----------------
+    // FIXED FUNCTIONS
+    //-----------------
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState{.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample{.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisample.rasterizationSamples = samples;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    blendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlend{.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    colorBlend.attachmentCount = 1;
+    colorBlend.pAttachments = &blendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = subpass;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(m_context.logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                  &m_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create instanced mesh pipeline");
+    }
+
+    vkDestroyShaderModule(m_context.logicalDevice, vertexModule, nullptr);
+    vkDestroyShaderModule(m_context.logicalDevice, fragmentModule, nullptr);
+}
+
+void InstancedMeshRenderer::RecordUpload(VkCommandBuffer commandBuffer, uint32_t frame) {
+    m_uploadCount++;
+    if (m_dirtyRanges.empty()) {
+        return;
+    }
+
+    // overlapping and touching ranges become one copy
+    std::sort(m_dirtyRanges.begin(), m_dirtyRanges.end());
+    std::vector<VkBufferCopy> copies;
+    for (const auto &range: m_dirtyRanges) {
+        const VkDeviceSize offset = sizeof(InstanceData) * range.first;
+        const VkDeviceSize end = sizeof(InstanceData) * range.second;
+        if (!copies.empty() && offset <= copies.back().dstOffset + copies.back().size) {
+            copies.back().size = std::max(copies.back().size, end - copies.back().dstOffset);
+            continue;
+        }
+        copies.push_back({offset, offset, end - offset});
+    }
+    m_dirtyRanges.clear();
+
+    for (const auto &copy: copies) {
+        memcpy(static_cast<char *>(m_stagingBuffersMapped[frame]) + copy.srcOffset,
+               reinterpret_cast<const char *>(m_instances.data()) + copy.srcOffset, copy.size);
+        m_uploadedBytes += copy.size;
+    }
+
+    // draws of the previous frames still read the instances that are about to be overwritten
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdCopyBuffer(commandBuffer, m_stagingBuffers[frame], m_instanceBuffer, static_cast<uint32_t>(copies.size()),
+                    copies.data());
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void InstancedMeshRenderer::RecordDraw(VkCommandBuffer commandBuffer, VkDescriptorSet cameraSet,
+                                       uint32_t cameraOffset, VkDescriptorSet materialSet) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    std::array<VkDescriptorSet, 2> sets = {cameraSet, materialSet};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0,
+                            static_cast<uint32_t>(sets.size()), sets.data(), 1, &cameraOffset);
+
+    m_meshes->Bind(commandBuffer);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 1, 1, &m_instanceBuffer, &offset);
+
+    for (const auto &batch: m_batches) {
+        if (batch.count == 0) continue;
+
+        // first instance moves the instance attributes to the range of the batch
+        const MeshRange &mesh = m_meshes->GetMesh(batch.mesh);
+        vkCmdDrawIndexed(commandBuffer, mesh.indexCount, batch.count, mesh.firstIndex, mesh.vertexOffset,
+                         batch.firstInstance);
+        m_drawCount++;
+    }
+}
+
+InstancedMeshRenderer::~InstancedMeshRenderer() {
+    vkDestroyPipeline(m_context.logicalDevice, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_pipelineLayout, nullptr);
+
+    for (size_t i = 0; i < m_stagingBuffers.size(); i++) {
+        vkUnmapMemory(m_context.logicalDevice, m_stagingBuffersMemory[i]);
+        vkDestroyBuffer(m_context.logicalDevice, m_stagingBuffers[i], nullptr);
+        vkFreeMemory(m_context.logicalDevice, m_stagingBuffersMemory[i], nullptr);
+    }
+    vkDestroyBuffer(m_context.logicalDevice, m_instanceBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_instanceBufferMemory, nullptr);
+}
@@ -0,0 +1,104 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef INSTANCEDMESHRENDERER_HPP
+#define INSTANCEDMESHRENDERER_HPP
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+class MeshPool;
+
+// one copy of the mesh, has to match the instance attributes of InstancedMeshVertex.vert
+struct InstanceData {
+    // scale has to be uniform, normals are turned by its upper 3x3
+    glm::mat4 transform = glm::mat4(1.0f);
+    glm::vec4 color = glm::vec4(1.0f);
+    // index in to the material table of the MaterialLibrary
+    uint32_t material = 0;
+    float padding[3] = {};
+};
+
+// Draws any amount of copies of the meshes of a MeshPool with hardware instancing.
+// Instances of the same mesh are one batch, a contiguous range of the instance buffer that is drawn with a single
+// vkCmdDrawIndexed whose firstInstance points at the range, so the cost on the CPU does not grow with the instances.
+// The instance buffer is device local, the CPU keeps a copy and only the ranges changed since the last upload
+// are copied through the staging buffer of the frame
+class InstancedMeshRenderer {
+public:
+    // pipeline is created for the given subpass, set 0 is the camera UBO (dynamic offset) and set 1 the materials
+    InstancedMeshRenderer(const DeviceContext &context, const MeshPool &meshes, VkRenderPass renderPass,
+                          uint32_t subpass, VkSampleCountFlagBits samples, VkDescriptorSetLayout cameraLayout,
+                          VkDescriptorSetLayout materialLayout, uint32_t maxInstances, uint32_t framesInFlight);
+
+    // reserves room for maxInstances copies of the mesh, returns the batch
+    uint32_t AddBatch(uint32_t mesh, uint32_t maxInstances);
+    // returns the index of the instance in the batch
+    uint32_t AddInstance(uint32_t batch, const InstanceData &instance);
+    void SetInstance(uint32_t batch, uint32_t index, const InstanceData &instance);
+    void SetTransform(uint32_t batch, uint32_t index, const glm::mat4 &transform);
+    const InstanceData &GetInstance(uint32_t batch, uint32_t index) const;
+    void ClearInstances(uint32_t batch);
+
+    uint32_t GetInstanceCount(uint32_t batch) const {return m_batches[batch].count;}
+    uint32_t GetInstanceCount() const;
+
+    // copies the changed instances, has to be recorded outside of the render pass before the draw
+    void RecordUpload(VkCommandBuffer commandBuffer, uint32_t frame);
+    // one draw per batch that has any instances, viewport and scissor have to be set
+    void RecordDraw(VkCommandBuffer commandBuffer, VkDescriptorSet cameraSet, uint32_t cameraOffset,
+                    VkDescriptorSet materialSet);
+
+    uint64_t GetUploadedBytes() const {return m_uploadedBytes;}
+    uint64_t GetUploadCount() const {return m_uploadCount;}
+    uint64_t GetDrawCount() const {return m_drawCount;}
+    VkDeviceSize GetInstanceBufferSize() const {return sizeof(InstanceData) * m_maxInstances;}
+    void ResetStatistics() {m_uploadedBytes = 0; m_uploadCount = 0; m_drawCount = 0;}
+
+    ~InstancedMeshRenderer();
+
+private:
+    struct Batch {
+        uint32_t mesh;
+        uint32_t firstInstance;
+        uint32_t capacity;
+        uint32_t count;
+    };
+
+    void CreateBuffers(uint32_t framesInFlight);
+    void CreatePipeline(VkRenderPass renderPass, uint32_t subpass, VkSampleCountFlagBits samples,
+                        VkDescriptorSetLayout cameraLayout, VkDescriptorSetLayout materialLayout);
+    void MarkDirty(uint32_t firstInstance, uint32_t count);
+
+    DeviceContext m_context;
+    const MeshPool *m_meshes;
+    uint32_t m_maxInstances;
+    uint32_t m_reservedInstances = 0;
+
+    std::vector<Batch> m_batches;
+    // CPU copy of the whole instance buffer
+    std::vector<InstanceData> m_instances;
+    // [first, end) instances changed since the last upload, merged when they are uploaded
+    std::vector<std::pair<uint32_t, uint32_t>> m_dirtyRanges;
+
+    VkBuffer m_instanceBuffer;
+    VkDeviceMemory m_instanceBufferMemory;
+    // per frame in flight, the copy of the previous frame can still be reading its staging buffer
+    std::vector<VkBuffer> m_stagingBuffers;
+    std::vector<VkDeviceMemory> m_stagingBuffersMemory;
+    std::vector<void *> m_stagingBuffersMapped;
+
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+
+    uint64_t m_uploadedBytes = 0;
+    uint64_t m_uploadCount = 0;
+    uint64_t m_drawCount = 0;
+};
+
+
+#endif //INSTANCEDMESHRENDERER_HPP
@@ -0,0 +1,132 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "MeshPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "Utils.hpp"
+
+MeshPool::MeshPool(const DeviceContext &context, uint32_t maxVertices, uint32_t maxIndices) {
+    this->m_context = context;
+    this->m_maxVertices = maxVertices;
+    this->m_maxIndices = maxIndices;
+
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    bufferCreateInfo.size = sizeof(Vertex) * maxVertices;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    CreateBuffer(bufferCreateInfo, m_vertexBuffer, m_vertexBufferMemory);
+
+    bufferCreateInfo.size = sizeof(uint32_t) * maxIndices;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    CreateBuffer(bufferCreateInfo, m_indexBuffer, m_indexBufferMemory);
+}
+
+uint32_t MeshPool::AddMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, VkQueue queue,
+                           VkCommandPool commandPool) {
+    return AddMesh(vertices, std::vector<std::vector<uint32_t>>{indices}, {0.0f}, queue, commandPool);
+}
+
+uint32_t MeshPool::AddMesh(const std::vector<Vertex> &vertices, const std::vector<std::vector<uint32_t>> &lods,
+                           const std::vector<float> &lodErrors, VkQueue queue, VkCommandPool commandPool) {
+    if (lods.empty() || lods.size() > MESH_MAX_LODS || lods.size() != lodErrors.size()) {
+        throw std::runtime_error("Mesh needs between 1 and MESH_MAX_LODS levels of detail, each with its error");
+    }
+
+    MeshRange mesh{};
+    mesh.vertexOffset = static_cast<int32_t>(m_vertexCount);
+    mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+    mesh.lodCount = static_cast<uint32_t>(lods.size());
+
+    std::vector<uint32_t> indices;
+    for (uint32_t lod = 0; lod < mesh.lodCount; lod++) {
+        mesh.lods[lod].firstIndex = m_indexCount + static_cast<uint32_t>(indices.size());
+        mesh.lods[lod].indexCount = static_cast<uint32_t>(lods[lod].size());
+        mesh.lods[lod].error = lodErrors[lod];
+        indices.insert(indices.end(), lods[lod].begin(), lods[lod].end());
+    }
+    mesh.firstIndex = mesh.lods[0].firstIndex;
+    mesh.indexCount = mesh.lods[0].indexCount;
+
+    if (m_vertexCount + vertices.size() > m_maxVertices || m_indexCount + indices.size() > m_maxIndices) {
+        throw std::runtime_error("Mesh pool is out of space for the mesh");
+    }
+
+    // sphere around the centre of the bounding box, not the tightest one but good enough for the culling
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (const auto &vertex: vertices) {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    mesh.boundsCenter = (boundsMin + boundsMax) * 0.5f;
+    mesh.boundsRadius = 0.0f;
+    for (const auto &vertex: vertices) {
+        mesh.boundsRadius = std::max(mesh.boundsRadius, glm::length(vertex.pos - mesh.boundsCenter));
+    }
+
+    //----------------
+    // STAGING BUFFER
+    //----------------
+    const VkDeviceSize vertexBytes = sizeof(Vertex) * vertices.size();
+    const VkDeviceSize indexBytes = sizeof(uint32_t) * indices.size();
+
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = vertexBytes + indexBytes;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    CreateBuffer(bufferCreateInfo, stagingBuffer, stagingBufferMemory);
+
+    void *data;
+    vkMapMemory(m_context.logicalDevice, stagingBufferMemory, 0, bufferCreateInfo.size, 0, &data);
+    memcpy(data, vertices.data(), vertexBytes);
+    memcpy(static_cast<char *>(data) + vertexBytes, indices.data(), indexBytes);
+    vkUnmapMemory(m_context.logicalDevice, stagingBufferMemory);
+
+    //-----------------------------
+    // COPY BEHIND THE LAST MESH
+    //-----------------------------
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_context.logicalDevice, commandPool);
+
+    VkBufferCopy vertexCopy{0, sizeof(Vertex) * m_vertexCount, vertexBytes};
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, m_vertexBuffer, 1, &vertexCopy);
+    VkBufferCopy indexCopy{vertexBytes, sizeof(uint32_t) * m_indexCount, indexBytes};
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, m_indexBuffer, 1, &indexCopy);
+
+    EndSingleTimeCommand(m_context.logicalDevice, commandPool, commandBuffer, queue);
+
+    vkDestroyBuffer(m_context.logicalDevice, stagingBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, stagingBufferMemory, nullptr);
+
+    m_vertexCount += mesh.vertexCount;
+    m_indexCount += static_cast<uint32_t>(indices.size());
+    m_meshes.push_back(mesh);
+    return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+void MeshPool::Bind(VkCommandBuffer commandBuffer) const {
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+MeshPool::~MeshPool() {
+    vkDestroyBuffer(m_context.logicalDevice, m_vertexBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_vertexBufferMemory, nullptr);
+    vkDestroyBuffer(m_context.logicalDevice, m_indexBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_indexBufferMemory, nullptr);
+}
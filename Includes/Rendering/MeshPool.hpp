@@ -0,0 +1,77 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef MESHPOOL_HPP
+#define MESHPOOL_HPP
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+// levels of detail a mesh can have, LOD 0 included
+constexpr uint32_t MESH_MAX_LODS = 4;
+
+// indices of a level of detail, it uses the vertices of the mesh
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // distance the surface moved compared to LOD 0, in the units of the mesh
+    float error;
+};
+
+// where the mesh lives in the shared buffers, the arguments of its vkCmdDrawIndexed
+struct MeshRange {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    // bounding sphere in the space of the mesh
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    // LOD 0 is the firstIndex and the indexCount above, the coarser ones follow it in the index buffer
+    uint32_t lodCount;
+    MeshLod lods[MESH_MAX_LODS];
+};
+
+// Vertices and indices of every mesh of the scene in one vertex and one index buffer, so they are bound once and
+// any mesh is drawn by its offsets. Buffers are sized up front and live in the device local memory,
+// meshes are copied in to them through a staging buffer when they are added
+class MeshPool {
+public:
+    MeshPool(const DeviceContext &context, uint32_t maxVertices, uint32_t maxIndices);
+
+    // indices are relative to the first vertex of the mesh and form a triangle list, returns the id of the mesh
+    uint32_t AddMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, VkQueue queue,
+                     VkCommandPool commandPool);
+    // indices of every LOD from the finest one follow each other in the index buffer and share the vertices,
+    // errors are the ones of MeshSimplifier::GenerateLods
+    uint32_t AddMesh(const std::vector<Vertex> &vertices, const std::vector<std::vector<uint32_t>> &lods,
+                     const std::vector<float> &lodErrors, VkQueue queue, VkCommandPool commandPool);
+
+    const MeshRange &GetMesh(uint32_t mesh) const {return m_meshes[mesh];}
+    uint32_t GetMeshCount() const {return static_cast<uint32_t>(m_meshes.size());}
+
+    // vertex buffer goes to the binding 0
+    void Bind(VkCommandBuffer commandBuffer) const;
+
+    ~MeshPool();
+
+private:
+    DeviceContext m_context;
+    uint32_t m_maxVertices;
+    uint32_t m_maxIndices;
+    uint32_t m_vertexCount = 0;
+    uint32_t m_indexCount = 0;
+
+    std::vector<MeshRange> m_meshes;
+
+    VkBuffer m_vertexBuffer;
+    VkDeviceMemory m_vertexBufferMemory;
+    VkBuffer m_indexBuffer;
+    VkDeviceMemory m_indexBufferMemory;
+};
+
+
+#endif //MESHPOOL_HPP
@@ -0,0 +1,258 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "MeshSimplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+//---------------------
+// QUADRIC
+//---------------------
+void MeshSimplifier::Quadric::AddPlane(const glm::vec3 &normal, float distance) {
+    const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+    a2 += a * a;
+    ab += a * b;
+    ac += a * c;
+    ad += a * d;
+    b2 += b * b;
+    bc += b * c;
+    bd += b * d;
+    c2 += c * c;
+    cd += c * d;
+    d2 += d * d;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric &other) {
+    a2 += other.a2;
+    ab += other.ab;
+    ac += other.ac;
+    ad += other.ad;
+    b2 += other.b2;
+    bc += other.bc;
+    bd += other.bd;
+    c2 += other.c2;
+    cd += other.cd;
+    d2 += other.d2;
+}
+
+double MeshSimplifier::Quadric::Evaluate(const glm::vec3 &point) const {
+    const double x = point.x, y = point.y, z = point.z;
+    return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x + b2 * y * y + 2.0 * bc * y * z +
+        2.0 * bd * y + c2 * z * z + 2.0 * cd * z + d2;
+}
+
+//---------------------
+// SIMPLIFIER
+//---------------------
+MeshSimplifier::MeshSimplifier(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) {
+    this->m_indices = indices;
+
+    // vertices that differ only in the normal or uv share the position
+    struct PositionHash {
+        size_t operator()(const glm::vec3 &position) const {
+            uint32_t bits[3];
+            memcpy(bits, &position.x, sizeof(bits));
+            return (static_cast<size_t>(bits[0]) * 73856093u) ^ (static_cast<size_t>(bits[1]) * 19349663u) ^
+                (static_cast<size_t>(bits[2]) * 83492791u);
+        }
+    };
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> positionIds;
+    m_positionOfVertex.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        auto [it, isNew] = positionIds.emplace(vertices[i].pos, static_cast<uint32_t>(m_positions.size()));
+        if (isNew) m_positions.push_back(vertices[i].pos);
+        m_positionOfVertex[i] = it->second;
+    }
+
+    // every triangle adds its plane to its corners, edges used by a single triangle are the open border
+    m_quadrics.resize(m_positions.size());
+    m_isLocked.assign(m_positions.size(), 0);
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const uint32_t corners[3] = {
+            m_positionOfVertex[indices[i]], m_positionOfVertex[indices[i + 1]], m_positionOfVertex[indices[i + 2]]
+        };
+        const glm::vec3 normal = glm::cross(m_positions[corners[1]] - m_positions[corners[0]],
+                                            m_positions[corners[2]] - m_positions[corners[0]]);
+        if (glm::length(normal) > 0.0f) {
+            const glm::vec3 unitNormal = glm::normalize(normal);
+            for (uint32_t corner: corners) {
+                m_quadrics[corner].AddPlane(unitNormal, -glm::dot(unitNormal, m_positions[corners[0]]));
+            }
+        }
+        for (int edge = 0; edge < 3; edge++) {
+            const uint32_t a = std::min(corners[edge], corners[(edge + 1) % 3]);
+            const uint32_t b = std::max(corners[edge], corners[(edge + 1) % 3]);
+            if (a != b) edgeUses[static_cast<uint64_t>(a) << 32 | b]++;
+        }
+    }
+    for (const auto &[edge, uses]: edgeUses) {
+        if (uses != 1) continue;
+        m_isLocked[edge >> 32] = 1;
+        m_isLocked[edge & 0xFFFFFFFFu] = 1;
+    }
+}
+
+bool MeshSimplifier::CanCollapse(uint32_t from, uint32_t to, const std::vector<uint32_t> &firstTriangle,
+                                 const std::vector<uint32_t> &triangles,
+                                 std::vector<std::pair<uint32_t, uint32_t>> &vertexPairs) const {
+    vertexPairs.clear();
+
+    // every vertex of `from` turns in to the vertex of `to` it shares a triangle with
+    for (uint32_t i = firstTriangle[from]; i < firstTriangle[from + 1]; i++) {
+        const uint32_t *corners = &m_indices[triangles[i] * 3];
+        uint32_t fromVertex = 0, toVertex = 0;
+        bool hasTo = false;
+        for (int corner = 0; corner < 3; corner++) {
+            const uint32_t position = m_positionOfVertex[corners[corner]];
+            if (position == from) fromVertex = corners[corner];
+            if (position == to) {
+                toVertex = corners[corner];
+                hasTo = true;
+            }
+        }
+        if (!hasTo) continue;
+        const bool isKnown = std::any_of(vertexPairs.begin(), vertexPairs.end(), [&](const auto &pair) {
+            return pair.first == fromVertex;
+        });
+        if (!isKnown) vertexPairs.emplace_back(fromVertex, toVertex);
+    }
+
+    for (uint32_t i = firstTriangle[from]; i < firstTriangle[from + 1]; i++) {
+        const uint32_t *corners = &m_indices[triangles[i] * 3];
+        glm::vec3 before[3], after[3];
+        bool hasTo = false;
+        for (int corner = 0; corner < 3; corner++) {
+            const uint32_t position = m_positionOfVertex[corners[corner]];
+            before[corner] = after[corner] = m_positions[position];
+            hasTo = hasTo || position == to;
+            if (position != from) continue;
+
+            // a vertex on the other side of a seam that does not touch `to` would tear the seam open
+            const bool isPaired = std::any_of(vertexPairs.begin(), vertexPairs.end(), [&](const auto &pair) {
+                return pair.first == corners[corner];
+            });
+            if (!isPaired) return false;
+            after[corner] = m_positions[to];
+        }
+
+        // triangles around the edge disappear, the rest must not turn over or fold in to slivers
+        if (hasTo) continue;
+        const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        // triangle folded flat has no normal to compare, its area is measured against its longest edge
+        const float longestEdge = std::max({glm::dot(after[1] - after[0], after[1] - after[0]),
+                                            glm::dot(after[2] - after[1], after[2] - after[1]),
+                                            glm::dot(after[0] - after[2], after[0] - after[2])});
+        if (glm::length(normalAfter) <= MESH_SIMPLIFIER_MIN_AREA_RATIO * longestEdge) return false;
+        const float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+        if (glm::dot(normalBefore, normalAfter) < MESH_SIMPLIFIER_MIN_NORMAL_COS * lengths) return false;
+    }
+    return true;
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(uint32_t targetTriangleCount) {
+    const uint32_t positionCount = static_cast<uint32_t>(m_positions.size());
+    std::vector<uint32_t> vertexRemap(m_positionOfVertex.size());
+    std::vector<uint8_t> isTouched(positionCount);
+    std::vector<uint32_t> firstTriangle(positionCount + 1);
+    std::vector<uint32_t> triangles;
+    std::vector<Collapse> collapses;
+    std::vector<std::pair<uint32_t, uint32_t>> vertexPairs;
+
+    while (GetTriangleCount() > targetTriangleCount) {
+        const uint32_t triangleCount = GetTriangleCount();
+
+        // triangles around every position
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (uint32_t vertex: m_indices) {
+            firstTriangle[m_positionOfVertex[vertex] + 1]++;
+        }
+        for (uint32_t position = 0; position < positionCount; position++) {
+            firstTriangle[position + 1] += firstTriangle[position];
+        }
+        triangles.resize(m_indices.size());
+        std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (uint32_t i = 0; i < m_indices.size(); i++) {
+            triangles[fill[m_positionOfVertex[m_indices[i]]]++] = i / 3;
+        }
+
+        // both directions of every edge, the cheapest go first
+        collapses.clear();
+        for (uint32_t i = 0; i < m_indices.size(); i++) {
+            const uint32_t a = m_positionOfVertex[m_indices[i]];
+            const uint32_t b = m_positionOfVertex[m_indices[i - i % 3 + (i + 1) % 3]];
+            if (a == b) continue;
+            Quadric quadric = m_quadrics[a];
+            quadric.Add(m_quadrics[b]);
+            if (!m_isLocked[a]) collapses.push_back({quadric.Evaluate(m_positions[b]), a, b});
+            if (!m_isLocked[b]) collapses.push_back({quadric.Evaluate(m_positions[a]), b, a});
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+            return a.cost < b.cost;
+        });
+
+        // every collapse removes about 2 triangles, the pass stops close to the target and the next one
+        // sorts the edges again with the merged quadrics. Neighbours of a collapse wait for the next pass
+        const uint32_t maxCollapses = (triangleCount - targetTriangleCount) / 2 + 1;
+        uint32_t collapseCount = 0;
+        std::iota(vertexRemap.begin(), vertexRemap.end(), 0);
+        std::fill(isTouched.begin(), isTouched.end(), 0);
+        for (const Collapse &collapse: collapses) {
+            if (collapseCount >= maxCollapses) break;
+            if (isTouched[collapse.from] || isTouched[collapse.to]) continue;
+            if (!CanCollapse(collapse.from, collapse.to, firstTriangle, triangles, vertexPairs)) continue;
+
+            for (const auto &[fromVertex, toVertex]: vertexPairs) {
+                vertexRemap[fromVertex] = toVertex;
+            }
+            m_quadrics[collapse.to].Add(m_quadrics[collapse.from]);
+            m_error = std::max(m_error, static_cast<float>(std::sqrt(std::max(collapse.cost, 0.0))));
+            for (uint32_t i = firstTriangle[collapse.from]; i < firstTriangle[collapse.from + 1]; i++) {
+                for (int corner = 0; corner < 3; corner++) {
+                    isTouched[m_positionOfVertex[m_indices[triangles[i] * 3 + corner]]] = 1;
+                }
+            }
+            collapseCount++;
+        }
+        if (collapseCount == 0) break;
+
+        // triangles with two corners at the same position are gone
+        std::vector<uint32_t> indices;
+        indices.reserve(m_indices.size());
+        for (size_t i = 0; i < m_indices.size(); i += 3) {
+            const uint32_t a = vertexRemap[m_indices[i]];
+            const uint32_t b = vertexRemap[m_indices[i + 1]];
+            const uint32_t c = vertexRemap[m_indices[i + 2]];
+            const uint32_t positionA = m_positionOfVertex[a];
+            const uint32_t positionB = m_positionOfVertex[b];
+            const uint32_t positionC = m_positionOfVertex[c];
+            if (positionA == positionB || positionB == positionC || positionA == positionC) continue;
+            indices.insert(indices.end(), {a, b, c});
+        }
+        m_indices = std::move(indices);
+    }
+    return m_indices;
+}
+
+void MeshSimplifier::GenerateLods(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+                                  uint32_t maxLods, std::vector<std::vector<uint32_t>> &lodIndices,
+                                  std::vector<float> &lodErrors) {
+    lodIndices = {indices};
+    lodErrors = {0.0f};
+
+    MeshSimplifier simplifier(vertices, indices);
+    while (lodIndices.size() < maxLods) {
+        const uint32_t previousCount = static_cast<uint32_t>(lodIndices.back().size() / 3);
+        std::vector<uint32_t> lod = simplifier.Simplify(static_cast<uint32_t>(previousCount * MESH_LOD_REDUCTION));
+        if (lod.empty() || lod.size() / 3 > previousCount * (1.0f - MESH_LOD_MIN_REDUCTION)) break;
+
+        lodIndices.push_back(std::move(lod));
+        lodErrors.push_back(simplifier.GetError());
+    }
+}
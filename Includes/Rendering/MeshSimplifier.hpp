@@ -0,0 +1,78 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef MESHSIMPLIFIER_HPP
+#define MESHSIMPLIFIER_HPP
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+// every next LOD aims for this fraction of the triangles of the previous one
+constexpr float MESH_LOD_REDUCTION = 0.5f;
+// LOD that removes less than this fraction of the triangles of the previous one is not worth its indices
+constexpr float MESH_LOD_MIN_REDUCTION = 0.1f;
+// collapse is rejected once a triangle around it turns further than this cosine (about 75 degrees)
+constexpr float MESH_SIMPLIFIER_MIN_NORMAL_COS = 0.25f;
+// or once a triangle around it gets thinner than this, twice its area over its longest edge squared
+constexpr float MESH_SIMPLIFIER_MIN_AREA_RATIO = 1e-3f;
+
+// Simplifies a triangle mesh with quadric error edge collapses (Garland & Heckbert). Vertices never move, every
+// collapse merges the vertex in to the other end of the edge, so the LODs only need new indices and share the
+// vertices of the mesh. Vertices with the same position but different normal or uv (seams) are collapsed together
+// and only along the edges both sides of the seam share, so the seams and the hard edges stay closed.
+// Vertices on the open borders of the mesh are never collapsed
+class MeshSimplifier {
+public:
+    MeshSimplifier(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+
+    // collapses the edges until at most targetTriangleCount triangles are left or nothing can be collapsed anymore,
+    // every call continues from the result of the previous one. Returns the indices of the simplified mesh
+    std::vector<uint32_t> Simplify(uint32_t targetTriangleCount);
+
+    // distance the surface moved at most so far, estimated from the quadrics, in the units of the mesh
+    float GetError() const {return m_error;}
+    uint32_t GetTriangleCount() const {return static_cast<uint32_t>(m_indices.size() / 3);}
+
+    // LOD 0 is the mesh itself, every next one has about half of the triangles of the previous one.
+    // Stops at maxLods or once the mesh does not get any simpler, errors are in the units of the mesh
+    static void GenerateLods(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+                             uint32_t maxLods, std::vector<std::vector<uint32_t>> &lodIndices,
+                             std::vector<float> &lodErrors);
+
+private:
+    // symmetric 4x4 matrix of the summed squared distances to the planes of the triangles
+    struct Quadric {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        void AddPlane(const glm::vec3 &normal, float distance);
+        void Add(const Quadric &other);
+        double Evaluate(const glm::vec3 &point) const;
+    };
+
+    struct Collapse {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+    };
+
+    // fills the vertex each vertex of `from` turns in to, false if the collapse would open a seam or flip a triangle
+    bool CanCollapse(uint32_t from, uint32_t to, const std::vector<uint32_t> &firstTriangle,
+                     const std::vector<uint32_t> &triangles,
+                     std::vector<std::pair<uint32_t, uint32_t>> &vertexPairs) const;
+
+    // position of every vertex, vertices of a seam share it
+    std::vector<uint32_t> m_positionOfVertex;
+    std::vector<glm::vec3> m_positions;
+    std::vector<Quadric> m_quadrics;
+    // 1 for the positions on the open border
+    std::vector<uint8_t> m_isLocked;
+
+    std::vector<uint32_t> m_indices;
+    float m_error = 0.0f;
+};
+
+
+#endif //MESHSIMPLIFIER_HPP
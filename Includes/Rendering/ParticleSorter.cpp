@@ -0,0 +1,243 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ParticleSorter.hpp"
+
+#include <algorithm>
+
+#include "Utils.hpp"
+
+ParticleSorter::ParticleSorter(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers,
+                               uint32_t particleCount, uint32_t framesInFlight) {
+    this->m_context = context;
+    this->m_particleCount = particleCount;
+    // bitonic sort needs power of two that fills at least one work group
+    this->m_paddedCount = std::max(256u, NextPowerOfTwo(particleCount));
+    this->m_framesInFlight = framesInFlight;
+    this->m_stateCount = static_cast<uint32_t>(particleBuffers.size());
+
+    CreateBuffers();
+    CreateDescriptors(particleBuffers);
+    CreatePipelines();
+}
+
+void ParticleSorter::CreateBuffers() {
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    bufferCreateInfo.size = sizeof(uint32_t) * m_paddedCount;
+
+    CreateBuffer(bufferCreateInfo, m_keyBuffer, m_keyBufferMemory);
+
+    m_drawOrderBuffers.resize(m_framesInFlight);
+    m_drawOrderBuffersMemory.resize(m_framesInFlight);
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        CreateBuffer(bufferCreateInfo, m_drawOrderBuffers[i], m_drawOrderBuffersMemory[i]);
+    }
+}
+
+void ParticleSorter::CreateDescriptors(const std::vector<VkBuffer> &particleBuffers) {
+    //-------------------------
+    // DESCRIPTOR SET LAYOUTS
+    //-------------------------
+    // keys pass reads the particles and writes keys and values, sort reads and writes keys and values
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_keyDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle sort key descriptor set layout");
+    }
+
+    layoutInfo.bindingCount = 2;
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_sortDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle sort descriptor set layout");
+    }
+
+    //-----------------
+    // DESCRIPTOR POOL
+    //-----------------
+    const uint32_t keySetCount = m_framesInFlight * m_stateCount;
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 3 * keySetCount + 2 * m_framesInFlight;
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = keySetCount + m_framesInFlight;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle sort descriptor pool");
+    }
+
+    //-----------------
+    // DESCRIPTOR SETS
+    //-----------------
+    std::vector<VkDescriptorSetLayout> keyLayouts(keySetCount, m_keyDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = keySetCount;
+    allocInfo.pSetLayouts = keyLayouts.data();
+    m_keyDescriptorSets.resize(keySetCount);
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, m_keyDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate particle sort key descriptor sets");
+    }
+
+    std::vector<VkDescriptorSetLayout> sortLayouts(m_framesInFlight, m_sortDescriptorSetLayout);
+    allocInfo.descriptorSetCount = m_framesInFlight;
+    allocInfo.pSetLayouts = sortLayouts.data();
+    m_sortDescriptorSets.resize(m_framesInFlight);
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, m_sortDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate particle sort descriptor sets");
+    }
+
+    for (uint32_t frame = 0; frame < m_framesInFlight; frame++) {
+        std::array<VkDescriptorBufferInfo, 2> sortBufferInfos = {{
+            {m_keyBuffer, 0, VK_WHOLE_SIZE},
+            {m_drawOrderBuffers[frame], 0, VK_WHOLE_SIZE},
+        }};
+        std::array<VkWriteDescriptorSet, 2> sortWrites{};
+        for (uint32_t b = 0; b < sortWrites.size(); b++) {
+            sortWrites[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            sortWrites[b].dstSet = m_sortDescriptorSets[frame];
+            sortWrites[b].dstBinding = b;
+            sortWrites[b].descriptorCount = 1;
+            sortWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            sortWrites[b].pBufferInfo = &sortBufferInfos[b];
+        }
+        vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(sortWrites.size()), sortWrites.data(), 0,
+                               nullptr);
+
+        for (uint32_t state = 0; state < m_stateCount; state++) {
+            std::array<VkDescriptorBufferInfo, 3> bufferInfos = {{
+                {particleBuffers[state], 0, VK_WHOLE_SIZE},
+                {m_keyBuffer, 0, VK_WHOLE_SIZE},
+                {m_drawOrderBuffers[frame], 0, VK_WHOLE_SIZE},
+            }};
+            std::array<VkWriteDescriptorSet, 3> writes{};
+            for (uint32_t b = 0; b < writes.size(); b++) {
+                writes[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+                writes[b].dstSet = m_keyDescriptorSets[frame * m_stateCount + state];
+                writes[b].dstBinding = b;
+                writes[b].descriptorCount = 1;
+                writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[b].pBufferInfo = &bufferInfos[b];
+            }
+            vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0,
+                                   nullptr);
+        }
+    }
+}
+
+void ParticleSorter::CreatePipelines() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_keyDescriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_keyPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle sort key pipeline layout");
+    }
+
+    pushConstantRange.size = sizeof(SortPushConstants);
+    layoutInfo.pSetLayouts = &m_sortDescriptorSetLayout;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_sortPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle sort pipeline layout");
+    }
+
+    m_keyPipeline = CreateComputePipelineFromFile(m_context.logicalDevice, "Shaders/Compiled/ParticleSortKeys.spv",
+                                                  m_keyPipelineLayout);
+    // same sort Barnes-Hut uses for the morton codes
+    m_sortPipeline = CreateComputePipelineFromFile(m_context.logicalDevice, "Shaders/Compiled/BitonicSort.spv",
+                                                   m_sortPipelineLayout);
+}
+
+void ParticleSorter::RecordCommands(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t stateIndex,
+                                    const glm::mat4 &modelView, GpuTimer &timer) {
+    PushConstants pushConstants{};
+    pushConstants.modelView = modelView;
+    pushConstants.particleCount = m_particleCount;
+    pushConstants.paddedCount = m_paddedCount;
+
+    // particles might come from a compute shader or from a transfer (CPU simulation, replay),
+    // keys are shared with the frame before
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    timer.Begin(commandBuffer, frame, "Sorting", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_keyPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_keyPipelineLayout, 0, 1,
+                            &m_keyDescriptorSets[frame * m_stateCount + stateIndex], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_keyPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, m_paddedCount / 256, 1, 1);
+    InsertComputeBarrier(commandBuffer);
+
+    RecordSort(commandBuffer, frame);
+
+    timer.End(commandBuffer, frame, "Sorting", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+}
+
+void ParticleSorter::RecordSort(VkCommandBuffer commandBuffer, uint32_t frame) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_sortPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_sortPipelineLayout, 0, 1,
+                            &m_sortDescriptorSets[frame], 0, nullptr);
+
+    const uint32_t groupCount = m_paddedCount / 256;
+    auto sortStep = [&](uint32_t k, uint32_t j) {
+        SortPushConstants sortConstants{m_paddedCount, k, j};
+        vkCmdPushConstants(commandBuffer, m_sortPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(SortPushConstants), &sortConstants);
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+        InsertComputeBarrier(commandBuffer);
+    };
+
+    // same sequence as BarnesHut::RecordSort, blocks of 256 in the shared memory first, then they are merged
+    sortStep(0, 0);
+    for (uint32_t k = 512; k <= m_paddedCount; k <<= 1) {
+        uint32_t j = k >> 1;
+        for (; j >= 256; j >>= 1) {
+            sortStep(k, j);
+        }
+        sortStep(k, j);
+    }
+}
+
+ParticleSorter::~ParticleSorter() {
+    vkDestroyPipeline(m_context.logicalDevice, m_keyPipeline, nullptr);
+    vkDestroyPipeline(m_context.logicalDevice, m_sortPipeline, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_keyPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_sortPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_keyDescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_sortDescriptorSetLayout, nullptr);
+
+    vkDestroyBuffer(m_context.logicalDevice, m_keyBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_keyBufferMemory, nullptr);
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        vkDestroyBuffer(m_context.logicalDevice, m_drawOrderBuffers[i], nullptr);
+        vkFreeMemory(m_context.logicalDevice, m_drawOrderBuffersMemory[i], nullptr);
+    }
+}
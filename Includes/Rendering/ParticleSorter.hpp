@@ -0,0 +1,80 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef PARTICLESORTER_HPP
+#define PARTICLESORTER_HPP
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Profiling/GpuTimer.hpp"
+
+// Draw order of the particles from the farthest to the closest one, for the sorted alpha blending.
+// ParticleSortKeys.comp turns the view depth of every particle in to a key, BitonicSort.comp sorts the keys
+// together with the particle indices and the sorted indices are read by the vertex shaders instead of gl_InstanceIndex.
+// Every frame in flight has its own draw order, so the frame that is still drawn is not overwritten
+class ParticleSorter {
+public:
+    ParticleSorter(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers, uint32_t particleCount,
+                   uint32_t framesInFlight);
+
+    // modelView has to be the one the particles are drawn with,
+    // has to be recorded after the commands that wrote particleBuffers[stateIndex]
+    void RecordCommands(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t stateIndex, const glm::mat4 &modelView,
+                        GpuTimer &timer);
+
+    // uint per particle, first is the farthest one
+    VkBuffer GetDrawOrderBuffer(uint32_t frame) const {return m_drawOrderBuffers[frame];}
+
+    ~ParticleSorter();
+
+private:
+    // has to match SortKeyParameters in ParticleSortKeys.comp
+    struct PushConstants {
+        glm::mat4 modelView;
+        uint32_t particleCount;
+        uint32_t paddedCount;
+    };
+
+    struct SortPushConstants {
+        uint32_t count;
+        uint32_t k;
+        uint32_t j;
+    };
+
+    void CreateBuffers();
+    void CreateDescriptors(const std::vector<VkBuffer> &particleBuffers);
+    void CreatePipelines();
+    void RecordSort(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    DeviceContext m_context;
+    uint32_t m_particleCount;
+    uint32_t m_paddedCount;
+    uint32_t m_framesInFlight;
+    uint32_t m_stateCount;
+
+    // keys are shared, the frame that sorts them is the only one using them
+    VkBuffer m_keyBuffer;
+    VkDeviceMemory m_keyBufferMemory;
+    // per frame in flight, padded to the power of two
+    std::vector<VkBuffer> m_drawOrderBuffers;
+    std::vector<VkDeviceMemory> m_drawOrderBuffersMemory;
+
+    VkDescriptorSetLayout m_keyDescriptorSetLayout;
+    VkDescriptorSetLayout m_sortDescriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    // indexed [frame * stateCount + stateIndex]
+    std::vector<VkDescriptorSet> m_keyDescriptorSets;
+    // indexed [frame]
+    std::vector<VkDescriptorSet> m_sortDescriptorSets;
+    VkPipelineLayout m_keyPipelineLayout;
+    VkPipelineLayout m_sortPipelineLayout;
+    VkPipeline m_keyPipeline;
+    VkPipeline m_sortPipeline;
+};
+
+
+#endif //PARTICLESORTER_HPP
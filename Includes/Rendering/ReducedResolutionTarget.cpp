@@ -0,0 +1,385 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ReducedResolutionTarget.hpp"
+
+#include <algorithm>
+
+#include "Utils.hpp"
+
+ReducedResolutionTarget::ReducedResolutionTarget(const DeviceContext &context, VkRenderPass compositeRenderPass,
+                                                 uint32_t compositeSubpass, VkSampleCountFlagBits compositeSamples,
+                                                 VkExtent2D fullExtent, uint32_t divisor) {
+    this->m_context = context;
+    this->m_fullExtent = fullExtent;
+    this->m_divisor = divisor;
+    this->m_extent = {std::max(1u, fullExtent.width / divisor), std::max(1u, fullExtent.height / divisor)};
+    // upsample fetches the depth, so it has to be sampled as well
+    this->m_depthFormat = FinsSupportedFormat(m_context.physicalDevice, m_context.logicalDevice,
+                                              {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL,
+                                              VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                              VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+    CreateRenderPass();
+    CreateImages();
+    CreateDescriptors();
+    WriteDescriptors();
+    CreatePipeline(compositeRenderPass, compositeSubpass, compositeSamples);
+}
+
+void ReducedResolutionTarget::Resize(VkExtent2D fullExtent, uint32_t divisor) {
+    m_fullExtent = fullExtent;
+    m_divisor = divisor;
+    m_extent = {std::max(1u, fullExtent.width / divisor), std::max(1u, fullExtent.height / divisor)};
+
+    DestroyImages();
+    CreateImages();
+    WriteDescriptors();
+}
+
+void ReducedResolutionTarget::CreateRenderPass() {
+    //--------------
+    // ATTACHMENTS
+    //--------------
+    // both are kept for the upsample, which samples them in the full resolution render pass
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = REDUCED_RESOLUTION_COLOR_FORMAT;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    // depth starts cleared every frame and only orders the particles among themselves, the scene occludes them
+    // in the upsample
+    VkAttachmentDescription depthAttachment = colorAttachment;
+    depthAttachment.format = m_depthFormat;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subPass{};
+    subPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subPass.colorAttachmentCount = 1;
+    subPass.pColorAttachments = &colorAttachmentRef;
+    subPass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    //---------------
+    // DEPENDENCIES
+    //---------------
+    // upsample of the previous frame has to be done reading before the target is cleared
+    std::array<VkSubpassDependency, 2> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    // and the upsample of this frame reads what was drawn
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+
+    VkRenderPassCreateInfo renderPassInfo{.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subPass;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(m_context.logicalDevice, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create reduced resolution render pass");
+    }
+}
+
+void ReducedResolutionTarget::CreateImages() {
+    ImageCreateInfo imageInfo{};
+    imageInfo.physicalDevice = m_context.physicalDevice;
+    imageInfo.logicalDevice = m_context.logicalDevice;
+    imageInfo.surface = m_context.surface;
+    imageInfo.width = m_extent.width;
+    imageInfo.height = m_extent.height;
+    imageInfo.mipLevels = 1;
+    imageInfo.imageTiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.memoryProperteis = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    imageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+
+    imageInfo.format = REDUCED_RESOLUTION_COLOR_FORMAT;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    CreateImage(imageInfo, m_colorImage, m_colorImageMemory);
+    m_colorImageView = GenerateImageView(m_context.logicalDevice, m_colorImage, 1, REDUCED_RESOLUTION_COLOR_FORMAT);
+
+    imageInfo.format = m_depthFormat;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    CreateImage(imageInfo, m_depthImage, m_depthImageMemory);
+    m_depthImageView = GenerateImageView(m_context.logicalDevice, m_depthImage, 1, m_depthFormat,
+                                         VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    std::array<VkImageView, 2> attachments = {m_colorImageView, m_depthImageView};
+    VkFramebufferCreateInfo frameBufferInfo{.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    frameBufferInfo.renderPass = m_renderPass;
+    frameBufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    frameBufferInfo.pAttachments = attachments.data();
+    frameBufferInfo.width = m_extent.width;
+    frameBufferInfo.height = m_extent.height;
+    frameBufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(m_context.logicalDevice, &frameBufferInfo, nullptr, &m_frameBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create reduced resolution frame buffer");
+    }
+}
+
+void ReducedResolutionTarget::DestroyImages() {
+    vkDestroyFramebuffer(m_context.logicalDevice, m_frameBuffer, nullptr);
+    vkDestroyImageView(m_context.logicalDevice, m_colorImageView, nullptr);
+    vkDestroyImage(m_context.logicalDevice, m_colorImage, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_colorImageMemory, nullptr);
+    vkDestroyImageView(m_context.logicalDevice, m_depthImageView, nullptr);
+    vkDestroyImage(m_context.logicalDevice, m_depthImage, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_depthImageMemory, nullptr);
+}
+
+void ReducedResolutionTarget::CreateDescriptors() {
+    VkSamplerCreateInfo samplerInfo{.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(m_context.logicalDevice, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create reduced resolution sampler");
+    }
+
+    // colour and depth
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create reduced resolution descriptor set layout");
+    }
+
+    // single set, it is rewritten only on resize when nothing is in flight
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = static_cast<uint32_t>(bindings.size());
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create reduced resolution descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate reduced resolution descriptor set");
+    }
+}
+
+void ReducedResolutionTarget::WriteDescriptors() {
+    std::array<VkDescriptorImageInfo, 2> imageInfos = {{
+        {m_sampler, m_colorImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {m_sampler, m_depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL},
+    }};
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    for (uint32_t i = 0; i < writes.size(); i++) {
+        writes[i] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[i].dstSet = m_descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[i].pImageInfo = &imageInfos[i];
+    }
+    vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void ReducedResolutionTarget::CreatePipeline(VkRenderPass compositeRenderPass, uint32_t compositeSubpass,
+                                             VkSampleCountFlagBits compositeSamples) {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create reduced resolution pipeline layout");
+    }
+
+    //----------
+    // SHADERS
+    //----------
+    auto vertexCode = readFile("Shaders/Compiled/FullScreenTriangle.spv");
+    auto fragmentCode = readFile("Shaders/Compiled/ParticleUpsample.spv");
+    VkShaderModule vertexModule = createShaderModuel(m_context.logicalDevice, vertexCode);
+    VkShaderModule fragmentModule = createShaderModuel(m_context.logicalDevice, fragmentCode);
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    shaderStages[0] = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertexModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1] = shaderStages[0];
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragmentModule;
+
+    //-----------------
+    // FIXED FUNCTIONS
+    //-----------------
+    // one triangle over the whole screen, there is no vertex input
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState{.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample{.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisample.rasterizationSamples = compositeSamples;
+
+    // upsampled depth is written, so whatever is drawn after the particles is occluded by them.
+    // Sorted particles do not write the depth and leave the cleared 1.0, hence less or equal
+    VkPipelineDepthStencilStateCreateInfo depthStencil{.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    // colour is premultiplied by the coverage
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    blendAttachment.blendEnable = VK_TRUE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlend{.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    colorBlend.attachmentCount = 1;
+    colorBlend.pAttachments = &blendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.renderPass = compositeRenderPass;
+    pipelineInfo.subpass = compositeSubpass;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(m_context.logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                  &m_upsamplePipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle upsample pipeline");
+    }
+
+    vkDestroyShaderModule(m_context.logicalDevice, vertexModule, nullptr);
+    vkDestroyShaderModule(m_context.logicalDevice, fragmentModule, nullptr);
+}
+
+void ReducedResolutionTarget::BeginRenderPass(VkCommandBuffer commandBuffer) {
+    // nothing covered, depth at the far plane
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo renderPassInfo{.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+    renderPassInfo.renderPass = m_renderPass;
+    renderPassInfo.framebuffer = m_frameBuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = m_extent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void ReducedResolutionTarget::EndRenderPass(VkCommandBuffer commandBuffer) {
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void ReducedResolutionTarget::RecordUpsample(VkCommandBuffer commandBuffer, const glm::mat4 &projection) {
+    PushConstants pushConstants{};
+    pushConstants.depthUnproject = glm::vec2(projection[2][2], projection[3][2]);
+    pushConstants.divisor = static_cast<float>(m_divisor);
+    pushConstants.depthTolerance = REDUCED_RESOLUTION_DEPTH_TOLERANCE;
+
+    // covers the full resolution target
+    VkViewport viewport{0.0f, 0.0f, static_cast<float>(m_fullExtent.width), static_cast<float>(m_fullExtent.height),
+                        0.0f, 1.0f};
+    VkRect2D scissor{{0, 0}, m_fullExtent};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_upsamplePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet,
+                            0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+ReducedResolutionTarget::~ReducedResolutionTarget() {
+    DestroyImages();
+    vkDestroyPipeline(m_context.logicalDevice, m_upsamplePipeline, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_descriptorSetLayout, nullptr);
+    vkDestroySampler(m_context.logicalDevice, m_sampler, nullptr);
+    vkDestroyRenderPass(m_context.logicalDevice, m_renderPass, nullptr);
+}
@@ -0,0 +1,93 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef REDUCEDRESOLUTIONTARGET_HPP
+#define REDUCEDRESOLUTIONTARGET_HPP
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+// colour of the reduced resolution particles, premultiplied by the coverage in alpha
+constexpr VkFormat REDUCED_RESOLUTION_COLOR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+// covered texels further behind the nearest one than this fraction of its view distance are not upsampled
+constexpr float REDUCED_RESOLUTION_DEPTH_TOLERANCE = 0.05f;
+
+// Offscreen single sampled colour and depth at 1 / divisor of the swap chain size, particles are drawn in to it
+// with their own render pass and ParticleUpsample.frag writes them in to the full resolution colour and depth.
+// The upsample is depth aware: of the 4 nearest texels only the ones close to the nearest covered one are blended,
+// so a particle behind does not bleed through the one in front, and the nearest depth is written for the rest of
+// the frame to test against. Fill rate drops with the square of the divisor.
+// The reduced depth holds only the particles, the scene is not downsampled in to it: the instanced meshes are drawn
+// later in the full resolution render pass, so the particles behind the scene are still shaded at the reduced
+// resolution and are hidden only by the depth test of the upsample against the full resolution depth
+class ReducedResolutionTarget {
+public:
+    // upsample pipeline is created for the given subpass of the full resolution render pass
+    ReducedResolutionTarget(const DeviceContext &context, VkRenderPass compositeRenderPass, uint32_t compositeSubpass,
+                            VkSampleCountFlagBits compositeSamples, VkExtent2D fullExtent, uint32_t divisor);
+
+    // recreates the images for the new swap chain size or divisor, nothing can be in flight
+    void Resize(VkExtent2D fullExtent, uint32_t divisor);
+
+    // particle pipelines drawn in to the target have to be created with this render pass and 1 sample
+    VkRenderPass GetRenderPass() const {return m_renderPass;}
+    VkExtent2D GetExtent() const {return m_extent;}
+    uint32_t GetDivisor() const {return m_divisor;}
+
+    // clears the target, viewport and scissor have to be set to GetExtent()
+    void BeginRenderPass(VkCommandBuffer commandBuffer);
+    void EndRenderPass(VkCommandBuffer commandBuffer);
+
+    // full screen upsample in to the current subpass of the full resolution render pass,
+    // projection has to be the one the particles were drawn with
+    void RecordUpsample(VkCommandBuffer commandBuffer, const glm::mat4 &projection);
+
+    ~ReducedResolutionTarget();
+
+private:
+    // has to match UpsampleParameters in ParticleUpsample.frag
+    struct PushConstants {
+        // projection[2][2] and projection[3][2], view distance is y / (depth + x)
+        glm::vec2 depthUnproject;
+        float divisor;
+        float depthTolerance;
+    };
+
+    void CreateRenderPass();
+    void CreateImages();
+    void DestroyImages();
+    void CreateDescriptors();
+    void WriteDescriptors();
+    void CreatePipeline(VkRenderPass compositeRenderPass, uint32_t compositeSubpass,
+                        VkSampleCountFlagBits compositeSamples);
+
+    DeviceContext m_context;
+    VkExtent2D m_fullExtent;
+    VkExtent2D m_extent;
+    uint32_t m_divisor;
+    VkFormat m_depthFormat;
+
+    VkRenderPass m_renderPass;
+    VkImage m_colorImage;
+    VkDeviceMemory m_colorImageMemory;
+    VkImageView m_colorImageView;
+    VkImage m_depthImage;
+    VkDeviceMemory m_depthImageMemory;
+    VkImageView m_depthImageView;
+    VkFramebuffer m_frameBuffer;
+
+    // texels are fetched, the sampler only has to exist
+    VkSampler m_sampler;
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    VkDescriptorSet m_descriptorSet;
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_upsamplePipeline;
+};
+
+
+#endif //REDUCEDRESOLUTIONTARGET_HPP
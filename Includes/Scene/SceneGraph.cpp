@@ -0,0 +1,160 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "SceneGraph.hpp"
+
+#include <chrono>
+#include <stdexcept>
+
+SceneGraph::SceneGraph(ThreadPool &threadPool) : m_threadPool(threadPool) {
+}
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const glm::mat4 &local) {
+    const uint32_t node = GetNodeCount();
+    if (parent != SCENE_GRAPH_NO_PARENT && parent >= node) {
+        throw std::runtime_error("Scene graph parent has to be added before its children");
+    }
+
+    m_parentOfNode.push_back(parent);
+    m_depthOfNode.push_back(parent == SCENE_GRAPH_NO_PARENT ? 0 : m_depthOfNode[parent] + 1);
+    // appended at the end until the nodes are sorted again
+    m_slotOfNode.push_back(static_cast<uint32_t>(m_local.size()));
+    m_local.push_back(local);
+    m_isSortNeeded = true;
+    return node;
+}
+
+void SceneGraph::SetLocal(uint32_t node, const glm::mat4 &local) {
+    const uint32_t slot = m_slotOfNode[node];
+    m_local[slot] = local;
+    // sorting queues every node anyway
+    if (m_isSortNeeded || m_isQueued[slot]) return;
+
+    m_isQueued[slot] = 1;
+    m_dirtyLevels[m_depthOfNode[node]].push_back(slot);
+}
+
+void SceneGraph::Clear() {
+    m_parentOfNode.clear();
+    m_depthOfNode.clear();
+    m_slotOfNode.clear();
+    m_local.clear();
+    m_world.clear();
+    m_parent.clear();
+    m_firstChild.clear();
+    m_childCount.clear();
+    m_nodeOfSlot.clear();
+    m_isQueued.clear();
+    m_dirtyLevels.clear();
+    m_changedNodes.clear();
+    m_isSortNeeded = false;
+}
+
+void SceneGraph::SortNodes() {
+    const uint32_t count = GetNodeCount();
+
+    // children of every node, counting sort by the parent
+    std::vector<uint32_t> childStart(count + 1, 0);
+    for (uint32_t parent: m_parentOfNode) {
+        if (parent != SCENE_GRAPH_NO_PARENT) childStart[parent + 1]++;
+    }
+    for (uint32_t node = 0; node < count; node++) {
+        childStart[node + 1] += childStart[node];
+    }
+    std::vector<uint32_t> children(childStart[count]);
+    std::vector<uint32_t> childFill(childStart.begin(), childStart.end() - 1);
+    for (uint32_t node = 0; node < count; node++) {
+        if (m_parentOfNode[node] != SCENE_GRAPH_NO_PARENT) children[childFill[m_parentOfNode[node]]++] = node;
+    }
+
+    // breadth first from the roots, so every level is contiguous and the children of a node follow each other
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    for (uint32_t node = 0; node < count; node++) {
+        if (m_parentOfNode[node] == SCENE_GRAPH_NO_PARENT) order.push_back(node);
+    }
+    m_firstChild.assign(count, 0);
+    m_childCount.assign(count, 0);
+    uint32_t levelCount = 0;
+    for (size_t levelBegin = 0; levelBegin < order.size(); levelCount++) {
+        const size_t levelEnd = order.size();
+        for (size_t slot = levelBegin; slot < levelEnd; slot++) {
+            const uint32_t node = order[slot];
+            m_firstChild[slot] = static_cast<uint32_t>(order.size());
+            m_childCount[slot] = childStart[node + 1] - childStart[node];
+            order.insert(order.end(), children.begin() + childStart[node], children.begin() + childStart[node + 1]);
+        }
+        levelBegin = levelEnd;
+    }
+
+    std::vector<glm::mat4> local(count);
+    for (uint32_t slot = 0; slot < count; slot++) {
+        local[slot] = m_local[m_slotOfNode[order[slot]]];
+    }
+    m_local = std::move(local);
+    for (uint32_t slot = 0; slot < count; slot++) {
+        m_slotOfNode[order[slot]] = slot;
+    }
+    m_parent.resize(count);
+    for (uint32_t slot = 0; slot < count; slot++) {
+        const uint32_t parent = m_parentOfNode[order[slot]];
+        m_parent[slot] = parent == SCENE_GRAPH_NO_PARENT ? SCENE_GRAPH_NO_PARENT : m_slotOfNode[parent];
+    }
+    m_nodeOfSlot = std::move(order);
+    m_world.resize(count);
+
+    // children are queued by their parents
+    m_isQueued.assign(count, 0);
+    m_dirtyLevels.assign(levelCount, {});
+    for (uint32_t slot = 0; slot < count && m_parent[slot] == SCENE_GRAPH_NO_PARENT; slot++) {
+        m_isQueued[slot] = 1;
+        m_dirtyLevels[0].push_back(slot);
+    }
+    m_isSortNeeded = false;
+}
+
+uint32_t SceneGraph::Update() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (m_isSortNeeded) SortNodes();
+
+    m_changedNodes.clear();
+    for (size_t level = 0; level < m_dirtyLevels.size(); level++) {
+        std::vector<uint32_t> &slots = m_dirtyLevels[level];
+        if (slots.empty()) continue;
+
+        // parents are in the previous level, which is already done
+        const uint32_t *queued = slots.data();
+        m_threadPool.ParallelFor(static_cast<uint32_t>(slots.size()), SCENE_GRAPH_MIN_CHUNK,
+                                 [&](uint32_t begin, uint32_t end) {
+                                     for (uint32_t i = begin; i < end; i++) {
+                                         const uint32_t slot = queued[i];
+                                         const uint32_t parent = m_parent[slot];
+                                         m_world[slot] = parent == SCENE_GRAPH_NO_PARENT
+                                                             ? m_local[slot]
+                                                             : m_world[parent] * m_local[slot];
+                                     }
+                                 });
+
+        // whole subtree of a changed node has to follow it, children queued by SetLocal are not queued twice
+        const bool hasNextLevel = level + 1 < m_dirtyLevels.size();
+        for (uint32_t slot: slots) {
+            m_isQueued[slot] = 0;
+            m_changedNodes.push_back(m_nodeOfSlot[slot]);
+            if (!hasNextLevel) continue;
+            for (uint32_t child = m_firstChild[slot]; child < m_firstChild[slot] + m_childCount[slot]; child++) {
+                if (m_isQueued[child]) continue;
+                m_isQueued[child] = 1;
+                m_dirtyLevels[level + 1].push_back(child);
+            }
+        }
+        slots.clear();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    m_totalMicroseconds += std::chrono::duration<double, std::micro>(end - start).count();
+    m_changedSum += m_changedNodes.size();
+    m_samples++;
+    return static_cast<uint32_t>(m_changedNodes.size());
+}
@@ -0,0 +1,90 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef SCENEGRAPH_HPP
+#define SCENEGRAPH_HPP
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Threading/ThreadPool.hpp"
+
+// parent of the root nodes
+constexpr uint32_t SCENE_GRAPH_NO_PARENT = UINT32_MAX;
+// smallest amount of nodes of one level a single thread gets, a matrix multiply is too cheap to split it more
+constexpr uint32_t SCENE_GRAPH_MIN_CHUNK = 4096;
+
+// Hierarchy of transforms kept as flat arrays sorted by the depth of the nodes, every level is contiguous and the
+// children of a node are next to each other in the next level. Changing the local transform of a node queues it
+// on its level, Update walks the levels from the roots and recomputes only the queued nodes and their subtrees,
+// so the cost grows with the amount of changes and not with the size of the scene.
+// Nodes are referenced by the index AddNode returned, it stays the same when the arrays are sorted again
+class SceneGraph {
+public:
+    explicit SceneGraph(ThreadPool &threadPool);
+
+    // parent has to be added before its children, returns the node
+    uint32_t AddNode(uint32_t parent, const glm::mat4 &local);
+    void SetLocal(uint32_t node, const glm::mat4 &local);
+    const glm::mat4 &GetLocal(uint32_t node) const {return m_local[m_slotOfNode[node]];}
+    // valid after Update
+    const glm::mat4 &GetWorld(uint32_t node) const {return m_world[m_slotOfNode[node]];}
+    void Clear();
+
+    // recomputes the world transforms of the changed subtrees, levels with many of them are split between the
+    // threads of the pool. Returns the amount of the recomputed nodes
+    uint32_t Update();
+
+    // nodes whose world transform was recomputed by the last Update, parents are before their children
+    const std::vector<uint32_t> &GetChangedNodes() const {return m_changedNodes;}
+
+    uint32_t GetNodeCount() const {return static_cast<uint32_t>(m_parentOfNode.size());}
+    uint32_t GetLevelCount() const {return static_cast<uint32_t>(m_dirtyLevels.size());}
+
+    bool HasResults() const {return m_samples > 0;}
+
+    double GetAverageMicroseconds() const {
+        return m_samples == 0 ? 0.0 : m_totalMicroseconds / static_cast<double>(m_samples);
+    }
+
+    double GetAverageChangedCount() const {
+        return m_samples == 0 ? 0.0 : static_cast<double>(m_changedSum) / static_cast<double>(m_samples);
+    }
+
+    void ResetStatistics() {m_totalMicroseconds = 0.0; m_changedSum = 0; m_samples = 0;}
+
+private:
+    // sorts the nodes by their depth again and queues the roots, so the next Update recomputes everything
+    void SortNodes();
+
+    ThreadPool &m_threadPool;
+
+    // per node
+    std::vector<uint32_t> m_parentOfNode;
+    std::vector<uint32_t> m_depthOfNode;
+    std::vector<uint32_t> m_slotOfNode;
+
+    // per slot, sorted by the depth
+    std::vector<glm::mat4> m_local;
+    std::vector<glm::mat4> m_world;
+    std::vector<uint32_t> m_parent;
+    std::vector<uint32_t> m_firstChild;
+    std::vector<uint32_t> m_childCount;
+    std::vector<uint32_t> m_nodeOfSlot;
+    // 1 if the slot is queued for the next Update
+    std::vector<uint8_t> m_isQueued;
+
+    // queued slots of every level
+    std::vector<std::vector<uint32_t>> m_dirtyLevels;
+    std::vector<uint32_t> m_changedNodes;
+    // nodes were added since the last sort
+    bool m_isSortNeeded = false;
+
+    double m_totalMicroseconds = 0.0;
+    uint64_t m_changedSum = 0;
+    uint64_t m_samples = 0;
+};
+
+
+#endif //SCENEGRAPH_HPP
@@ -0,0 +1,402 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "BarnesHut.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "Utils.hpp"
+
+// has to match Node in BarnesHut.comp (std430)
+struct BarnesHutNode {
+    glm::vec4 centerOfMass;
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    int32_t left;
+    int32_t right;
+    int32_t parent;
+    int32_t escape;
+};
+static_assert(sizeof(BarnesHutNode) == 64, "Barnes-Hut node has to match the std430 layout of the shader");
+
+BarnesHut::BarnesHut(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers, uint32_t particleCount) {
+    if (particleCount < 2) {
+        throw std::runtime_error("Barnes-Hut needs at least 2 particles to build the tree");
+    }
+
+    this->m_context = context;
+    this->m_particleCount = particleCount;
+    // bitonic sort works on power of two and the smallest block it sorts is 256 elements
+    this->m_paddedCount = std::max(256u, NextPowerOfTwo(particleCount));
+    this->m_bufferCount = static_cast<uint32_t>(particleBuffers.size());
+    this->m_particleBuffers = particleBuffers;
+
+    CreateBuffers();
+    CreateDescriptors(particleBuffers);
+    CreatePipelines();
+}
+
+void BarnesHut::CreateBuffers() {
+    const uint32_t nodeCount = 2 * m_particleCount - 1;
+    const std::array<VkDeviceSize, 6> sizes = {
+        sizeof(uint32_t) * m_paddedCount,
+        sizeof(uint32_t) * m_paddedCount,
+        sizeof(BarnesHutNode) * nodeCount,
+        sizeof(uint32_t) * m_particleCount,
+        sizeof(glm::vec4) * 2,
+        sizeof(glm::vec4) * m_particleCount,
+    };
+
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    for (size_t i = 0; i < m_buffers.size(); i++) {
+        bufferCreateInfo.size = sizes[i];
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        CreateBuffer(bufferCreateInfo, m_buffers[i], m_buffersMemory[i]);
+    }
+
+    //----------------------------
+    // READ BACK FOR VALIDATION
+    //----------------------------
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    bufferCreateInfo.size = sizeof(Particle) * m_particleCount;
+    CreateBuffer(bufferCreateInfo, m_readbackParticles, m_readbackParticlesMemory);
+
+    bufferCreateInfo.size = sizeof(glm::vec4) * m_particleCount;
+    CreateBuffer(bufferCreateInfo, m_readbackAccelerations, m_readbackAccelerationsMemory);
+}
+
+void BarnesHut::CreateDescriptors(const std::vector<VkBuffer> &particleBuffers) {
+    //---------------------------
+    // DESCRIPTOR SET LAYOUTS
+    //---------------------------
+    // particles in, particles out and the 6 buffers of the tree
+    std::vector<VkDescriptorSetLayoutBinding> bindings(2 + m_buffers.size());
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Barnes-Hut descriptor set layout");
+    }
+
+    // keys and values for the sort
+    layoutInfo.bindingCount = 2;
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_sortDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create sort descriptor set layout");
+    }
+
+    //-----------------
+    // DESCRIPTOR POOL
+    //-----------------
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = static_cast<uint32_t>(bindings.size()) * m_bufferCount + 2;
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = m_bufferCount + 1;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Barnes-Hut descriptor pool");
+    }
+
+    //-----------------
+    // DESCRIPTOR SETS
+    //-----------------
+    std::vector<VkDescriptorSetLayout> layouts(m_bufferCount, m_descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = m_bufferCount;
+    allocInfo.pSetLayouts = layouts.data();
+    m_descriptorSets.resize(m_bufferCount);
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate Barnes-Hut descriptor sets");
+    }
+
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_sortDescriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, &m_sortDescriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate sort descriptor set");
+    }
+
+    //-------------------
+    // DESCRIPTOR WRITES
+    //-------------------
+    for (uint32_t i = 0; i < m_bufferCount; i++) {
+        std::vector<VkDescriptorBufferInfo> bufferInfos(bindings.size());
+        // same ping pong as the rest of the simulation, previous buffer is read and this one written
+        bufferInfos[0] = {particleBuffers[(i + m_bufferCount - 1) % m_bufferCount], 0, VK_WHOLE_SIZE};
+        bufferInfos[1] = {particleBuffers[i], 0, VK_WHOLE_SIZE};
+        for (size_t b = 0; b < m_buffers.size(); b++) {
+            bufferInfos[2 + b] = {m_buffers[b], 0, VK_WHOLE_SIZE};
+        }
+
+        std::vector<VkWriteDescriptorSet> writes(bindings.size());
+        for (uint32_t b = 0; b < writes.size(); b++) {
+            writes[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            writes[b].dstSet = m_descriptorSets[i];
+            writes[b].dstBinding = b;
+            writes[b].descriptorCount = 1;
+            writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[b].pBufferInfo = &bufferInfos[b];
+        }
+        vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    std::array<VkDescriptorBufferInfo, 2> sortInfos = {{
+        {m_buffers[0], 0, VK_WHOLE_SIZE},
+        {m_buffers[1], 0, VK_WHOLE_SIZE},
+    }};
+    std::array<VkWriteDescriptorSet, 2> sortWrites{};
+    for (uint32_t b = 0; b < sortWrites.size(); b++) {
+        sortWrites[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        sortWrites[b].dstSet = m_sortDescriptorSet;
+        sortWrites[b].dstBinding = b;
+        sortWrites[b].descriptorCount = 1;
+        sortWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sortWrites[b].pBufferInfo = &sortInfos[b];
+    }
+    vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(sortWrites.size()), sortWrites.data(), 0, nullptr);
+}
+
+void BarnesHut::CreatePipelines() {
+    //------------------
+    // PIPELINE LAYOUTS
+    //------------------
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Barnes-Hut pipeline layout");
+    }
+
+    pushConstantRange.size = sizeof(SortPushConstants);
+    layoutInfo.pSetLayouts = &m_sortDescriptorSetLayout;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_sortPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create sort pipeline layout");
+    }
+
+    //-----------
+    // PIPELINES
+    //-----------
+    // every pass is the same shader specialized with different PASS constant
+    VkSpecializationMapEntry passEntry{};
+    passEntry.constantID = 0;
+    passEntry.offset = 0;
+    passEntry.size = sizeof(uint32_t);
+
+    for (uint32_t pass = 0; pass < PASS_COUNT; pass++) {
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &passEntry;
+        specializationInfo.dataSize = sizeof(uint32_t);
+        specializationInfo.pData = &pass;
+
+        m_pipelines[pass] = CreateComputePipelineFromFile(m_context.logicalDevice, "Shaders/Compiled/BarnesHut.spv",
+                                                          m_pipelineLayout, &specializationInfo);
+    }
+
+    m_sortPipeline = CreateComputePipelineFromFile(m_context.logicalDevice, "Shaders/Compiled/BitonicSort.spv",
+                                                   m_sortPipelineLayout);
+}
+
+void BarnesHut::RecordCommands(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t targetBuffer, GpuTimer &timer,
+                               float deltaTime, float gravity, float softening) {
+    m_pushConstants.particleCount = m_particleCount;
+    m_pushConstants.paddedCount = m_paddedCount;
+    m_pushConstants.theta = m_theta;
+    m_pushConstants.softening = softening;
+    m_pushConstants.gravity = gravity;
+    m_pushConstants.deltaTime = deltaTime;
+
+    const uint32_t particleGroups = (m_particleCount + 255) / 256;
+    const uint32_t nodeGroups = (2 * m_particleCount - 1 + 255) / 256;
+
+    // tree buffers are shared between the steps and the frames in flight, the previous step might still use them
+    InsertComputeBarrier(commandBuffer);
+
+    //------------
+    // TREE BUILD
+    //------------
+    timer.Begin(commandBuffer, frame, "BarnesHut::Build", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1,
+                            &m_descriptorSets[targetBuffer], 0, nullptr);
+    Dispatch(commandBuffer, PASS_BOUNDS, 1);
+    Dispatch(commandBuffer, PASS_MORTON_CODES, m_paddedCount / 256);
+
+    RecordSort(commandBuffer);
+
+    // sort pipeline has different layout, so the set has to be bound again
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1,
+                            &m_descriptorSets[targetBuffer], 0, nullptr);
+    Dispatch(commandBuffer, PASS_BUILD_TREE, particleGroups);
+    Dispatch(commandBuffer, PASS_SUMMARIZE, nodeGroups);
+
+    timer.End(commandBuffer, frame, "BarnesHut::Build", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    //------------
+    // TRAVERSAL
+    //------------
+    timer.Begin(commandBuffer, frame, "BarnesHut::Force", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    Dispatch(commandBuffer, PASS_FORCES, particleGroups);
+    timer.End(commandBuffer, frame, "BarnesHut::Force", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    m_lastTargetBuffer = static_cast<int>(targetBuffer);
+}
+
+void BarnesHut::Dispatch(VkCommandBuffer commandBuffer, PASS pass, uint32_t groupCount) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[pass]);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &m_pushConstants);
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+    // every pass consumes results of the previous one
+    InsertComputeBarrier(commandBuffer);
+}
+
+void BarnesHut::RecordSort(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_sortPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_sortPipelineLayout, 0, 1,
+                            &m_sortDescriptorSet, 0, nullptr);
+
+    const uint32_t groupCount = m_paddedCount / 256;
+    auto sortStep = [&](uint32_t k, uint32_t j) {
+        SortPushConstants sortConstants{m_paddedCount, k, j};
+        vkCmdPushConstants(commandBuffer, m_sortPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(SortPushConstants), &sortConstants);
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+        InsertComputeBarrier(commandBuffer);
+    };
+
+    // blocks of 256 are sorted in the shared memory first, then they are merged
+    // steps with the partner further than 256 elements go through the global memory one by one,
+    // the rest of the steps for the given k is done in the shared memory in one dispatch
+    sortStep(0, 0);
+    for (uint32_t k = 512; k <= m_paddedCount; k <<= 1) {
+        uint32_t j = k >> 1;
+        for (; j >= 256; j >>= 1) {
+            sortStep(k, j);
+        }
+        sortStep(k, j);
+    }
+}
+
+void BarnesHut::RecordReadback(VkCommandBuffer commandBuffer) {
+    if (m_lastTargetBuffer < 0) return;
+
+    const uint32_t inputBuffer = (m_lastTargetBuffer + m_bufferCount - 1) % m_bufferCount;
+
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+
+    CopyBuffer(m_context.logicalDevice, commandBuffer, m_particleBuffers[inputBuffer], m_readbackParticles,
+               sizeof(Particle) * m_particleCount);
+    CopyBuffer(m_context.logicalDevice, commandBuffer, m_buffers[5], m_readbackAccelerations,
+               sizeof(glm::vec4) * m_particleCount);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void BarnesHut::ReportErrorAgainstExact(float softening) {
+    if (m_lastTargetBuffer < 0) {
+        std::cout << "Barnes-Hut has not run yet, nothing to validate \n";
+        return;
+    }
+
+    std::vector<Particle> particles(m_particleCount);
+    std::vector<glm::vec4> accelerations(m_particleCount);
+
+    void *data;
+    vkMapMemory(m_context.logicalDevice, m_readbackParticlesMemory, 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(particles.data(), data, sizeof(Particle) * m_particleCount);
+    vkUnmapMemory(m_context.logicalDevice, m_readbackParticlesMemory);
+
+    vkMapMemory(m_context.logicalDevice, m_readbackAccelerationsMemory, 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(accelerations.data(), data, sizeof(glm::vec4) * m_particleCount);
+    vkUnmapMemory(m_context.logicalDevice, m_readbackAccelerationsMemory);
+
+    // exact sum in double precision for evenly spread subset of the particles
+    const uint32_t samples = std::min(BARNES_HUT_VALIDATION_SAMPLES, m_particleCount);
+    const uint32_t stride = m_particleCount / samples;
+    const double softeningSquared = static_cast<double>(softening) * softening;
+
+    double errorSquaredSum = 0.0;
+    double exactSquaredSum = 0.0;
+    double maxRelativeError = 0.0;
+    for (uint32_t s = 0; s < samples; s++) {
+        const uint32_t i = s * stride;
+        glm::dvec3 position(particles[i].position);
+        glm::dvec3 exact(0.0);
+        for (uint32_t j = 0; j < m_particleCount; j++) {
+            glm::dvec3 r = glm::dvec3(particles[j].position) - position;
+            double distanceSquared = glm::dot(r, r) + softeningSquared;
+            exact += r / (distanceSquared * std::sqrt(distanceSquared));
+        }
+
+        glm::dvec3 approximated = glm::dvec3(accelerations[i]);
+        double error = glm::length(approximated - exact);
+        double exactLength = glm::length(exact);
+
+        errorSquaredSum += error * error;
+        exactSquaredSum += exactLength * exactLength;
+        if (exactLength > 0.0) {
+            maxRelativeError = std::max(maxRelativeError, error / exactLength);
+        }
+    }
+
+    std::cout << "[Barnes-Hut] theta " << m_theta << ", " << samples << " of " << m_particleCount
+        << " particles against exact sum: relative RMS error " << std::sqrt(errorSquaredSum / exactSquaredSum)
+        << ", max relative error " << maxRelativeError << "\n";
+}
+
+BarnesHut::~BarnesHut() {
+    for (auto pipeline: m_pipelines) {
+        vkDestroyPipeline(m_context.logicalDevice, pipeline, nullptr);
+    }
+    vkDestroyPipeline(m_context.logicalDevice, m_sortPipeline, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_pipelineLayout, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_sortPipelineLayout, nullptr);
+
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_descriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_sortDescriptorSetLayout, nullptr);
+
+    for (size_t i = 0; i < m_buffers.size(); i++) {
+        vkDestroyBuffer(m_context.logicalDevice, m_buffers[i], nullptr);
+        vkFreeMemory(m_context.logicalDevice, m_buffersMemory[i], nullptr);
+    }
+
+    vkDestroyBuffer(m_context.logicalDevice, m_readbackParticles, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_readbackParticlesMemory, nullptr);
+    vkDestroyBuffer(m_context.logicalDevice, m_readbackAccelerations, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_readbackAccelerationsMemory, nullptr);
+}
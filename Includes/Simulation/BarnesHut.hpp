@@ -0,0 +1,107 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef BARNESHUT_HPP
+#define BARNESHUT_HPP
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Profiling/GpuTimer.hpp"
+
+// opening angle, cell is taken as one body once size / distance drops below it
+constexpr float BARNES_HUT_THETA = 0.5f;
+// how many particles are compared against the exact O(N^2) sum on the CPU
+constexpr uint32_t BARNES_HUT_VALIDATION_SAMPLES = 512;
+
+// GPU Barnes-Hut gravity, every step the tree is rebuilt from scratch:
+// bounds -> morton codes -> bitonic sort -> radix tree -> centre of mass (bottom up) -> stackless traversal
+// Reads and writes the same particle buffers as the other simulation modes, step that writes buffer i reads buffer i-1
+class BarnesHut {
+public:
+    BarnesHut(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers, uint32_t particleCount);
+
+    // records whole simulation step that writes particleBuffers[targetBuffer] in to the compute command buffer of the given frame,
+    // can be recorded several times in to the same command buffer
+    void RecordCommands(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t targetBuffer, GpuTimer &timer,
+                        float deltaTime, float gravity, float softening);
+
+    // copies input of the last recorded step and its accelerations in to the host visible memory
+    void RecordReadback(VkCommandBuffer commandBuffer);
+
+    // call once the command buffer with RecordReadback has finished executing
+    void ReportErrorAgainstExact(float softening);
+
+    void SetTheta(float theta) {m_theta = theta;}
+    float GetTheta() const {return m_theta;}
+
+    ~BarnesHut();
+
+private:
+    struct PushConstants {
+        uint32_t particleCount;
+        uint32_t paddedCount;
+        uint32_t sortK;
+        uint32_t sortJ;
+        float theta;
+        float softening;
+        float gravity;
+        float deltaTime;
+    };
+
+    struct SortPushConstants {
+        uint32_t count;
+        uint32_t k;
+        uint32_t j;
+    };
+
+    enum PASS {
+        PASS_BOUNDS = 0,
+        PASS_MORTON_CODES = 1,
+        PASS_BUILD_TREE = 2,
+        PASS_SUMMARIZE = 3,
+        PASS_FORCES = 4,
+        PASS_COUNT = 5,
+    };
+
+    void CreateBuffers();
+    void CreateDescriptors(const std::vector<VkBuffer> &particleBuffers);
+    void CreatePipelines();
+    void RecordSort(VkCommandBuffer commandBuffer);
+    void Dispatch(VkCommandBuffer commandBuffer, PASS pass, uint32_t groupCount);
+
+    DeviceContext m_context;
+    uint32_t m_particleCount;
+    uint32_t m_paddedCount;
+    uint32_t m_bufferCount;
+    float m_theta = BARNES_HUT_THETA;
+    PushConstants m_pushConstants{};
+    int m_lastTargetBuffer = -1;
+
+    // 0 - morton keys, 1 - sorted indices, 2 - nodes, 3 - visit counters, 4 - bounds, 5 - accelerations
+    std::array<VkBuffer, 6> m_buffers{};
+    std::array<VkDeviceMemory, 6> m_buffersMemory{};
+
+    VkBuffer m_readbackParticles = VK_NULL_HANDLE;
+    VkDeviceMemory m_readbackParticlesMemory = VK_NULL_HANDLE;
+    VkBuffer m_readbackAccelerations = VK_NULL_HANDLE;
+    VkDeviceMemory m_readbackAccelerationsMemory = VK_NULL_HANDLE;
+    std::vector<VkBuffer> m_particleBuffers;
+
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorSetLayout m_sortDescriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    std::vector<VkDescriptorSet> m_descriptorSets;
+    VkDescriptorSet m_sortDescriptorSet;
+
+    VkPipelineLayout m_pipelineLayout;
+    VkPipelineLayout m_sortPipelineLayout;
+    std::array<VkPipeline, PASS_COUNT> m_pipelines{};
+    VkPipeline m_sortPipeline;
+};
+
+
+#endif //BARNESHUT_HPP
@@ -0,0 +1,157 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "CpuSimulation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// the AVX2 path needs the target attribute and the builtins of GCC and Clang, other compilers take the scalar one
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CPU_SIMULATION_X86
+#endif
+
+//---------------------
+// INTEGRATION KERNELS
+//---------------------
+// position.xy += velocity.xy * deltaTime, z and velocity stay the same (same as Particles.comp)
+// multiply and add are kept separate on purpose, fused multiply add would round differently than the shader
+
+static void IntegrateScalar(float *positionX, float *positionY, const float *velocityX, const float *velocityY,
+                            float deltaTime, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+        float stepX = velocityX[i] * deltaTime;
+        float stepY = velocityY[i] * deltaTime;
+        positionX[i] = positionX[i] + stepX;
+        positionY[i] = positionY[i] + stepY;
+    }
+}
+
+#ifdef CPU_SIMULATION_X86
+// SSE2 is always there on x86-64
+static void IntegrateSse(float *positionX, float *positionY, const float *velocityX, const float *velocityY,
+                         float deltaTime, uint32_t begin, uint32_t end) {
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_add_ps(_mm_loadu_ps(positionX + i), _mm_mul_ps(_mm_loadu_ps(velocityX + i), dt));
+        __m128 y = _mm_add_ps(_mm_loadu_ps(positionY + i), _mm_mul_ps(_mm_loadu_ps(velocityY + i), dt));
+        _mm_storeu_ps(positionX + i, x);
+        _mm_storeu_ps(positionY + i, y);
+    }
+    IntegrateScalar(positionX, positionY, velocityX, velocityY, deltaTime, i, end);
+}
+
+// compiled for AVX2 only, called only when the CPU reports the support
+__attribute__((target("avx2")))
+static void IntegrateAvx2(float *positionX, float *positionY, const float *velocityX, const float *velocityY,
+                          float deltaTime, uint32_t begin, uint32_t end) {
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(positionX + i), _mm256_mul_ps(_mm256_loadu_ps(velocityX + i), dt));
+        __m256 y = _mm256_add_ps(_mm256_loadu_ps(positionY + i), _mm256_mul_ps(_mm256_loadu_ps(velocityY + i), dt));
+        _mm256_storeu_ps(positionX + i, x);
+        _mm256_storeu_ps(positionY + i, y);
+    }
+    IntegrateScalar(positionX, positionY, velocityX, velocityY, deltaTime, i, end);
+}
+#endif
+
+CpuSimulation::CpuSimulation(const std::vector<Particle> &particles, ThreadPool &threadPool) : m_threadPool(threadPool) {
+#ifdef CPU_SIMULATION_X86
+    m_hasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+    LoadParticles(particles);
+}
+
+void CpuSimulation::LoadParticles(const std::vector<Particle> &particles) {
+    const size_t count = particles.size();
+    m_positionX.resize(count);
+    m_positionY.resize(count);
+    m_positionZ.resize(count);
+    m_velocityX.resize(count);
+    m_velocityY.resize(count);
+    m_velocityZ.resize(count);
+    m_colors.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        m_positionX[i] = particles[i].position.x;
+        m_positionY[i] = particles[i].position.y;
+        m_positionZ[i] = particles[i].position.z;
+        m_velocityX[i] = particles[i].velocity.x;
+        m_velocityY[i] = particles[i].velocity.y;
+        m_velocityZ[i] = particles[i].velocity.z;
+        m_colors[i] = particles[i].color;
+    }
+}
+
+void CpuSimulation::Step(float deltaTime) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    float *positionX = m_positionX.data();
+    float *positionY = m_positionY.data();
+    const float *velocityX = m_velocityX.data();
+    const float *velocityY = m_velocityY.data();
+    const bool hasAvx2 = m_hasAvx2;
+
+    m_threadPool.ParallelFor(GetParticleCount(), CPU_SIMULATION_MIN_CHUNK, [&](uint32_t begin, uint32_t end) {
+#ifdef CPU_SIMULATION_X86
+        if (hasAvx2) {
+            IntegrateAvx2(positionX, positionY, velocityX, velocityY, deltaTime, begin, end);
+        }
+        else {
+            IntegrateSse(positionX, positionY, velocityX, velocityY, deltaTime, begin, end);
+        }
+#else
+        IntegrateScalar(positionX, positionY, velocityX, velocityY, deltaTime, begin, end);
+#endif
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    m_totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+    m_samples++;
+}
+
+void CpuSimulation::WriteParticles(Particle *destination) const {
+    m_threadPool.ParallelFor(GetParticleCount(), CPU_SIMULATION_MIN_CHUNK, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            destination[i].position = glm::vec3(m_positionX[i], m_positionY[i], m_positionZ[i]);
+            destination[i].velocity = glm::vec3(m_velocityX[i], m_velocityY[i], m_velocityZ[i]);
+            destination[i].color = m_colors[i];
+        }
+    });
+}
+
+CpuComparisonResult CpuSimulation::Compare(const std::vector<Particle> &particles) const {
+    CpuComparisonResult result{};
+    const uint32_t count = std::min(GetParticleCount(), static_cast<uint32_t>(particles.size()));
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 position(m_positionX[i], m_positionY[i], m_positionZ[i]);
+        glm::vec3 velocity(m_velocityX[i], m_velocityY[i], m_velocityZ[i]);
+
+        // exact comparison, the point is to see if both sides do the very same arithmetic
+        if (position != particles[i].position || velocity != particles[i].velocity) {
+            result.mismatchedParticles++;
+        }
+
+        glm::vec3 positionDifference = glm::abs(position - particles[i].position);
+        glm::vec3 velocityDifference = glm::abs(velocity - particles[i].velocity);
+        result.maxPositionDifference = std::max(result.maxPositionDifference,
+            std::max(positionDifference.x, std::max(positionDifference.y, positionDifference.z)));
+        result.maxVelocityDifference = std::max(result.maxVelocityDifference,
+            std::max(velocityDifference.x, std::max(velocityDifference.y, velocityDifference.z)));
+    }
+    return result;
+}
+
+const char *CpuSimulation::GetInstructionSet() const {
+#ifdef CPU_SIMULATION_X86
+    return m_hasAvx2 ? "AVX2" : "SSE2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,64 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef CPUSIMULATION_HPP
+#define CPUSIMULATION_HPP
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+#include "Threading/ThreadPool.hpp"
+
+// smallest amount of particles a single thread gets, smaller chunks cost more in synchronization than they save
+constexpr uint32_t CPU_SIMULATION_MIN_CHUNK = 4096;
+
+struct CpuComparisonResult {
+    uint32_t mismatchedParticles = 0;
+    float maxPositionDifference = 0.0f;
+    float maxVelocityDifference = 0.0f;
+};
+
+// CPU version of Particles.comp. Particles are kept as structure of arrays so that 4 (SSE) or 8 (AVX2)
+// of them are integrated with one instruction, the array is split between the threads of the pool.
+// Every step does the same multiply and add with the same rounding as the shader, so the results match bit for bit
+class CpuSimulation {
+public:
+    CpuSimulation(const std::vector<Particle> &particles, ThreadPool &threadPool);
+
+    // overwrites the state, used to continue from where the GPU simulation is
+    void LoadParticles(const std::vector<Particle> &particles);
+
+    void Step(float deltaTime);
+
+    // converts the state back to the layout of the SSBO, destination has to have room for all particles
+    void WriteParticles(Particle *destination) const;
+
+    CpuComparisonResult Compare(const std::vector<Particle> &particles) const;
+
+    const char *GetInstructionSet() const;
+
+    uint32_t GetParticleCount() const {return static_cast<uint32_t>(m_positionX.size());}
+
+    uint32_t GetThreadCount() const {return m_threadPool.GetThreadCount();}
+
+    bool HasResults() const {return m_samples > 0;}
+
+    double GetAverageMs() const {return m_samples == 0 ? 0.0 : m_totalMs / static_cast<double>(m_samples);}
+
+    void ResetStatistics() {m_totalMs = 0.0; m_samples = 0;}
+
+private:
+    ThreadPool &m_threadPool;
+    bool m_hasAvx2 = false;
+
+    std::vector<float> m_positionX, m_positionY, m_positionZ;
+    std::vector<float> m_velocityX, m_velocityY, m_velocityZ;
+    std::vector<glm::vec4> m_colors;
+
+    double m_totalMs = 0.0;
+    uint64_t m_samples = 0;
+};
+
+
+#endif //CPUSIMULATION_HPP
@@ -0,0 +1,523 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "MeshCollider.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <glm/gtc/packing.hpp>
+
+#include "Utils.hpp"
+
+MeshCollider::MeshCollider(const DeviceContext &context, VkQueue queue, VkCommandPool commandPool,
+                           const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+                           uint32_t resolution, const std::string &cachePath) {
+    if (indices.size() < 3) {
+        throw std::runtime_error("Mesh collider needs at least one triangle");
+    }
+
+    this->m_context = context;
+    this->m_resolution = resolution;
+
+    // field is a cube, so the voxels are cubes as well
+    glm::vec3 meshMin(std::numeric_limits<float>::max());
+    glm::vec3 meshMax(std::numeric_limits<float>::lowest());
+    std::vector<glm::vec4> corners(indices.size() - indices.size() % 3);
+    for (size_t i = 0; i < corners.size(); i++) {
+        corners[i] = glm::vec4(vertices[indices[i]].pos, 1.0f);
+        meshMin = glm::min(meshMin, vertices[indices[i]].pos);
+        meshMax = glm::max(meshMax, vertices[indices[i]].pos);
+    }
+    const glm::vec3 center = (meshMin + meshMax) * 0.5f;
+    const float halfSize = glm::max(meshMax.x - meshMin.x, glm::max(meshMax.y - meshMin.y, meshMax.z - meshMin.z)) *
+        (0.5f + MESH_DISTANCE_FIELD_MARGIN);
+    m_boundsMin = center - glm::vec3(halfSize);
+    m_boundsMax = center + glm::vec3(halfSize);
+
+    // cached field of a different mesh or resolution is baked again and overwritten
+    const uint64_t meshHash = HashMesh(vertices, indices);
+
+    std::vector<float> distances;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (LoadCache(cachePath, meshHash, distances)) {
+        std::cout << "[Collider] distance field loaded from " << cachePath << "\n";
+    }
+    else {
+        distances = Bake(queue, commandPool, corners);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "[Collider] " << resolution << "^3 distance field of " << corners.size() / 3
+            << " triangles baked in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+        SaveCache(cachePath, meshHash, distances);
+    }
+
+    CreateImage(queue, commandPool, distances);
+}
+
+uint64_t MeshCollider::HashMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto hashBytes = [&hash](const void *data, size_t size) {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+        }
+    };
+
+    // only the positions shape the surface, normals and uvs can change without changing the field
+    for (uint32_t index: indices) {
+        const glm::vec3 &position = vertices[index].pos;
+        hashBytes(&position.x, sizeof(float));
+        hashBytes(&position.y, sizeof(float));
+        hashBytes(&position.z, sizeof(float));
+    }
+    return hash;
+}
+
+//------------------
+// CACHE
+//------------------
+bool MeshCollider::LoadCache(const std::string &cachePath, uint64_t meshHash, std::vector<float> &distances) {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    MeshDistanceFieldHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || header.magic != MESH_DISTANCE_FIELD_MAGIC || header.version != MESH_DISTANCE_FIELD_VERSION ||
+        header.meshHash != meshHash || header.resolution != m_resolution) {
+        return false;
+    }
+
+    distances.resize(static_cast<size_t>(m_resolution) * m_resolution * m_resolution);
+    file.read(reinterpret_cast<char *>(distances.data()), static_cast<std::streamsize>(distances.size() * sizeof(float)));
+    if (!file) return false;
+
+    m_boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    m_boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    return true;
+}
+
+void MeshCollider::SaveCache(const std::string &cachePath, uint64_t meshHash, const std::vector<float> &distances) const {
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write the distance field cache " << cachePath << " \n";
+        return;
+    }
+
+    MeshDistanceFieldHeader header{};
+    header.magic = MESH_DISTANCE_FIELD_MAGIC;
+    header.version = MESH_DISTANCE_FIELD_VERSION;
+    header.meshHash = meshHash;
+    header.resolution = m_resolution;
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = m_boundsMin[i];
+        header.boundsMax[i] = m_boundsMax[i];
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(distances.data()),
+               static_cast<std::streamsize>(distances.size() * sizeof(float)));
+}
+
+//------------------
+// BAKE
+//------------------
+std::vector<glm::vec4> MeshCollider::ComputePseudonormals(const std::vector<glm::vec4> &corners) {
+    // has to match the features in MeshDistanceField.comp
+    constexpr uint32_t FEATURE_COUNT = 7;
+    constexpr uint32_t FEATURE_FACE = 0;
+    constexpr uint32_t FEATURE_VERTEX = 1;
+    constexpr uint32_t FEATURE_EDGE = 4;
+    const size_t triangleCount = corners.size() / 3;
+
+    // corners of the seams are separate vertices of the mesh but the same point of the surface
+    std::map<std::tuple<float, float, float>, uint32_t> positionIds;
+    std::vector<uint32_t> cornerPositions(corners.size());
+    for (size_t i = 0; i < corners.size(); i++) {
+        auto key = std::make_tuple(corners[i].x, corners[i].y, corners[i].z);
+        cornerPositions[i] = positionIds.emplace(key, static_cast<uint32_t>(positionIds.size())).first->second;
+    }
+
+    // vertex normal is weighted by the angle of every triangle at the vertex, edge normal by nothing
+    std::vector<glm::vec3> faceNormals(triangleCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> vertexNormals(positionIds.size(), glm::vec3(0.0f));
+    std::unordered_map<uint64_t, glm::vec3> edgeNormals;
+    auto edgeKey = [](uint32_t a, uint32_t b) {
+        return static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+    };
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        const glm::vec3 normal = glm::cross(glm::vec3(corners[3 * triangle + 1] - corners[3 * triangle]),
+                                            glm::vec3(corners[3 * triangle + 2] - corners[3 * triangle]));
+        if (glm::length(normal) == 0.0f) continue;
+        faceNormals[triangle] = glm::normalize(normal);
+
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            const glm::vec3 position = glm::vec3(corners[3 * triangle + corner]);
+            const glm::vec3 next = glm::vec3(corners[3 * triangle + (corner + 1) % 3]) - position;
+            const glm::vec3 previous = glm::vec3(corners[3 * triangle + (corner + 2) % 3]) - position;
+            const float angle = std::acos(glm::clamp(glm::dot(glm::normalize(next), glm::normalize(previous)),
+                                                     -1.0f, 1.0f));
+            vertexNormals[cornerPositions[3 * triangle + corner]] += angle * faceNormals[triangle];
+            edgeNormals[edgeKey(cornerPositions[3 * triangle + corner],
+                                cornerPositions[3 * triangle + (corner + 1) % 3])] += faceNormals[triangle];
+        }
+    }
+
+    // only the direction decides the sign, the normals are left as they were summed
+    std::vector<glm::vec4> normals(triangleCount * FEATURE_COUNT);
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        glm::vec4 *features = &normals[triangle * FEATURE_COUNT];
+        features[FEATURE_FACE] = glm::vec4(faceNormals[triangle], 0.0f);
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            const uint32_t position = cornerPositions[3 * triangle + corner];
+            const uint32_t nextPosition = cornerPositions[3 * triangle + (corner + 1) % 3];
+            features[FEATURE_VERTEX + corner] = glm::vec4(vertexNormals[position], 0.0f);
+            // edges go AB, BC, CA
+            features[FEATURE_EDGE + corner] = glm::vec4(edgeNormals[edgeKey(position, nextPosition)], 0.0f);
+        }
+    }
+    return normals;
+}
+
+std::vector<float> MeshCollider::Bake(VkQueue queue, VkCommandPool commandPool, const std::vector<glm::vec4> &corners) {
+    const uint32_t voxelCount = m_resolution * m_resolution * m_resolution;
+    const uint32_t triangleCount = static_cast<uint32_t>(corners.size() / 3);
+
+    //----------
+    // BUFFERS
+    //----------
+    // 0 - triangle corners, 1 and 2 - seeds, 3 - distances, 4 - pseudonormals.
+    // Corners and normals are written and the distances read by the CPU once, so they stay in the host visible memory
+    const std::vector<glm::vec4> normals = ComputePseudonormals(corners);
+    std::array<VkBuffer, 5> buffers{};
+    std::array<VkDeviceMemory, 5> buffersMemory{};
+    const std::array<VkDeviceSize, 5> sizes = {
+        sizeof(glm::vec4) * corners.size(),
+        sizeof(uint32_t) * voxelCount,
+        sizeof(uint32_t) * voxelCount,
+        sizeof(float) * voxelCount,
+        sizeof(glm::vec4) * normals.size(),
+    };
+
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        const bool isHostVisible = i == 0 || i == 3 || i == 4;
+        bufferCreateInfo.size = sizes[i];
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferCreateInfo.properties = isHostVisible
+                                          ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                          : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        CreateBuffer(bufferCreateInfo, buffers[i], buffersMemory[i]);
+    }
+
+    void *data;
+    vkMapMemory(m_context.logicalDevice, buffersMemory[0], 0, sizes[0], 0, &data);
+    memcpy(data, corners.data(), static_cast<size_t>(sizes[0]));
+    vkUnmapMemory(m_context.logicalDevice, buffersMemory[0]);
+    vkMapMemory(m_context.logicalDevice, buffersMemory[4], 0, sizes[4], 0, &data);
+    memcpy(data, normals.data(), static_cast<size_t>(sizes[4]));
+    vkUnmapMemory(m_context.logicalDevice, buffersMemory[4]);
+
+    //--------------
+    // DESCRIPTORS
+    //--------------
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create distance field descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = static_cast<uint32_t>(bindings.size());
+
+    VkDescriptorPool descriptorPool;
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create distance field descriptor pool");
+    }
+
+    VkDescriptorSet descriptorSet;
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate distance field descriptor set");
+    }
+
+    std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+    std::array<VkWriteDescriptorSet, 5> writes{};
+    for (uint32_t b = 0; b < writes.size(); b++) {
+        bufferInfos[b] = {buffers[b], 0, VK_WHOLE_SIZE};
+        writes[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[b].dstSet = descriptorSet;
+        writes[b].dstBinding = b;
+        writes[b].descriptorCount = 1;
+        writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[b].pBufferInfo = &bufferInfos[b];
+    }
+    vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    //-------------
+    // PIPELINES
+    //-------------
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayout pipelineLayout;
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create distance field pipeline layout");
+    }
+
+    // every pass is the same shader specialized with different PASS constant
+    VkSpecializationMapEntry passEntry{};
+    passEntry.constantID = 0;
+    passEntry.offset = 0;
+    passEntry.size = sizeof(uint32_t);
+
+    std::array<VkPipeline, PASS_COUNT> pipelines{};
+    for (uint32_t pass = 0; pass < PASS_COUNT; pass++) {
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &passEntry;
+        specializationInfo.dataSize = sizeof(uint32_t);
+        specializationInfo.pData = &pass;
+
+        pipelines[pass] = CreateComputePipelineFromFile(m_context.logicalDevice,
+                                                        "Shaders/Compiled/MeshDistanceField.spv", pipelineLayout,
+                                                        &specializationInfo);
+    }
+
+    //-------------
+    // RECORDING
+    //-------------
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_context.logicalDevice, commandPool);
+
+    // no voxel has a seed yet
+    vkCmdFillBuffer(commandBuffer, buffers[1], 0, VK_WHOLE_SIZE, 0xFFFFFFFF);
+    VkMemoryBarrier fillBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &fillBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet,
+                            0, nullptr);
+
+    PushConstants pushConstants{};
+    pushConstants.boundsMin = m_boundsMin;
+    pushConstants.voxelSize = (m_boundsMax.x - m_boundsMin.x) / static_cast<float>(m_resolution);
+    pushConstants.resolution = m_resolution;
+    pushConstants.triangleCount = triangleCount;
+    pushConstants.readFromB = 0;
+
+    auto dispatch = [&](PASS pass, uint32_t invocationCount) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[pass]);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                           &pushConstants);
+        vkCmdDispatch(commandBuffer, (invocationCount + 63) / 64, 1, 1);
+        // every pass consumes results of the previous one
+        InsertComputeBarrier(commandBuffer);
+    };
+
+    dispatch(PASS_SEED, triangleCount);
+
+    // steps N/2, N/4 ... 1 and one more pass of 1, which fixes most of the voxels the halving got wrong
+    for (uint32_t step = NextPowerOfTwo(m_resolution) / 2; step >= 1; step /= 2) {
+        pushConstants.step = step;
+        dispatch(PASS_FLOOD, voxelCount);
+        pushConstants.readFromB = 1 - pushConstants.readFromB;
+    }
+    pushConstants.step = 1;
+    dispatch(PASS_FLOOD, voxelCount);
+    pushConstants.readFromB = 1 - pushConstants.readFromB;
+
+    dispatch(PASS_DISTANCE, voxelCount);
+
+    VkMemoryBarrier hostBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+    EndSingleTimeCommand(m_context.logicalDevice, commandPool, commandBuffer, queue);
+
+    std::vector<float> distances(voxelCount);
+    vkMapMemory(m_context.logicalDevice, buffersMemory[3], 0, sizes[3], 0, &data);
+    memcpy(distances.data(), data, static_cast<size_t>(sizes[3]));
+    vkUnmapMemory(m_context.logicalDevice, buffersMemory[3]);
+
+    // nothing of the bake is needed once the distances are on the CPU
+    for (VkPipeline pipeline: pipelines) {
+        vkDestroyPipeline(m_context.logicalDevice, pipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(m_context.logicalDevice, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_context.logicalDevice, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, descriptorSetLayout, nullptr);
+    for (size_t i = 0; i < buffers.size(); i++) {
+        vkDestroyBuffer(m_context.logicalDevice, buffers[i], nullptr);
+        vkFreeMemory(m_context.logicalDevice, buffersMemory[i], nullptr);
+    }
+
+    return distances;
+}
+
+//------------------
+// 3D TEXTURE
+//------------------
+void MeshCollider::CreateImage(VkQueue queue, VkCommandPool commandPool, const std::vector<float> &distances) {
+    // linear filtering of 32 bit floats is optional, of the half floats it is not
+    std::vector<uint16_t> halfDistances(distances.size());
+    for (size_t i = 0; i < distances.size(); i++) {
+        halfDistances[i] = glm::packHalf1x16(distances[i]);
+    }
+    const VkDeviceSize size = sizeof(uint16_t) * halfDistances.size();
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    CreateBuffer(bufferCreateInfo, stagingBuffer, stagingBufferMemory);
+
+    void *data;
+    vkMapMemory(m_context.logicalDevice, stagingBufferMemory, 0, size, 0, &data);
+    memcpy(data, halfDistances.data(), static_cast<size_t>(size));
+    vkUnmapMemory(m_context.logicalDevice, stagingBufferMemory);
+
+    //---------
+    // IMAGE
+    //---------
+    VkImageCreateInfo imageInfo{.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    imageInfo.imageType = VK_IMAGE_TYPE_3D;
+    imageInfo.format = VK_FORMAT_R16_SFLOAT;
+    imageInfo.extent = {m_resolution, m_resolution, m_resolution};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(m_context.logicalDevice, &imageInfo, nullptr, &m_image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create distance field image");
+    }
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(m_context.logicalDevice, m_image, &memoryRequirements);
+    VkMemoryAllocateInfo memoryInfo{.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    memoryInfo.allocationSize = memoryRequirements.size;
+    memoryInfo.memoryTypeIndex = FindMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                m_context.physicalDevice);
+    if (vkAllocateMemory(m_context.logicalDevice, &memoryInfo, nullptr, &m_imageMemory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate distance field memory");
+    }
+    vkBindImageMemory(m_context.logicalDevice, m_image, m_imageMemory, 0);
+
+    //----------
+    // UPLOAD
+    //----------
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_context.logicalDevice, commandPool);
+
+    VkImageMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {m_resolution, m_resolution, m_resolution};
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // sampled only by the simulation
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    EndSingleTimeCommand(m_context.logicalDevice, commandPool, commandBuffer, queue);
+
+    vkDestroyBuffer(m_context.logicalDevice, stagingBuffer, nullptr);
+    vkFreeMemory(m_context.logicalDevice, stagingBufferMemory, nullptr);
+
+    //------------------
+    // VIEW AND SAMPLER
+    //------------------
+    VkImageViewCreateInfo viewInfo{.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    viewInfo.image = m_image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+    viewInfo.format = VK_FORMAT_R16_SFLOAT;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (vkCreateImageView(m_context.logicalDevice, &viewInfo, nullptr, &m_imageView) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create distance field image view");
+    }
+
+    // trilinear interpolation of the distances, the field stays continuous between the voxels
+    VkSamplerCreateInfo samplerInfo{.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(m_context.logicalDevice, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create distance field sampler");
+    }
+}
+
+VkDescriptorImageInfo MeshCollider::GetDescriptorInfo() const {
+    return {m_sampler, m_imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+}
+
+MeshCollider::~MeshCollider() {
+    vkDestroySampler(m_context.logicalDevice, m_sampler, nullptr);
+    vkDestroyImageView(m_context.logicalDevice, m_imageView, nullptr);
+    vkDestroyImage(m_context.logicalDevice, m_image, nullptr);
+    vkFreeMemory(m_context.logicalDevice, m_imageMemory, nullptr);
+}
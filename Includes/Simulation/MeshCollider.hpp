@@ -0,0 +1,93 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef MESHCOLLIDER_HPP
+#define MESHCOLLIDER_HPP
+#include <array>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+constexpr uint32_t MESH_DISTANCE_FIELD_MAGIC = 0x46445353; // "SSDF"
+constexpr uint32_t MESH_DISTANCE_FIELD_VERSION = 2;
+// empty space around the mesh, as a fraction of its size, so the particles see the surface before they reach it
+constexpr float MESH_DISTANCE_FIELD_MARGIN = 0.1f;
+
+// start of the cached distance field, followed by resolution^3 floats
+struct MeshDistanceFieldHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t meshHash;
+    uint32_t resolution;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// Signed distance field of a triangle mesh in a 3D texture, the simulation samples it for the collisions.
+// MeshDistanceField.comp bakes it with jump flooding: triangles seed the voxels they pass through and every flood
+// pass halves the distance the voxels look for a closer triangle, so the bake is log2(resolution) passes over the
+// voxels instead of testing every triangle in every voxel. Baked field is stored in the cache file under the hash
+// of the mesh and the resolution, so it is baked only once per mesh (delete the file to bake again)
+class MeshCollider {
+public:
+    // the queue and pool are used only while the field is baked or uploaded, before the constructor returns
+    MeshCollider(const DeviceContext &context, VkQueue queue, VkCommandPool commandPool,
+                 const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, uint32_t resolution,
+                 const std::string &cachePath);
+
+    // FNV-1a of the positions of the indexed triangles, the same mesh loaded again hashes the same
+    static uint64_t HashMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+
+    // sampler and view of the field in the shader read only layout, distances are in the space of the mesh
+    VkDescriptorImageInfo GetDescriptorInfo() const;
+    // box the field covers, in the space of the mesh
+    glm::vec3 GetBoundsMin() const {return m_boundsMin;}
+    glm::vec3 GetBoundsMax() const {return m_boundsMax;}
+    uint32_t GetResolution() const {return m_resolution;}
+
+    ~MeshCollider();
+
+private:
+    // has to match BakeParameters in MeshDistanceField.comp
+    struct PushConstants {
+        glm::vec3 boundsMin;
+        float voxelSize;
+        uint32_t resolution;
+        uint32_t triangleCount;
+        uint32_t step;
+        uint32_t readFromB;
+    };
+
+    enum PASS {
+        PASS_SEED = 0,
+        PASS_FLOOD = 1,
+        PASS_DISTANCE = 2,
+        PASS_COUNT = 3,
+    };
+
+    bool LoadCache(const std::string &cachePath, uint64_t meshHash, std::vector<float> &distances);
+    void SaveCache(const std::string &cachePath, uint64_t meshHash, const std::vector<float> &distances) const;
+    // angle weighted pseudonormals of the face, the 3 vertices and the 3 edges of every triangle, in the order
+    // of the features in MeshDistanceField.comp. Triangles are joined by the positions of their corners
+    static std::vector<glm::vec4> ComputePseudonormals(const std::vector<glm::vec4> &corners);
+    // runs the bake on the GPU and reads the distances back
+    std::vector<float> Bake(VkQueue queue, VkCommandPool commandPool, const std::vector<glm::vec4> &corners);
+    void CreateImage(VkQueue queue, VkCommandPool commandPool, const std::vector<float> &distances);
+
+    DeviceContext m_context;
+    uint32_t m_resolution;
+    glm::vec3 m_boundsMin;
+    glm::vec3 m_boundsMax;
+
+    VkImage m_image;
+    VkDeviceMemory m_imageMemory;
+    VkImageView m_imageView;
+    VkSampler m_sampler;
+};
+
+
+#endif //MESHCOLLIDER_HPP
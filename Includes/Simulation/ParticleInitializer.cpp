@@ -0,0 +1,244 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ParticleInitializer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "Utils.hpp"
+
+ParticleInitializer::ParticleInitializer(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers,
+                                         uint32_t particleCount) {
+    if (particleBuffers.size() != 2) {
+        throw std::runtime_error("Particle initializer writes exactly 2 particle buffers");
+    }
+
+    this->m_context = context;
+    this->m_particleCount = particleCount;
+
+    CreateDescriptors(particleBuffers);
+    // single degenerate triangle, so the mesh bindings are valid before any mesh is set
+    CreateMeshBuffers(std::vector<glm::vec4>(3, glm::vec4(0.0f)), {1.0f});
+    CreatePipeline();
+}
+
+void ParticleInitializer::CreateDescriptors(const std::vector<VkBuffer> &particleBuffers) {
+    //------------------------
+    // DESCRIPTOR SET LAYOUT
+    //------------------------
+    // 2 particle buffers, triangle corners and the running sum of the areas
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle init descriptor set layout");
+    }
+
+    //-----------------
+    // DESCRIPTOR POOL
+    //-----------------
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = static_cast<uint32_t>(bindings.size());
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(m_context.logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle init descriptor pool");
+    }
+
+    //-----------------
+    // DESCRIPTOR SET
+    //-----------------
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_context.logicalDevice, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate particle init descriptor set");
+    }
+
+    // mesh bindings are written together with the mesh buffers
+    std::array<VkDescriptorBufferInfo, 2> bufferInfos = {{
+        {particleBuffers[0], 0, VK_WHOLE_SIZE},
+        {particleBuffers[1], 0, VK_WHOLE_SIZE},
+    }};
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    for (uint32_t b = 0; b < writes.size(); b++) {
+        writes[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[b].dstSet = m_descriptorSet;
+        writes[b].dstBinding = b;
+        writes[b].descriptorCount = 1;
+        writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[b].pBufferInfo = &bufferInfos[b];
+    }
+    vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void ParticleInitializer::CreatePipeline() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_context.logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle init pipeline layout");
+    }
+
+    m_pipeline = CreateComputePipelineFromFile(m_context.logicalDevice, "Shaders/Compiled/ParticleInit.spv",
+                                               m_pipelineLayout);
+}
+
+void ParticleInitializer::SetMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+                                  float radius) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        throw std::runtime_error("Mesh for the particle initialization has no triangles");
+    }
+
+    // centre of the bounding box goes to the origin and the furthest vertex to the radius
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (uint32_t index: indices) {
+        boundsMin = glm::min(boundsMin, vertices[index].pos);
+        boundsMax = glm::max(boundsMax, vertices[index].pos);
+    }
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float extent = 0.0f;
+    for (uint32_t index: indices) {
+        extent = std::max(extent, glm::length(vertices[index].pos - center));
+    }
+    const float scale = extent > 0.0f ? radius / extent : 1.0f;
+
+    std::vector<glm::vec4> corners(triangleCount * 3);
+    std::vector<float> cumulativeAreas(triangleCount);
+    float totalArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (size_t c = 0; c < 3; c++) {
+            corners[3 * t + c] = glm::vec4((vertices[indices[3 * t + c]].pos - center) * scale, 1.0f);
+        }
+        glm::vec3 ab = glm::vec3(corners[3 * t + 1] - corners[3 * t]);
+        glm::vec3 ac = glm::vec3(corners[3 * t + 2] - corners[3 * t]);
+        totalArea += 0.5f * glm::length(glm::cross(ab, ac));
+        cumulativeAreas[t] = totalArea;
+    }
+    if (totalArea <= 0.0f) {
+        throw std::runtime_error("Mesh for the particle initialization has no surface");
+    }
+    for (float &area: cumulativeAreas) {
+        area /= totalArea;
+    }
+    // rounding must not leave the last triangle out of the search
+    cumulativeAreas.back() = 1.0f;
+
+    DestroyMeshBuffers();
+    CreateMeshBuffers(corners, cumulativeAreas);
+    m_hasMesh = true;
+}
+
+void ParticleInitializer::CreateMeshBuffers(const std::vector<glm::vec4> &corners,
+                                            const std::vector<float> &cumulativeAreas) {
+    // only read once per initialization, so they stay in the host visible memory
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_context.physicalDevice;
+    bufferCreateInfo.logicalDevice = m_context.logicalDevice;
+    bufferCreateInfo.surface = m_context.surface;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    const std::array<const void *, 2> sources = {corners.data(), cumulativeAreas.data()};
+    const std::array<VkDeviceSize, 2> sizes = {
+        sizeof(glm::vec4) * corners.size(),
+        sizeof(float) * cumulativeAreas.size(),
+    };
+
+    for (size_t i = 0; i < m_meshBuffers.size(); i++) {
+        bufferCreateInfo.size = sizes[i];
+        CreateBuffer(bufferCreateInfo, m_meshBuffers[i], m_meshBuffersMemory[i]);
+
+        void *data;
+        vkMapMemory(m_context.logicalDevice, m_meshBuffersMemory[i], 0, sizes[i], 0, &data);
+        memcpy(data, sources[i], static_cast<size_t>(sizes[i]));
+        vkUnmapMemory(m_context.logicalDevice, m_meshBuffersMemory[i]);
+    }
+    m_triangleCount = static_cast<uint32_t>(cumulativeAreas.size());
+
+    std::array<VkDescriptorBufferInfo, 2> bufferInfos = {{
+        {m_meshBuffers[0], 0, VK_WHOLE_SIZE},
+        {m_meshBuffers[1], 0, VK_WHOLE_SIZE},
+    }};
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    for (uint32_t b = 0; b < writes.size(); b++) {
+        writes[b] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[b].dstSet = m_descriptorSet;
+        writes[b].dstBinding = 2 + b;
+        writes[b].descriptorCount = 1;
+        writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[b].pBufferInfo = &bufferInfos[b];
+    }
+    vkUpdateDescriptorSets(m_context.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void ParticleInitializer::RecordCommands(VkCommandBuffer commandBuffer, PARTICLE_DISTRIBUTION distribution,
+                                         uint32_t seed, float radius, float speed) {
+    PushConstants pushConstants{};
+    pushConstants.particleCount = m_particleCount;
+    pushConstants.seed = seed;
+    pushConstants.distribution = static_cast<uint32_t>(distribution);
+    pushConstants.triangleCount = m_triangleCount;
+    pushConstants.radius = radius;
+    pushConstants.speed = speed;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1,
+                            &m_descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, (m_particleCount + 255) / 256, 1, 1);
+
+    // particles are read by the simulation, copied by the CPU simulation and drawn as vertices
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT |
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ParticleInitializer::DestroyMeshBuffers() {
+    for (size_t i = 0; i < m_meshBuffers.size(); i++) {
+        vkDestroyBuffer(m_context.logicalDevice, m_meshBuffers[i], nullptr);
+        vkFreeMemory(m_context.logicalDevice, m_meshBuffersMemory[i], nullptr);
+        m_meshBuffers[i] = VK_NULL_HANDLE;
+        m_meshBuffersMemory[i] = VK_NULL_HANDLE;
+    }
+}
+
+ParticleInitializer::~ParticleInitializer() {
+    vkDestroyPipeline(m_context.logicalDevice, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_context.logicalDevice, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_context.logicalDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_context.logicalDevice, m_descriptorSetLayout, nullptr);
+    DestroyMeshBuffers();
+}
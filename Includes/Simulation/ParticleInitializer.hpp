@@ -0,0 +1,65 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef PARTICLEINITIALIZER_HPP
+#define PARTICLEINITIALIZER_HPP
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "Structs.hpp"
+
+// Generates the initial particles on the GPU with ParticleInit.comp, one dispatch writes every particle
+// in to both particle buffers, so nothing is generated on the CPU and nothing goes through a staging buffer
+class ParticleInitializer {
+public:
+    // particleBuffers has to hold exactly 2 buffers, the previous and the latest state
+    ParticleInitializer(const DeviceContext &context, const std::vector<VkBuffer> &particleBuffers, uint32_t particleCount);
+
+    // surface used by PARTICLE_DISTRIBUTION_MESH_SURFACE, the mesh is centred and scaled to fit in the radius.
+    // Buffers are replaced, so nothing recorded with the previous mesh can be executing
+    void SetMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, float radius);
+
+    bool HasMesh() const {return m_hasMesh;}
+
+    void RecordCommands(VkCommandBuffer commandBuffer, PARTICLE_DISTRIBUTION distribution, uint32_t seed, float radius,
+                        float speed);
+
+    ~ParticleInitializer();
+
+private:
+    // has to match InitParameters in ParticleInit.comp
+    struct PushConstants {
+        uint32_t particleCount;
+        uint32_t seed;
+        uint32_t distribution;
+        uint32_t triangleCount;
+        float radius;
+        float speed;
+    };
+
+    void CreateDescriptors(const std::vector<VkBuffer> &particleBuffers);
+    void CreatePipeline();
+    void CreateMeshBuffers(const std::vector<glm::vec4> &corners, const std::vector<float> &cumulativeAreas);
+    void DestroyMeshBuffers();
+
+    DeviceContext m_context;
+    uint32_t m_particleCount;
+    uint32_t m_triangleCount = 0;
+    bool m_hasMesh = false;
+
+    // 0 - triangle corners, 1 - running sum of the areas
+    std::array<VkBuffer, 2> m_meshBuffers{};
+    std::array<VkDeviceMemory, 2> m_meshBuffersMemory{};
+
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    VkDescriptorSet m_descriptorSet;
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+};
+
+
+#endif //PARTICLEINITIALIZER_HPP
@@ -1,3 +1,10 @@
+#ifndef STRUCTS_HPP
+#define STRUCTS_HPP
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #define GLM_ENABLE_EXPERIMENTAL
@@ -14,6 +21,13 @@ struct BufferCreateInfo {
 };
 
 
+// handles that sub systems creating their own Vulkan resources need
+struct DeviceContext {
+    VkPhysicalDevice physicalDevice;
+    VkSurfaceKHR surface;
+    VkDevice logicalDevice;
+};
+
 enum APPLICATION_STATUS {
     IDLE = 0,
     RUNNING = 1,
@@ -129,20 +143,33 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// constants of the view, written once per frame, per draw data (model matrix) is in the push constants
 struct UniformBufferObject {
     alignas(16)glm::vec3 camPos;
     alignas(16)glm::vec3 lightPos;
-    alignas(16)glm::mat4 model;
     alignas(16)glm::mat4 view;
     alignas(16)glm::mat4 projection;
-    alignas(16)glm::mat4 normal;
 };
 
-    struct alignas(16) UBOComputeShader {
-        float deltaTime = 1.0f;
-        float padding = 0.0f;
-        glm::vec3 MouseWorldSpace = glm::vec3(0.0f);
-    };
+// has to match std140 layout of ParameterUBO in the compute shaders
+struct alignas(16) UBOComputeShader {
+    float deltaTime = 1.0f;
+    float padding = 0.0f;
+    alignas(16) glm::vec3 MouseWorldSpace = glm::vec3(0.0f);
+    uint32_t particleCount = 0;
+    float gravity = 0.0f;
+    float softening = 0.0f;
+    // mesh the particles collide with, particle position = colliderCenter + colliderScale * mesh position
+    alignas(16) glm::vec3 colliderCenter = glm::vec3(0.0f);
+    float colliderScale = 1.0f;
+    // box of the distance field in the space of the mesh
+    alignas(16) glm::vec3 distanceFieldMin = glm::vec3(0.0f);
+    uint32_t isCollisionEnabled = 0;
+    alignas(16) glm::vec3 distanceFieldMax = glm::vec3(0.0f);
+    float collisionRadius = 0.0f;
+    // part of the velocity into the surface that bounces back
+    float collisionRestitution = 0.0f;
+};
 
 struct ImageCreateInfo {
     VkPhysicalDevice physicalDevice;
@@ -166,6 +193,80 @@ struct ImageLayoutDependencyInfo {
     VkQueue transformQueue;
 };
 
+enum PARTICLE_SIMULATION_MODE {
+    PARTICLE_SIMULATION_INTEGRATE = 0,
+    PARTICLE_SIMULATION_NBODY_TILED = 1,
+    PARTICLE_SIMULATION_BARNES_HUT = 2,
+    PARTICLE_SIMULATION_CPU = 3,
+    PARTICLE_SIMULATION_REPLAY = 4,
+};
+
+// has to match the DISTRIBUTION constants in ParticleInit.comp
+enum PARTICLE_DISTRIBUTION {
+    PARTICLE_DISTRIBUTION_SPHERE = 0,
+    PARTICLE_DISTRIBUTION_DISK = 1,
+    PARTICLE_DISTRIBUTION_MESH_SURFACE = 2,
+    PARTICLE_DISTRIBUTION_COUNT = 3,
+};
+
+enum PARTICLE_RENDER_MODE {
+    PARTICLE_RENDER_POINTS = 0,
+    PARTICLE_RENDER_BILLBOARDS = 1,
+    PARTICLE_RENDER_MESHES = 2,
+    PARTICLE_RENDER_MODE_COUNT = 3,
+};
+
+// how billboards and meshes are blended, points are always opaque
+enum PARTICLE_TRANSPARENCY_MODE {
+    PARTICLE_TRANSPARENCY_OPAQUE = 0,
+    // alpha blending of the particles sorted from the farthest to the closest one on the GPU
+    PARTICLE_TRANSPARENCY_SORTED = 1,
+    // weighted blended order independent transparency, unsorted accumulation and full screen composite
+    PARTICLE_TRANSPARENCY_WEIGHTED = 2,
+    PARTICLE_TRANSPARENCY_MODE_COUNT = 3,
+};
+
+// size of the target the particles are drawn in to, reduced ones are upsampled in to the swap chain resolution.
+// Divisor of the resolution is 1 << mode
+enum PARTICLE_RESOLUTION {
+    PARTICLE_RESOLUTION_FULL = 0,
+    PARTICLE_RESOLUTION_HALF = 1,
+    PARTICLE_RESOLUTION_QUARTER = 2,
+    PARTICLE_RESOLUTION_COUNT = 3,
+};
+
+// subpasses of the main render pass
+enum RENDER_SUBPASS {
+    // opaque geometry and the sorted transparency
+    SUBPASS_OPAQUE = 0,
+    // weighted blended transparency writes the accumulation and revealage attachments
+    SUBPASS_TRANSPARENCY_ACCUMULATE = 1,
+    // accumulation is composited on top of the opaque colour, which is then resolved
+    SUBPASS_TRANSPARENCY_COMPOSITE = 2,
+    SUBPASS_COUNT = 3,
+};
+
+// has to match RenderParameters in ParticleVertex.vert, ParticleBillboardVertex.vert and ParticleMeshVertex.vert
+struct ParticleRenderPushConstants {
+    // scale is uniform, so its upper 3x3 turns the normals as well
+    glm::mat4 model;
+    float particleSize;
+    float stretchFactor;
+    float maxStretch;
+    // 0 draws the previous simulation state, 1 the latest one
+    float interpolation;
+    // particle under the mouse, drawn larger and white
+    uint32_t highlightedParticle;
+    // alpha of the transparent particles
+    float opacity;
+    // instance i draws particle drawOrder[i] instead of particle i
+    uint32_t useDrawOrder;
+    // 1 / divisor of the target the particles are drawn in to, sizes in pixels are scaled by it
+    float resolutionScale;
+    // size of the material table, mesh particles cycle through it
+    uint32_t materialCount;
+};
+
 enum GEOMETRY_TYPE {
     PLANE = 0,
     CUBE = 1,
@@ -173,10 +274,11 @@ enum GEOMETRY_TYPE {
     MODEL = 3,
 };
 
+// members are aligned the same way std140 aligns vec3 so that shaders and vertex input read the same offsets
 struct alignas(16) Particle {
-    glm::vec3 position;
-    glm::vec3 velocity;
-    glm::vec4 color;
+    alignas(16) glm::vec3 position;
+    alignas(16) glm::vec3 velocity;
+    alignas(16) glm::vec4 color;
 
     static VkVertexInputBindingDescription getBindingDescription() {
         VkVertexInputBindingDescription bindingDescription{};
@@ -224,4 +326,4 @@ namespace std {
     };
 }
 
-
+#endif //STRUCTS_HPP
@@ -0,0 +1,86 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // calling thread takes part in the work as well
+    for (uint32_t i = 0; i + 1 < threadCount; i++) {
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+void ThreadPool::ParallelFor(uint32_t count, uint32_t minChunkSize,
+                             const std::function<void(uint32_t begin, uint32_t end)> &task) {
+    if (count == 0) return;
+
+    minChunkSize = std::max(1u, minChunkSize);
+    uint32_t chunkCount = std::min(GetThreadCount(), (count + minChunkSize - 1) / minChunkSize);
+    uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    if (chunkCount == 1) {
+        task(0, count);
+        return;
+    }
+
+    // every chunk except of the first one goes to the workers
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    uint32_t remaining = chunkCount - 1;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (uint32_t chunk = 1; chunk < chunkCount; chunk++) {
+            uint32_t begin = chunk * chunkSize;
+            uint32_t end = std::min(count, begin + chunkSize);
+            m_tasks.emplace([&, begin, end]() {
+                if (begin < end) {
+                    task(begin, end);
+                }
+                std::lock_guard<std::mutex> doneLock(doneMutex);
+                if (--remaining == 0) {
+                    doneCondition.notify_one();
+                }
+            });
+        }
+    }
+    m_condition.notify_all();
+
+    task(0, std::min(count, chunkSize));
+
+    std::unique_lock<std::mutex> doneLock(doneMutex);
+    doneCondition.wait(doneLock, [&]() { return remaining == 0; });
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_isStopping || !m_tasks.empty(); });
+            if (m_isStopping && m_tasks.empty()) return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+    for (auto &worker: m_workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,42 @@
+//
+// Created by wpsimon09 on 19/10/26.
+//
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed amount of worker threads that are created once and sleep while there is no work.
+// ParallelFor splits a range in to one chunk per thread, the calling thread works on the first chunk
+// and returns once every chunk is done
+class ThreadPool {
+public:
+    // 0 uses every hardware thread
+    explicit ThreadPool(uint32_t threadCount = 0);
+
+    // task is called with [begin, end) ranges, chunks are never smaller than minChunkSize (except of the last one)
+    void ParallelFor(uint32_t count, uint32_t minChunkSize, const std::function<void(uint32_t begin, uint32_t end)> &task);
+
+    // workers and the calling thread
+    uint32_t GetThreadCount() const {return static_cast<uint32_t>(m_workers.size()) + 1;}
+
+    ~ThreadPool();
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_isStopping = false;
+};
+
+
+#endif //THREADPOOL_HPP
@@ -525,6 +525,60 @@ static inline void GenerateSphere(std::vector<Vertex> &vertices, std::vector<uin
 
 }
 
+static inline VkPipeline CreateComputePipelineFromFile(VkDevice logicalDevice, const std::string &shaderPath, VkPipelineLayout layout, const VkSpecializationInfo *specializationInfo = nullptr) {
+    auto shaderCode = readFile(shaderPath);
+    VkShaderModule shaderModule = createShaderModuel(logicalDevice, shaderCode);
+
+    VkPipelineShaderStageCreateInfo stageInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stageInfo.module = shaderModule;
+    stageInfo.pName = "main";
+    stageInfo.pSpecializationInfo = specializationInfo;
+
+    VkComputePipelineCreateInfo pipelineInfo{.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipelineInfo.layout = layout;
+    pipelineInfo.stage = stageInfo;
+
+    VkPipeline pipeline;
+    if(vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute pipeline from: " + shaderPath);
+    }
+
+    vkDestroyShaderModule(logicalDevice, shaderModule, nullptr);
+    return pipeline;
+}
+
+// makes writes of previous compute dispatches visible to the next ones (also across submissions to the same queue)
+static inline void InsertComputeBarrier(VkCommandBuffer commandBuffer) {
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+
+// reductions over the particles (picking, statistics) use subgroupMin/Max/Add in the compute shaders
+static inline bool SupportsComputeSubgroupArithmetic(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceSubgroupProperties subgroupProperties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    properties.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+        (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT);
+}
+
+static inline uint32_t NextPowerOfTwo(uint32_t value) {
+    uint32_t result = 1;
+    while(result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
 inline static bool HasStencilComponent(VkFormat format) {
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
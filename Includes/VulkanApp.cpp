@@ -4,8 +4,12 @@
 
 #include "VulkanApp.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <emmintrin.h>
+#include <limits>
 #include <random>
 #include <thread>
 #include <unistd.h>
@@ -71,23 +75,25 @@ void VulkanApp::InitVulkan()
         CreateImageViews();
         CreateColorResources();
         CreateDepthResources();
+        CreateTransparencyResources();
         CreateRenderPass();
         //GenerateGeometryVertices(MODEL);
         CreateDescriptorSetLayout();
         CreateGraphicsPipeline();
-        CreateComputePipeline();
         CreateFrameBuffers();
         CreateCommandPool();
-        //CreateTextureImage();
-
-        //CreateTextureImageView();
-        //CreateTextureSampler();
         //CreateVertexBuffers();
+        CreateMeshBuffers();
+        CreateMaterials();
         CreateShaderStorageBuffer();
+        CreateSimulationBackends();
         //CreateIndexBuffers();
         CreateUniformBuffers();
-        CreateDescriptorPool();
+        CreateDescriptorAllocators();
         CreateDescriptorSet();
+        CreateScene();
+        // kernels are tuned on the real particles, so everything they read has to exist
+        CreateComputePipeline();
         CreateCommandBuffers();
         CreateSyncObjects();
 }
@@ -196,6 +202,11 @@ void VulkanApp::MainLoop()
         double currentTime = glfwGetTime();
         m_lastTimeFrame = (currentTime - m_lastTime) * 1000;
         m_lastTime = currentTime;
+        if (currentTime - m_lastBenchmarkReport >= BENCHMARK_REPORT_INTERVAL)
+        {
+            ReportBenchmark();
+            m_lastBenchmarkReport = currentTime;
+        }
         m_appNotifier.NotifyChange();
         glfwPollEvents();
     }
@@ -208,7 +219,13 @@ void VulkanApp::DrawFrame()
     // COMPUTE SUBMISSION
     //-------------------
     vkWaitForFences(m_device, 1, &m_computeFences[currentFrame], VK_TRUE, UINT64_MAX);
-    UpdateUniformBuffer(currentFrame);
+    //queries of this frame are finished now, so reading them will not stall
+    m_computeTimer->CollectResults(currentFrame);
+    m_recorder->CollectCompleted(currentFrame);
+    m_picker->CollectResults(currentFrame);
+    m_telemetry->CollectResults(currentFrame);
+    m_simulationSteps = AdvanceSimulationClock();
+    UpdateSimulationUniforms();
     vkResetFences(m_device, 1, &m_computeFences[currentFrame]);
     vkResetCommandBuffer(m_computeCommandBuffers[currentFrame], 0);
     RecordComputeCommandBuffer(m_computeCommandBuffers[currentFrame]);
@@ -231,6 +248,12 @@ void VulkanApp::DrawFrame()
     //-------------------
     // wait for previous frame to finish drawind
     vkWaitForFences(m_device, 1, &m_inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    m_graphicsTimer->CollectResults(currentFrame);
+    m_gpuDrivenRenderer->CollectResults(currentFrame);
+    // nothing the frame has drawn with is in flight anymore
+    m_frameDescriptorAllocators[currentFrame]->Reset();
+    m_descriptorFrameCount++;
+    m_renderStatistics->CollectResults(currentFrame);
 
     //get image from swap chain to draw into
     uint32_t imageIndex;
@@ -250,7 +273,12 @@ void VulkanApp::DrawFrame()
     //reset fences after we are sure that we can continue rendering
     vkResetFences(m_device, 1, &m_inFlightFences[currentFrame]);
 
-    UpdateUniformBuffer(currentFrame);
+    UpdateFrameUniforms();
+    AnimateScene();
+    if (m_isCpuCullingEnabled && m_frustumCuller->GetObjectCount() > 0)
+    {
+        m_frustumCuller->Cull(m_camera->getPojectionMatix(), m_camera->getViewMatrix());
+    }
 
     //clear the command buffer so that it can record new information
     //here is acctual draw command and pipeline binding, scissors and viewport configuratio
@@ -304,6 +332,431 @@ void VulkanApp::DrawFrame()
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+uint32_t VulkanApp::AdvanceSimulationClock()
+{
+    m_simulationAccumulator += m_lastTimeFrame / 1000.0;
+
+    uint32_t steps = static_cast<uint32_t>(m_simulationAccumulator / SIMULATION_STEP_SECONDS);
+    if (steps > SIMULATION_MAX_STEPS_PER_FRAME)
+    {
+        // time that can not be caught up with is dropped, otherwise every slow frame would make the next one slower
+        steps = SIMULATION_MAX_STEPS_PER_FRAME;
+        m_simulationAccumulator = 0.0;
+    }
+    else
+    {
+        m_simulationAccumulator -= steps * SIMULATION_STEP_SECONDS;
+    }
+
+    m_totalSimulationSteps += steps;
+    m_simulatedFrames++;
+    return steps;
+}
+
+void VulkanApp::ReportBenchmark()
+{
+    std::cout << "[Benchmark] " << m_physicalDeviceName << "\n";
+
+    if (m_simulatedFrames > 0)
+    {
+        std::cout << "\t Simulation: " << static_cast<double>(m_totalSimulationSteps) / m_simulatedFrames
+            << " steps/frame, " << SIMULATION_STEP_SECONDS * 1000.0 << " ms per step\n";
+    }
+
+    if (m_computeTimer->HasResults("Simulation::Integrate"))
+    {
+        std::cout << "\t Integrate (" << PARTICLE_COUNT << " particles): "
+            << m_computeTimer->GetAverageMs("Simulation::Integrate") << " ms\n";
+    }
+
+    if (m_computeTimer->HasResults("Simulation::NBodyTiled"))
+    {
+        // every body interacts with every body, including itself
+        double milliseconds = m_computeTimer->GetAverageMs("Simulation::NBodyTiled");
+        double interactions = static_cast<double>(PARTICLE_COUNT) * static_cast<double>(PARTICLE_COUNT);
+        std::cout << "\t N-body tiled (" << PARTICLE_COUNT << " bodies, tile " << m_nbodyWorkGroupSize << ", unroll "
+            << m_nbodyUnrollFactor << "): "
+            << milliseconds << " ms, " << interactions / (milliseconds * 1e-3) * 1e-9 << " G interactions/s\n";
+    }
+
+    if (m_computeTimer->HasResults("BarnesHut::Build") && m_computeTimer->HasResults("BarnesHut::Force"))
+    {
+        // tree is rebuilt every step so both parts have to be counted in to the cost of the step
+        std::cout << "\t Barnes-Hut (" << PARTICLE_COUNT << " bodies, theta " << m_barnesHut->GetTheta() << "): build "
+            << m_computeTimer->GetAverageMs("BarnesHut::Build") << " ms, force "
+            << m_computeTimer->GetAverageMs("BarnesHut::Force") << " ms\n";
+    }
+
+    if (m_cpuSimulation->HasResults())
+    {
+        double milliseconds = m_cpuSimulation->GetAverageMs();
+        double particlesPerSecond = PARTICLE_COUNT / (milliseconds * 1e-3);
+        std::cout << "\t CPU integrate (" << m_cpuSimulation->GetInstructionSet() << ", "
+            << m_cpuSimulation->GetThreadCount() << " threads): " << milliseconds << " ms, "
+            << particlesPerSecond / m_cpuSimulation->GetThreadCount() * 1e-6 << " M particles/s per core\n";
+    }
+
+    if (m_telemetry->HasStatistics())
+    {
+        // reduced on the GPU, only the small result is read back
+        const ParticleTelemetry::Statistics &statistics = m_telemetry->GetStatistics();
+        std::cout << "\t Particles: " << statistics.aliveCount << "/" << PARTICLE_COUNT << " alive, bounds ("
+            << statistics.boundsMin.x << ", " << statistics.boundsMin.y << ", " << statistics.boundsMin.z << ") - ("
+            << statistics.boundsMax.x << ", " << statistics.boundsMax.y << ", " << statistics.boundsMax.z
+            << "), speed mean " << m_telemetry->GetMeanSpeed() << " max " << statistics.maxSpeed
+            << ", kinetic energy " << statistics.kineticEnergy;
+        if (m_computeTimer->HasResults("Telemetry"))
+        {
+            std::cout << ", " << m_computeTimer->GetAverageMs("Telemetry") << " ms GPU reduction";
+        }
+        std::cout << "\n";
+    }
+
+    if (m_recorder->IsRecording())
+    {
+        // compression ratio is raw state size over what ended up in the file
+        double ratio = m_recorder->GetWrittenBytes() == 0
+                           ? 0.0
+                           : static_cast<double>(m_recorder->GetRawBytes()) / m_recorder->GetWrittenBytes();
+        std::cout << "\t Recording: " << m_recorder->GetCapturedCount() << " captures ("
+            << m_recorder->GetDroppedCount() << " dropped), " << m_recorder->GetWrittenBytes() * 1e-6 << " MB written, "
+            << m_recorder->GetSustainedMBps() << " MB/s sustained, compression " << ratio << "x, "
+            << m_recorder->GetAverageOverheadMs() << " ms/frame on the render thread";
+        if (m_computeTimer->HasResults("Recording::Copy"))
+        {
+            std::cout << ", " << m_computeTimer->GetAverageMs("Recording::Copy") << " ms GPU copy";
+        }
+        std::cout << "\n";
+        m_recorder->ResetOverhead();
+    }
+
+    if (m_descriptorFrameCount > 0)
+    {
+        // transient sets are allocated and written every frame, the persistent ones only when something is rebuilt
+        uint64_t allocations = m_descriptorAllocator->GetAllocationCount();
+        uint32_t poolCount = m_descriptorAllocator->GetPoolCount();
+        uint32_t createdPools = m_descriptorAllocator->GetCreatedPoolCount();
+        m_descriptorAllocator->ResetStatistics();
+        for (auto& allocator : m_frameDescriptorAllocators)
+        {
+            allocations += allocator->GetAllocationCount();
+            poolCount += allocator->GetPoolCount();
+            createdPools += allocator->GetCreatedPoolCount();
+            allocator->ResetStatistics();
+        }
+        const uint64_t updates = m_particleDrawTemplate->GetUpdateCount() + m_simulationTemplate->GetUpdateCount() +
+            m_transparencyTemplate->GetUpdateCount() + m_cameraTemplate->GetUpdateCount();
+        m_particleDrawTemplate->ResetStatistics();
+        m_simulationTemplate->ResetStatistics();
+        m_transparencyTemplate->ResetStatistics();
+        m_cameraTemplate->ResetStatistics();
+
+        const double frames = static_cast<double>(m_descriptorFrameCount);
+        std::cout << "\t Descriptors: " << allocations / frames << " sets allocated/frame, " << updates / frames
+            << " template updates/frame, " << poolCount << " pools (" << createdPools << " new), "
+            << m_descriptorLayoutCache->GetLayoutCount() << " set layouts (" << m_descriptorLayoutCache->GetHitCount()
+            << " cache hits)\n";
+
+        std::cout << "\t Uniforms: " << m_uniformAllocator->GetAllocationCount() / frames << " allocations/frame, "
+            << m_uniformAllocator->GetPeakUsage() << " of " << m_uniformAllocator->GetRegionSize()
+            << " bytes per region at peak\n";
+        m_uniformAllocator->ResetStatistics();
+        m_descriptorFrameCount = 0;
+    }
+
+    std::vector<std::string> renderScopes;
+    for (const char *resolutionSuffix : RESOLUTION_SCOPE_SUFFIXES)
+    {
+        renderScopes.emplace_back(std::string("Render::Points") + resolutionSuffix);
+        for (const std::string base : {"Render::Billboards", "Render::Meshes"})
+        {
+            for (const char *suffix : TRANSPARENCY_SCOPE_SUFFIXES)
+            {
+                renderScopes.emplace_back(base + suffix + resolutionSuffix);
+            }
+        }
+    }
+
+    for (const std::string &scope : renderScopes)
+    {
+        if (!m_graphicsTimer->HasResults(scope)) continue;
+
+        double milliseconds = m_graphicsTimer->GetAverageMs(scope);
+        std::cout << "\t " << scope << " (" << m_drawnParticleCount << " particles): " << milliseconds << " ms, "
+            << m_drawnParticleCount / (milliseconds * 1e-3) * 1e-6 << " M particles/s";
+        if (scope.rfind("Render::Meshes", 0) == 0)
+        {
+            double triangles = static_cast<double>(m_drawnParticleCount) * (indices.size() / 3);
+            std::cout << ", " << triangles / (milliseconds * 1e-3) * 1e-9 << " G triangles/s";
+        }
+
+        // fragments per particle shows how much of the cost is the fill rate
+        if (m_renderStatistics->HasResults(scope))
+        {
+            auto counters = m_renderStatistics->GetAverage(scope);
+            std::cout << ", " << counters.fragmentInvocations / m_drawnParticleCount << " fragments/particle, "
+                << counters.fragmentInvocations / (milliseconds * 1e-3) * 1e-9 << " G fragments/s";
+        }
+        std::cout << "\n";
+
+        // reduced resolution saves fill rate but pays for the full screen upsample
+        const bool isReduced = scope.find(RESOLUTION_SCOPE_SUFFIXES[PARTICLE_RESOLUTION_HALF]) != std::string::npos ||
+            scope.find(RESOLUTION_SCOPE_SUFFIXES[PARTICLE_RESOLUTION_QUARTER]) != std::string::npos;
+        if (isReduced && m_graphicsTimer->HasResults("Render::Upsample"))
+        {
+            double upsampleMs = m_graphicsTimer->GetAverageMs("Render::Upsample");
+            std::cout << "\t Reduced resolution: " << milliseconds << " ms draw + " << upsampleMs
+                << " ms upsample = " << milliseconds + upsampleMs << " ms\n";
+        }
+
+        // whole cost of the transparency, sorting runs in the compute and the composite after the draw
+        if (scope.find(TRANSPARENCY_SCOPE_SUFFIXES[PARTICLE_TRANSPARENCY_SORTED]) != std::string::npos &&
+            m_computeTimer->HasResults("Sorting"))
+        {
+            double sortMs = m_computeTimer->GetAverageMs("Sorting");
+            std::cout << "\t Transparency sorted: " << sortMs << " ms sort + " << milliseconds << " ms blend = "
+                << sortMs + milliseconds << " ms\n";
+        }
+        if (scope.find(TRANSPARENCY_SCOPE_SUFFIXES[PARTICLE_TRANSPARENCY_WEIGHTED]) != std::string::npos &&
+            m_graphicsTimer->HasResults("Render::Composite"))
+        {
+            double compositeMs = m_graphicsTimer->GetAverageMs("Render::Composite");
+            std::cout << "\t Transparency weighted: " << milliseconds << " ms accumulate + " << compositeMs
+                << " ms composite = " << milliseconds + compositeMs << " ms\n";
+        }
+    }
+
+    // one draw per mesh no matter how many instances, only the instances the scene graph changed are uploaded
+    if (m_sceneInstanceCount > 0 && m_graphicsTimer->HasResults("Render::Instances"))
+    {
+        const double milliseconds = m_graphicsTimer->GetAverageMs("Render::Instances");
+        const double frames = static_cast<double>(std::max<uint64_t>(m_instancedRenderer->GetUploadCount(), 1));
+        double triangles = 0.0;
+        for (uint32_t batch : m_sceneBatches)
+        {
+            triangles += static_cast<double>(m_instancedRenderer->GetInstanceCount(batch)) *
+                (m_meshPool->GetMesh(batch).indexCount / 3);
+        }
+        std::cout << "\t Render::Instances (" << m_sceneInstanceCount << " instances, "
+            << m_instancedRenderer->GetDrawCount() / frames << " draws/frame): " << milliseconds << " ms, "
+            << m_sceneInstanceCount / (milliseconds * 1e-3) * 1e-6 << " M instances/s, "
+            << triangles / (milliseconds * 1e-3) * 1e-9 << " G triangles/s, "
+            << m_instancedRenderer->GetUploadedBytes() / frames / 1024.0 << " KB/frame uploaded of "
+            << m_instancedRenderer->GetInstanceBufferSize() / 1024 << " KB\n";
+    }
+    m_instancedRenderer->ResetStatistics();
+
+    // recomputed nodes are the spinning instances and the row that moves with its instances, no matter the count
+    if (m_sceneInstanceCount > 0 && m_sceneGraph->HasResults())
+    {
+        std::cout << "\t Scene graph (" << m_sceneGraph->GetNodeCount() << " nodes, " << m_sceneGraph->GetLevelCount()
+            << " levels): " << m_sceneGraph->GetAverageChangedCount() << " nodes/frame recomputed in "
+            << m_sceneGraph->GetAverageMicroseconds() << " us\n";
+    }
+    m_sceneGraph->ResetStatistics();
+
+    // whole cost of the GPU driven objects, the culling runs over all of them and only the visible ones are drawn,
+    // with the occlusion culling it is both of the passes and the build of the pyramid
+    const uint32_t objectCount = m_gpuDrivenRenderer->GetObjectCount();
+    const std::vector<std::string> gpuSceneScopes = m_isOcclusionCullingEnabled
+        ? std::vector<std::string>{"Cull::Early", "Render::GpuDriven", "HiZ::Build", "Cull::Late",
+                                   "Render::GpuDriven::Late"}
+        : std::vector<std::string>{"Cull::Objects", "Render::GpuDriven"};
+    const bool hasGpuSceneResults = std::all_of(gpuSceneScopes.begin(), gpuSceneScopes.end(),
+                                                [this](const std::string &scope)
+                                                {
+                                                    return m_graphicsTimer->HasResults(scope);
+                                                });
+    if (objectCount > 0 && m_gpuSceneRecordedFrames > 0 && hasGpuSceneResults)
+    {
+        double cullMs = m_graphicsTimer->GetAverageMs(gpuSceneScopes[0]);
+        double drawMs = m_graphicsTimer->GetAverageMs("Render::GpuDriven");
+        double hiZMs = 0.0;
+        if (m_isOcclusionCullingEnabled)
+        {
+            cullMs += m_graphicsTimer->GetAverageMs("Cull::Late");
+            drawMs += m_graphicsTimer->GetAverageMs("Render::GpuDriven::Late");
+            hiZMs = m_graphicsTimer->GetAverageMs("HiZ::Build");
+        }
+        const double totalMs = cullMs + hiZMs + drawMs;
+        const GpuDrivenRenderer::CullStatistics statistics = m_gpuDrivenRenderer->GetAverageStatistics();
+        const double visible = statistics.earlyDrawCount + statistics.lateDrawCount;
+        std::cout << "\t Render::GpuDriven (" << objectCount << " objects, " << visible << " visible): "
+            << cullMs << " ms cull + " << hiZMs << " ms Hi-Z + " << drawMs << " ms draw, "
+            << objectCount / (cullMs * 1e-3) * 1e-6 << " M objects culled/s, "
+            << visible / (drawMs * 1e-3) * 1e-6 << " M draws/s, "
+            << m_gpuSceneRecordMicroseconds / m_gpuSceneRecordedFrames << " us to record on the CPU\n";
+
+        // saving is measured against the last report without the occlusion culling at the same object count
+        std::cout << "\t\t culled per frame: " << objectCount - statistics.inFrustumCount << " by the frustum, "
+            << statistics.occludedCount << " occluded, drawn " << statistics.earlyDrawCount << " early + "
+            << statistics.lateDrawCount << " late";
+        if (!m_isOcclusionCullingEnabled)
+        {
+            m_gpuSceneFrustumOnlyMs = totalMs;
+            std::cout << "\n";
+        }
+        else if (m_gpuSceneFrustumOnlyMs > 0.0)
+        {
+            std::cout << ", " << m_gpuSceneFrustumOnlyMs - totalMs << " ms GPU time saved against "
+                << m_gpuSceneFrustumOnlyMs << " ms with the frustum culling only\n";
+        }
+        else
+        {
+            std::cout << ", press Z to measure the frustum culling only\n";
+        }
+
+        // saving of the LODs is measured against the last report without them, with the same culling
+        std::cout << "\t\t " << statistics.triangleCount * 1e-6 << " M triangles/frame, objects by LOD:";
+        for (uint32_t lod = 0; lod < MESH_MAX_LODS; lod++)
+        {
+            std::cout << (lod == 0 ? " " : " / ") << statistics.lodDrawCounts[lod];
+        }
+        if (!m_isLodEnabled)
+        {
+            m_gpuSceneFullDetailMs = totalMs;
+            m_gpuSceneFullDetailTriangles = statistics.triangleCount;
+            std::cout << "\n";
+        }
+        else if (m_gpuSceneFullDetailMs > 0.0)
+        {
+            std::cout << ", " << m_gpuSceneFullDetailMs - totalMs << " ms GPU time and "
+                << (m_gpuSceneFullDetailTriangles - statistics.triangleCount) * 1e-6 << " M triangles saved against "
+                << m_gpuSceneFullDetailMs << " ms without the LODs\n";
+        }
+        else
+        {
+            std::cout << ", press J to measure without the LODs\n";
+        }
+    }
+    m_gpuDrivenRenderer->ResetStatistics();
+    m_gpuSceneRecordMicroseconds = 0.0;
+    m_gpuSceneRecordedFrames = 0;
+
+    // same objects culled on the CPU, the visible count is comparable to the objects the GPU found in the frustum
+    if (m_frustumCuller->HasResults())
+    {
+        const double milliseconds = m_frustumCuller->GetAverageMs();
+        const double objectsPerMicrosecond = m_frustumCuller->GetObjectCount() / (milliseconds * 1e3);
+        std::cout << "\t CPU frustum culling (" << m_frustumCuller->GetInstructionSet() << ", "
+            << m_frustumCuller->GetThreadCount() << " threads, " << m_frustumCuller->GetObjectCount()
+            << " objects, " << m_frustumCuller->GetAverageVisibleCount() << " visible): " << milliseconds << " ms, "
+            << objectsPerMicrosecond << " objects/us, "
+            << objectsPerMicrosecond / m_frustumCuller->GetThreadCount() << " objects/us per core\n";
+    }
+    m_frustumCuller->ResetStatistics();
+
+    std::cout << std::flush;
+    m_computeTimer->ResetStatistics();
+    m_graphicsTimer->ResetStatistics();
+    m_renderStatistics->ResetStatistics();
+    m_cpuSimulation->ResetStatistics();
+    m_totalSimulationSteps = 0;
+    m_simulatedFrames = 0;
+}
+
+void VulkanApp::ValidateBarnesHut()
+{
+    if (m_lastRecordedSimulationMode != PARTICLE_SIMULATION_BARNES_HUT)
+    {
+        std::cout << "Switch to Barnes-Hut (key 3) before validating it \n";
+        return;
+    }
+
+    // nothing can be in flight, otherwise the next step would overwrite buffers that are being read back
+    vkDeviceWaitIdle(m_device);
+
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_device, m_computeCommandPool);
+    m_barnesHut->RecordReadback(commandBuffer);
+    EndSingleTimeCommand(m_device, m_computeCommandPool, commandBuffer, m_computeQueue);
+
+    m_barnesHut->ReportErrorAgainstExact(NBODY_SOFTENING);
+}
+
+void VulkanApp::ValidateComputePrimitives()
+{
+    // primitives share their scratch buffers, nothing else can use them while they are validated
+    vkDeviceWaitIdle(m_device);
+
+    QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(m_physicalDevice, m_sruface);
+    m_primitives->Validate(m_computeQueue, m_computeCommandPool, queueFamilyIndices.graphicsAndComputeFamily.value());
+}
+
+void VulkanApp::ValidateCpuSimulation()
+{
+    if (m_lastRecordedSimulationMode != PARTICLE_SIMULATION_INTEGRATE)
+    {
+        std::cout << "Switch to the GPU integration (key 1) before comparing it with the CPU \n";
+        return;
+    }
+    if (m_isCollisionEnabled)
+    {
+        // CPU simulation does not collide, the particles near the mesh would never match
+        std::cout << "Turn off the mesh collision (key M) before comparing the GPU with the CPU \n";
+        return;
+    }
+
+    vkDeviceWaitIdle(m_device);
+
+    // input and output of the last GPU step
+    std::vector<Particle> gpuInput;
+    std::vector<Particle> gpuOutput;
+    ReadBackParticles(m_shaderStorageBuffer[(m_stateIndex + 1) % PARTICLE_STATE_COUNT], gpuInput);
+    ReadBackParticles(m_shaderStorageBuffer[m_stateIndex], gpuOutput);
+
+    // the same step on the CPU
+    m_cpuSimulation->LoadParticles(gpuInput);
+    m_cpuSimulation->Step(SIMULATION_DELTA_TIME);
+    auto result = m_cpuSimulation->Compare(gpuOutput);
+
+    std::cout << "[CPU vs GPU] " << PARTICLE_COUNT - result.mismatchedParticles << " of " << PARTICLE_COUNT
+        << " particles are bit identical, max position difference " << result.maxPositionDifference
+        << ", max velocity difference " << result.maxVelocityDifference << "\n";
+}
+
+void VulkanApp::ToggleRecording()
+{
+    if (m_recorder->IsRecording())
+    {
+        m_recorder->Stop();
+        std::cout << "Recording stopped, " << m_recorder->GetCapturedCount() << " states written to " << RECORDING_PATH
+            << "\n";
+        return;
+    }
+
+    if (m_simulationMode == PARTICLE_SIMULATION_REPLAY)
+    {
+        std::cout << "Can not record while the recording is replayed \n";
+        return;
+    }
+
+    // copies of the previous recording might still be in flight
+    vkDeviceWaitIdle(m_device);
+    if (m_recorder->Start(RECORDING_PATH, RECORDING_FRAME_INTERVAL))
+    {
+        std::cout << "Recording every " << RECORDING_FRAME_INTERVAL << " frames to " << RECORDING_PATH << "\n";
+    }
+}
+
+void VulkanApp::StartReplay()
+{
+    if (m_recorder->IsRecording())
+    {
+        m_recorder->Stop();
+    }
+
+    try
+    {
+        m_replay = std::make_unique<ParticleReplay>(RECORDING_PATH, PARTICLE_COUNT);
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cout << error.what() << ", record something with key R first \n";
+        return;
+    }
+    m_simulationMode = PARTICLE_SIMULATION_REPLAY;
+}
+
 void VulkanApp::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
 {
     createInfo = {};
@@ -344,6 +797,7 @@ void VulkanApp::PickPhysicalDevice()
             VkPhysicalDeviceProperties props;
             m_msaaSamples = GetMaxUsableSampleCount();
             vkGetPhysicalDeviceProperties(device, &props);
+            m_physicalDeviceName = props.deviceName;
             std::cout << "Using:" << props.deviceName << std::endl;
             break;
         }
@@ -486,11 +940,29 @@ void VulkanApp::CreateRenderPass()
     colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 
+    //--------------------------------
+    // TRANSPARENCY ATTACHEMENTS INFO
+    //--------------------------------
+    // weighted blended transparency accumulates in to these and the composite reads them back in the same render pass,
+    // they never leave the tile memory on the tiled GPUs
+    VkAttachmentDescription accumulationAttachment{};
+    accumulationAttachment.format = TRANSPARENCY_ACCUMULATION_FORMAT;
+    accumulationAttachment.samples = m_msaaSamples;
+    accumulationAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    accumulationAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    accumulationAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    accumulationAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    accumulationAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    accumulationAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentDescription revealageAttachment = accumulationAttachment;
+    revealageAttachment.format = TRANSPARENCY_REVEALAGE_FORMAT;
+
     //----------------------
     // ATTACHEMNT REFERENCES
     //----------------------
     VkAttachmentReference colorAttachmentRef{};
-    //reference to the imaginary array of VkAttachmentDescription (we only have one)
+    //reference to the imaginary array of VkAttachmentDescription
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
@@ -498,66 +970,199 @@ void VulkanApp::CreateRenderPass()
     depthAttachmentRef.attachment = 1;
     depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
+    // transparent geometry is tested against the opaque one but does not write the depth
+    VkAttachmentReference depthReadOnlyAttachmentRef{};
+    depthReadOnlyAttachmentRef.attachment = 1;
+    depthReadOnlyAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
     VkAttachmentReference colorAttachmentResolveRef{};
     colorAttachmentResolveRef.attachment = 2;
     colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    //---------
-    // SUB PASS
-    //---------
-    VkSubpassDescription subPass{};
-    subPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    //reference to the colour attachemnt
-    subPass.colorAttachmentCount = 1;
-    subPass.pColorAttachments = &colorAttachmentRef;
-    subPass.pDepthStencilAttachment = &depthAttachmentRef;
-    subPass.pResolveAttachments = &colorAttachmentResolveRef;
-
-    std::array<VkAttachmentDescription, 3> attachemnts = {colorAttachment, depthAttachment, colorAttachmentResolve};
-
-    //--------------------
-    // SUB PASS DEPENDENCY
-    //--------------------
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    //subpass we are going to use since we only have one we will pass 0
+    std::array<VkAttachmentReference, 2> transparencyAttachmentRefs{};
+    transparencyAttachmentRefs[0].attachment = 3;
+    transparencyAttachmentRefs[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    transparencyAttachmentRefs[1].attachment = 4;
+    transparencyAttachmentRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    std::array<VkAttachmentReference, 2> transparencyInputRefs = transparencyAttachmentRefs;
+    transparencyInputRefs[0].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    transparencyInputRefs[1].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    //----------
+    // SUB PASSES
+    //----------
+    std::array<VkSubpassDescription, SUBPASS_COUNT> subPasses{};
+    // opaque geometry and the sorted transparency
+    subPasses[SUBPASS_OPAQUE].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subPasses[SUBPASS_OPAQUE].colorAttachmentCount = 1;
+    subPasses[SUBPASS_OPAQUE].pColorAttachments = &colorAttachmentRef;
+    subPasses[SUBPASS_OPAQUE].pDepthStencilAttachment = &depthAttachmentRef;
+
+    // weighted blended accumulation, opaque colour is kept for the composite
+    const uint32_t preservedAttachment = 0;
+    subPasses[SUBPASS_TRANSPARENCY_ACCUMULATE].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subPasses[SUBPASS_TRANSPARENCY_ACCUMULATE].colorAttachmentCount = static_cast<uint32_t>(transparencyAttachmentRefs.size());
+    subPasses[SUBPASS_TRANSPARENCY_ACCUMULATE].pColorAttachments = transparencyAttachmentRefs.data();
+    subPasses[SUBPASS_TRANSPARENCY_ACCUMULATE].pDepthStencilAttachment = &depthReadOnlyAttachmentRef;
+    subPasses[SUBPASS_TRANSPARENCY_ACCUMULATE].preserveAttachmentCount = 1;
+    subPasses[SUBPASS_TRANSPARENCY_ACCUMULATE].pPreserveAttachments = &preservedAttachment;
+
+    // full screen composite on top of the opaque colour, which is then resolved to the swap chain image
+    subPasses[SUBPASS_TRANSPARENCY_COMPOSITE].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subPasses[SUBPASS_TRANSPARENCY_COMPOSITE].inputAttachmentCount = static_cast<uint32_t>(transparencyInputRefs.size());
+    subPasses[SUBPASS_TRANSPARENCY_COMPOSITE].pInputAttachments = transparencyInputRefs.data();
+    subPasses[SUBPASS_TRANSPARENCY_COMPOSITE].colorAttachmentCount = 1;
+    subPasses[SUBPASS_TRANSPARENCY_COMPOSITE].pColorAttachments = &colorAttachmentRef;
+    subPasses[SUBPASS_TRANSPARENCY_COMPOSITE].pResolveAttachments = &colorAttachmentResolveRef;
+
+    std::array<VkAttachmentDescription, 5> attachemnts = {
+        colorAttachment, depthAttachment, colorAttachmentResolve, accumulationAttachment, revealageAttachment
+    };
+
+    //----------------------
+    // SUB PASS DEPENDENCIES
+    //----------------------
+    std::array<VkSubpassDependency, 5> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
     //dst subpass must be heigher than srcSubpass, only exception is if src is VK_SUBPASS_EXTERNAL
-    dependency.dstSubpass = 0;
+    dependencies[0].dstSubpass = SUBPASS_OPAQUE;
     //dependecy start
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     //we are not targeting any memmory so 0
-    dependency.srcAccessMask = 0;
-
+    dependencies[0].srcAccessMask = 0;
     //dependency end
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     //we want to access colour attachemnt so that we can write to it
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    // swap chain image is first used by the composite, it still has to wait for the image to be acquired
+    dependencies[1] = dependencies[0];
+    dependencies[1].dstSubpass = SUBPASS_TRANSPARENCY_COMPOSITE;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // accumulation is tested against the depth of the opaque geometry
+    dependencies[2].srcSubpass = SUBPASS_OPAQUE;
+    dependencies[2].dstSubpass = SUBPASS_TRANSPARENCY_ACCUMULATE;
+    dependencies[2].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[2].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[2].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    // composite reads what the accumulation wrote at the same pixel
+    dependencies[3].srcSubpass = SUBPASS_TRANSPARENCY_ACCUMULATE;
+    dependencies[3].dstSubpass = SUBPASS_TRANSPARENCY_COMPOSITE;
+    dependencies[3].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[3].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[3].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[3].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    dependencies[3].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    // composite blends on top of the opaque colour
+    dependencies[4].srcSubpass = SUBPASS_OPAQUE;
+    dependencies[4].dstSubpass = SUBPASS_TRANSPARENCY_COMPOSITE;
+    dependencies[4].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[4].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[4].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[4].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[4].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachemnts.size());
     renderPassInfo.pAttachments = attachemnts.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subPass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subPasses.size());
+    renderPassInfo.pSubpasses = subPasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
 
 
     if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to create render pass");
     }
+
+    //----------------------------
+    // RENDER PASS AFTER THE SCENE
+    //----------------------------
+    // only the load of the colour and the depth differs, so the pipelines and frame buffers of m_renderPass work with it
+    attachemnts[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachemnts[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachemnts[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachemnts[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    // GPU driven objects were drawn in to both of them before
+    dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+    if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPassLoad) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create render pass that loads the scene");
+    }
+
+    //---------------------
+    // SCENE RENDER PASSES
+    //---------------------
+    // depth is stored for the Hi-Z pyramid and the late draw, colour for the main render pass
+    std::array<VkAttachmentDescription, 2> sceneAttachments = {colorAttachment, depthAttachment};
+    sceneAttachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    VkSubpassDescription sceneSubPass{};
+    sceneSubPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    sceneSubPass.colorAttachmentCount = 1;
+    sceneSubPass.pColorAttachments = &colorAttachmentRef;
+    sceneSubPass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkSubpassDependency sceneDependency = dependencies[0];
+    sceneDependency.dstSubpass = 0;
+
+    VkRenderPassCreateInfo scenePassInfo{};
+    scenePassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    scenePassInfo.attachmentCount = static_cast<uint32_t>(sceneAttachments.size());
+    scenePassInfo.pAttachments = sceneAttachments.data();
+    scenePassInfo.subpassCount = 1;
+    scenePassInfo.pSubpasses = &sceneSubPass;
+    scenePassInfo.dependencyCount = 1;
+    scenePassInfo.pDependencies = &sceneDependency;
+
+    if (vkCreateRenderPass(m_device, &scenePassInfo, nullptr, &m_scenePass) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create scene render pass");
+    }
+
+    // late draw goes on top of the early one
+    sceneAttachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    sceneAttachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    sceneAttachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    sceneAttachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    if (vkCreateRenderPass(m_device, &scenePassInfo, nullptr, &m_sceneLoadPass) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create scene render pass that loads the early draw");
+    }
+
+    // particles drawn at reduced resolution are upsampled in to the opaque subpass
+    DeviceContext context{};
+    context.physicalDevice = m_physicalDevice;
+    context.surface = m_sruface;
+    context.logicalDevice = m_device;
+    m_reducedTarget = std::make_unique<ReducedResolutionTarget>(context, m_renderPass, SUBPASS_OPAQUE, m_msaaSamples,
+                                                                m_swapChainExtent, 1u << m_resolution);
 }
 
 std::vector<VkDescriptorSetLayoutBinding> VulkanApp::CreateComputeDescriptorSetLayout(int stratsFrom)
 {
-    // UBO for delat time, SSBO for reads and SSBO for writes (3 bindings in total)
-    std::vector<VkDescriptorSetLayoutBinding> particleDescriptorLayoutBindings(3);
+    // UBO for delat time, SSBO for reads, SSBO for writes and the distance field of the mesh (4 bindings in total)
+    std::vector<VkDescriptorSetLayoutBinding> particleDescriptorLayoutBindings(4);
     particleDescriptorLayoutBindings[0].binding = stratsFrom;
     particleDescriptorLayoutBindings[0].descriptorCount = 1;
-    particleDescriptorLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    particleDescriptorLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     particleDescriptorLayoutBindings[0].pImmutableSamplers = nullptr;
     particleDescriptorLayoutBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
@@ -575,216 +1180,166 @@ std::vector<VkDescriptorSetLayoutBinding> VulkanApp::CreateComputeDescriptorSetL
     particleDescriptorLayoutBindings[2].pImmutableSamplers = nullptr;
     particleDescriptorLayoutBindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+    //Distance field of the mesh the particles collide with
+    particleDescriptorLayoutBindings[3].binding = stratsFrom + 3;
+    particleDescriptorLayoutBindings[3].descriptorCount = 1;
+    particleDescriptorLayoutBindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    particleDescriptorLayoutBindings[3].pImmutableSamplers = nullptr;
+    particleDescriptorLayoutBindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
     return particleDescriptorLayoutBindings;
 }
 
 void VulkanApp::CreateDescriptorSetLayout()
 {
-    //FOR MVP
+    m_descriptorLayoutCache = std::make_unique<DescriptorLayoutCache>(m_device);
+
+    //FOR VIEW AND PROJECTION, BOUND WITH THE OFFSET OF THE FRAME IN THE UNIFORM ALLOCATOR
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
 
-    //auto bindings = m_material->GetLayoutBindings(1);
-    //bindings.emplace_back(uboLayoutBinding);
-
-    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-    layoutInfo.bindingCount = 1; //static_cast<uint32_t>(bindings.size());
-    layoutInfo.pBindings = &uboLayoutBinding;
-    layoutInfo.pNext = nullptr;
-
-    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to create descriptor set layout");
-    };
-
-    auto computeBindings = CreateComputeDescriptorSetLayout(0);
-    layoutInfo.bindingCount = static_cast<uint32_t>(computeBindings.size());
-    layoutInfo.pBindings = computeBindings.data();
-    layoutInfo.pNext = nullptr;
+    //FOR BILLBOARDS THAT READ PARTICLES STRAIGHT FROM THE SSBO
+    VkDescriptorSetLayoutBinding particleLayoutBinding{};
+    particleLayoutBinding.binding = 1;
+    particleLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    particleLayoutBinding.descriptorCount = 1;
+    particleLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    particleLayoutBinding.pImmutableSamplers = nullptr;
 
-    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_computeDescryptorSetLayout) != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to create compute descriptor set layout");
-    };
-}
+    //PREVIOUS SIMULATION STATE, BILLBOARDS INTERPOLATE BETWEEN THE TWO
+    VkDescriptorSetLayoutBinding previousParticleLayoutBinding = particleLayoutBinding;
+    previousParticleLayoutBinding.binding = 2;
 
-void VulkanApp::CreateDescriptorPool()
-{
-    std::array<VkDescriptorPoolSize, 1> graphicsPoolSizes{};
+    //BACK TO FRONT ORDER OF THE PARTICLES FOR THE SORTED TRANSPARENCY
+    VkDescriptorSetLayoutBinding drawOrderLayoutBinding = particleLayoutBinding;
+    drawOrderLayoutBinding.binding = 3;
 
-    // for UBO MVP
-    graphicsPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    graphicsPoolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    // textures and materials are in the set of the material library (set = 1)
+    m_descriptorSetLayout = m_descriptorLayoutCache->GetLayout({
+        uboLayoutBinding, particleLayoutBinding, previousParticleLayoutBinding, drawOrderLayoutBinding
+    });
 
-    // for Sampler
-    // graphicsPoolSizes[1] = m_material->GetDescriptorPoolSize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+    m_computeDescryptorSetLayout = m_descriptorLayoutCache->GetLayout(CreateComputeDescriptorSetLayout(0));
 
-    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    poolInfo.poolSizeCount = static_cast<uint32_t>(graphicsPoolSizes.size());
-    poolInfo.pPoolSizes = graphicsPoolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    //VIEW AND PROJECTION ALONE, FOR THE INSTANCED MESHES
+    m_cameraDescriptorSetLayout = m_descriptorLayoutCache->GetLayout({uboLayoutBinding});
 
-    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+    //ACCUMULATION AND REVEALAGE READ BY THE TRANSPARENCY COMPOSITE
+    std::vector<VkDescriptorSetLayoutBinding> transparencyBindings(2);
+    for (uint32_t i = 0; i < transparencyBindings.size(); i++)
     {
-        throw std::runtime_error("Failed to create descriptor pool");
+        transparencyBindings[i].binding = i;
+        transparencyBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        transparencyBindings[i].descriptorCount = 1;
+        transparencyBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        transparencyBindings[i].pImmutableSamplers = nullptr;
     }
+    m_transparencyDescriptorSetLayout = m_descriptorLayoutCache->GetLayout(transparencyBindings);
+}
 
+void VulkanApp::CreateDescriptorAllocators()
+{
+    // pools are sized per set, not for the whole app, they grow when a new set does not fit
+    // particle sets have one UBO and up to 3 SSBOs, the simulation samples the distance field
+    const std::vector<DescriptorAllocator::PoolSizeRatio> ratios = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.0f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1.0f},
+    };
+    m_descriptorAllocator = std::make_unique<DescriptorAllocator>(m_device, DESCRIPTOR_INITIAL_SETS_PER_POOL, ratios);
 
-    std::array<VkDescriptorPoolSize, 2> computePoolSizes{};
-    //for delta time UBO
-    graphicsPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    graphicsPoolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-    //for each frame in flight both read and write SSBO will be used, thus * 2
-    graphicsPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    graphicsPoolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
-
-    VkDescriptorPoolCreateInfo computePoolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    computePoolInfo.poolSizeCount = static_cast<uint32_t>(graphicsPoolSizes.size());
-    computePoolInfo.pPoolSizes = graphicsPoolSizes.data();
-    computePoolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-    if (vkCreateDescriptorPool(m_device, &computePoolInfo, nullptr, &m_computeDescriptorPool) != VK_SUCCESS)
+    // only the particle draw set is transient so far
+    const std::vector<DescriptorAllocator::PoolSizeRatio> frameRatios = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.0f},
+    };
+    m_frameDescriptorAllocators.resize(MAX_FRAMES_IN_FLIGHT);
+    for (auto& allocator : m_frameDescriptorAllocators)
     {
-        throw std::runtime_error("Failed to create compute descriptor pool");
+        allocator = std::make_unique<DescriptorAllocator>(m_device, DESCRIPTOR_INITIAL_SETS_PER_POOL, frameRatios);
     }
 }
 
 void VulkanApp::CreateDescriptorSet()
 {
-    //--------------------------------------------
-    // DESCRIPTOR SET LAYOUT FOR GRAPHICS PIPELINE
-    //--------------------------------------------
-    std::vector<VkDescriptorSetLayout> graphicsDsLayout(MAX_FRAMES_IN_FLIGHT, m_descriptorSetLayout);
-    VkDescriptorSetAllocateInfo graphicsAllocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    graphicsAllocInfo.descriptorPool = m_descriptorPool;
-    graphicsAllocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    graphicsAllocInfo.pSetLayouts = graphicsDsLayout.data();
-    m_descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-
-    if (vkAllocateDescriptorSets(m_device, &graphicsAllocInfo, m_descriptorSets.data()) != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to allocate descriptors sets");
-    }
-
-    //----------------------------------------
-    // DESCRIPTOR WRITES FOR GRAPHICS PIPELINE
-    //----------------------------------------
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        //--------
-        // UBO
-        //--------
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = m_uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = VK_WHOLE_SIZE;
-
-        //--------
-        // UBO
-        //--------
-        VkWriteDescriptorSet bufferDescriptorWrite;
-        bufferDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        bufferDescriptorWrite.dstSet = m_descriptorSets[i];
-        bufferDescriptorWrite.dstBinding = 0;
-        bufferDescriptorWrite.dstArrayElement = 0;
-        bufferDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        bufferDescriptorWrite.descriptorCount = 1;
-        bufferDescriptorWrite.pBufferInfo = &bufferInfo;
-        bufferDescriptorWrite.pImageInfo = nullptr;
-        bufferDescriptorWrite.pTexelBufferView = nullptr;
-        bufferDescriptorWrite.pNext = nullptr;
-
-        //auto descriptorWrites = m_material->GetDescriptorWrites(m_descriptorSets[i]);
-        //descriptorWrites.insert(descriptorWrites.begin(), bufferDescriptorWrite);
-
-        vkUpdateDescriptorSets(m_device, 1, &bufferDescriptorWrite, 0,
-                               nullptr);
-    }
-
+    //------------------
+    // UPDATE TEMPLATES
+    //------------------
+    m_particleDrawTemplate = std::make_unique<DescriptorUpdateTemplate>(m_device, m_descriptorSetLayout,
+        std::vector<DescriptorUpdateTemplate::Entry>{
+            {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, offsetof(ParticleDrawDescriptors, ubo)},
+            {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(ParticleDrawDescriptors, particles)},
+            {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(ParticleDrawDescriptors, previousParticles)},
+            {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(ParticleDrawDescriptors, drawOrder)},
+        });
+
+    m_simulationTemplate = std::make_unique<DescriptorUpdateTemplate>(m_device, m_computeDescryptorSetLayout,
+        std::vector<DescriptorUpdateTemplate::Entry>{
+            {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, offsetof(SimulationDescriptors, ubo)},
+            {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(SimulationDescriptors, particlesIn)},
+            {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(SimulationDescriptors, particlesOut)},
+            {3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offsetof(SimulationDescriptors, distanceField)},
+        });
+
+    m_transparencyTemplate = std::make_unique<DescriptorUpdateTemplate>(m_device, m_transparencyDescriptorSetLayout,
+        std::vector<DescriptorUpdateTemplate::Entry>{
+            {0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, offsetof(TransparencyDescriptors, accumulation)},
+            {1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, offsetof(TransparencyDescriptors, revealage)},
+        });
+
+    m_cameraTemplate = std::make_unique<DescriptorUpdateTemplate>(m_device, m_cameraDescriptorSetLayout,
+        std::vector<DescriptorUpdateTemplate::Entry>{
+            {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, offsetof(CameraDescriptors, ubo)},
+        });
 
     //-----------------------------------------------
-    // DESCRIPTOR SET FOR LAYOUT FOR COMPUTE PIPELINE
+    // DESCRIPTOR SETS FOR THE COMPUTE PIPELINE
     //-----------------------------------------------
-    std::vector<VkDescriptorSetLayout> computeDsLayout(MAX_FRAMES_IN_FLIGHT, m_computeDescryptorSetLayout);
-    VkDescriptorSetAllocateInfo computeAllocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    computeAllocInfo.descriptorPool = m_computeDescriptorPool;
-    computeAllocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    computeAllocInfo.pSetLayouts = computeDsLayout.data();
-    m_computeDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-
-    if (vkAllocateDescriptorSets(m_device, &computeAllocInfo, m_computeDescriptorSets.data()) != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to allocate compute descriptor sets");
-    }
+    // particle draw sets are allocated every frame from the frame allocator, see RecordParticleDraw
+    // constants of every frame are in the same buffer, only the dynamic offset differs, so one set per target is enough
+    m_computeDescriptorSets.resize(PARTICLE_STATE_COUNT);
+    for (size_t target = 0; target < PARTICLE_STATE_COUNT; target++)
+    {
+        SimulationDescriptors descriptors{};
+        descriptors.ubo = {m_uniformAllocator->GetBuffer(), 0, sizeof(UBOComputeShader)};
+        descriptors.particlesIn = {
+            m_shaderStorageBuffer[(target + 1) % PARTICLE_STATE_COUNT], 0, sizeof(Particle) * PARTICLE_COUNT
+        };
+        descriptors.particlesOut = {m_shaderStorageBuffer[target], 0, sizeof(Particle) * PARTICLE_COUNT};
+        // same field for every set, it never changes
+        descriptors.distanceField = m_meshCollider->GetDescriptorInfo();
+
+        m_computeDescriptorSets[target] = m_descriptorAllocator->Allocate(m_computeDescryptorSetLayout);
+        m_simulationTemplate->Update(m_computeDescriptorSets[target], &descriptors);
+    }
+
+    //------------------------------------
+    // DESCRIPTOR SET FOR THE TRANSPARENCY
+    //------------------------------------
+    m_transparencyDescriptorSet = m_descriptorAllocator->Allocate(m_transparencyDescriptorSetLayout);
+    WriteTransparencyDescriptorSet();
+
+    //------------------------------
+    // DESCRIPTOR SET OF THE CAMERA
+    //------------------------------
+    // every frame binds it with the offset of its constants in the uniform allocator
+    CameraDescriptors cameraDescriptors{};
+    cameraDescriptors.ubo = {m_uniformAllocator->GetBuffer(), 0, sizeof(UniformBufferObject)};
+    m_cameraDescriptorSet = m_descriptorAllocator->Allocate(m_cameraDescriptorSetLayout);
+    m_cameraTemplate->Update(m_cameraDescriptorSet, &cameraDescriptors);
+}
 
-    //---------------------------------------
-    // DESCRIPTOR WRITES FOR COMPUTE PIPELINE
-    //---------------------------------------
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        std::array<VkWriteDescriptorSet, 3> computeDescriptorWrites{};
-
-        //for the time delta uniform buffer
-        VkDescriptorBufferInfo uboInfo{};
-        uboInfo.buffer = m_deltaTimeUBOBuffer[i];
-        uboInfo.offset = 0;
-        uboInfo.range = sizeof(UBOComputeShader);
-
-        computeDescriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[0].dstSet = m_computeDescriptorSets[i];
-        computeDescriptorWrites[0].dstBinding = 0;
-        computeDescriptorWrites[0].dstArrayElement = 0;
-        computeDescriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        computeDescriptorWrites[0].descriptorCount = 1;
-        computeDescriptorWrites[0].pBufferInfo = &uboInfo;
-        computeDescriptorWrites[0].pImageInfo = nullptr;
-        computeDescriptorWrites[0].pTexelBufferView = nullptr;
-        computeDescriptorWrites[0].pNext = nullptr;
-
-        VkDescriptorBufferInfo ssboInBufferInfo{};
-        ssboInBufferInfo.buffer = m_shaderStorageBuffer[(i - 1) % MAX_FRAMES_IN_FLIGHT];
-        ssboInBufferInfo.offset = 0;
-        ssboInBufferInfo.range = sizeof(Particle) * PARTICLE_COUNT;
-
-        computeDescriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[1].dstSet = m_computeDescriptorSets[i];
-        computeDescriptorWrites[1].dstBinding = 1;
-        computeDescriptorWrites[1].dstArrayElement = 0;
-        computeDescriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[1].descriptorCount = 1;
-        computeDescriptorWrites[1].pBufferInfo = &ssboInBufferInfo;
-        computeDescriptorWrites[1].pImageInfo = nullptr;
-        computeDescriptorWrites[1].pTexelBufferView = nullptr;
-        computeDescriptorWrites[1].pNext = nullptr;
-
-        //during the second itteration the bufferin the computeDescriptorWrites becomes some random ass address
-        //without any meaning, this should be realted ot the array creation and resizing it but i am not sure
-        VkDescriptorBufferInfo ssboOutBufferInfo{};
-        ssboOutBufferInfo.buffer = m_shaderStorageBuffer[i];
-        ssboOutBufferInfo.offset = 0;
-        ssboOutBufferInfo.range = sizeof(Particle) * PARTICLE_COUNT;
-
-        computeDescriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[2].dstSet = m_computeDescriptorSets[i];
-        computeDescriptorWrites[2].dstBinding = 2;
-        computeDescriptorWrites[2].dstArrayElement = 0;
-        computeDescriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[2].descriptorCount = 1;
-        computeDescriptorWrites[2].pBufferInfo = &ssboOutBufferInfo;
-        computeDescriptorWrites[2].pImageInfo = nullptr;
-        computeDescriptorWrites[2].pTexelBufferView = nullptr;
-        computeDescriptorWrites[2].pNext = nullptr;
-
-
-        //this is causing the crash during the second iterationy
-        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(computeDescriptorWrites.size()),
-                               computeDescriptorWrites.data(), 0, nullptr);
-    }
+void VulkanApp::WriteTransparencyDescriptorSet()
+{
+    TransparencyDescriptors descriptors{};
+    descriptors.accumulation = {VK_NULL_HANDLE, m_accumulationImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    descriptors.revealage = {VK_NULL_HANDLE, m_revealageImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    m_transparencyTemplate->Update(m_transparencyDescriptorSet, &descriptors);
 }
 
 void VulkanApp::CreateGraphicsPipeline()
@@ -837,13 +1392,24 @@ void VulkanApp::CreateGraphicsPipeline()
     //------------------
     // VERTEX ATTRIBUTES
     //------------------
-    auto bindingDescription = Particle::getBindingDescription();
-    auto attributeDescriptions = Particle::getAttributeDescription();
+    // binding 0 is the latest particle state, binding 1 the previous one, only its position is read
+    std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {
+        Particle::getBindingDescription(), Particle::getBindingDescription()
+    };
+    bindingDescriptions[1].binding = 1;
+
+    auto particleAttributes = Particle::getAttributeDescription();
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(particleAttributes.begin(),
+                                                                         particleAttributes.end());
+    VkVertexInputAttributeDescription previousPositionAttribute = particleAttributes[0];
+    previousPositionAttribute.binding = 1;
+    previousPositionAttribute.location = 1;
+    attributeDescriptions.emplace_back(previousPositionAttribute);
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
@@ -977,10 +1543,20 @@ void VulkanApp::CreateGraphicsPipeline()
     //----------------
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
     pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.setLayoutCount = 1;
-    pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+    // particles in set 0, the bindless materials of the mesh particles in set 1
+    std::array<VkDescriptorSetLayout, 2> graphicsSetLayouts = {
+        m_descriptorSetLayout, m_materials->GetDescriptorSetLayout()
+    };
+    pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(graphicsSetLayouts.size());
+    pipelineLayoutCreateInfo.pSetLayouts = graphicsSetLayouts.data();
+    // billboard size and stretching (the point pipeline does not use them) and the interpolation between the states
+    VkPushConstantRange renderPushConstantRange{};
+    renderPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    renderPushConstantRange.offset = 0;
+    renderPushConstantRange.size = sizeof(ParticleRenderPushConstants);
+
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &renderPushConstantRange;
 
     if (vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
     {
@@ -1023,155 +1599,354 @@ void VulkanApp::CreateGraphicsPipeline()
         std::cout << "Graphics pipeline created sucessfully !\n";
     }
 
+    //-----------------------------
+    // REDUCED RESOLUTION VARIANTS
+    //-----------------------------
+    // target of the reduced resolution has its own render pass with single sampled colour and depth
+    VkPipelineMultisampleStateCreateInfo lowResolutionMultisample = multisampleCreateInfo;
+    lowResolutionMultisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    auto createLowResolutionPipeline = [&](VkPipeline &pipeline, const std::string &name)
+    {
+        pipelineInfo.renderPass = m_reducedTarget->GetRenderPass();
+        pipelineInfo.subpass = 0;
+        pipelineInfo.pMultisampleState = &lowResolutionMultisample;
+
+        if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create reduced resolution " + name + " graphics pipeline");
+        }
+
+        pipelineInfo.renderPass = m_renderPass;
+        pipelineInfo.subpass = SUBPASS_OPAQUE;
+        pipelineInfo.pMultisampleState = &multisampleCreateInfo;
+    };
+
+    createLowResolutionPipeline(m_lowResolutionPointPipeline, "point");
+
 
     vkDestroyShaderModule(m_device, vertexShaderModule, nullptr);
     vkDestroyShaderModule(m_device, fragmentShaderModule, nullptr);
-}
 
-void VulkanApp::CreateComputePipeline()
-{
-    auto computeShaderCode = readFile("Shaders/Compiled/Particles.spv");
-    VkShaderModule computeShaderModule = createShaderModuel(m_device, computeShaderCode);
+    //-----------------------
+    // TRANSPARENCY VARIANTS
+    //-----------------------
+    // billboards and meshes have one pipeline per PARTICLE_TRANSPARENCY_MODE, the fragment shader picks
+    // what it writes with the TRANSPARENCY specialization constant
+    VkSpecializationMapEntry transparencyEntry{};
+    transparencyEntry.constantID = 0;
+    transparencyEntry.offset = 0;
+    transparencyEntry.size = sizeof(uint32_t);
+
+    // sorted particles are blended back to front over each other
+    VkPipelineColorBlendAttachmentState sortedBlendAttachment = colourBlendAttachmentCreateInfo;
+    sortedBlendAttachment.blendEnable = VK_TRUE;
+    sortedBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    sortedBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    sortedBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    sortedBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+
+    // accumulation sums the weighted premultiplied colours, revealage multiplies the (1 - alpha) of the fragments
+    std::array<VkPipelineColorBlendAttachmentState, 2> weightedBlendAttachments = {
+        colourBlendAttachmentCreateInfo, colourBlendAttachmentCreateInfo
+    };
+    weightedBlendAttachments[0].blendEnable = VK_TRUE;
+    weightedBlendAttachments[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    weightedBlendAttachments[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    weightedBlendAttachments[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    weightedBlendAttachments[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    weightedBlendAttachments[1].colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+    weightedBlendAttachments[1].blendEnable = VK_TRUE;
+    weightedBlendAttachments[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    weightedBlendAttachments[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+
+    auto createTransparencyVariants = [&](std::array<VkPipeline, PARTICLE_TRANSPARENCY_MODE_COUNT> &pipelines,
+                                          std::array<VkPipeline, PARTICLE_TRANSPARENCY_MODE_COUNT> &lowResolutionPipelines,
+                                          const std::string &name)
+    {
+        for (uint32_t mode = 0; mode < PARTICLE_TRANSPARENCY_MODE_COUNT; mode++)
+        {
+            VkSpecializationInfo specializationInfo{};
+            specializationInfo.mapEntryCount = 1;
+            specializationInfo.pMapEntries = &transparencyEntry;
+            specializationInfo.dataSize = sizeof(uint32_t);
+            specializationInfo.pData = &mode;
+            shaderStages[1].pSpecializationInfo = &specializationInfo;
+
+            // transparent particles are tested against the opaque geometry but do not hide what is behind them
+            depthStencil.depthWriteEnable = mode == PARTICLE_TRANSPARENCY_OPAQUE ? VK_TRUE : VK_FALSE;
+            if (mode == PARTICLE_TRANSPARENCY_WEIGHTED)
+            {
+                colourBlendCreateInfo.attachmentCount = static_cast<uint32_t>(weightedBlendAttachments.size());
+                colourBlendCreateInfo.pAttachments = weightedBlendAttachments.data();
+                pipelineInfo.subpass = SUBPASS_TRANSPARENCY_ACCUMULATE;
+            }
+            else
+            {
+                colourBlendCreateInfo.attachmentCount = 1;
+                colourBlendCreateInfo.pAttachments = mode == PARTICLE_TRANSPARENCY_SORTED
+                                                         ? &sortedBlendAttachment
+                                                         : &colourBlendAttachmentCreateInfo;
+                pipelineInfo.subpass = SUBPASS_OPAQUE;
+            }
+
+            if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipelines[mode]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create " + name + " graphics pipeline");
+            }
+
+            // weighted blended accumulation needs the attachments of the full resolution render pass
+            if (mode != PARTICLE_TRANSPARENCY_WEIGHTED)
+            {
+                createLowResolutionPipeline(lowResolutionPipelines[mode], name);
+            }
+        }
 
-    VkPipelineShaderStageCreateInfo computeShaderStageInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO
+        shaderStages[1].pSpecializationInfo = nullptr;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        colourBlendCreateInfo.attachmentCount = 1;
+        colourBlendCreateInfo.pAttachments = &colourBlendAttachmentCreateInfo;
+        pipelineInfo.subpass = SUBPASS_OPAQUE;
     };
-    computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    computeShaderStageInfo.module = computeShaderModule;
-    computeShaderStageInfo.pName = "main";
-    computeShaderStageInfo.pSpecializationInfo = nullptr;
 
-    VkPipelineLayoutCreateInfo computePipelineLayout{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    computePipelineLayout.pSetLayouts = &m_computeDescryptorSetLayout;
-    computePipelineLayout.setLayoutCount = 1;
-    if (vkCreatePipelineLayout(m_device, &computePipelineLayout, nullptr, &m_computePipelineLayout) != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to create pipeline layout !");
-    }
+    //---------------------
+    // BILLBOARD PIPELINE
+    //---------------------
+    auto billboardVertexCode = readFile("Shaders/Compiled/ParticleBillboardVertex.spv");
+    auto billboardFragmentCode = readFile("Shaders/Compiled/ParticleBillboardFragment.spv");
+    VkShaderModule billboardVertexModule = createShaderModuel(m_device, billboardVertexCode);
+    VkShaderModule billboardFragmentModule = createShaderModuel(m_device, billboardFragmentCode);
 
-    VkComputePipelineCreateInfo computePipelineInfo{.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
-    computePipelineInfo.layout = m_computePipelineLayout;
-    computePipelineInfo.stage = computeShaderStageInfo;
-    if (vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &m_computePipeline) !=
-        VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to create compute pipeline !");
-    }
-}
+    shaderStages[0].module = billboardVertexModule;
+    shaderStages[1].module = billboardFragmentModule;
 
-void VulkanApp::CreateFrameBuffers()
-{
-    m_swapChainFrameBuffers.resize(m_swapChainImageViews.size());
+    // particles are pulled from the SSBO by the instance index, so there is no vertex input at all
+    VkPipelineVertexInputStateCreateInfo emptyVertexInputInfo{};
+    emptyVertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    pipelineInfo.pVertexInputState = &emptyVertexInputInfo;
 
-    for (size_t i = 0; i < m_swapChainImageViews.size(); i++)
+    // every instance is its own 4 vertex strip
+    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    rasterizerCreateInfo.cullMode = VK_CULL_MODE_NONE;
+
+    createTransparencyVariants(m_billboardPipelines, m_lowResolutionBillboardPipelines, "billboard");
+
+    vkDestroyShaderModule(m_device, billboardVertexModule, nullptr);
+    vkDestroyShaderModule(m_device, billboardFragmentModule, nullptr);
+
+    //---------------------
+    // MESH PIPELINE
+    //---------------------
+    auto meshVertexCode = readFile("Shaders/Compiled/ParticleMeshVertex.spv");
+    auto meshFragmentCode = readFile("Shaders/Compiled/ParticleMeshFragment.spv");
+    VkShaderModule meshVertexModule = createShaderModuel(m_device, meshVertexCode);
+    VkShaderModule meshFragmentModule = createShaderModuel(m_device, meshFragmentCode);
+
+    shaderStages[0].module = meshVertexModule;
+    shaderStages[1].module = meshFragmentModule;
+
+    // vertices of the model are the only vertex input, particles are pulled from the SSBO by the instance index
+    auto meshBindingDescription = Vertex::getBindingDescription();
+    auto meshAttributeDescriptions = Vertex::getAttributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo meshVertexInputInfo{};
+    meshVertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    meshVertexInputInfo.vertexBindingDescriptionCount = 1;
+    meshVertexInputInfo.pVertexBindingDescriptions = &meshBindingDescription;
+    meshVertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(meshAttributeDescriptions.size());
+    meshVertexInputInfo.pVertexAttributeDescriptions = meshAttributeDescriptions.data();
+    pipelineInfo.pVertexInputState = &meshVertexInputInfo;
+
+    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+
+    createTransparencyVariants(m_meshPipelines, m_lowResolutionMeshPipelines, "mesh particle");
+
+    vkDestroyShaderModule(m_device, meshVertexModule, nullptr);
+    vkDestroyShaderModule(m_device, meshFragmentModule, nullptr);
+
+    //----------------------------------
+    // TRANSPARENCY COMPOSITE PIPELINE
+    //----------------------------------
+    VkPipelineLayoutCreateInfo transparencyLayoutCreateInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    transparencyLayoutCreateInfo.setLayoutCount = 1;
+    transparencyLayoutCreateInfo.pSetLayouts = &m_transparencyDescriptorSetLayout;
+
+    if (vkCreatePipelineLayout(m_device, &transparencyLayoutCreateInfo, nullptr, &m_transparencyPipelineLayout) != VK_SUCCESS)
     {
-        std::array<VkImageView, 3> attachments = {
-            m_colorImageView,
-            m_depthImageView,
-            m_swapChainImageViews[i]
-        };
-        VkFramebufferCreateInfo frameBufferInfo{};
-        frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        frameBufferInfo.renderPass = m_renderPass;
-        frameBufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        frameBufferInfo.pAttachments = attachments.data();
-        frameBufferInfo.width = m_swapChainExtent.width;
-        frameBufferInfo.height = m_swapChainExtent.height;
-        frameBufferInfo.layers = 1;
+        throw std::runtime_error("Failed to create transparency pipeline layout !");
+    }
 
-        if (vkCreateFramebuffer(m_device, &frameBufferInfo, nullptr, &m_swapChainFrameBuffers[i]) != VK_SUCCESS)
-        {
-            throw std::runtime_error("Failed to create frame buffers from swap chain images");
-        }
+    auto compositeVertexCode = readFile("Shaders/Compiled/FullScreenTriangle.spv");
+    auto compositeFragmentCode = readFile("Shaders/Compiled/TransparencyComposite.spv");
+    VkShaderModule compositeVertexModule = createShaderModuel(m_device, compositeVertexCode);
+    VkShaderModule compositeFragmentModule = createShaderModuel(m_device, compositeFragmentCode);
+
+    shaderStages[0].module = compositeVertexModule;
+    shaderStages[1].module = compositeFragmentModule;
+
+    // composite averages the samples of the accumulation by itself
+    const int32_t sampleCount = static_cast<int32_t>(m_msaaSamples);
+    VkSpecializationInfo sampleCountInfo{};
+    sampleCountInfo.mapEntryCount = 1;
+    sampleCountInfo.pMapEntries = &transparencyEntry;
+    sampleCountInfo.dataSize = sizeof(int32_t);
+    sampleCountInfo.pData = &sampleCount;
+    shaderStages[1].pSpecializationInfo = &sampleCountInfo;
+
+    // one triangle over the whole screen
+    pipelineInfo.pVertexInputState = &emptyVertexInputInfo;
+    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    rasterizerCreateInfo.cullMode = VK_CULL_MODE_NONE;
+    depthStencil.depthTestEnable = VK_FALSE;
+    depthStencil.depthWriteEnable = VK_FALSE;
+
+    // transparent colour covers (1 - revealage) of the opaque one
+    VkPipelineColorBlendAttachmentState compositeBlendAttachment = colourBlendAttachmentCreateInfo;
+    compositeBlendAttachment.blendEnable = VK_TRUE;
+    compositeBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    compositeBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    compositeBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    compositeBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colourBlendCreateInfo.pAttachments = &compositeBlendAttachment;
+
+    pipelineInfo.layout = m_transparencyPipelineLayout;
+    pipelineInfo.subpass = SUBPASS_TRANSPARENCY_COMPOSITE;
+
+    if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_transparencyCompositePipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create transparency composite pipeline");
     }
-}
 
+    vkDestroyShaderModule(m_device, compositeVertexModule, nullptr);
+    vkDestroyShaderModule(m_device, compositeFragmentModule, nullptr);
+}
 
-void VulkanApp::CreateTextureImage()
+void VulkanApp::CreateComputePipeline()
 {
-    TEXTURE_TYPE texturesToProcess[] = {TEXTURE_TYPE_ALBEDO, TEXTURE_TYPE_ARM, TEXTURE_TYPE_NORMAL};
-    std::vector<std::string> paths = {
-        "Textures/tie_albeo.png", "Textures/tie_arm.png", "Textures/normal.png"
-    };
+    VkPipelineLayoutCreateInfo computePipelineLayout{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    computePipelineLayout.pSetLayouts = &m_computeDescryptorSetLayout;
+    computePipelineLayout.setLayoutCount = 1;
+    if (vkCreatePipelineLayout(m_device, &computePipelineLayout, nullptr, &m_computePipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create pipeline layout !");
+    }
 
-    VkBuffer stagingImageBuffer;
-    VkDeviceMemory stagingImageMemory;
+    //-----------------------
+    // AUTO TUNING
+    //-----------------------
+    // tuned dispatches read the compute uniform buffer of the first frame, so it has to hold valid parameters
+    UpdateSimulationUniforms();
 
-    BufferCreateInfo bufferInfo;
-    bufferInfo.physicalDevice = m_physicalDevice;
-    bufferInfo.logicalDevice = m_device;
-    bufferInfo.surface = m_sruface;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    DeviceContext context{};
+    context.physicalDevice = m_physicalDevice;
+    context.surface = m_sruface;
+    context.logicalDevice = m_device;
 
-    ImageCreateInfo imageCreateInfo{};
-    imageCreateInfo.physicalDevice = m_physicalDevice;
-    imageCreateInfo.logicalDevice = m_device;
-    imageCreateInfo.surface = m_sruface;
-    imageCreateInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-    imageCreateInfo.imageTiling = VK_IMAGE_TILING_OPTIMAL;
-    imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
-        VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    imageCreateInfo.memoryProperteis = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(m_physicalDevice, m_sruface);
+    ComputeAutoTuner tuner(context, queueFamilyIndices.graphicsAndComputeFamily.value(), m_computeQueue,
+                           m_computeCommandPool, COMPUTE_TUNING_CACHE_PATH);
 
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
 
-    for (int i = 0; i < paths.size(); i++)
+    // every variant runs one simulation step on the real particles, from the first SSBO in to the second one
+    auto recordDispatch = [this](VkCommandBuffer commandBuffer, const KernelVariant &variant)
     {
-        int texWidth, texHeight, texChanels;
-        stbi_uc* pixels = stbi_load(paths[i].c_str(), &texWidth, &texHeight, &texChanels, STBI_rgb_alpha);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1,
+                                &m_computeDescriptorSets[1], 1, &m_simulationUniformOffset);
+        vkCmdDispatch(commandBuffer, (PARTICLE_COUNT + variant[0] - 1) / variant[0], 1, 1);
+    };
 
-        std::cout << "Loading texture: " << paths[i] << std::endl;
+    std::vector<KernelVariant> integrateVariants = {{32}, {64}, {128}, {256}, {512}, {1024}};
+    KernelVariant integrateVariant = tuner.Tune("Integrate", "Shaders/Compiled/Particles.spv",
+                                                m_computePipelineLayout, integrateVariants, {256}, recordDispatch);
+    m_integrateWorkGroupSize = integrateVariant[0];
 
-        if (!pixels)
+    // tile is the work group size of the N-body kernel, unroll factor has to divide it and the tile
+    // of positions (vec4 per body) has to fit in to the shared memory
+    std::vector<KernelVariant> nbodyVariants;
+    for (uint32_t tileSize : {64u, 128u, 256u, 512u})
+    {
+        for (uint32_t unrollFactor : {1u, 2u, 4u, 8u, 16u})
         {
-            throw std::runtime_error("Failed to load textue");
+            if (tileSize % unrollFactor == 0 &&
+                tileSize * sizeof(glm::vec4) <= properties.limits.maxComputeSharedMemorySize)
+            {
+                nbodyVariants.push_back({tileSize, unrollFactor});
+            }
         }
+    }
+    KernelVariant nbodyVariant = tuner.Tune("NBodyTiled", "Shaders/Compiled/ParticlesNBody.spv",
+                                            m_computePipelineLayout, nbodyVariants, {256, 8}, recordDispatch);
+    m_nbodyWorkGroupSize = nbodyVariant[0];
+    m_nbodyUnrollFactor = nbodyVariant[1];
 
-        m_material->GetTextures()[texturesToProcess[i]].maxMipLevels = static_cast<uint32_t>(std::floor(
-                std::log2(std::max(texWidth, texHeight)))) +
-            1;;
-        imageCreateInfo.mipLevels = m_material->GetTextures()[texturesToProcess[i]].maxMipLevels;
-
-        // times 4 becaus   e we have RGBA
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-        bufferInfo.size = imageSize;
-        CreateBuffer(bufferInfo, stagingImageBuffer, stagingImageMemory);
-
-        void* data;
-        vkMapMemory(m_device, stagingImageMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(m_device, stagingImageMemory);
-
-        stbi_image_free(pixels);
+    std::cout << "[Tuning] integrate work group " << m_integrateWorkGroupSize << ", N-body tile "
+        << m_nbodyWorkGroupSize << " unroll " << m_nbodyUnrollFactor << " \n";
 
-        imageCreateInfo.width = texWidth;
-        imageCreateInfo.height = texHeight;
-        imageCreateInfo.size = imageSize;
+    if (tuner.HasMeasured())
+    {
+        // measured steps have moved the particles, simulation has to start from the initial state
+        InitializeParticles();
+    }
 
-        ImageLayoutDependencyInfo dependencyInfo{};
-        dependencyInfo.commandBuffer = StartRecordingCommandBuffer();
-        dependencyInfo.logicalDevice = m_device;
-        dependencyInfo.transformQueue = m_transferQueue;
+    //-----------------------
+    // PIPELINES
+    //-----------------------
+    // both pipelines read and write the same descriptors so they can share the layout
+    m_computePipeline = ComputeAutoTuner::CreatePipeline(m_device, "Shaders/Compiled/Particles.spv",
+                                                         m_computePipelineLayout, integrateVariant);
+    m_nbodyPipeline = ComputeAutoTuner::CreatePipeline(m_device, "Shaders/Compiled/ParticlesNBody.spv",
+                                                       m_computePipelineLayout, nbodyVariant);
+}
 
-        CreateImage(imageCreateInfo, m_material->GetTextures()[texturesToProcess[i]].image,
-                    m_material->GetTextures()[texturesToProcess[i]].memory);
+void VulkanApp::CreateFrameBuffers()
+{
+    m_swapChainFrameBuffers.resize(m_swapChainImageViews.size());
 
-        TransferImageLayout(dependencyInfo, m_material->GetTextures()[texturesToProcess[i]].image,
-                            imageCreateInfo.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                            m_material->GetTextures()[texturesToProcess[i]].maxMipLevels);
+    for (size_t i = 0; i < m_swapChainImageViews.size(); i++)
+    {
+        std::array<VkImageView, 5> attachments = {
+            m_colorImageView,
+            m_depthImageView,
+            m_swapChainImageViews[i],
+            m_accumulationImageView,
+            m_revealageImageView
+        };
+        VkFramebufferCreateInfo frameBufferInfo{};
+        frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frameBufferInfo.renderPass = m_renderPass;
+        frameBufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        frameBufferInfo.pAttachments = attachments.data();
+        frameBufferInfo.width = m_swapChainExtent.width;
+        frameBufferInfo.height = m_swapChainExtent.height;
+        frameBufferInfo.layers = 1;
 
-        CopyBufferToImage(dependencyInfo, stagingImageBuffer, m_material->GetTextures()[texturesToProcess[i]].image,
-                          static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+        if (vkCreateFramebuffer(m_device, &frameBufferInfo, nullptr, &m_swapChainFrameBuffers[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create frame buffers from swap chain images");
+        }
+    }
 
-        GenerateMipMaps(m_physicalDevice, dependencyInfo, m_material->GetTextures()[texturesToProcess[i]].image,
-                        texWidth, texHeight, m_material->GetTextures()[texturesToProcess[i]].maxMipLevels);
+    // both of the scene render passes are compatible
+    std::array<VkImageView, 2> sceneAttachments = {m_colorImageView, m_depthImageView};
+    VkFramebufferCreateInfo sceneFrameBufferInfo{};
+    sceneFrameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    sceneFrameBufferInfo.renderPass = m_scenePass;
+    sceneFrameBufferInfo.attachmentCount = static_cast<uint32_t>(sceneAttachments.size());
+    sceneFrameBufferInfo.pAttachments = sceneAttachments.data();
+    sceneFrameBufferInfo.width = m_swapChainExtent.width;
+    sceneFrameBufferInfo.height = m_swapChainExtent.height;
+    sceneFrameBufferInfo.layers = 1;
 
-        FlushCommandBuffer(dependencyInfo.commandBuffer);
+    if (vkCreateFramebuffer(m_device, &sceneFrameBufferInfo, nullptr, &m_sceneFrameBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create scene frame buffer");
     }
-    vkFreeMemory(m_device, stagingImageMemory, nullptr);
-    vkDestroyBuffer(m_device, stagingImageBuffer, nullptr);
 }
 
+
 void VulkanApp::CreateCommandPool()
 {
     //retrieve all queue families from the GPU
@@ -1278,94 +2053,293 @@ void VulkanApp::CreateIndexBuffers()
     vkFreeMemory(m_device, stagingMemory, nullptr);
 }
 
-void VulkanApp::CreateUniformBuffers()
+void VulkanApp::CreateMeshBuffers()
 {
-    BufferCreateInfo bufferInfo{};
-    bufferInfo.logicalDevice = m_device;
-    bufferInfo.physicalDevice = m_physicalDevice;
-    bufferInfo.surface = m_sruface;
-    bufferInfo.size = sizeof(UniformBufferObject);
-    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    bufferInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    // model drawn for every particle in PARTICLE_RENDER_MESHES
+    m_geometryType = MODEL;
+    GenerateGeometryVertices(MODEL, vertices, indices);
+
+    // centre of the bounding box goes to the origin and the furthest vertex to the radius of 1,
+    // so the size of the instances does not depend on the units of the model
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float extent = 0.0f;
+    for (const auto& vertex : vertices)
+    {
+        extent = std::max(extent, glm::length(vertex.pos - center));
+    }
+    for (auto& vertex : vertices)
+    {
+        vertex.pos = extent > 0.0f ? (vertex.pos - center) / extent : vertex.pos;
+    }
 
-    m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    m_uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    m_uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    CreateVertexBuffers();
+    CreateIndexBuffers();
+    std::cout << "[Mesh particles] " << vertices.size() << " vertices, " << indices.size() / 3
+        << " triangles per instance\n";
+}
 
-    m_deltaTimeUBOBuffer.resize(MAX_FRAMES_IN_FLIGHT);
-    m_deltaTimeUBOMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    m_deltaTimeBufferMapped.resize(MAX_FRAMES_IN_FLIGHT);
+void VulkanApp::CreateMaterials()
+{
+    // ARM maps hold data, not colours, so they are not sRGB
+    const uint32_t tieAlbedo = m_materials->AddTexture("Textures/tie_albeo.png", m_graphicsQueue, m_comandPool);
+    const uint32_t tieArm = m_materials->AddTexture("Textures/tie_arm.png", m_graphicsQueue, m_comandPool,
+                                                    VK_FORMAT_R8G8B8A8_UNORM);
+    const uint32_t paintedAlbedo = m_materials->AddTexture("Textures/TIE_color.png", m_graphicsQueue, m_comandPool);
+    const uint32_t paintedArm = m_materials->AddTexture("Textures/arm.png", m_graphicsQueue, m_comandPool,
+                                                        VK_FORMAT_R8G8B8A8_UNORM);
+
+    MaterialParameters tie{};
+    tie.albedoTexture = tieAlbedo;
+    tie.armTexture = tieArm;
+    m_materials->AddMaterial(tie);
+
+    MaterialParameters painted{};
+    painted.albedoTexture = paintedAlbedo;
+    painted.armTexture = paintedArm;
+    m_materials->AddMaterial(painted);
+
+    // scalar only materials, they share the table with the textured ones
+    MaterialParameters polished{};
+    polished.roughness = 0.15f;
+    polished.metalness = 0.9f;
+    m_materials->AddMaterial(polished);
+
+    MaterialParameters tinted{};
+    tinted.baseColor = glm::vec4(1.0f, 0.35f, 0.3f, 1.0f);
+    tinted.albedoTexture = tieAlbedo;
+    tinted.roughness = 0.8f;
+    m_materials->AddMaterial(tinted);
+
+    std::cout << "[Materials] " << m_materials->GetMaterialCount() << " materials, "
+        << m_materials->GetTextureCount() << " textures in one descriptor set\n";
+}
 
+void VulkanApp::CreateScene()
+{
+    // sphere is left out, GenerateSphere makes the indices of a triangle strip and the pool draws lists
+    std::vector<Vertex> cubeVertices;
+    std::vector<uint32_t> cubeIndices;
+    GenerateGeometryVertices(CUBE, cubeVertices, cubeIndices);
+
+    // LODs share the vertices of their mesh, only their indices are added to the pool.
+    // Every vertex of the cube is on a seam between its faces, so it stays with a single LOD
+    std::array<std::vector<std::vector<uint32_t>>, 2> lodIndices;
+    std::array<std::vector<float>, 2> lodErrors;
+    const std::array<const std::vector<Vertex> *, 2> meshVertices = {&cubeVertices, &vertices};
+    const std::array<const std::vector<uint32_t> *, 2> meshIndices = {&cubeIndices, &indices};
+    uint32_t indexCount = 0;
+    for (size_t i = 0; i < lodIndices.size(); i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        MeshSimplifier::GenerateLods(*meshVertices[i], *meshIndices[i], MESH_MAX_LODS, lodIndices[i], lodErrors[i]);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "[LOD] " << SCENE_MESH_NAMES[i] << ": " << lodIndices[i].size() << " LODs in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms, triangles (error):";
+        for (size_t lod = 0; lod < lodIndices[i].size(); lod++)
+        {
+            std::cout << (lod == 0 ? " " : " / ") << lodIndices[i][lod].size() / 3 << " (" << lodErrors[i][lod] << ")";
+            indexCount += static_cast<uint32_t>(lodIndices[i][lod].size());
+        }
+        std::cout << "\n";
+    }
+
+    DeviceContext context{m_physicalDevice, m_sruface, m_device};
+    m_meshPool = std::make_unique<MeshPool>(context, static_cast<uint32_t>(cubeVertices.size() + vertices.size()),
+                                            indexCount);
+    const uint32_t cube = m_meshPool->AddMesh(cubeVertices, lodIndices[0], lodErrors[0], m_graphicsQueue,
+                                              m_comandPool);
+    // normalized by CreateMeshBuffers to the radius of 1
+    const uint32_t model = m_meshPool->AddMesh(vertices, lodIndices[1], lodErrors[1], m_graphicsQueue, m_comandPool);
+
+    m_instancedRenderer = std::make_unique<InstancedMeshRenderer>(context, *m_meshPool, m_renderPass, SUBPASS_OPAQUE,
+                                                                  m_msaaSamples, m_cameraDescriptorSetLayout,
+                                                                  m_materials->GetDescriptorSetLayout(),
+                                                                  SCENE_MAX_INSTANCES, MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t mesh : {cube, model})
+    {
+        m_sceneBatches.push_back(m_instancedRenderer->AddBatch(mesh, (SCENE_MAX_INSTANCES + 1) / 2));
+    }
+
+    // same vertices as in the mesh pool, so the instances are picked in the space of their mesh
+    m_meshBvhs.push_back(std::make_unique<MeshBvh>(cubeVertices, cubeIndices, *m_threadPool, MESH_BVH_CACHE_PATHS[0]));
+    m_meshBvhs.push_back(std::make_unique<MeshBvh>(vertices, indices, *m_threadPool, MESH_BVH_CACHE_PATHS[1]));
+    for (size_t i = 0; i < m_meshBvhs.size(); i++)
+    {
+        uint32_t hits = 0;
+        const double microseconds = m_meshBvhs[i]->BenchmarkQueries(MESH_BVH_BENCHMARK_RAYS, hits);
+        std::cout << "[BVH] " << SCENE_MESH_NAMES[i] << " (" << m_meshBvhs[i]->GetTriangleCount() << " triangles, "
+            << m_meshBvhs[i]->GetInstructionSet() << "): " << microseconds << " us/ray, "
+            << 1.0 / microseconds << " M rays/s on one thread, " << hits << " of " << MESH_BVH_BENCHMARK_RAYS
+            << " rays hit\n";
+    }
+
+    // drawn in their own render pass, the Hi-Z pyramid is built from the depth of the early draw
+    m_gpuDrivenRenderer = std::make_unique<GpuDrivenRenderer>(context, *m_meshPool, m_scenePass, 0,
+                                                              m_msaaSamples, m_cameraDescriptorSetLayout,
+                                                              m_materials->GetDescriptorSetLayout(),
+                                                              GPU_SCENE_MAX_OBJECTS, MAX_FRAMES_IN_FLIGHT);
+    m_sceneGraph = std::make_unique<SceneGraph>(*m_threadPool);
+    m_frustumCuller = std::make_unique<FrustumCuller>(*m_threadPool);
+    m_hiZ = std::make_unique<HiZPyramid>(context, m_depthImage, m_depthImageView, FindDepthFormat(), m_swapChainExtent,
+                                         m_msaaSamples, m_graphicsQueue, m_comandPool);
+    m_gpuDrivenRenderer->SetPyramid(m_hiZ->GetDescriptorInfo(), m_hiZ->GetExtent());
+    m_gpuDrivenRenderer->SetLodThreshold(m_isLodEnabled ? GPU_SCENE_LOD_PIXEL_ERROR : 0.0f, m_swapChainExtent.height);
+
+    std::cout << "[Scene] " << m_meshPool->GetMeshCount() << " meshes in one vertex and index buffer, up to "
+        << SCENE_MAX_INSTANCES << " instances and " << GPU_SCENE_MAX_OBJECTS << " GPU driven objects\n";
+}
 
-    // for MVP UBO
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+void VulkanApp::SetSceneInstanceCount(uint32_t count)
+{
+    for (uint32_t batch : m_sceneBatches)
     {
-        CreateBuffer(bufferInfo, m_uniformBuffers[i], m_uniformBuffersMemory[i]);
-        vkMapMemory(m_device, m_uniformBuffersMemory[i], 0, bufferInfo.size, 0, &m_uniformBuffersMapped[i]);
+        m_instancedRenderer->ClearInstances(batch);
     }
+    m_sceneGraph->Clear();
+    m_sceneInstanceNodes.clear();
+    m_sceneRowNodes.clear();
 
-    bufferInfo.size = sizeof(UBOComputeShader);
-    //for delta time UBO
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    // square grid on the floor, centred below the particles
+    const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    const float halfExtent = (static_cast<float>(side) - 1.0f) * SCENE_INSTANCE_SPACING * 0.5f;
+    const uint32_t materialCount = m_materials->GetMaterialCount();
+    const uint32_t root = m_sceneGraph->AddNode(SCENE_GRAPH_NO_PARENT,
+                                                glm::translate(glm::mat4(1.0f), glm::vec3(0, SCENE_FLOOR_HEIGHT, 0)));
+    const uint32_t rows = side == 0 ? 0 : (count + side - 1) / side;
+    for (uint32_t row = 0; row < rows; row++)
     {
-        CreateBuffer(bufferInfo, m_deltaTimeUBOBuffer[i], m_deltaTimeUBOMemory[i]);
-        vkMapMemory(m_device, m_deltaTimeUBOMemory[i], 0, bufferInfo.size, 0, &m_deltaTimeBufferMapped[i]);
+        const float z = static_cast<float>(row) * SCENE_INSTANCE_SPACING - halfExtent;
+        m_sceneRowNodes.push_back(m_sceneGraph->AddNode(root, glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, z))));
     }
-}
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const glm::vec3 position(static_cast<float>(i % side) * SCENE_INSTANCE_SPACING - halfExtent,
+                                 SCENE_FLOOR_HEIGHT,
+                                 static_cast<float>(i / side) * SCENE_INSTANCE_SPACING - halfExtent);
+        const glm::mat4 local = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(position.x, 0, 0)),
+                                           glm::vec3(SCENE_INSTANCE_SCALE));
+        m_sceneInstanceNodes.push_back(m_sceneGraph->AddNode(m_sceneRowNodes[i / side], local));
 
-void VulkanApp::CreateTextureImageView()
-{
-    //m_textureImageView = GenerateImageView(m_device, m_textureImage);
+        InstanceData instance{};
+        instance.transform = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(SCENE_INSTANCE_SCALE));
+        instance.color = glm::vec4(0.5f + 0.5f * glm::vec3((i % side) / static_cast<float>(side), 0.5f,
+                                                            (i / side) / static_cast<float>(side)), 1.0f);
+        instance.material = i % materialCount;
+        m_instancedRenderer->AddInstance(m_sceneBatches[i % m_sceneBatches.size()], instance);
+    }
 
-    for (auto& materialTexture : m_material->GetTextures())
+    m_sceneNodeInstances.assign(m_sceneGraph->GetNodeCount(), SCENE_NO_INSTANCE);
+    for (uint32_t i = 0; i < count; i++)
     {
-        materialTexture.second.imageView = GenerateImageView(m_device, materialTexture.second.image,
-                                                             materialTexture.second.maxMipLevels);
+        m_sceneNodeInstances[m_sceneInstanceNodes[i]] = i;
     }
+
+    m_sceneInstanceCount = count;
+    // averages of the previous count would be mixed in to the new one
+    m_graphicsTimer->ResetStatistics();
+    m_instancedRenderer->ResetStatistics();
+    m_sceneGraph->ResetStatistics();
 }
 
-void VulkanApp::CreateTextureSampler()
+void VulkanApp::SetGpuSceneObjectCount(uint32_t count)
 {
-    VkSamplerCreateInfo samplerInfo{.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
-    samplerInfo.magFilter = VK_FILTER_LINEAR; //can be VK_FILTER_NEREAST (resutls in pixelatino)
-    samplerInfo.minFilter = VK_FILTER_LINEAR; //can be VK_FILTER_NEREAST (resutls in pixelatino)
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    // what happens when we attemp to sample where there are not pixels
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT; // can be repeat, clamp to eadge or clamp to border
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_TRUE;
-
-    VkPhysicalDeviceProperties physicalDeviceProperties;
-    vkGetPhysicalDeviceProperties(m_physicalDevice, &physicalDeviceProperties);
-    samplerInfo.maxAnisotropy = physicalDeviceProperties.limits.maxSamplerAnisotropy;
-
-    //color to be used when VK_SAMPLER_ADRESSS_MODE_BORDER is selected
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    // square grid, the cubes and the models alternate
+    const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    const float halfExtent = (static_cast<float>(side) - 1.0f) * GPU_SCENE_OBJECT_SPACING * 0.5f;
+    const uint32_t materialCount = m_materials->GetMaterialCount();
+    std::vector<GpuObject> objects;
+    objects.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const glm::vec3 position(static_cast<float>(i % side) * GPU_SCENE_OBJECT_SPACING - halfExtent,
+                                 GPU_SCENE_FLOOR_HEIGHT,
+                                 static_cast<float>(i / side) * GPU_SCENE_OBJECT_SPACING - halfExtent);
+        const glm::mat4 transform = glm::scale(glm::translate(glm::mat4(1.0f), position),
+                                               glm::vec3(SCENE_INSTANCE_SCALE));
+        const glm::vec4 color(0.5f + 0.5f * glm::vec3((i / side) / static_cast<float>(side), 0.5f,
+                                                       (i % side) / static_cast<float>(side)), 1.0f);
+        objects.push_back(m_gpuDrivenRenderer->CreateObject(i % m_meshPool->GetMeshCount(), transform, color,
+                                                            i % materialCount));
+    }
+
+    // frames in flight still draw the previous objects
+    vkDeviceWaitIdle(m_device);
+    m_gpuDrivenRenderer->SetObjects(objects, m_graphicsQueue, m_comandPool);
 
-    // use uv coordinates in range (0,1) - true or (0,imageLimit) - false
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    std::vector<glm::vec4> bounds;
+    bounds.reserve(objects.size());
+    for (const GpuObject &object : objects)
+    {
+        bounds.push_back(object.bounds);
+    }
+    m_frustumCuller->SetBounds(bounds);
+    m_frustumCuller->ResetStatistics();
 
-    // compare values against reference, this will be important while calculating PCF shadow
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    m_graphicsTimer->ResetStatistics();
+    m_gpuDrivenRenderer->ResetStatistics();
+    m_gpuSceneRecordMicroseconds = 0.0;
+    m_gpuSceneRecordedFrames = 0;
+    // was measured with the previous objects
+    m_gpuSceneFrustumOnlyMs = 0.0;
+    m_gpuSceneFullDetailMs = 0.0;
+}
 
-    // mip mapping
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f; // can also be physicalDeviceProperties.limits.maxSamplerLodBias
-    samplerInfo.minLod = 0.0;
-    samplerInfo.maxLod = m_material->GetMaximalMipValue();
+void VulkanApp::AnimateScene()
+{
+    if (m_sceneInstanceCount == 0) return;
 
-    if (vkCreateSampler(m_device, &samplerInfo, nullptr, &m_textureSampler) != VK_SUCCESS)
+    const float angle = static_cast<float>(glfwGetTime());
+    const uint32_t animated = std::min(m_sceneInstanceCount, SCENE_ANIMATED_INSTANCES);
+    for (uint32_t i = 0; i < animated; i++)
     {
-        throw std::runtime_error("Failed to create texture sampler");
+        // keeps the position in the row and the scale, only the rotation around y changes
+        const glm::vec3 position(m_sceneGraph->GetLocal(m_sceneInstanceNodes[i])[3]);
+        m_sceneGraph->SetLocal(m_sceneInstanceNodes[i],
+                               glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), position),
+                                                      angle + static_cast<float>(i), glm::vec3(0, 1, 0)),
+                                          glm::vec3(SCENE_INSTANCE_SCALE)));
     }
+    const uint32_t lastRow = m_sceneRowNodes.back();
+    const float z = m_sceneGraph->GetLocal(lastRow)[3].z;
+    m_sceneGraph->SetLocal(lastRow, glm::translate(glm::mat4(1.0f), glm::vec3(0, std::sin(angle) * SCENE_ROW_HEIGHT, z)));
 
-    for (auto& material : m_material->GetTextures())
+    UpdateSceneGraph();
+}
+
+void VulkanApp::UpdateSceneGraph()
+{
+    // only the changed subtrees are recomputed and only their instances are uploaded,
+    // the rest of the buffer stays untouched on the GPU
+    m_sceneGraph->Update();
+    for (uint32_t node : m_sceneGraph->GetChangedNodes())
     {
-        material.second.sampler = m_textureSampler;
+        const uint32_t instance = m_sceneNodeInstances[node];
+        if (instance == SCENE_NO_INSTANCE) continue;
+        m_instancedRenderer->SetTransform(m_sceneBatches[instance % m_sceneBatches.size()],
+                                          instance / static_cast<uint32_t>(m_sceneBatches.size()),
+                                          m_sceneGraph->GetWorld(node));
     }
 }
 
+void VulkanApp::CreateUniformBuffers()
+{
+    DeviceContext context{};
+    context.physicalDevice = m_physicalDevice;
+    context.surface = m_sruface;
+    context.logicalDevice = m_device;
+
+    // compute and graphics of the same frame wait for different fences, so each of them has its own region
+    m_uniformAllocator = std::make_unique<UniformAllocator>(context, UNIFORM_REGION_SIZE, 2 * MAX_FRAMES_IN_FLIGHT);
+}
+
 void VulkanApp::CreateColorResources()
 {
     VkFormat colorFormat = m_swapChainImageFormat;
@@ -1387,6 +2361,31 @@ void VulkanApp::CreateColorResources()
     m_colorImageView = GenerateImageView(m_device, m_colorImage, 1, colorFormat);
 }
 
+void VulkanApp::CreateTransparencyResources()
+{
+    // written by the accumulation subpass and read by the composite, nothing else touches them
+    ImageCreateInfo transparencyImageInfo{};
+    transparencyImageInfo.physicalDevice = m_physicalDevice;
+    transparencyImageInfo.logicalDevice = m_device;
+    transparencyImageInfo.surface = m_sruface;
+    transparencyImageInfo.width = m_swapChainExtent.width;
+    transparencyImageInfo.height = m_swapChainExtent.height;
+    transparencyImageInfo.mipLevels = 1;
+    transparencyImageInfo.imageTiling = VK_IMAGE_TILING_OPTIMAL;
+    transparencyImageInfo.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+        VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    transparencyImageInfo.memoryProperteis = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    transparencyImageInfo.sampleCount = m_msaaSamples;
+
+    transparencyImageInfo.format = TRANSPARENCY_ACCUMULATION_FORMAT;
+    CreateImage(transparencyImageInfo, m_accumulationImage, m_accumulationImageMemory);
+    m_accumulationImageView = GenerateImageView(m_device, m_accumulationImage, 1, TRANSPARENCY_ACCUMULATION_FORMAT);
+
+    transparencyImageInfo.format = TRANSPARENCY_REVEALAGE_FORMAT;
+    CreateImage(transparencyImageInfo, m_revealageImage, m_revealageImageMemory);
+    m_revealageImageView = GenerateImageView(m_device, m_revealageImage, 1, TRANSPARENCY_REVEALAGE_FORMAT);
+}
+
 void VulkanApp::CreateCommandBuffers()
 {
     m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
@@ -1425,7 +2424,8 @@ void VulkanApp::CreateDepthResources()
     imageInfo.width = m_swapChainExtent.width;
     imageInfo.height = m_swapChainExtent.height;
     imageInfo.imageTiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    // Hi-Z pyramid is built from it
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.memoryProperteis = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     imageInfo.sampleCount = m_msaaSamples;
 
@@ -1436,72 +2436,213 @@ void VulkanApp::CreateDepthResources()
 
 void VulkanApp::CreateShaderStorageBuffer()
 {
-    m_shaderStorageBuffer.resize(MAX_FRAMES_IN_FLIGHT);
-    m_shaderStorageBufferMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    m_shaderStorageBuffer.resize(PARTICLE_STATE_COUNT);
+    m_shaderStorageBufferMemory.resize(PARTICLE_STATE_COUNT);
+
+    BufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.physicalDevice = m_physicalDevice;
+    bufferCreateInfo.logicalDevice = m_device;
+    bufferCreateInfo.surface = m_sruface;
+    bufferCreateInfo.size = PARTICLE_COUNT * sizeof(Particle);
+
+    for (size_t i = 0; i < PARTICLE_STATE_COUNT; i++)
+    {
+        //note the last bit flag, it is converting the buffer to be SSBO
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        CreateBuffer(bufferCreateInfo, m_shaderStorageBuffer[i], m_shaderStorageBufferMemory[i]);
+    }
+
+    DeviceContext context{};
+    context.physicalDevice = m_physicalDevice;
+    context.surface = m_sruface;
+    context.logicalDevice = m_device;
 
-    // Cretes random values between 0 and 1 with time as a seed
-    std::default_random_engine rndEngine((unsigned)time(nullptr));
-    std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+    // particles are generated straight in to the SSBOs, nothing is generated on the CPU or copied
+    m_particleInitializer = std::make_unique<ParticleInitializer>(context, m_shaderStorageBuffer, PARTICLE_COUNT);
+    InitializeParticles();
+}
 
-    float particleSpeed = 0.00025f;
-    std::vector<Particle> particles(PARTICLE_COUNT);
-    for (auto& particle : particles)
+void VulkanApp::InitializeParticles()
+{
+    if (m_particleDistribution == PARTICLE_DISTRIBUTION_MESH_SURFACE && !m_particleInitializer->HasMesh())
     {
-        float radius = 1.25f * sqrt(rndDist(rndEngine));
-        //scatter around entire circle
-        float theta = acos(1.0f - 2.0f * rndDist(rndEngine) * 2.0f * 3.14159265358979323846);
-        float phi = rndDist(rndEngine) * 2.0f * 3.14159265358979323846;
+        // model was loaded for the mesh particles, it is uploaded for the initialization when needed for the first time
+        m_particleInitializer->SetMesh(vertices, indices, PARTICLE_INIT_RADIUS);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommand(m_device, m_computeCommandPool);
+    m_particleInitializer->RecordCommands(commandBuffer, m_particleDistribution, PARTICLE_INIT_SEED,
+                                          PARTICLE_INIT_RADIUS, PARTICLE_INIT_SPEED);
+    EndSingleTimeCommand(m_device, m_computeCommandPool, commandBuffer, m_computeQueue);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "[Init] " << PARTICLE_COUNT << " particles generated on the GPU in "
+        << std::chrono::duration<double, std::milli>(end - start).count() << " ms \n";
+
+    // both SSBOs hold the same state now, the simulation starts over from the first one
+    m_stateIndex = 0;
+    m_simulationAccumulator = 0.0;
+    // CPU simulation loads the new particles from the SSBO before its next step
+    m_lastRecordedSimulationMode = PARTICLE_SIMULATION_INTEGRATE;
+}
+
+void VulkanApp::CreateSimulationBackends()
+{
+    DeviceContext context{};
+    context.physicalDevice = m_physicalDevice;
+    context.surface = m_sruface;
+    context.logicalDevice = m_device;
+
+    m_barnesHut = std::make_unique<BarnesHut>(context, m_shaderStorageBuffer, PARTICLE_COUNT);
+    m_recorder = std::make_unique<ParticleRecorder>(context, PARTICLE_COUNT);
+    m_picker = std::make_unique<ParticlePicker>(context, m_shaderStorageBuffer, PARTICLE_COUNT, MAX_FRAMES_IN_FLIGHT);
+    m_telemetry = std::make_unique<ParticleTelemetry>(context, m_shaderStorageBuffer, PARTICLE_COUNT,
+                                                      MAX_FRAMES_IN_FLIGHT);
+    m_primitives = std::make_unique<ComputePrimitives>(context, COMPUTE_PRIMITIVES_MAX_ELEMENTS);
+    m_sorter = std::make_unique<ParticleSorter>(context, m_shaderStorageBuffer, PARTICLE_COUNT, MAX_FRAMES_IN_FLIGHT);
+    // model was normalized for the mesh particles, the collider uses the same vertices
+    m_meshCollider = std::make_unique<MeshCollider>(context, m_computeQueue, m_computeCommandPool, vertices, indices,
+                                                    MESH_DISTANCE_FIELD_RESOLUTION, MESH_DISTANCE_FIELD_CACHE_PATH);
 
-        //from angle and radius to x and y
-        float x = radius * sin(theta) * cos(phi);
-        float y = radius * sin(theta) * sin(phi);
-        float z = radius * cos(theta);
+    //----------------
+    // CPU SIMULATION
+    //----------------
+    m_threadPool = std::make_unique<ThreadPool>();
+    // particles exist only on the GPU, they are read back once the CPU simulation is selected
+    m_cpuSimulation = std::make_unique<CpuSimulation>(std::vector<Particle>(), *m_threadPool);
 
+    m_cpuUploadBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_cpuUploadBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    m_cpuUploadBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-        particle.position = glm::vec3(x, y, z);
-        particle.velocity = glm::vec3(particleSpeed);
-        particle.color = glm::vec4(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine), 1.0f);
+    BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.physicalDevice = m_physicalDevice;
+    bufferCreateInfo.logicalDevice = m_device;
+    bufferCreateInfo.surface = m_sruface;
+    // previous state followed by the latest one
+    bufferCreateInfo.size = sizeof(Particle) * PARTICLE_COUNT * 2;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        CreateBuffer(bufferCreateInfo, m_cpuUploadBuffers[i], m_cpuUploadBuffersMemory[i]);
+        // persistent mapping, same as the uniform buffers
+        vkMapMemory(m_device, m_cpuUploadBuffersMemory[i], 0, bufferCreateInfo.size, 0, &m_cpuUploadBuffersMapped[i]);
     }
+}
 
-    VkDeviceSize stagingBufferSize = PARTICLE_COUNT * sizeof(Particle);
+void VulkanApp::ReadBackParticles(VkBuffer buffer, std::vector<Particle>& particles)
+{
+    VkDeviceSize size = sizeof(Particle) * PARTICLE_COUNT;
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
-    BufferCreateInfo bufferCreateInfo;
+    BufferCreateInfo bufferCreateInfo{};
     bufferCreateInfo.physicalDevice = m_physicalDevice;
     bufferCreateInfo.logicalDevice = m_device;
     bufferCreateInfo.surface = m_sruface;
-    bufferCreateInfo.size = stagingBufferSize;
-    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     bufferCreateInfo.properties = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
     CreateBuffer(bufferCreateInfo, stagingBuffer, stagingBufferMemory);
 
+    // compute queue, so that the copy is ordered after the simulation that wrote the buffer
+    CopyBuffer(m_device, m_computeQueue, m_computeCommandPool, buffer, stagingBuffer, size);
+
+    particles.resize(PARTICLE_COUNT);
     void* data;
-    vkMapMemory(m_device, stagingBufferMemory, 0, stagingBufferSize, 0, &data);
-    memcpy(data, particles.data(), (size_t)stagingBufferSize);
+    vkMapMemory(m_device, stagingBufferMemory, 0, size, 0, &data);
+    memcpy(particles.data(), data, (size_t)size);
     vkUnmapMemory(m_device, stagingBufferMemory);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+    vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+}
+
+void VulkanApp::RecordCpuSimulationUpload(VkCommandBuffer commandBuffer)
+{
+    // continue from the state the GPU simulation ended with
+    if (m_lastRecordedSimulationMode != PARTICLE_SIMULATION_CPU)
     {
-        //note the last bit flag, it is converting the buffer to be SSBO
-        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-        bufferCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        CreateBuffer(bufferCreateInfo, m_shaderStorageBuffer[i], m_shaderStorageBufferMemory[i]);
-        // copy from staging buffer to the acctual buffer on the GPU that acts like and SSBO
-        CopyBuffer(m_device, m_transferQueue, m_transferCommandPool, stagingBuffer, m_shaderStorageBuffer[i],
-                   stagingBufferSize);
+        vkDeviceWaitIdle(m_device);
+        std::vector<Particle> gpuParticles;
+        ReadBackParticles(m_shaderStorageBuffer[m_stateIndex], gpuParticles);
+        m_cpuSimulation->LoadParticles(gpuParticles);
     }
 
-    vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-    vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+    // the state before the last step is uploaded as well, so the renderer can interpolate
+    Particle* upload = static_cast<Particle*>(m_cpuUploadBuffersMapped[currentFrame]);
+    for (uint32_t step = 0; step < m_simulationSteps; step++)
+    {
+        if (step + 1 == m_simulationSteps)
+        {
+            m_cpuSimulation->WriteParticles(upload);
+        }
+        m_cpuSimulation->Step(SIMULATION_DELTA_TIME);
+    }
+    m_cpuSimulation->WriteParticles(upload + PARTICLE_COUNT);
+
+    const VkDeviceSize stateSize = sizeof(Particle) * PARTICLE_COUNT;
+    const uint32_t target = (m_stateIndex + 1) % PARTICLE_STATE_COUNT;
+
+    VkBufferCopy previousRegion{0, 0, stateSize};
+    vkCmdCopyBuffer(commandBuffer, m_cpuUploadBuffers[currentFrame], m_shaderStorageBuffer[m_stateIndex], 1,
+                    &previousRegion);
+    VkBufferCopy latestRegion{stateSize, 0, stateSize};
+    vkCmdCopyBuffer(commandBuffer, m_cpuUploadBuffers[currentFrame], m_shaderStorageBuffer[target], 1,
+                    &latestRegion);
+    m_stateIndex = target;
+
+    // next GPU step reads this buffer if the mode is switched back
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void VulkanApp::RecordReplayUpload(VkCommandBuffer commandBuffer)
+{
+    // previous state is already in the SSBO with the latest state, only the next recorded one is uploaded
+    Particle* upload = static_cast<Particle*>(m_cpuUploadBuffersMapped[currentFrame]);
+    if (!m_replay->ReadNext(upload + PARTICLE_COUNT))
+    {
+        // particles keep the last replayed state and the GPU simulates them from there
+        std::cout << RECORDING_PATH << " has no readable state, replay stopped \n";
+        m_replay.reset();
+        m_simulationMode = PARTICLE_SIMULATION_INTEGRATE;
+        return;
+    }
+
+    const VkDeviceSize stateSize = sizeof(Particle) * PARTICLE_COUNT;
+    const uint32_t target = (m_stateIndex + 1) % PARTICLE_STATE_COUNT;
+
+    VkBufferCopy latestRegion{stateSize, 0, stateSize};
+    vkCmdCopyBuffer(commandBuffer, m_cpuUploadBuffers[currentFrame], m_shaderStorageBuffer[target], 1,
+                    &latestRegion);
+    m_stateIndex = target;
+
+    // next GPU step reads this buffer if the mode is switched back
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
 }
 
 void VulkanApp::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
-    std::array<VkClearValue, 2> clearValues{};
+    std::array<VkClearValue, 5> clearValues{};
     clearValues[0].color = {{0.3f, 0.3f, 0.3f, 1.0f}};
     clearValues[1].depthStencil = {1.0f, 0};
+    // nothing accumulated and everything behind is fully revealed
+    clearValues[3].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    clearValues[4].color = {{1.0f, 0.0f, 0.0f, 0.0f}};
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -1513,9 +2654,65 @@ void VulkanApp::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imag
         throw std::runtime_error("Failed to start recording the command buffer");
     }
 
+    // queries can not be reset inside of the render pass
+    m_graphicsTimer->Reset(commandBuffer, currentFrame);
+    m_renderStatistics->Reset(commandBuffer, currentFrame);
+
+    // copies have to be outside of the render pass
+    if (m_sceneInstanceCount > 0)
+    {
+        m_instancedRenderer->RecordUpload(commandBuffer, currentFrame);
+    }
+
+    // GPU driven objects are drawn before everything else, the main render pass keeps their colour and depth
+    const bool hasGpuScene = m_gpuDrivenRenderer->GetObjectCount() > 0;
+    if (hasGpuScene)
+    {
+        RecordGpuScene(commandBuffer);
+    }
+
+    const PARTICLE_TRANSPARENCY_MODE transparencyMode = GetActiveTransparencyMode();
+    const PARTICLE_RESOLUTION resolution = GetActiveResolution();
+    const bool isReduced = resolution != PARTICLE_RESOLUTION_FULL;
+
+    std::string renderScope;
+    VkPipeline renderPipeline;
+    switch (m_renderMode)
+    {
+    case PARTICLE_RENDER_BILLBOARDS:
+        renderScope = "Render::Billboards";
+        renderPipeline = isReduced ? m_lowResolutionBillboardPipelines[transparencyMode] : m_billboardPipelines[transparencyMode];
+        break;
+    case PARTICLE_RENDER_MESHES:
+        renderScope = "Render::Meshes";
+        renderPipeline = isReduced ? m_lowResolutionMeshPipelines[transparencyMode] : m_meshPipelines[transparencyMode];
+        break;
+    default:
+        renderScope = "Render::Points";
+        renderPipeline = isReduced ? m_lowResolutionPointPipeline : m_graphicsPipeline;
+        break;
+    }
+    // transparent draws are timed on their own so the sorted and weighted paths can be compared,
+    // and so are the reduced resolutions
+    renderScope += TRANSPARENCY_SCOPE_SUFFIXES[transparencyMode];
+    renderScope += RESOLUTION_SCOPE_SUFFIXES[resolution];
+
+    // particles are drawn in to the reduced target first, the main render pass only upsamples them
+    if (isReduced)
+    {
+        m_reducedTarget->BeginRenderPass(commandBuffer);
+        m_graphicsTimer->Begin(commandBuffer, currentFrame, renderScope);
+        m_renderStatistics->Begin(commandBuffer, currentFrame, renderScope);
+        RecordParticleDraw(commandBuffer, renderPipeline, m_reducedTarget->GetExtent(), transparencyMode,
+                           1.0f / static_cast<float>(m_reducedTarget->GetDivisor()));
+        m_renderStatistics->End(commandBuffer, currentFrame);
+        m_graphicsTimer->End(commandBuffer, currentFrame, renderScope);
+        m_reducedTarget->EndRenderPass(commandBuffer);
+    }
+
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_renderPass;
+    renderPassInfo.renderPass = hasGpuScene ? m_renderPassLoad : m_renderPass;
     renderPassInfo.framebuffer = m_swapChainFrameBuffers[imageIndex];
 
     renderPassInfo.renderArea.offset = {0, 0};
@@ -1529,14 +2726,150 @@ void VulkanApp::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imag
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+    // opaque scene goes first, the particles are depth tested against it
+    if (m_sceneInstanceCount > 0)
+    {
+        VkViewport viewport{0.0f, 0.0f, static_cast<float>(m_swapChainExtent.width),
+                            static_cast<float>(m_swapChainExtent.height), 0.0f, 1.0f};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        VkRect2D scissors{{0, 0}, m_swapChainExtent};
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissors);
+
+        m_graphicsTimer->Begin(commandBuffer, currentFrame, "Render::Instances");
+        m_instancedRenderer->RecordDraw(commandBuffer, m_cameraDescriptorSet, m_frameUniformOffset,
+                                        m_materials->GetDescriptorSet());
+        m_graphicsTimer->End(commandBuffer, currentFrame, "Render::Instances");
+    }
+
+    if (isReduced)
+    {
+        // depth is linearized with the projection the particles were drawn with, the flip of y does not change it
+        m_graphicsTimer->Begin(commandBuffer, currentFrame, "Render::Upsample");
+        m_reducedTarget->RecordUpsample(commandBuffer, m_camera->getPojectionMatix());
+        m_graphicsTimer->End(commandBuffer, currentFrame, "Render::Upsample");
+    }
+    else
+    {
+        // weighted blended particles are drawn in to the accumulation, the opaque subpass stays empty
+        if (transparencyMode == PARTICLE_TRANSPARENCY_WEIGHTED)
+        {
+            vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+        }
+
+        m_graphicsTimer->Begin(commandBuffer, currentFrame, renderScope);
+        m_renderStatistics->Begin(commandBuffer, currentFrame, renderScope);
+        RecordParticleDraw(commandBuffer, renderPipeline, m_swapChainExtent, transparencyMode, 1.0f);
+        m_renderStatistics->End(commandBuffer, currentFrame);
+        m_graphicsTimer->End(commandBuffer, currentFrame, renderScope);
+    }
+
+    // render pass always goes through all of its subpasses, the last one resolves the colour
+    if (transparencyMode != PARTICLE_TRANSPARENCY_WEIGHTED)
+    {
+        vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    }
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+    if (transparencyMode == PARTICLE_TRANSPARENCY_WEIGHTED)
+    {
+        m_graphicsTimer->Begin(commandBuffer, currentFrame, "Render::Composite");
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_transparencyCompositePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_transparencyPipelineLayout, 0, 1,
+                                &m_transparencyDescriptorSet, 0, nullptr);
+        // full screen triangle
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        m_graphicsTimer->End(commandBuffer, currentFrame, "Render::Composite");
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to record command buffer !");
+    }
+}
+
+void VulkanApp::RecordGpuScene(VkCommandBuffer commandBuffer)
+{
+    // the CPU only records a few dispatches and draws, however many objects there are
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // culling works with the projection that is not flipped
+    const glm::mat4 view = m_camera->getViewMatrix();
+    const glm::mat4 projection = m_camera->getPojectionMatix();
+
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {{0.3f, 0.3f, 0.3f, 1.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = m_scenePass;
+    renderPassInfo.framebuffer = m_sceneFrameBuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = m_swapChainExtent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    VkViewport viewport{0.0f, 0.0f, static_cast<float>(m_swapChainExtent.width),
+                        static_cast<float>(m_swapChainExtent.height), 0.0f, 1.0f};
+    VkRect2D scissors{{0, 0}, m_swapChainExtent};
+
+    //----------------------
+    // EARLY (OR ONLY) DRAW
+    //----------------------
+    // objects visible in the previous frame, or every object in the frustum without the occlusion culling
+    const GpuDrivenRenderer::CULL_PASS firstPass = m_isOcclusionCullingEnabled
+                                                       ? GpuDrivenRenderer::CULL_PASS_EARLY
+                                                       : GpuDrivenRenderer::CULL_PASS_FRUSTUM;
+    m_gpuDrivenRenderer->RecordCulling(commandBuffer, currentFrame, view, projection, firstPass, *m_graphicsTimer);
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissors);
+    m_graphicsTimer->Begin(commandBuffer, currentFrame, "Render::GpuDriven");
+    m_gpuDrivenRenderer->RecordDraw(commandBuffer, m_cameraDescriptorSet, m_frameUniformOffset,
+                                    m_materials->GetDescriptorSet(), firstPass);
+    m_graphicsTimer->End(commandBuffer, currentFrame, "Render::GpuDriven");
+    vkCmdEndRenderPass(commandBuffer);
+
+    //----------------------
+    // LATE DRAW
+    //----------------------
+    // what was drawn early hides the rest, the late pass draws only what became visible since the previous frame
+    if (m_isOcclusionCullingEnabled)
+    {
+        m_hiZ->RecordBuild(commandBuffer, currentFrame, *m_graphicsTimer);
+        m_gpuDrivenRenderer->RecordCulling(commandBuffer, currentFrame, view, projection,
+                                           GpuDrivenRenderer::CULL_PASS_LATE, *m_graphicsTimer);
+
+        renderPassInfo.renderPass = m_sceneLoadPass;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissors);
+        m_graphicsTimer->Begin(commandBuffer, currentFrame, "Render::GpuDriven::Late");
+        m_gpuDrivenRenderer->RecordDraw(commandBuffer, m_cameraDescriptorSet, m_frameUniformOffset,
+                                        m_materials->GetDescriptorSet(), GpuDrivenRenderer::CULL_PASS_LATE);
+        m_graphicsTimer->End(commandBuffer, currentFrame, "Render::GpuDriven::Late");
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    m_gpuSceneRecordMicroseconds += std::chrono::duration<double, std::micro>(end - start).count();
+    m_gpuSceneRecordedFrames++;
+}
+
+void VulkanApp::RecordParticleDraw(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkExtent2D extent,
+                                   PARTICLE_TRANSPARENCY_MODE transparencyMode, float resolutionScale)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
 
-    viewport.width = static_cast<float>(m_swapChainExtent.width);
-    viewport.height = static_cast<float>(m_swapChainExtent.height);
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
 
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
@@ -1544,28 +2877,67 @@ void VulkanApp::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imag
 
     VkRect2D scissors{};
     scissors.offset = {0, 0};
-    scissors.extent = m_swapChainExtent;
+    scissors.extent = extent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissors);
 
-    VkBuffer vertexBuffers[] = {m_shaderStorageBuffer[currentFrame]};
-    VkDeviceSize offsets[] = {0};
-
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-
-    //    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
-                            &m_descriptorSets[currentFrame], 0, nullptr);
-
-    //vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-
-    vkCmdDraw(commandBuffer, PARTICLE_COUNT, 1, 0, 0);
-
-    vkCmdEndRenderPass(commandBuffer);
-
-    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    // transient set of this frame, it reads the state the frame draws
+    ParticleDrawDescriptors descriptors{};
+    descriptors.ubo = {m_uniformAllocator->GetBuffer(), 0, sizeof(UniformBufferObject)};
+    descriptors.particles = {m_shaderStorageBuffer[m_stateIndex], 0, sizeof(Particle) * PARTICLE_COUNT};
+    descriptors.previousParticles = {
+        m_shaderStorageBuffer[(m_stateIndex + 1) % PARTICLE_STATE_COUNT], 0, sizeof(Particle) * PARTICLE_COUNT
+    };
+    // sorted by the compute of the same frame
+    descriptors.drawOrder = {m_sorter->GetDrawOrderBuffer(currentFrame), 0, VK_WHOLE_SIZE};
+
+    VkDescriptorSet particleSet = m_frameDescriptorAllocators[currentFrame]->Allocate(m_descriptorSetLayout);
+    m_particleDrawTemplate->Update(particleSet, &descriptors);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &particleSet, 1,
+                            &m_frameUniformOffset);
+
+    ParticleRenderPushConstants renderParameters{};
+    renderParameters.model = glm::scale(glm::mat4(1.0f), glm::vec3(PARTICLE_MODEL_SCALE));
+    renderParameters.particleSize = m_renderMode == PARTICLE_RENDER_MESHES ? MESH_PARTICLE_SIZE : BILLBOARD_PARTICLE_SIZE;
+    renderParameters.stretchFactor = m_isBillboardStretched ? BILLBOARD_STRETCH_FACTOR : 0.0f;
+    renderParameters.maxStretch = BILLBOARD_MAX_STRETCH;
+    // time left in the accumulator is how far the frame is past the latest state
+    renderParameters.interpolation = static_cast<float>(m_simulationAccumulator / SIMULATION_STEP_SECONDS);
+    renderParameters.highlightedParticle = m_picker->GetResult().index;
+    renderParameters.opacity = transparencyMode == PARTICLE_TRANSPARENCY_OPAQUE ? 1.0f : PARTICLE_OPACITY;
+    // compute of this frame has sorted the particles back to front
+    renderParameters.useDrawOrder = transparencyMode == PARTICLE_TRANSPARENCY_SORTED ? 1 : 0;
+    renderParameters.resolutionScale = resolutionScale;
+    renderParameters.materialCount = m_materials->GetMaterialCount();
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                       sizeof(ParticleRenderPushConstants), &renderParameters);
+
+    // only the first m_drawnParticleCount particles (or sorted instances) are drawn
+    if (m_renderMode == PARTICLE_RENDER_BILLBOARDS)
+    {
+        // 4 vertices of the quad, one instance per particle
+        vkCmdDraw(commandBuffer, 4, m_drawnParticleCount, 0, 0);
+    }
+    else if (m_renderMode == PARTICLE_RENDER_MESHES)
+    {
+        // whole model, one instance per particle, every instance picks its material from the table,
+        // so all of them are still one draw
+        VkDescriptorSet materialSet = m_materials->GetDescriptorSet();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 1, 1, &materialSet,
+                                0, nullptr);
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), m_drawnParticleCount, 0, 0, 0);
+    }
+    else
     {
-        throw std::runtime_error("Failed to record command buffer !");
+        VkBuffer vertexBuffers[] = {
+            m_shaderStorageBuffer[m_stateIndex], m_shaderStorageBuffer[(m_stateIndex + 1) % PARTICLE_STATE_COUNT]
+        };
+        VkDeviceSize offsets[] = {0, 0};
+
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        vkCmdDraw(commandBuffer, m_drawnParticleCount, 1, 0, 0);
     }
 }
 
@@ -1578,16 +2950,93 @@ void VulkanApp::RecordComputeCommandBuffer(VkCommandBuffer commandBuffer)
         throw std::runtime_error("Failed to begin recording command buffer!");
     }
 
-    //bind the pipeline
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
-    //bind the descriptor sets
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1,
-                            &m_computeDescriptorSets[currentFrame], 0, nullptr
-    );
+    m_computeTimer->Reset(commandBuffer, currentFrame);
+
+    if (m_simulationSteps > 0)
+    {
+        // the first step overwrites the state the previous frame has drawn (interpolated from), the draw has to be
+        // done with it first. Compute and graphics share the queue so the barrier orders against the earlier submissions
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 0, nullptr);
+    }
+
+    if (m_simulationMode == PARTICLE_SIMULATION_CPU && m_simulationSteps > 0)
+    {
+        // nothing is dispatched, the queue only copies what the CPU computed
+        RecordCpuSimulationUpload(commandBuffer);
+    }
+    else if (m_simulationMode == PARTICLE_SIMULATION_REPLAY && m_simulationSteps > 0)
+    {
+        // one recorded state per frame that would simulate
+        RecordReplayUpload(commandBuffer);
+    }
+    else if (m_simulationMode == PARTICLE_SIMULATION_BARNES_HUT)
+    {
+        // Barnes-Hut has its own pipelines and descriptors, the parameters are passed as push constants
+        for (uint32_t step = 0; step < m_simulationSteps; step++)
+        {
+            const uint32_t target = (m_stateIndex + 1) % PARTICLE_STATE_COUNT;
+            m_barnesHut->RecordCommands(commandBuffer, currentFrame, target, *m_computeTimer, SIMULATION_DELTA_TIME,
+                                        NBODY_GRAVITY, NBODY_SOFTENING);
+            m_stateIndex = target;
+        }
+    }
+    else if (m_simulationMode != PARTICLE_SIMULATION_CPU && m_simulationMode != PARTICLE_SIMULATION_REPLAY)
+    {
+        const bool isNBody = m_simulationMode == PARTICLE_SIMULATION_NBODY_TILED;
+        const std::string timerScope = isNBody ? "Simulation::NBodyTiled" : "Simulation::Integrate";
+
+        //bind the pipeline
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, isNBody ? m_nbodyPipeline : m_computePipeline);
 
-    // PARTICLE_COUNT/256 is for the amount of local invocations of the compute shader in x axis
-    // last two parameters are for compute groups on y and z axis
-    vkCmdDispatch(commandBuffer, PARTICLE_COUNT / 256, 1, 1);
+        for (uint32_t step = 0; step < m_simulationSteps; step++)
+        {
+            // every step writes the SSBO the previous one has read, so they ping pong between the two
+            const uint32_t target = (m_stateIndex + 1) % PARTICLE_STATE_COUNT;
+
+            //bind the descriptor sets
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1,
+                                    &m_computeDescriptorSets[target], 1, &m_simulationUniformOffset);
+
+            m_computeTimer->Begin(commandBuffer, currentFrame, timerScope, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            // work group size in x was picked by the auto tuner, one invocation per particle
+            // last two parameters are for compute groups on y and z axis
+            const uint32_t workGroupSize = isNBody ? m_nbodyWorkGroupSize : m_integrateWorkGroupSize;
+            vkCmdDispatch(commandBuffer, (PARTICLE_COUNT + workGroupSize - 1) / workGroupSize, 1, 1);
+            m_computeTimer->End(commandBuffer, currentFrame, timerScope, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+            // next step reads what this one wrote and writes what this one read
+            InsertComputeBarrier(commandBuffer);
+            m_stateIndex = target;
+        }
+    }
+    // only after the recording, the CPU upload reads back the GPU state when the previous mode was not the CPU one
+    if (m_simulationSteps > 0)
+    {
+        m_lastRecordedSimulationMode = m_simulationMode;
+    }
+
+    // picks from the latest state, the result is read once the fence of this frame is waited on
+    glm::vec3 rayOrigin, rayDirection;
+    GetMouseRay(glm::scale(glm::mat4(1.0f), glm::vec3(PARTICLE_MODEL_SCALE)), rayOrigin, rayDirection);
+    m_picker->RecordCommands(commandBuffer, currentFrame, m_stateIndex, rayOrigin, rayDirection, *m_computeTimer);
+    m_telemetry->RecordCommands(commandBuffer, currentFrame, m_stateIndex, *m_computeTimer);
+    if (GetActiveTransparencyMode() == PARTICLE_TRANSPARENCY_SORTED)
+    {
+        // same model view the particles are drawn with, the graphics of this frame reads the order
+        const glm::mat4 modelView = m_camera->getViewMatrix() *
+            glm::scale(glm::mat4(1.0f), glm::vec3(PARTICLE_MODEL_SCALE));
+        m_sorter->RecordCommands(commandBuffer, currentFrame, m_stateIndex, modelView, *m_computeTimer);
+    }
+
+    // the copy runs after the simulation on the GPU, the CPU picks it up once the fence of this frame is waited on
+    if (m_recorder->ShouldCapture(m_frameNumber))
+    {
+        m_recorder->RecordCapture(commandBuffer, currentFrame, m_frameNumber, m_shaderStorageBuffer[m_stateIndex],
+                                  *m_computeTimer);
+    }
+    m_frameNumber++;
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
     {
@@ -1661,27 +3110,43 @@ void VulkanApp::CreateSyncObjects()
     }
 }
 
-void VulkanApp::UpdateUniformBuffer(uint32_t currentImage)
+void VulkanApp::UpdateSimulationUniforms()
+{
+    // compute fence of the frame has been waited for, nothing reads its region anymore
+    const uint32_t region = currentFrame;
+    m_uniformAllocator->Reset(region);
+
+    UBOComputeShader uboCompute{};
+    uboCompute.deltaTime = SIMULATION_DELTA_TIME;
+    uboCompute.MouseWorldSpace = GetMouseDirection();
+    uboCompute.particleCount = PARTICLE_COUNT;
+    uboCompute.gravity = NBODY_GRAVITY;
+    uboCompute.softening = NBODY_SOFTENING;
+    uboCompute.colliderCenter = glm::vec3(0.0f);
+    uboCompute.colliderScale = MESH_COLLIDER_SCALE;
+    uboCompute.distanceFieldMin = m_meshCollider->GetBoundsMin();
+    uboCompute.distanceFieldMax = m_meshCollider->GetBoundsMax();
+    uboCompute.isCollisionEnabled = m_isCollisionEnabled ? 1 : 0;
+    uboCompute.collisionRadius = MESH_COLLISION_RADIUS;
+    uboCompute.collisionRestitution = MESH_COLLISION_RESTITUTION;
+
+    m_simulationUniformOffset = m_uniformAllocator->Push(region, uboCompute);
+}
+
+void VulkanApp::UpdateFrameUniforms()
 {
+    // graphics fence of the frame has been waited for, nothing reads its region anymore
+    const uint32_t region = MAX_FRAMES_IN_FLIGHT + currentFrame;
+    m_uniformAllocator->Reset(region);
+
     UniformBufferObject ubo{};
-    ubo.model = glm::mat4(1.0f);
-    ubo.model = glm::translate(ubo.model, glm::vec3(0.0, 0.0f, 0.0f));
-    ubo.model = glm::scale(ubo.model, glm::vec3(1.7f));
     ubo.projection = m_camera->getPojectionMatix();
     ubo.projection[1][1] *= -1;
     ubo.view = m_camera->getViewMatrix();
     ubo.camPos = m_camera->getPosition();
-    ubo.normal = glm::transpose(glm::inverse(ubo.model));
     ubo.lightPos = m_lightPos;
 
-    memcpy(m_uniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
-
-
-    UBOComputeShader uboCompute{};
-    uboCompute.deltaTime = glm::sin(m_lastTimeFrame);
-    uboCompute.MouseWorldSpace = GetMouseDirection();
-
-    memcpy(m_deltaTimeBufferMapped[currentFrame], &uboCompute, sizeof(uboCompute));
+    m_frameUniformOffset = m_uniformAllocator->Push(region, ubo);
 }
 
 void VulkanApp::CleanupSwapChain()
@@ -1690,6 +3155,7 @@ void VulkanApp::CleanupSwapChain()
     {
         vkDestroyFramebuffer(m_device, frameBuffer, nullptr);
     }
+    vkDestroyFramebuffer(m_device, m_sceneFrameBuffer, nullptr);
 
     for (auto imageView : m_swapChainImageViews)
     {
@@ -1705,6 +3171,13 @@ void VulkanApp::CleanupSwapChain()
     vkDestroyImage(m_device, m_colorImage, nullptr);
     vkFreeMemory(m_device, m_colorImageMemory, nullptr);
 
+    vkDestroyImageView(m_device, m_accumulationImageView, nullptr);
+    vkDestroyImage(m_device, m_accumulationImage, nullptr);
+    vkFreeMemory(m_device, m_accumulationImageMemory, nullptr);
+    vkDestroyImageView(m_device, m_revealageImageView, nullptr);
+    vkDestroyImage(m_device, m_revealageImage, nullptr);
+    vkFreeMemory(m_device, m_revealageImageMemory, nullptr);
+
 
     vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
 }
@@ -1729,6 +3202,13 @@ void VulkanApp::RecreateSwapChain()
     CreateImageViews();
     CreateColorResources();
     CreateDepthResources();
+    CreateTransparencyResources();
+    // composite reads the new attachments
+    WriteTransparencyDescriptorSet();
+    m_reducedTarget->Resize(m_swapChainExtent, 1u << m_resolution);
+    m_hiZ->Resize(m_depthImage, m_depthImageView, m_swapChainExtent, m_graphicsQueue, m_comandPool);
+    m_gpuDrivenRenderer->SetPyramid(m_hiZ->GetDescriptorInfo(), m_hiZ->GetExtent());
+    m_gpuDrivenRenderer->SetLodThreshold(m_isLodEnabled ? GPU_SCENE_LOD_PIXEL_ERROR : 0.0f, m_swapChainExtent.height);
     CreateFrameBuffers();
 }
 
@@ -1750,14 +3230,24 @@ void VulkanApp::CreateLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // only used to count fragments for the benchmark, so it is fine if it is missing
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures = &deviceFeatures;
+    // descriptor indexing of the bindless materials, the indirect count of the GPU driven objects and the Hi-Z build
+    VkPhysicalDeviceVulkan12Features vulkan12Features = MaterialLibrary::GetRequiredFeatures(m_physicalDevice);
+    GpuDrivenRenderer::EnableRequiredFeatures(m_physicalDevice, deviceFeatures, vulkan12Features);
+    HiZPyramid::EnableRequiredFeatures(m_physicalDevice, deviceFeatures);
+    createInfo.pNext = &vulkan12Features;
     createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtentions.size());
     createInfo.ppEnabledExtensionNames = deviceExtentions.data();
     if (enableValidationLayers)
@@ -1779,7 +3269,14 @@ void VulkanApp::CreateLogicalDevice()
     vkGetDeviceQueue(m_device, indices.graphicsAndComputeFamily.value(), 0, &m_computeQueue);
     vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentationQueue);
 
-    this->m_material = std::make_unique<Material>(m_device);
+    this->m_materials = std::make_unique<MaterialLibrary>(DeviceContext{m_physicalDevice, m_sruface, m_device},
+                                                          MATERIAL_MAX_TEXTURES, MATERIAL_MAX_MATERIALS);
+    this->m_computeTimer = std::make_unique<GpuTimer>(m_physicalDevice, m_device,
+                                                      indices.graphicsAndComputeFamily.value(), MAX_FRAMES_IN_FLIGHT);
+    this->m_graphicsTimer = std::make_unique<GpuTimer>(m_physicalDevice, m_device,
+                                                       indices.graphicsAndComputeFamily.value(), MAX_FRAMES_IN_FLIGHT);
+    this->m_renderStatistics = std::make_unique<PipelineStatistics>(m_device, MAX_FRAMES_IN_FLIGHT,
+                                                                    deviceFeatures.pipelineStatisticsQuery == VK_TRUE);
 }
 
 void VulkanApp::CreateSurface()
@@ -1856,30 +3353,71 @@ void VulkanApp::CleanUp()
 
     CleanupSwapChain();
 
-    vkDestroySampler(m_device, m_textureSampler, nullptr);
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        vkDestroyBuffer(m_device, m_uniformBuffers[i], nullptr);
-        vkFreeMemory(m_device, m_uniformBuffersMemory[i], nullptr);
-
-        vkDestroyBuffer(m_device, m_deltaTimeUBOBuffer[i], nullptr);
-        vkFreeMemory(m_device, m_deltaTimeUBOMemory[i], nullptr);
-    }
+    m_uniformAllocator.reset();
 
-    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
-    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+    m_particleDrawTemplate.reset();
+    m_simulationTemplate.reset();
+    m_transparencyTemplate.reset();
+    m_cameraTemplate.reset();
+    m_descriptorAllocator.reset();
+    m_frameDescriptorAllocators.clear();
+    // destroys every set layout
+    m_descriptorLayoutCache.reset();
 
     vkDestroyBuffer(m_device, m_vertexBuffer, nullptr);
     vkFreeMemory(m_device, m_vertexBufferMemory, nullptr);
 
     vkDestroyBuffer(m_device, m_indexBuffer, nullptr);
     vkFreeMemory(m_device, m_indexBufferMemory, nullptr);
-    m_material.reset();
+    m_materials.reset();
+    m_computeTimer.reset();
+    m_graphicsTimer.reset();
+    m_renderStatistics.reset();
+    m_barnesHut.reset();
+    m_particleInitializer.reset();
+    m_recorder.reset();
+    m_replay.reset();
+    m_picker.reset();
+    m_telemetry.reset();
+    m_primitives.reset();
+    m_sorter.reset();
+    m_meshCollider.reset();
+    m_cpuSimulation.reset();
+    m_threadPool.reset();
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(m_device, m_cpuUploadBuffers[i], nullptr);
+        vkFreeMemory(m_device, m_cpuUploadBuffersMemory[i], nullptr);
+    }
+
+    vkDestroyPipeline(m_device, m_computePipeline, nullptr);
+    vkDestroyPipeline(m_device, m_nbodyPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_computePipelineLayout, nullptr);
 
     vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
+    vkDestroyPipeline(m_device, m_lowResolutionPointPipeline, nullptr);
+    for (size_t i = 0; i < PARTICLE_TRANSPARENCY_MODE_COUNT; i++)
+    {
+        vkDestroyPipeline(m_device, m_billboardPipelines[i], nullptr);
+        vkDestroyPipeline(m_device, m_meshPipelines[i], nullptr);
+        vkDestroyPipeline(m_device, m_lowResolutionBillboardPipelines[i], nullptr);
+        vkDestroyPipeline(m_device, m_lowResolutionMeshPipelines[i], nullptr);
+    }
+    m_reducedTarget.reset();
+    m_instancedRenderer.reset();
+    m_sceneGraph.reset();
+    m_meshBvhs.clear();
+    m_gpuDrivenRenderer.reset();
+    m_hiZ.reset();
+    m_frustumCuller.reset();
+    m_meshPool.reset();
     vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyPipeline(m_device, m_transparencyCompositePipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_transparencyPipelineLayout, nullptr);
     vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+    vkDestroyRenderPass(m_device, m_renderPassLoad, nullptr);
+    vkDestroyRenderPass(m_device, m_scenePass, nullptr);
+    vkDestroyRenderPass(m_device, m_sceneLoadPass, nullptr);
     if (enableValidationLayers)
     {
         DestroyDebugUtilsMessengerEXT(m_instance, m_debugMessanger, nullptr);
@@ -1965,6 +3503,130 @@ void VulkanApp::ProcessKeyboardInput()
     if (glfwGetKey(m_window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(m_window, true);
 
+    // simulation modes
+    if (glfwGetKey(m_window, GLFW_KEY_1) == GLFW_PRESS)
+        m_simulationMode = PARTICLE_SIMULATION_INTEGRATE;
+    if (glfwGetKey(m_window, GLFW_KEY_2) == GLFW_PRESS)
+        m_simulationMode = PARTICLE_SIMULATION_NBODY_TILED;
+    if (glfwGetKey(m_window, GLFW_KEY_3) == GLFW_PRESS)
+        m_simulationMode = PARTICLE_SIMULATION_BARNES_HUT;
+    if (glfwGetKey(m_window, GLFW_KEY_4) == GLFW_PRESS)
+        m_simulationMode = PARTICLE_SIMULATION_CPU;
+    if (IsKeyPressedOnce(GLFW_KEY_5))
+        StartReplay();
+    if (IsKeyPressedOnce(GLFW_KEY_R))
+        ToggleRecording();
+    if (IsKeyPressedOnce(GLFW_KEY_C))
+        ValidateCpuSimulation();
+    if (IsKeyPressedOnce(GLFW_KEY_P))
+        ReportPickedParticle();
+    if (IsKeyPressedOnce(GLFW_KEY_H))
+        PickSceneInstance();
+
+    // Barnes-Hut opening angle, 0 degenerates in to the exact sum
+    if (IsKeyPressedOnce(GLFW_KEY_LEFT_BRACKET))
+        m_barnesHut->SetTheta(std::max(0.0f, m_barnesHut->GetTheta() - BARNES_HUT_THETA_STEP));
+    if (IsKeyPressedOnce(GLFW_KEY_RIGHT_BRACKET))
+        m_barnesHut->SetTheta(m_barnesHut->GetTheta() + BARNES_HUT_THETA_STEP);
+    if (IsKeyPressedOnce(GLFW_KEY_V))
+        ValidateBarnesHut();
+    if (IsKeyPressedOnce(GLFW_KEY_K))
+        ValidateComputePrimitives();
+
+    // render modes
+    if (IsKeyPressedOnce(GLFW_KEY_B))
+        m_renderMode = static_cast<PARTICLE_RENDER_MODE>((m_renderMode + 1) % PARTICLE_RENDER_MODE_COUNT);
+    if (IsKeyPressedOnce(GLFW_KEY_T))
+        m_isBillboardStretched = !m_isBillboardStretched;
+    if (IsKeyPressedOnce(GLFW_KEY_M))
+    {
+        m_isCollisionEnabled = !m_isCollisionEnabled;
+        std::cout << "Mesh collision: " << (m_isCollisionEnabled ? "on" : "off")
+            << (m_simulationMode == PARTICLE_SIMULATION_INTEGRATE ? "" : " (only the GPU integration collides)") << "\n";
+    }
+    if (IsKeyPressedOnce(GLFW_KEY_O))
+    {
+        m_transparencyMode = static_cast<PARTICLE_TRANSPARENCY_MODE>(
+            (m_transparencyMode + 1) % PARTICLE_TRANSPARENCY_MODE_COUNT);
+        std::cout << "Transparency: " << TRANSPARENCY_MODE_NAMES[m_transparencyMode]
+            << (m_renderMode == PARTICLE_RENDER_POINTS ? " (points are always opaque)" : "") << "\n";
+    }
+    if (IsKeyPressedOnce(GLFW_KEY_L))
+    {
+        m_resolution = static_cast<PARTICLE_RESOLUTION>((m_resolution + 1) % PARTICLE_RESOLUTION_COUNT);
+        // images of the target are recreated, the frames in flight still sample the old ones
+        vkDeviceWaitIdle(m_device);
+        m_reducedTarget->Resize(m_swapChainExtent, 1u << m_resolution);
+        // upsample of the half and quarter resolution is timed in the same scope
+        m_graphicsTimer->ResetStatistics();
+        std::cout << "Particle resolution: " << RESOLUTION_NAMES[m_resolution]
+            << (m_transparencyMode == PARTICLE_TRANSPARENCY_WEIGHTED && m_renderMode != PARTICLE_RENDER_POINTS
+                    ? " (weighted blended transparency is drawn at the full resolution)"
+                    : "") << "\n";
+    }
+    if (IsKeyPressedOnce(GLFW_KEY_N))
+    {
+        uint32_t step = 0;
+        while (PARTICLE_COUNT / DRAWN_PARTICLE_COUNT_DIVISORS[step] != m_drawnParticleCount) step++;
+        step = (step + 1) % std::size(DRAWN_PARTICLE_COUNT_DIVISORS);
+        m_drawnParticleCount = PARTICLE_COUNT / DRAWN_PARTICLE_COUNT_DIVISORS[step];
+        // averages of the previous count would be mixed in to the new one
+        m_graphicsTimer->ResetStatistics();
+        m_renderStatistics->ResetStatistics();
+        std::cout << "Drawn particles: " << m_drawnParticleCount << "/" << PARTICLE_COUNT << "\n";
+    }
+    if (IsKeyPressedOnce(GLFW_KEY_G))
+    {
+        uint32_t step = 0;
+        while (SCENE_INSTANCE_COUNTS[step] != m_sceneInstanceCount) step++;
+        step = (step + 1) % std::size(SCENE_INSTANCE_COUNTS);
+        SetSceneInstanceCount(SCENE_INSTANCE_COUNTS[step]);
+        std::cout << "Scene instances: " << m_sceneInstanceCount << "\n";
+    }
+    if (IsKeyPressedOnce(GLFW_KEY_U))
+    {
+        uint32_t step = 0;
+        while (GPU_SCENE_OBJECT_COUNTS[step] != m_gpuDrivenRenderer->GetObjectCount()) step++;
+        step = (step + 1) % std::size(GPU_SCENE_OBJECT_COUNTS);
+        SetGpuSceneObjectCount(GPU_SCENE_OBJECT_COUNTS[step]);
+        std::cout << "GPU driven objects: " << m_gpuDrivenRenderer->GetObjectCount() << "\n";
+    }
+    if (IsKeyPressedOnce(GLFW_KEY_X))
+    {
+        m_isCpuCullingEnabled = !m_isCpuCullingEnabled;
+        std::cout << "CPU frustum culling of the GPU driven objects: " << (m_isCpuCullingEnabled ? "on" : "off")
+            << (m_frustumCuller->GetObjectCount() == 0 ? " (key U places the objects)" : "") << "\n";
+    }
+    if (IsKeyPressedOnce(GLFW_KEY_Z))
+    {
+        m_isOcclusionCullingEnabled = !m_isOcclusionCullingEnabled;
+        // averages of the other culling would be mixed in to the new one
+        m_graphicsTimer->ResetStatistics();
+        m_gpuDrivenRenderer->ResetStatistics();
+        m_gpuSceneFullDetailMs = 0.0;
+        std::cout << "Occlusion culling of the GPU driven objects: " << (m_isOcclusionCullingEnabled ? "on" : "off")
+            << "\n";
+    }
+    if (IsKeyPressedOnce(GLFW_KEY_J))
+    {
+        m_isLodEnabled = !m_isLodEnabled;
+        m_gpuDrivenRenderer->SetLodThreshold(m_isLodEnabled ? GPU_SCENE_LOD_PIXEL_ERROR : 0.0f,
+                                             m_swapChainExtent.height);
+        // averages of the full detail would be mixed in to the LODs
+        m_graphicsTimer->ResetStatistics();
+        m_gpuDrivenRenderer->ResetStatistics();
+        std::cout << "LODs of the GPU driven objects: " << (m_isLodEnabled ? "on" : "off") << "\n";
+    }
+
+    // starts over with the next distribution of the initial particles
+    if (IsKeyPressedOnce(GLFW_KEY_I))
+    {
+        m_particleDistribution = static_cast<PARTICLE_DISTRIBUTION>(
+            (m_particleDistribution + 1) % PARTICLE_DISTRIBUTION_COUNT);
+        vkDeviceWaitIdle(m_device);
+        InitializeParticles();
+    }
+
 
     const float lightSpeed = 0.8f; // adjust accordingly
     if (glfwGetKey(m_window, GLFW_KEY_UP) == GLFW_PRESS)
@@ -1981,37 +3643,46 @@ void VulkanApp::ProcessKeyboardInput()
         m_lightPos.y -= lightSpeed;
 }
 
-void VulkanApp::GenerateGeometryVertices(GEOMETRY_TYPE geometryType)
+bool VulkanApp::IsKeyPressedOnce(int key)
+{
+    // true only in the frame in which the key went down, holding it does not repeat the action
+    bool isPressed = glfwGetKey(m_window, key) == GLFW_PRESS;
+    bool wasPressed = m_previousKeyStates[key];
+    m_previousKeyStates[key] = isPressed;
+    return isPressed && !wasPressed;
+}
+
+void VulkanApp::GenerateGeometryVertices(GEOMETRY_TYPE geometryType, std::vector<Vertex>& outVertices,
+                                         std::vector<uint32_t>& outIndices)
 {
-    m_geometryType = geometryType;
     switch (geometryType)
     {
     case CUBE:
         {
-            vertices = VertexData::cubeVertices;
-            indices = VertexData::cubeIndices;
+            outVertices = VertexData::cubeVertices;
+            outIndices = VertexData::cubeIndices;
             break;
         }
     case PLANE:
         {
-            vertices = VertexData::planeVertices;
-            indices = VertexData::planeIndices;
+            outVertices = VertexData::planeVertices;
+            outIndices = VertexData::planeIndices;
             break;
         }
     case SPHERE:
         {
-            GenerateSphere(vertices, indices);
+            GenerateSphere(outVertices, outIndices);
             break;
         }
     case MODEL:
         {
-            LoadModel();
+            LoadModel(outVertices, outIndices);
         }
     }
 }
 
 
-void VulkanApp::LoadModel()
+void VulkanApp::LoadModel(std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices)
 {
     //contains vertices, normals, uv all packed together
     tinyobj::attrib_t attrib;
@@ -2058,40 +3729,142 @@ void VulkanApp::LoadModel()
             if (uniqueVetices.count(vertex) == 0)
             {
                 //add its index
-                uniqueVetices[vertex] = static_cast<uint32_t>(vertices.size());
+                uniqueVetices[vertex] = static_cast<uint32_t>(outVertices.size());
                 //add vertex itself
-                vertices.push_back(vertex);
+                outVertices.push_back(vertex);
             }
             //store only index
-            indices.push_back(uniqueVetices[vertex]);
+            outIndices.push_back(uniqueVetices[vertex]);
         }
     }
 }
 
 glm::vec3 VulkanApp::GetMouseDirection()
 {
+    glm::vec3 origin, direction;
+    GetMouseRay(glm::mat4(1.0f), origin, direction);
+    return direction;
+}
+
+PARTICLE_TRANSPARENCY_MODE VulkanApp::GetActiveTransparencyMode()
+{
+    // points have no transparent pipeline
+    return m_renderMode == PARTICLE_RENDER_POINTS ? PARTICLE_TRANSPARENCY_OPAQUE : m_transparencyMode;
+}
 
-    float x = (2.0f * m_mousePos.x) / WIDTH - 1.0f;
-    float y = 1.0f-(1.0f - (2.0f * m_mousePos.y) / HEIGHT);
-    float z = 1.0f;
+PARTICLE_RESOLUTION VulkanApp::GetActiveResolution()
+{
+    // weighted blended transparency accumulates in to the attachments of the full resolution render pass
+    return GetActiveTransparencyMode() == PARTICLE_TRANSPARENCY_WEIGHTED ? PARTICLE_RESOLUTION_FULL : m_resolution;
+}
 
-    // from 0:widht, 0:height to -1 and 1
-    glm::vec3 rayNDS = glm::vec3(x, y, z);
+void VulkanApp::GetMouseRay(const glm::mat4 &model, glm::vec3 &origin, glm::vec3 &direction)
+{
+    // mouse position is in the window coordinates, which differ from the frame buffer ones on high DPI screens
+    int width, height;
+    glfwGetWindowSize(m_window, &width, &height);
+    if (width == 0 || height == 0)
+    {
+        origin = glm::vec3(0.0f);
+        direction = glm::vec3(0.0f, 0.0f, -1.0f);
+        return;
+    }
 
-    // clip space of the view frustrum
-    glm::vec4 rayClipSpace = glm::vec4(rayNDS.x, rayNDS.y, 1.0f,1.0f);
+    // projection is flipped the same way as for the rendering, so y of the window goes straight to the NDC
+    glm::mat4 projection = m_camera->getPojectionMatix();
+    projection[1][1] *= -1;
 
-    // to the camera spce
-    glm::vec4 rayCameraSpace = glm::inverse(m_camera->getPojectionMatix())* rayClipSpace;
-    rayCameraSpace = glm::vec4(rayCameraSpace.x, rayCameraSpace.y,- 1.0f,0.0f);
+    // points on the near (z = 0) and far (z = 1) plane under the mouse taken back with single inverse
+    // of the whole transformation, ray ends up in the space of the model
+    glm::mat4 inverseTransformation = glm::inverse(projection * m_camera->getViewMatrix() * model);
+    float x = (2.0f * static_cast<float>(m_mousePos.x)) / static_cast<float>(width) - 1.0f;
+    float y = (2.0f * static_cast<float>(m_mousePos.y)) / static_cast<float>(height) - 1.0f;
 
-    // to the world space
-    glm::vec3 rayWorldSpce =  glm::normalize(glm::vec3(glm::inverse(m_camera->getViewMatrix()) * rayCameraSpace));
+    glm::vec4 nearPoint = inverseTransformation * glm::vec4(x, y, 0.0f, 1.0f);
+    glm::vec4 farPoint = inverseTransformation * glm::vec4(x, y, 1.0f, 1.0f);
+    origin = glm::vec3(nearPoint) / nearPoint.w;
+    direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+}
 
-    glm::vec3 CameraPosition = m_camera->getPosition();
-    glm::vec3 RayDirection = glm::normalize(rayWorldSpce);
+void VulkanApp::ReportPickedParticle()
+{
+    // result is one or two frames old, which is not visible at the speed the particles move
+    if (!m_picker->HasPickedParticle())
+    {
+        std::cout << "[Picking] No particle under the mouse \n";
+        return;
+    }
+
+    const ParticlePicker::PickResult &result = m_picker->GetResult();
+    std::cout << "[Picking] Particle " << result.index << " at (" << result.position.x << ", " << result.position.y
+        << ", " << result.position.z << "), velocity (" << result.velocity.x << ", " << result.velocity.y << ", "
+        << result.velocity.z << "), " << result.angle << " rad from the mouse ray \n";
+}
+
+void VulkanApp::PickSceneInstance()
+{
+    if (m_sceneInstanceCount == 0)
+    {
+        std::cout << "[Picking] No instances in the scene, key G places them \n";
+        return;
+    }
+
+    // instances placed by key G in the same input have no world transforms until the graph is updated
+    UpdateSceneGraph();
+
+    glm::vec3 origin, direction;
+    GetMouseRay(glm::mat4(1.0f), origin, direction);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    MeshBvhHit closest;
+    uint32_t closestInstance = SCENE_NO_INSTANCE;
+    uint32_t testedInstances = 0;
+    for (uint32_t i = 0; i < m_sceneInstanceCount; i++)
+    {
+        const MeshBvh &bvh = *m_meshBvhs[i % m_sceneBatches.size()];
+        const glm::mat4 &world = m_sceneGraph->GetWorld(m_sceneInstanceNodes[i]);
+
+        // bounding sphere of the mesh first, the scale of the instances is uniform
+        const glm::vec3 centre(world * glm::vec4((bvh.GetBoundsMin() + bvh.GetBoundsMax()) * 0.5f, 1.0f));
+        const float radius = glm::length(bvh.GetBoundsMax() - bvh.GetBoundsMin()) * 0.5f *
+            glm::length(glm::vec3(world[0]));
+        const glm::vec3 toCentre = centre - origin;
+        const float along = glm::dot(toCentre, direction);
+        if (glm::dot(toCentre, toCentre) - along * along > radius * radius || along + radius < 0.0f ||
+            along - radius > closest.distance)
+        {
+            continue;
+        }
+
+        // direction keeps the scale of the instance, so the distance of the hit stays in the world units
+        const glm::mat4 inverse = glm::inverse(world);
+        MeshBvhHit hit;
+        testedInstances++;
+        if (bvh.Intersect(glm::vec3(inverse * glm::vec4(origin, 1.0f)), glm::mat3(inverse) * direction, hit,
+                          closest.distance))
+        {
+            closest = hit;
+            closestInstance = i;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+
+    if (closestInstance == SCENE_NO_INSTANCE)
+    {
+        std::cout << "[Picking] No instance under the mouse, " << testedInstances << " of " << m_sceneInstanceCount
+            << " instances tested in " << microseconds << " us \n";
+        return;
+    }
 
-    return {RayDirection.x, RayDirection.y, RayDirection.z};
+    const glm::mat4 &world = m_sceneGraph->GetWorld(m_sceneInstanceNodes[closestInstance]);
+    const glm::vec3 position = origin + direction * closest.distance;
+    const glm::vec3 normal = glm::normalize(glm::mat3(world) * closest.normal);
+    std::cout << "[Picking] Instance " << closestInstance << " ("
+        << SCENE_MESH_NAMES[closestInstance % m_sceneBatches.size()] << "), triangle " << closest.triangle << " at ("
+        << position.x << ", " << position.y << ", " << position.z << "), normal (" << normal.x << ", " << normal.y
+        << ", " << normal.z << "), " << testedInstances << " of " << m_sceneInstanceCount
+        << " instances tested by their BVH in " << microseconds << " us \n";
 }
 
 VkFormat VulkanApp::FindDepthFormat()
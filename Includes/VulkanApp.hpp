@@ -19,18 +19,155 @@
 #include <glm/glm.hpp>
 
 #include "Camera/Camera.hpp"
+#include "Compute/ComputePrimitives.hpp"
+#include "Culling/FrustumCuller.hpp"
+#include "Descriptors/DescriptorAllocator.hpp"
+#include "Descriptors/DescriptorLayoutCache.hpp"
+#include "Descriptors/DescriptorUpdateTemplate.hpp"
 #include "memory"
 #include "VertexData.hpp"
 #include <stb/stb_image.h>
 #include <unordered_map>
 #include <sys/prctl.h>
 
-#include "Material/Material.hpp"
+#include "Material/MaterialLibrary.hpp"
+#include "Memory/UniformAllocator.hpp"
+#include "Picking/MeshBvh.hpp"
+#include "Picking/ParticlePicker.hpp"
+#include "Profiling/ComputeAutoTuner.hpp"
+#include "Profiling/GpuTimer.hpp"
+#include "Profiling/ParticleTelemetry.hpp"
+#include "Profiling/PipelineStatistics.hpp"
+#include "Recording/ParticleRecorder.hpp"
+#include "Recording/ParticleReplay.hpp"
+#include "Rendering/GpuDrivenRenderer.hpp"
+#include "Rendering/HiZPyramid.hpp"
+#include "Rendering/InstancedMeshRenderer.hpp"
+#include "Rendering/MeshPool.hpp"
+#include "Rendering/MeshSimplifier.hpp"
+#include "Rendering/ParticleSorter.hpp"
+#include "Rendering/ReducedResolutionTarget.hpp"
+#include "Scene/SceneGraph.hpp"
+#include "Simulation/BarnesHut.hpp"
+#include "Simulation/CpuSimulation.hpp"
+#include "Simulation/MeshCollider.hpp"
+#include "Simulation/ParticleInitializer.hpp"
+#include "Threading/ThreadPool.hpp"
 
 constexpr uint32_t WIDTH = 800;
 constexpr uint32_t HEIGHT = 600;
 constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 constexpr uint32_t PARTICLE_COUNT = 8192;
+// particle state is ping ponged between two SSBOs, one holds the latest state and the other one the previous state
+constexpr uint32_t PARTICLE_STATE_COUNT = 2;
+// sets the first pool of every descriptor allocator holds, the later pools grow when they run out
+constexpr uint32_t DESCRIPTOR_INITIAL_SETS_PER_POOL = 4;
+// bytes of the uniform data one frame can write on one queue, the allocator throws when a frame needs more
+constexpr VkDeviceSize UNIFORM_REGION_SIZE = 16 * 1024;
+// uniform scale of the model matrix the particles are drawn with
+constexpr float PARTICLE_MODEL_SCALE = 1.7f;
+
+// initial particles are generated on the GPU, the same seed gives the same particles on every run
+constexpr uint32_t PARTICLE_INIT_SEED = 1337;
+constexpr float PARTICLE_INIT_RADIUS = 1.25f;
+constexpr float PARTICLE_INIT_SPEED = 0.00025f;
+
+// fixed time step simulation, every rendered frame runs as many steps as the elapsed time needs,
+// all of them recorded in to one compute command buffer
+constexpr double SIMULATION_STEP_SECONDS = 1.0 / 120.0;
+// time step passed to the simulation, in the units its constants were tuned for
+constexpr float SIMULATION_DELTA_TIME = 1.0f;
+// upper limit of steps per frame, when the frame takes longer than that the simulation slows down instead of
+// spending even more time on catching up
+constexpr uint32_t SIMULATION_MAX_STEPS_PER_FRAME = 4;
+
+// N-body simulation parameters, tile size and unroll factor are picked by the auto tuner
+constexpr float NBODY_GRAVITY = 1e-7f;
+constexpr float NBODY_SOFTENING = 0.05f;
+
+// tuned kernel variants are stored here, delete the file to tune the kernels again
+constexpr const char *COMPUTE_TUNING_CACHE_PATH = "compute_tuning.cache";
+
+// how much is the Barnes-Hut opening angle changed by single key press
+constexpr float BARNES_HUT_THETA_STEP = 0.1f;
+
+// values the compute primitives are validated and benchmarked on (key K)
+constexpr uint32_t COMPUTE_PRIMITIVES_MAX_ELEMENTS = 1 << 22;
+
+// billboard particles, size is half of the quad in the view space
+constexpr float BILLBOARD_PARTICLE_SIZE = 0.01f;
+constexpr float BILLBOARD_STRETCH_FACTOR = 2000.0f;
+constexpr float BILLBOARD_MAX_STRETCH = 6.0f;
+
+// mesh particles, the model is normalized to the radius of 1 and scaled to this radius
+constexpr float MESH_PARTICLE_SIZE = 0.015f;
+// slots of the bindless material library, mesh particles cycle through the materials it holds
+constexpr uint32_t MATERIAL_MAX_TEXTURES = 64;
+constexpr uint32_t MATERIAL_MAX_MATERIALS = 256;
+
+// alpha of the billboards and meshes when they are drawn transparent (key O)
+constexpr float PARTICLE_OPACITY = 0.35f;
+// weighted blended transparency, weighted sums can get large so the accumulation needs floats
+constexpr VkFormat TRANSPARENCY_ACCUMULATION_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+constexpr VkFormat TRANSPARENCY_REVEALAGE_FORMAT = VK_FORMAT_R16_SFLOAT;
+// indexed by PARTICLE_TRANSPARENCY_MODE
+constexpr const char *TRANSPARENCY_MODE_NAMES[] = {"opaque", "sorted", "weighted blended"};
+constexpr const char *TRANSPARENCY_SCOPE_SUFFIXES[] = {"", "::Sorted", "::Weighted"};
+
+// particles drawn at reduced resolution and upsampled (key L), indexed by PARTICLE_RESOLUTION.
+// Weighted blended transparency is always drawn at the full resolution
+constexpr const char *RESOLUTION_NAMES[] = {"full", "half", "quarter"};
+constexpr const char *RESOLUTION_SCOPE_SUFFIXES[] = {"", "::Half", "::Quarter"};
+// how many of the particles are drawn (key N), fill rate of the resolutions is compared at each of them
+constexpr uint32_t DRAWN_PARTICLE_COUNT_DIVISORS[] = {8, 4, 2, 1};
+
+// collision of the integrated particles with the loaded model (key M), the model is centred at the origin and
+// scaled from the radius of 1 to MESH_COLLIDER_SCALE
+constexpr float MESH_COLLIDER_SCALE = 0.6f;
+constexpr float MESH_COLLISION_RADIUS = 0.01f;
+constexpr float MESH_COLLISION_RESTITUTION = 0.5f;
+constexpr uint32_t MESH_DISTANCE_FIELD_RESOLUTION = 64;
+// baked distance field of the model, delete the file to bake it again
+constexpr const char *MESH_DISTANCE_FIELD_CACHE_PATH = "mesh_distance_field.cache";
+
+// instanced copies of the cube and the model on a grid below the particles, key G steps through the counts,
+// the first SCENE_ANIMATED_INSTANCES of them spin so only their range is uploaded every frame.
+// In the scene graph every row of the grid is a node under the root and its instances are below it,
+// the last row rises and falls by SCENE_ROW_HEIGHT and its instances follow it
+constexpr uint32_t SCENE_INSTANCE_COUNTS[] = {0, 1, 100, 1000, 10000, 100000};
+constexpr uint32_t SCENE_MAX_INSTANCES = 100000;
+constexpr uint32_t SCENE_ANIMATED_INSTANCES = 256;
+constexpr float SCENE_INSTANCE_SPACING = 0.5f;
+constexpr float SCENE_INSTANCE_SCALE = 0.15f;
+constexpr float SCENE_FLOOR_HEIGHT = -4.0f;
+constexpr float SCENE_ROW_HEIGHT = 0.5f;
+// node that has no instance drawn for it
+constexpr uint32_t SCENE_NO_INSTANCE = UINT32_MAX;
+
+// GPU driven objects on a wider grid below the instanced ones, key U steps through the counts,
+// most of the objects at 1M are outside of the frustum and culled on the GPU,
+// key Z toggles the two phase occlusion culling against the Hi-Z pyramid,
+// key X culls the same objects on the CPU every frame to measure its throughput,
+// key J toggles the LODs of the meshes the culling picks for every object
+constexpr uint32_t GPU_SCENE_OBJECT_COUNTS[] = {0, 10000, 100000, 1000000};
+constexpr uint32_t GPU_SCENE_MAX_OBJECTS = 1000000;
+constexpr float GPU_SCENE_OBJECT_SPACING = 1.0f;
+constexpr float GPU_SCENE_FLOOR_HEIGHT = -6.0f;
+// object is drawn with the coarsest LOD whose error covers at most this many pixels
+constexpr float GPU_SCENE_LOD_PIXEL_ERROR = 1.0f;
+
+// BVH of every mesh of the scene (in the order of the batches), key H picks the instance under the mouse with them
+constexpr const char *SCENE_MESH_NAMES[] = {"cube", "model"};
+constexpr const char *MESH_BVH_CACHE_PATHS[] = {"cube_bvh.cache", "model_bvh.cache"};
+// random rays shot at every BVH once it is built or loaded
+constexpr uint32_t MESH_BVH_BENCHMARK_RAYS = 100000;
+
+// particle state recording, key R starts and stops it and key 5 replays the file
+const std::string RECORDING_PATH = "particles.prec";
+constexpr uint32_t RECORDING_FRAME_INTERVAL = 4;
+
+// how often (in seconds) are the GPU timings printed to the console
+constexpr double BENCHMARK_REPORT_INTERVAL = 2.0;
 
 const std::string MODEL_PATH = "Includes/Models/TIE Fighter.obj";
 const std::string TEXTURE_PATH = "Textures/TIE_color.png";
@@ -98,32 +235,50 @@ private:
     void CreateCommandPool();
     void CreateVertexBuffers();
     void CreateIndexBuffers();
+    void CreateMeshBuffers();
+    void CreateMaterials();
+    void CreateScene();
+    void SetSceneInstanceCount(uint32_t count);
+    void SetGpuSceneObjectCount(uint32_t count);
+    void AnimateScene();
+    // propagates the changed transforms of the scene graph and uploads only the instances below them
+    void UpdateSceneGraph();
     void CreateUniformBuffers();
     void CreateCommandBuffers();
     void CreateDepthResources();
     void CreateShaderStorageBuffer();
+    void InitializeParticles();
+    void CreateSimulationBackends();
+    void ReadBackParticles(VkBuffer buffer, std::vector<Particle> &particles);
+    void RecordCpuSimulationUpload(VkCommandBuffer commandBuffer);
+    void RecordReplayUpload(VkCommandBuffer commandBuffer);
     void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void RecordParticleDraw(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkExtent2D extent,
+                            PARTICLE_TRANSPARENCY_MODE transparencyMode, float resolutionScale);
+    // culling and draws of the GPU driven objects before the main render pass, which then keeps their colour and depth
+    void RecordGpuScene(VkCommandBuffer commandBuffer);
     void RecordComputeCommandBuffer(VkCommandBuffer commandBuffer);
     VkCommandBuffer StartRecordingCommandBuffer();
     void FlushCommandBuffer(VkCommandBuffer commandBuffer);
-    void CreateDescriptorPool();
+    void CreateDescriptorAllocators();
     void CreateDescriptorSet();
     //-----------------------------------
 
     //---------------------
     // TEXTURES AND IMAGES
     //---------------------
-    void CreateTextureImage();
-    void CreateTextureImageView();
-    void CreateTextureSampler();
     void CreateColorResources();
+    void CreateTransparencyResources();
+    void WriteTransparencyDescriptorSet();
     //---------------------
 
     //---------------------
     // SYNCHRONIZATION
     //---------------------
     void CreateSyncObjects();
-    void UpdateUniformBuffer(uint32_t currentImage);
+    // write the constants of the current frame in to its regions of the uniform allocator
+    void UpdateSimulationUniforms();
+    void UpdateFrameUniforms();
     //---------------------
 
 
@@ -132,6 +287,13 @@ private:
     //-------------------------
     void MainLoop();
     void DrawFrame();
+    uint32_t AdvanceSimulationClock();
+    void ReportBenchmark();
+    void ValidateBarnesHut();
+    void ValidateCpuSimulation();
+    void ValidateComputePrimitives();
+    void ToggleRecording();
+    void StartReplay();
     //-------------------------
 
     //-------------
@@ -150,15 +312,23 @@ private:
     static void MouseClickCallback(GLFWwindow *window, int button, int action, int mods);
     static void MouseScrollCallback(GLFWwindow *window, double xoffset, double yoffset);
     void ProcessKeyboardInput();
+    bool IsKeyPressedOnce(int key);
     //---------------------
 
     //---------------------
     // MISCELLANEOUS
     //---------------------
-    void GenerateGeometryVertices(GEOMETRY_TYPE geometryType);
-    void LoadModel();
+    void GenerateGeometryVertices(GEOMETRY_TYPE geometryType, std::vector<Vertex> &outVertices,
+                                  std::vector<uint32_t> &outIndices);
+    void LoadModel(std::vector<Vertex> &outVertices, std::vector<uint32_t> &outIndices);
     VkFormat FindDepthFormat();
     glm::vec3 GetMouseDirection();
+    void GetMouseRay(const glm::mat4 &model, glm::vec3 &origin, glm::vec3 &direction);
+    PARTICLE_TRANSPARENCY_MODE GetActiveTransparencyMode();
+    PARTICLE_RESOLUTION GetActiveResolution();
+    void ReportPickedParticle();
+    // closest instance of the scene under the mouse, tested against the BVH of its mesh
+    void PickSceneInstance();
     //-----------------
 
 
@@ -187,12 +357,39 @@ private:
     std::vector<VkFramebuffer> m_swapChainFrameBuffers;
 
     VkRenderPass m_renderPass;
+    // same as m_renderPass, keeps the colour and the depth of the GPU driven objects instead of clearing them
+    VkRenderPass m_renderPassLoad;
+    // colour and depth only, the GPU driven objects are drawn there so the Hi-Z pyramid can be built in between
+    // the early and the late draw, the first one clears and the second one keeps what was drawn
+    VkRenderPass m_scenePass;
+    VkRenderPass m_sceneLoadPass;
+    VkFramebuffer m_sceneFrameBuffer;
     VkDescriptorSetLayout m_descriptorSetLayout;
     VkDescriptorSetLayout m_computeDescryptorSetLayout;
     VkPipelineLayout m_pipelineLayout;
     VkPipelineLayout m_computePipelineLayout;
     VkPipeline m_graphicsPipeline;
+    // indexed by PARTICLE_TRANSPARENCY_MODE
+    std::array<VkPipeline, PARTICLE_TRANSPARENCY_MODE_COUNT> m_billboardPipelines{};
+    std::array<VkPipeline, PARTICLE_TRANSPARENCY_MODE_COUNT> m_meshPipelines{};
+    // same pipelines for the reduced resolution target, there is no weighted blended one
+    VkPipeline m_lowResolutionPointPipeline;
+    std::array<VkPipeline, PARTICLE_TRANSPARENCY_MODE_COUNT> m_lowResolutionBillboardPipelines{};
+    std::array<VkPipeline, PARTICLE_TRANSPARENCY_MODE_COUNT> m_lowResolutionMeshPipelines{};
+    // full screen composite of the weighted blended transparency, reads the accumulation as input attachments
+    VkDescriptorSetLayout m_transparencyDescriptorSetLayout;
+    VkDescriptorSet m_transparencyDescriptorSet;
+    VkPipelineLayout m_transparencyPipelineLayout;
+    VkPipeline m_transparencyCompositePipeline;
+    // view and projection alone (dynamic offset), for the pipelines that do not read the particles
+    VkDescriptorSetLayout m_cameraDescriptorSetLayout;
+    VkDescriptorSet m_cameraDescriptorSet;
     VkPipeline m_computePipeline;
+    VkPipeline m_nbodyPipeline;
+    // specialization of the compute kernels picked by the auto tuner
+    uint32_t m_integrateWorkGroupSize = 256;
+    uint32_t m_nbodyWorkGroupSize = 256;
+    uint32_t m_nbodyUnrollFactor = 8;
 
     VkCommandPool m_comandPool;
     VkCommandPool m_transferCommandPool;
@@ -213,17 +410,17 @@ private:
     std::vector<VkBuffer> m_shaderStorageBuffer;
     std::vector<VkDeviceMemory> m_shaderStorageBufferMemory;
 
+    // CPU simulation writes the previous and the latest state here, both are copied to the SSBOs
+    std::vector<VkBuffer> m_cpuUploadBuffers;
+    std::vector<VkDeviceMemory> m_cpuUploadBuffersMemory;
+    std::vector<void*> m_cpuUploadBuffersMapped;
+
     VkBuffer m_vertexBuffer;
     VkDeviceMemory m_vertexBufferMemory;
 
     VkBuffer m_indexBuffer;
     VkDeviceMemory m_indexBufferMemory;
 
-    VkImage m_textureImage;
-    VkImageView m_textureImageView;
-    VkDeviceMemory m_textureImageMemory;
-    VkSampler m_textureSampler;
-
     VkImage m_colorImage;
     VkDeviceMemory m_colorImageMemory;
     VkImageView m_colorImageView;
@@ -232,18 +429,61 @@ private:
     VkDeviceMemory m_depthMemory;
     VkImageView m_depthImageView;
 
-    VkDescriptorPool m_descriptorPool;
-    VkDescriptorPool m_computeDescriptorPool;
-    std::vector<VkDescriptorSet> m_descriptorSets;
-    std::vector<VkDescriptorSet> m_computeDescriptorSets;
+    // weighted blended transparency, only live inside the render pass
+    VkImage m_accumulationImage;
+    VkDeviceMemory m_accumulationImageMemory;
+    VkImageView m_accumulationImageView;
+    VkImage m_revealageImage;
+    VkDeviceMemory m_revealageImageMemory;
+    VkImageView m_revealageImageView;
 
-    std::vector<VkBuffer> m_uniformBuffers;
-    std::vector<VkDeviceMemory> m_uniformBuffersMemory;
-    std::vector<void*> m_uniformBuffersMapped;
+    //---------------------
+    // DESCRIPTORS
+    //---------------------
+    // infos of every binding of the sets in the order of the bindings, the update templates read them
+    struct ParticleDrawDescriptors {
+        VkDescriptorBufferInfo ubo;
+        VkDescriptorBufferInfo particles;
+        VkDescriptorBufferInfo previousParticles;
+        VkDescriptorBufferInfo drawOrder;
+    };
+    struct SimulationDescriptors {
+        VkDescriptorBufferInfo ubo;
+        VkDescriptorBufferInfo particlesIn;
+        VkDescriptorBufferInfo particlesOut;
+        VkDescriptorImageInfo distanceField;
+    };
+    struct TransparencyDescriptors {
+        VkDescriptorImageInfo accumulation;
+        VkDescriptorImageInfo revealage;
+    };
+    struct CameraDescriptors {
+        VkDescriptorBufferInfo ubo;
+    };
+
+    // owns every set layout of the app, the ones with the same bindings are shared
+    std::unique_ptr<DescriptorLayoutCache> m_descriptorLayoutCache;
+    // sets that live as long as the app
+    std::unique_ptr<DescriptorAllocator> m_descriptorAllocator;
+    // transient sets of the frame in flight, reset once its fence is waited for
+    std::vector<std::unique_ptr<DescriptorAllocator>> m_frameDescriptorAllocators;
+    std::unique_ptr<DescriptorUpdateTemplate> m_particleDrawTemplate;
+    std::unique_ptr<DescriptorUpdateTemplate> m_simulationTemplate;
+    std::unique_ptr<DescriptorUpdateTemplate> m_transparencyTemplate;
+    std::unique_ptr<DescriptorUpdateTemplate> m_cameraTemplate;
+    // frames since the descriptor statistics were reported
+    uint64_t m_descriptorFrameCount = 0;
+    // indexed by the SSBO the step writes
+    std::vector<VkDescriptorSet> m_computeDescriptorSets;
 
-    std::vector<VkBuffer> m_deltaTimeUBOBuffer;
-    std::vector<VkDeviceMemory> m_deltaTimeUBOMemory;
-    std::vector<void*> m_deltaTimeBufferMapped;
+    //---------------------
+    // UNIFORMS
+    //---------------------
+    // regions [0, MAX_FRAMES_IN_FLIGHT) hold the simulation constants, the rest the constants of the drawing
+    std::unique_ptr<UniformAllocator> m_uniformAllocator;
+    // dynamic offsets of the UBOs the current frame is recorded with
+    uint32_t m_simulationUniformOffset = 0;
+    uint32_t m_frameUniformOffset = 0;
 
     VkSampleCountFlagBits m_msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -255,7 +495,74 @@ private:
     bool m_frameBufferResized = false;
     ApplicationStatusNotifier m_appNotifier;
     std::unique_ptr<Camera> m_camera;
-    std::unique_ptr<Material> m_material;
+    std::unique_ptr<MaterialLibrary> m_materials;
+    std::unique_ptr<GpuTimer> m_computeTimer;
+    std::unique_ptr<GpuTimer> m_graphicsTimer;
+    std::unique_ptr<PipelineStatistics> m_renderStatistics;
+    std::unique_ptr<BarnesHut> m_barnesHut;
+    std::unique_ptr<ThreadPool> m_threadPool;
+    std::unique_ptr<CpuSimulation> m_cpuSimulation;
+    std::unique_ptr<ParticleInitializer> m_particleInitializer;
+    std::unique_ptr<MeshCollider> m_meshCollider;
+    std::unique_ptr<ParticleRecorder> m_recorder;
+    std::unique_ptr<ParticleReplay> m_replay;
+    std::unique_ptr<ParticlePicker> m_picker;
+    std::unique_ptr<ParticleTelemetry> m_telemetry;
+    std::unique_ptr<ComputePrimitives> m_primitives;
+    std::unique_ptr<ParticleSorter> m_sorter;
+    std::unique_ptr<ReducedResolutionTarget> m_reducedTarget;
+    std::unique_ptr<MeshPool> m_meshPool;
+    std::unique_ptr<InstancedMeshRenderer> m_instancedRenderer;
+    // one batch per mesh of the scene, instance i goes to the batch i % their count
+    std::vector<uint32_t> m_sceneBatches;
+    uint32_t m_sceneInstanceCount = 0;
+    // transforms of the instances, the changed world transforms are what the instanced renderer uploads
+    std::unique_ptr<SceneGraph> m_sceneGraph;
+    // node of every instance and one node per row of the grid
+    std::vector<uint32_t> m_sceneInstanceNodes;
+    std::vector<uint32_t> m_sceneRowNodes;
+    // instance of every node, SCENE_NO_INSTANCE for the root and the rows that are not drawn
+    std::vector<uint32_t> m_sceneNodeInstances;
+    // one per batch of the scene
+    std::vector<std::unique_ptr<MeshBvh>> m_meshBvhs;
+    std::unique_ptr<GpuDrivenRenderer> m_gpuDrivenRenderer;
+    std::unique_ptr<HiZPyramid> m_hiZ;
+    bool m_isOcclusionCullingEnabled = true;
+    // GPU time of the culling and the draw of the GPU driven objects with the frustum culling only, measured at the
+    // current object count, the occlusion culling reports what it saves against it
+    double m_gpuSceneFrustumOnlyMs = 0.0;
+    bool m_isLodEnabled = true;
+    // same for the GPU time and the triangles without the LODs, the LODs report what they save against it
+    double m_gpuSceneFullDetailMs = 0.0;
+    double m_gpuSceneFullDetailTriangles = 0.0;
+    // bounds of the GPU driven objects, only measured, the GPU still culls and draws them
+    std::unique_ptr<FrustumCuller> m_frustumCuller;
+    bool m_isCpuCullingEnabled = false;
+    // CPU time of recording the culling and the draw of the GPU driven objects since the last report
+    double m_gpuSceneRecordMicroseconds = 0.0;
+    uint64_t m_gpuSceneRecordedFrames = 0;
+    std::string m_physicalDeviceName;
+    double m_lastBenchmarkReport = 0.0;
+    PARTICLE_SIMULATION_MODE m_simulationMode = PARTICLE_SIMULATION_INTEGRATE;
+    PARTICLE_SIMULATION_MODE m_lastRecordedSimulationMode = PARTICLE_SIMULATION_INTEGRATE;
+    PARTICLE_RENDER_MODE m_renderMode = PARTICLE_RENDER_POINTS;
+    PARTICLE_TRANSPARENCY_MODE m_transparencyMode = PARTICLE_TRANSPARENCY_OPAQUE;
+    PARTICLE_RESOLUTION m_resolution = PARTICLE_RESOLUTION_FULL;
+    uint32_t m_drawnParticleCount = PARTICLE_COUNT;
+    PARTICLE_DISTRIBUTION m_particleDistribution = PARTICLE_DISTRIBUTION_SPHERE;
+    bool m_isBillboardStretched = false;
+    bool m_isCollisionEnabled = false;
+    // SSBO with the latest particle state, the other one holds the state one step before
+    uint32_t m_stateIndex = 0;
+    // simulation time that was not simulated yet, always less than one step after AdvanceSimulationClock
+    double m_simulationAccumulator = 0.0;
+    // steps recorded for the current frame
+    uint32_t m_simulationSteps = 0;
+    uint64_t m_totalSimulationSteps = 0;
+    uint64_t m_simulatedFrames = 0;
+    // frames that had their compute command buffer recorded, decides which of them are captured
+    uint64_t m_frameNumber = 0;
+    std::unordered_map<int, bool> m_previousKeyStates;
     double m_lastX;
     double m_lastY;
     glm::vec2 m_mousePos;
@@ -270,7 +577,6 @@ private:
 
     std::vector<Vertex>   vertices;
     std::vector<uint32_t> indices;
-    std::vector<Particle> particles;
 
 
 };
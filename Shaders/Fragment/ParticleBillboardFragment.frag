@@ -0,0 +1,42 @@
+#version 460
+
+// 0 - opaque, 1 - alpha blended (particles are sorted back to front), 2 - weighted blended accumulation
+layout(constant_id = 0) const uint TRANSPARENCY = 0;
+
+layout(location = 0) in vec3 outFragColor;
+layout(location = 1) in vec2 outQuadCoord;
+layout(location = 2) in float outOpacity;
+// colour, or the weighted sum of the premultiplied colours when accumulating
+layout(location = 0) out vec4 FragColor;
+// product of (1 - alpha), only the accumulation has the attachment for it
+layout(location = 1) out float FragRevealage;
+
+// weight of the fragment from its view depth (McGuire and Bavoil, 2013), closer fragments outweigh the farther ones.
+// gl_FragCoord.w is 1 / clip w, which is the view depth for the perspective projection
+float Weight(float alpha) {
+    float depth = 1.0 / gl_FragCoord.w;
+    return alpha * clamp(10.0 / (1e-5 + pow(depth / 5.0, 2.0) + pow(depth / 200.0, 6.0)), 1e-2, 3e3);
+}
+
+void main() {
+    // quad is cut to the circle (ellipse when stretched)
+    float radius = dot(outQuadCoord, outQuadCoord);
+    if (radius > 1.0) {
+        discard;
+    }
+
+    if (TRANSPARENCY == 0) {
+        FragColor = vec4(outFragColor.rgb, 1.0);
+        return;
+    }
+
+    // transparent particles fade out towards the edge
+    float alpha = outOpacity * (1.0 - radius);
+    if (TRANSPARENCY == 1) {
+        FragColor = vec4(outFragColor.rgb, alpha);
+    }
+    else {
+        FragColor = vec4(outFragColor.rgb * alpha, alpha) * Weight(alpha);
+        FragRevealage = alpha;
+    }
+}
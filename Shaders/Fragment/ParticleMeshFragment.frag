@@ -0,0 +1,105 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+
+// 0 - opaque, 1 - alpha blended (particles are sorted back to front), 2 - weighted blended accumulation
+layout(constant_id = 0) const uint TRANSPARENCY = 0;
+
+layout(location = 0) in vec3 outFragColor;
+layout(location = 1) in vec3 outNormal;
+layout(location = 2) in vec3 outWorldPosition;
+layout(location = 3) in vec3 outLightPosition;
+layout(location = 4) in float outOpacity;
+layout(location = 5) in vec2 outUv;
+layout(location = 6) flat in uint outMaterial;
+layout(location = 7) in vec3 outCameraPosition;
+// colour, or the weighted sum of the premultiplied colours when accumulating
+layout(location = 0) out vec4 FragColor;
+// product of (1 - alpha), only the accumulation has the attachment for it
+layout(location = 1) out float FragRevealage;
+
+const uint NO_TEXTURE = 0xFFFFFFFFu;
+
+// has to match MaterialParameters on the c++ side
+struct Material {
+    vec4 baseColor;
+    uint albedoTexture;
+    uint armTexture;     // ambient occlusion, roughness and metalness
+    uint normalTexture;
+    float roughness;
+    float metalness;
+};
+
+// bindless material library, textures are indexed by the material instead of being bound one by one
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler textureSampler;
+layout(std430, set = 1, binding = 2) readonly buffer MaterialTable {
+    Material materials[];
+};
+
+// index can differ between the invocations of the draw, so it has to be marked as non uniform
+vec4 SampleTexture(uint index) {
+    return texture(sampler2D(textures[nonuniformEXT(index)], textureSampler), outUv);
+}
+
+// normal map in the tangent space built from the derivatives, the model has no tangents
+vec3 NormalFromMap(uint index, vec3 normal) {
+    vec3 tangentNormal = SampleTexture(index).xyz * 2.0 - 1.0;
+
+    vec3 Q1 = dFdx(outWorldPosition);
+    vec3 Q2 = dFdy(outWorldPosition);
+    vec2 st1 = dFdx(outUv);
+    vec2 st2 = dFdy(outUv);
+
+    vec3 T = normalize(Q1 * st2.t - Q2 * st1.t);
+    vec3 B = -normalize(cross(normal, T));
+    return normalize(mat3(T, B, normal) * tangentNormal);
+}
+
+// same weight as in ParticleBillboardFragment.frag
+float Weight(float alpha) {
+    float depth = 1.0 / gl_FragCoord.w;
+    return alpha * clamp(10.0 / (1e-5 + pow(depth / 5.0, 2.0) + pow(depth / 200.0, 6.0)), 1e-2, 3e3);
+}
+
+void main() {
+    Material material = materials[outMaterial];
+
+    vec3 albedo = outFragColor * material.baseColor.rgb;
+    if (material.albedoTexture != NO_TEXTURE) {
+        albedo *= SampleTexture(material.albedoTexture).rgb;
+    }
+    float ao = 1.0;
+    float roughness = material.roughness;
+    float metalness = material.metalness;
+    if (material.armTexture != NO_TEXTURE) {
+        vec3 arm = SampleTexture(material.armTexture).rgb;
+        ao = arm.r;
+        roughness = arm.g;
+        metalness = arm.b;
+    }
+    vec3 normal = normalize(outNormal);
+    if (material.normalTexture != NO_TEXTURE) {
+        normal = NormalFromMap(material.normalTexture, normal);
+    }
+
+    // diffuse with a bit of ambient and a blinn-phong highlight, just enough to tell the materials apart
+    vec3 lightDirection = normalize(outLightPosition - outWorldPosition);
+    vec3 viewDirection = normalize(outCameraPosition - outWorldPosition);
+    vec3 halfway = normalize(lightDirection + viewDirection);
+    float diffuse = abs(dot(normal, lightDirection));
+    float shininess = mix(128.0, 4.0, roughness);
+    vec3 specularColor = mix(vec3(0.04), albedo, metalness);
+    vec3 specular = specularColor * pow(max(dot(normal, halfway), 0.0), shininess);
+    vec3 color = albedo * (0.2 * ao + 0.8 * diffuse * (1.0 - metalness)) + specular;
+
+    if (TRANSPARENCY == 0) {
+        FragColor = vec4(color, 1.0);
+    }
+    else if (TRANSPARENCY == 1) {
+        FragColor = vec4(color, outOpacity);
+    }
+    else {
+        FragColor = vec4(color * outOpacity, outOpacity) * Weight(outOpacity);
+        FragRevealage = outOpacity;
+    }
+}
@@ -0,0 +1,65 @@
+#version 460
+
+// writes the particles drawn at reduced resolution in to the full resolution colour and depth.
+// Of the 4 texels around the pixel only the ones at about the same view distance as the nearest covered one are
+// blended, so the edges of the particles in front stay sharp and the ones behind do not bleed through.
+// Colour is premultiplied by the coverage, it is blended with one / one minus src alpha
+layout(binding = 0) uniform sampler2D reducedColor;
+layout(binding = 1) uniform sampler2D reducedDepth;
+
+// has to match ReducedResolutionTarget::PushConstants
+layout(push_constant) uniform UpsampleParameters{
+    vec2 depthUnproject;    // projection[2][2] and projection[3][2]
+    float divisor;
+    float depthTolerance;   // fraction of the view distance of the nearest covered texel
+}parameters;
+
+layout(location = 0) out vec4 FragColor;
+
+float ViewDistance(float depth) {
+    return parameters.depthUnproject.y / (depth + parameters.depthUnproject.x);
+}
+
+void main() {
+    ivec2 size = textureSize(reducedColor, 0);
+    // position in the reduced texels, centre of the texel is at .5
+    vec2 position = gl_FragCoord.xy / parameters.divisor - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 fraction = position - vec2(base);
+
+    vec4 colors[4];
+    float depths[4];
+    float weights[4];
+    float nearestDepth = 1.0;
+    bool isCovered = false;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), size - 1);
+        colors[i] = texelFetch(reducedColor, texel, 0);
+        depths[i] = texelFetch(reducedDepth, texel, 0).r;
+        weights[i] = (offset.x == 1 ? fraction.x : 1.0 - fraction.x) * (offset.y == 1 ? fraction.y : 1.0 - fraction.y);
+        if (colors[i].a > 0.0) {
+            isCovered = true;
+            nearestDepth = min(nearestDepth, depths[i]);
+        }
+    }
+
+    if (!isCovered) {
+        discard;
+    }
+
+    float nearestDistance = ViewDistance(nearestDepth);
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        // empty texels soften the silhouette, covered ones too far behind belong to another particle
+        bool isEmpty = colors[i].a <= 0.0;
+        if (isEmpty || ViewDistance(depths[i]) - nearestDistance <= parameters.depthTolerance * nearestDistance) {
+            sum += colors[i] * weights[i];
+            weightSum += weights[i];
+        }
+    }
+
+    FragColor = sum / max(weightSum, 1e-5);
+    gl_FragDepth = nearestDepth;
+}
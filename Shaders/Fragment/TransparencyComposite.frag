@@ -0,0 +1,36 @@
+#version 460
+
+// resolves the weighted blended accumulation on top of the opaque colour, it is blended with
+// src alpha / one minus src alpha so the opaque colour is hidden by (1 - revealage).
+// Attachments are multisampled and sample shading is not enabled, so the samples are averaged per pixel
+layout(constant_id = 0) const int SAMPLE_COUNT = 1;
+
+// weighted sum of the premultiplied colours (rgb) and of the alphas (a)
+layout(input_attachment_index = 0, binding = 0) uniform subpassInputMS accumulation;
+// product of (1 - alpha) of every transparent fragment
+layout(input_attachment_index = 1, binding = 1) uniform subpassInputMS revealage;
+
+layout(location = 0) out vec4 FragColor;
+
+void main() {
+    vec4 accumulated = vec4(0.0);
+    float revealed = 0.0;
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        accumulated += subpassLoad(accumulation, i);
+        revealed += subpassLoad(revealage, i).r;
+    }
+    accumulated /= float(SAMPLE_COUNT);
+    revealed /= float(SAMPLE_COUNT);
+
+    // nothing transparent covers the pixel
+    if (revealed >= 1.0) {
+        discard;
+    }
+
+    // half floats overflow when many heavy fragments overlap, the average colour is lost but the coverage is not
+    if (any(isinf(accumulated.rgb))) {
+        accumulated.rgb = vec3(accumulated.a);
+    }
+
+    FragColor = vec4(accumulated.rgb / max(accumulated.a, 1e-5), 1.0 - revealed);
+}
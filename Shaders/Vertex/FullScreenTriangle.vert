@@ -0,0 +1,8 @@
+#version 460
+
+// single triangle that covers the whole screen, there is no vertex input, 3 vertices are drawn
+
+void main() {
+    vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
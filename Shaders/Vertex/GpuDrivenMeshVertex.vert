@@ -0,0 +1,56 @@
+#version 460
+
+// objects of the GPU driven scene, the culling wrote the index of the object in to firstInstance of its draw,
+// so gl_InstanceIndex is the object
+// outputs are the same as the ones of ParticleMeshVertex.vert, the shading is shared
+
+layout (set = 0, binding = 0) uniform UnifromBufferObject {
+    vec3 camPos;
+    vec3 lightPosition;
+    mat4 view;
+    mat4 proj;
+}ubo;
+
+// has to match GpuObject in GpuDrivenRenderer.hpp
+struct Object{
+    mat4 transform;
+    vec4 color;
+    vec4 bounds;
+    uint mesh;
+    uint material;
+    uint padding0;
+    uint padding1;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Objects{
+    Object objects[];
+};
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 2) in vec3 inNormal;
+layout (location = 3) in vec2 inUv;
+
+layout(location = 0) out vec3 outFragColor;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 outWorldPosition;
+layout(location = 3) out vec3 outLightPosition;
+layout(location = 4) out float outOpacity;
+layout(location = 5) out vec2 outUv;
+layout(location = 6) flat out uint outMaterial;
+layout(location = 7) out vec3 outCameraPosition;
+
+void main() {
+    Object object = objects[gl_InstanceIndex];
+    vec4 worldPosition = object.transform * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * worldPosition;
+
+    // scale of the objects is uniform, the fragment shader normalizes the normal
+    outNormal = mat3(object.transform) * inNormal;
+    outWorldPosition = worldPosition.xyz;
+    outLightPosition = ubo.lightPosition;
+    outFragColor = object.color.rgb;
+    outOpacity = 1.0;
+    outUv = inUv;
+    outMaterial = object.material;
+    outCameraPosition = ubo.camPos;
+}
@@ -0,0 +1,44 @@
+#version 460
+
+// every instance is one copy of the mesh, its transform, colour and material come from the instance buffer
+// (second vertex binding with the instance input rate), so any amount of copies is one draw
+// outputs are the same as the ones of ParticleMeshVertex.vert, the shading is shared
+
+layout (set = 0, binding = 0) uniform UnifromBufferObject {
+    vec3 camPos;
+    vec3 lightPosition;
+    mat4 view;
+    mat4 proj;
+}ubo;
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 2) in vec3 inNormal;
+layout (location = 3) in vec2 inUv;
+// per instance, transform takes the locations 4 to 7
+layout (location = 4) in mat4 inTransform;
+layout (location = 8) in vec4 inInstanceColor;
+layout (location = 9) in uint inMaterial;
+
+layout(location = 0) out vec3 outFragColor;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 outWorldPosition;
+layout(location = 3) out vec3 outLightPosition;
+layout(location = 4) out float outOpacity;
+layout(location = 5) out vec2 outUv;
+layout(location = 6) flat out uint outMaterial;
+layout(location = 7) out vec3 outCameraPosition;
+
+void main() {
+    vec4 worldPosition = inTransform * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * worldPosition;
+
+    // scale of the instances is uniform, the fragment shader normalizes the normal
+    outNormal = mat3(inTransform) * inNormal;
+    outWorldPosition = worldPosition.xyz;
+    outLightPosition = ubo.lightPosition;
+    outFragColor = inInstanceColor.rgb;
+    outOpacity = 1.0;
+    outUv = inUv;
+    outMaterial = inMaterial;
+    outCameraPosition = ubo.camPos;
+}
@@ -0,0 +1,90 @@
+#version 460
+
+// every particle is one instance of 4 vertex triangle strip, there is no vertex input,
+// particle is read from the SSBO with gl_InstanceIndex and the quad is expanded in the view space
+// so its size shrinks with the distance like any other geometry
+// position is interpolated between the previous and the latest simulation state
+
+layout (binding = 0) uniform UnifromBufferObject {
+    vec3 camPos;
+    vec3 lightPosition;
+    mat4 view;
+    mat4 proj;
+}ubo;
+
+//same as in c++ side
+struct Particle{
+    vec3 position;
+    vec3 velocity;
+    vec4 color;
+};
+
+layout(std140, binding = 1) readonly buffer ParticleSSBO{
+    Particle particles[];
+};
+
+layout(std140, binding = 2) readonly buffer PreviousParticleSSBO{
+    Particle previousParticles[];
+};
+
+// particles sorted from the farthest to the closest one, only for the sorted transparency
+layout(std430, binding = 3) readonly buffer DrawOrder{
+    uint drawOrder[];
+};
+
+layout(push_constant) uniform RenderParameters{
+    mat4 model;             // per draw, the particles are in its space
+    float particleSize;     // half of the quad size in the view space
+    float stretchFactor;    // 0 turns of the stretching along the velocity
+    float maxStretch;
+    float interpolation;    // how far between the previous and the latest simulation state the frame is
+    uint highlightedParticle;   // particle under the mouse
+    float opacity;          // alpha of the transparent particles
+    uint useDrawOrder;      // instances are drawn in the order of drawOrder instead of the particle order
+    float resolutionScale;  // unused, sizes are in the view space
+    uint materialCount;     // unused, billboards have no material
+}parameters;
+
+layout(location = 0) out vec3 outFragColor;
+layout(location = 1) out vec2 outQuadCoord;
+layout(location = 2) out float outOpacity;
+
+const vec2 CORNERS[4] = vec2[](
+    vec2(-1.0, -1.0),
+    vec2( 1.0, -1.0),
+    vec2(-1.0,  1.0),
+    vec2( 1.0,  1.0)
+);
+
+void main() {
+    uint particleIndex = parameters.useDrawOrder != 0 ? drawOrder[gl_InstanceIndex] : uint(gl_InstanceIndex);
+    Particle particle = particles[particleIndex];
+    vec2 corner = CORNERS[gl_VertexIndex];
+
+    mat4 modelView = ubo.view * parameters.model;
+    vec3 position = mix(previousParticles[particleIndex].position, particle.position, parameters.interpolation);
+    vec4 viewPosition = modelView * vec4(position, 1.0);
+
+    vec2 right = vec2(1.0, 0.0);
+    vec2 up = vec2(0.0, 1.0);
+    bool isHighlighted = particleIndex == parameters.highlightedParticle;
+    vec2 size = vec2(isHighlighted ? 2.0 * parameters.particleSize : parameters.particleSize);
+
+    if (parameters.stretchFactor > 0.0) {
+        // stretch along the velocity projected to the view plane
+        vec2 viewVelocity = (modelView * vec4(particle.velocity, 0.0)).xy;
+        float speed = length(viewVelocity);
+        if (speed > 1e-7) {
+            up = viewVelocity / speed;
+            right = vec2(up.y, -up.x);
+            size.y *= min(1.0 + speed * parameters.stretchFactor, parameters.maxStretch);
+        }
+    }
+
+    viewPosition.xy += right * corner.x * size.x + up * corner.y * size.y;
+
+    gl_Position = ubo.proj * viewPosition;
+    outFragColor = isHighlighted ? vec3(1.0) : particle.color.rgb;
+    outQuadCoord = corner;
+    outOpacity = parameters.opacity;
+}
@@ -0,0 +1,92 @@
+#version 460
+
+// every particle is one instance of the loaded model, there is no per instance vertex input,
+// particle is read from the SSBO with gl_InstanceIndex and the model is turned so its +Z points along the velocity
+// position is interpolated between the previous and the latest simulation state
+
+layout (binding = 0) uniform UnifromBufferObject {
+    vec3 camPos;
+    vec3 lightPosition;
+    mat4 view;
+    mat4 proj;
+}ubo;
+
+//same as in c++ side
+struct Particle{
+    vec3 position;
+    vec3 velocity;
+    vec4 color;
+};
+
+layout(std140, binding = 1) readonly buffer ParticleSSBO{
+    Particle particles[];
+};
+
+layout(std140, binding = 2) readonly buffer PreviousParticleSSBO{
+    Particle previousParticles[];
+};
+
+// particles sorted from the farthest to the closest one, only for the sorted transparency
+layout(std430, binding = 3) readonly buffer DrawOrder{
+    uint drawOrder[];
+};
+
+layout(push_constant) uniform RenderParameters{
+    mat4 model;             // uniform scale, its upper 3x3 turns the normals as well
+    float particleSize;     // radius of the model in the particle space, the model is normalized to the radius of 1
+    float stretchFactor;
+    float maxStretch;
+    float interpolation;    // how far between the previous and the latest simulation state the frame is
+    uint highlightedParticle;   // particle under the mouse
+    float opacity;          // alpha of the transparent particles
+    uint useDrawOrder;      // instances are drawn in the order of drawOrder instead of the particle order
+    float resolutionScale;  // unused, sizes are in the view space
+    uint materialCount;     // particles cycle through the materials of the library
+}parameters;
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 2) in vec3 inNormal;
+layout (location = 3) in vec2 inUv;
+
+layout(location = 0) out vec3 outFragColor;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 outWorldPosition;
+layout(location = 3) out vec3 outLightPosition;
+layout(location = 4) out float outOpacity;
+layout(location = 5) out vec2 outUv;
+layout(location = 6) flat out uint outMaterial;
+layout(location = 7) out vec3 outCameraPosition;
+
+void main() {
+    uint particleIndex = parameters.useDrawOrder != 0 ? drawOrder[gl_InstanceIndex] : uint(gl_InstanceIndex);
+    Particle particle = particles[particleIndex];
+    vec3 position = mix(previousParticles[particleIndex].position, particle.position, parameters.interpolation);
+
+    // orthonormal basis from the velocity, particles that do not move keep the orientation of the model
+    vec3 forward = vec3(0.0, 0.0, 1.0);
+    float speed = length(particle.velocity);
+    if (speed > 1e-7) {
+        forward = particle.velocity / speed;
+    }
+    vec3 up = abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(up, forward));
+    up = cross(forward, right);
+    mat3 orientation = mat3(right, up, forward);
+
+    bool isHighlighted = particleIndex == parameters.highlightedParticle;
+    float size = isHighlighted ? 2.0 * parameters.particleSize : parameters.particleSize;
+
+    vec4 worldPosition = parameters.model * vec4(position + orientation * (inPosition * size), 1.0);
+    gl_Position = ubo.proj * ubo.view * worldPosition;
+
+    // rotation only, so the normal does not need the inverse transpose of it
+    outNormal = mat3(parameters.model) * (orientation * inNormal);
+    outWorldPosition = worldPosition.xyz;
+    outLightPosition = ubo.lightPosition;
+    outFragColor = isHighlighted ? vec3(1.0) : particle.color.rgb;
+    outOpacity = parameters.opacity;
+    outUv = inUv;
+    outCameraPosition = ubo.camPos;
+    // index of the particle, not of the instance, so the sorted draw keeps the materials of the particles
+    outMaterial = particleIndex % max(parameters.materialCount, 1u);
+}
@@ -2,22 +2,37 @@
 
 
 layout(location = 0) in vec3 inParticlePosition;
+// same particle in the previous simulation state (second vertex buffer)
+layout(location = 1) in vec3 inPreviousParticlePosition;
 layout(location = 2) in vec4 inParticleColour;
 
 layout (binding = 0) uniform UnifromBufferObject {
     vec3 camPos;
     vec3 lightPosition;
-    mat4 model;
     mat4 view;
     mat4 proj;
-    mat4 normalMatix;
 }ubo;
 
+layout(push_constant) uniform RenderParameters{
+    mat4 model;             // per draw, the particles are in its space
+    float particleSize;
+    float stretchFactor;
+    float maxStretch;
+    float interpolation;    // how far between the previous and the latest simulation state the frame is
+    uint highlightedParticle;   // particle under the mouse
+    float opacity;          // points are always opaque
+    uint useDrawOrder;
+    float resolutionScale;  // 1 / divisor of the reduced resolution target, point size is in pixels
+    uint materialCount;     // unused, points have no material
+}parameters;
+
 layout(location = 0) out vec3 outFragColor;
 
 void main() {
-    gl_PointSize = 10.0;
+    bool isHighlighted = uint(gl_VertexIndex) == parameters.highlightedParticle;
+    gl_PointSize = (isHighlighted ? 20.0 : 10.0) * parameters.resolutionScale;
 
-    gl_Position =  ubo.proj * ubo.view * ubo.model * vec4(inParticlePosition.xyz,1.0);
-    outFragColor = inParticleColour.rgb;
+    vec3 position = mix(inPreviousParticlePosition, inParticlePosition, parameters.interpolation);
+    gl_Position =  ubo.proj * ubo.view * parameters.model * vec4(position,1.0);
+    outFragColor = isHighlighted ? vec3(1.0) : inParticleColour.rgb;
 }
\ No newline at end of file
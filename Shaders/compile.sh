@@ -44,7 +44,8 @@ for comp_shader in Compute/*.comp; do
     if [[ -f "$comp_shader" ]]; then
         shader_name=$(basename "$comp_shader")
         echo "Compiling compute shader: $shader_name"
-        $VULKAN_SDK_PATH "$comp_shader" -V -o "Compiled/${shader_name%.comp}.spv"
+        # subgroup operations need at least SPIR-V 1.3
+        $VULKAN_SDK_PATH "$comp_shader" -V --target-env vulkan1.1 -o "Compiled/${shader_name%.comp}.spv"
         if [[ $? -eq 0 ]]; then
             echo "Compiled $comp_shader to Compiled/${shader_name%.comp}.spv"
         else